@@ -124,8 +124,10 @@ int main(int argc, char *argv[]) {
     lamure::ren::lod_stream* in_access = new lamure::ren::lod_stream();
     in_access->open(lod_filename);
 
-    size_t size_of_node = (uint64_t)bvh->get_primitives_per_node() * sizeof(lamure::ren::dataset::serialized_surfel);
+    const lamure::surfel_encoding encoding = bvh->get_surfel_encoding();
+    const size_t size_of_surfel = lamure::surfel_codec::encoded_size(encoding);
     xyzall_surfel_t* surfels = new xyzall_surfel_t[bvh->get_primitives_per_node()];
+    char* node_data = new char[(uint64_t)bvh->get_primitives_per_node() * size_of_surfel];
 
     lamure::node_t first_leaf = bvh->get_first_node_id_of_depth(depth);
     lamure::node_t num_leafs = bvh->get_length_of_depth(depth);
@@ -147,7 +149,14 @@ int main(int argc, char *argv[]) {
         }
 #endif
         
-        in_access->read((char*)surfels, leaf_id * size_of_node, size_of_node);
+        const lamure::lod_node_extent extent = bvh->get_node_extent(leaf_id);
+        if (extent.length > 0) {
+            in_access->read(node_data, extent.offset * size_of_surfel, extent.length * size_of_surfel);
+        }
+        const scm::gl::boxf& box = bvh->get_bounding_box(leaf_id);
+        lamure::surfel_codec::decode_node(node_data, (char*)surfels,
+                                          extent.length, encoding,
+                                          box.min_vertex(), box.max_vertex());
 
         std::ios::openmode mode = std::ios::out | std::ios::app;
         out_stream.open(xyz_filename, mode);
@@ -155,7 +164,7 @@ int main(int argc, char *argv[]) {
         std::string filestr;
         std::stringstream ss(filestr);
         
-        for (unsigned int i = 0; i < bvh->get_primitives_per_node(); ++i) {
+        for (unsigned int i = 0; i < extent.length; ++i) {
             const xyzall_surfel_t& s = surfels[i];
 
             if (s.size_ <= 0.0f) {
@@ -194,6 +203,7 @@ int main(int argc, char *argv[]) {
     std::cout << "done. (" << num_surfels_excluded << " surfels excluded)" << std::endl;
 
     delete[] surfels;
+    delete[] node_data;
     delete in_access;
     delete bvh;
 
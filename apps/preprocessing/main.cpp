@@ -114,6 +114,49 @@ int main(int argc, const char *argv[])
          po::value<int>()->default_value(150),
          "buffer size in MiB")
 
+        ("io-backend",
+         po::value<std::string>()->default_value("stream"),
+         "Backend for out-of-core file access. Possible values:\n"
+         "  stream - buffered stream, one access at a time\n"
+         "  positional - concurrent positional reads and writes (not on Windows)")
+
+        ("interm-compression",
+         po::value<std::string>()->default_value("none"),
+         "Storage of the intermediate surfel files (.bin, .lv*). Possible values:\n"
+         "  none - surfels are stored as they are in memory\n"
+         "  block - lossless compression of blocks of surfels, the files are\n"
+         "          smaller but accesses are serialized")
+
+        ("split-algo",
+         po::value<std::string>()->default_value("sort"),
+         "Ordering of node surfels before splitting them during the downsweep. Possible values:\n"
+         "  sort - comparison sort of whole surfels\n"
+         "  keysort - radix sort of compact (coordinate, index) keys\n"
+         "  partition - multi-way selection without sorting the children")
+
+        ("downsweep-algo",
+         po::value<std::string>()->default_value("pernode"),
+         "Construction of the out-of-core tree levels. Possible values:\n"
+         "  pernode - sort and split every out-of-core node along its longest axis\n"
+         "  morton - sort all surfels along a Morton curve once and split the\n"
+         "           out-of-core levels into contiguous ranges")
+
+        ("lod-encoding",
+         po::value<std::string>()->default_value("raw"),
+         "Encoding of the surfels in the .lod file. Possible values:\n"
+         "  raw - 32 bytes per surfel, float attributes\n"
+         "  quantized - 16 bytes per surfel, positions relative to the node\n"
+         "              bounding box, octahedral normals, logarithmic radii")
+
+        ("lod-layout",
+         po::value<std::string>()->default_value("fixed"),
+         "Placement of the nodes in the .lod file. Possible values:\n"
+         "  fixed - every node is padded to the desired number of surfels\n"
+         "  compact - nodes store only their surfels, the .bvh file stores\n"
+         "            the offset and length of every node\n"
+         "  clustered - compact, with the nodes of a subtree stored close\n"
+         "              together (van Emde Boas order)")
+
         ("reduction-algo",
          po::value<std::string>()->default_value("ndc"),
          "Reduction strategy for the LOD construction. Possible values:\n"
@@ -271,6 +314,12 @@ int main(int argc, const char *argv[])
         std::string normal_computation_algo = vm["normal-computation-algo"].as<std::string>();
         std::string radius_computation_algo = vm["radius-computation-algo"].as<std::string>();
         std::string rep_radius_algo = vm["rep-radius-algo"].as<std::string>();
+        std::string io_backend = vm["io-backend"].as<std::string>();
+        std::string interm_compression = vm["interm-compression"].as<std::string>();
+        std::string split_algo = vm["split-algo"].as<std::string>();
+        std::string lod_encoding = vm["lod-encoding"].as<std::string>();
+        std::string lod_layout = vm["lod-layout"].as<std::string>();
+        std::string downsweep_algo = vm["downsweep-algo"].as<std::string>();
 
         if (reduction_algo == "ndc")
             desc.reduction_algo        = lamure::pre::reduction_algorithm::ndc;
@@ -336,6 +385,64 @@ int main(int argc, const char *argv[])
             return EXIT_FAILURE;
         }
 
+        if (io_backend == "stream")
+            desc.io_backend            = lamure::pre::file_backend::stream;
+        else if (io_backend == "positional")
+            desc.io_backend            = lamure::pre::file_backend::positional;
+        else {
+            std::cerr << "Unknown file backend" << details_msg;
+            return EXIT_FAILURE;
+        }
+
+        if (interm_compression == "none")
+            desc.interm_compression    = lamure::pre::file_compression::none;
+        else if (interm_compression == "block")
+            desc.interm_compression    = lamure::pre::file_compression::block;
+        else {
+            std::cerr << "Unknown intermediate compression" << details_msg;
+            return EXIT_FAILURE;
+        }
+
+        if (split_algo == "sort")
+            desc.split_algo            = lamure::pre::split_algorithm::surfel_sort;
+        else if (split_algo == "keysort")
+            desc.split_algo            = lamure::pre::split_algorithm::key_sort;
+        else if (split_algo == "partition")
+            desc.split_algo            = lamure::pre::split_algorithm::partition;
+        else {
+            std::cerr << "Unknown split algorithm" << details_msg;
+            return EXIT_FAILURE;
+        }
+
+        if (downsweep_algo == "pernode")
+            desc.downsweep_algo        = lamure::pre::downsweep_algorithm::per_node;
+        else if (downsweep_algo == "morton")
+            desc.downsweep_algo        = lamure::pre::downsweep_algorithm::morton;
+        else {
+            std::cerr << "Unknown downsweep algorithm" << details_msg;
+            return EXIT_FAILURE;
+        }
+
+        if (lod_encoding == "raw")
+            desc.lod_encoding          = lamure::surfel_encoding::raw;
+        else if (lod_encoding == "quantized")
+            desc.lod_encoding          = lamure::surfel_encoding::quantized;
+        else {
+            std::cerr << "Unknown lod encoding" << details_msg;
+            return EXIT_FAILURE;
+        }
+
+        if (lod_layout == "fixed")
+            desc.lod_layout            = lamure::node_layout::fixed;
+        else if (lod_layout == "compact")
+            desc.lod_layout            = lamure::node_layout::compact;
+        else if (lod_layout == "clustered")
+            desc.lod_layout            = lamure::node_layout::clustered;
+        else {
+            std::cerr << "Unknown lod layout" << details_msg;
+            return EXIT_FAILURE;
+        }
+
         desc.input_file                   = fs::canonical(input_file).string();
         desc.working_directory            = fs::canonical(wd).string();
         desc.max_fan_factor               = std::min(std::max(vm["max-fanout"].as<int>(), 2), 8);
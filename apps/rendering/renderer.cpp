@@ -320,7 +320,6 @@ render_one_pass_LQ(lamure::context_t context_id,
                 continue;
             }
 
-            size_t surfels_per_node_of_model = bvh->get_primitives_per_node();
             //store culling result and push it back for second pass#
 
             std::vector<scm::gl::boxf>const & bounding_box_vector = bvh->get_bounding_boxes();
@@ -365,7 +364,7 @@ render_one_pass_LQ(lamure::context_t context_id,
                     context_->begin_query(depth_pass_timer_query);
 #endif
 
-                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (node_slot_aggregate.slot_id_) * number_of_surfels_per_node, surfels_per_node_of_model);
+                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (node_slot_aggregate.slot_id_) * number_of_surfels_per_node, bvh->get_primitives_in_node(node_slot_aggregate.node_id_));
 
 #ifdef LAMURE_RENDERING_ENABLE_PERFORMANCE_MEASUREMENT
 
@@ -507,7 +506,6 @@ render_one_pass_HQ(lamure::context_t context_id,
 
 
                             
-                            size_t surfels_per_node_of_model = bvh->get_primitives_per_node();
 
                             for(auto const& node_slot_aggregate : renderable) {
                                 uint32_t node_culling_result = camera.cull_against_frustum( frustum_by_model ,bounding_box_vector[ node_slot_aggregate.node_id_ ] );
@@ -521,7 +519,7 @@ render_one_pass_HQ(lamure::context_t context_id,
                                 context_->begin_query(depth_pass_timer_query);
 #endif
 
-                                context_->draw_arrays(PRIMITIVE_POINT_LIST, (node_slot_aggregate.slot_id_) * number_of_surfels_per_node, surfels_per_node_of_model);
+                                context_->draw_arrays(PRIMITIVE_POINT_LIST, (node_slot_aggregate.slot_id_) * number_of_surfels_per_node, bvh->get_primitives_in_node(node_slot_aggregate.node_id_));
 
                                 ++non_culled_node_idx;
                             }
@@ -654,7 +652,6 @@ render_two_pass_HQ(lamure::context_t context_id,
             }
 
 
-            size_t surfels_per_node_of_model = bvh->get_primitives_per_node();
             //store culling result and push it back for second pass#
 
             std::vector<scm::gl::boxf>const & bounding_box_vector = bvh->get_bounding_boxes();
@@ -679,7 +676,7 @@ render_two_pass_HQ(lamure::context_t context_id,
                     context_->begin_query(depth_pass_timer_query);
 #endif
 
-                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (node_slot_aggregate.slot_id_) * number_of_surfels_per_node, surfels_per_node_of_model);
+                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (node_slot_aggregate.slot_id_) * number_of_surfels_per_node, bvh->get_primitives_in_node(node_slot_aggregate.node_id_));
 
 #ifdef LAMURE_RENDERING_ENABLE_PERFORMANCE_MEASUREMENT
 
@@ -732,7 +729,6 @@ render_two_pass_HQ(lamure::context_t context_id,
                 continue;
             }
 
-            size_t surfels_per_node_of_model = bvh->get_primitives_per_node();
 
 
             upload_transformation_matrices(camera, model_id, RenderPass::ACCUMULATION);
@@ -747,7 +743,7 @@ render_two_pass_HQ(lamure::context_t context_id,
                     scm::gl::timer_query_ptr accumulation_pass_timer_query = device_->create_timer_query();
                     context_->begin_query(accumulation_pass_timer_query);
 #endif
-                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (node_slot_aggregate.slot_id_) * number_of_surfels_per_node, surfels_per_node_of_model);
+                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (node_slot_aggregate.slot_id_) * number_of_surfels_per_node, bvh->get_primitives_in_node(node_slot_aggregate.node_id_));
 #ifdef LAMURE_RENDERING_ENABLE_PERFORMANCE_MEASUREMENT
                     context_->end_query(accumulation_pass_timer_query);
                     context_->collect_query_results(accumulation_pass_timer_query);
@@ -289,7 +289,6 @@ render(lamure::context_t context_id, lamure::ren::camera const& camera, const la
 
                             std::vector<cut::node_slot_aggregate> renderable = cut.complete_set();
 
-                            uint32_t surfels_per_node_of_model = bvh->get_primitives_per_node();
                             //store culling result and push it back for second pass#
 
                             std::vector<scm::gl::boxf>const & bounding_box_vector = bvh->get_bounding_boxes();
@@ -323,7 +322,7 @@ render(lamure::context_t context_id, lamure::ren::camera const& camera, const la
 
                                     context_->apply();
 
-                                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (k->slot_id_) * database->get_primitives_per_node(), surfels_per_node_of_model);
+                                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (k->slot_id_) * database->get_primitives_per_node(), bvh->get_primitives_in_node(k->node_id_));
                                 }
 
 
@@ -384,7 +383,6 @@ render(lamure::context_t context_id, lamure::ren::camera const& camera, const la
 
                             std::vector<cut::node_slot_aggregate> renderable = cut.complete_set();
 
-                            uint32_t surfels_per_node_of_model = bvh->get_primitives_per_node();
                             //store culling result and push it back for second pass#
 
 
@@ -406,7 +404,7 @@ render(lamure::context_t context_id, lamure::ren::camera const& camera, const la
                                     context_->apply();
 
 
-                                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (k->slot_id_) * database->get_primitives_per_node(), surfels_per_node_of_model);
+                                    context_->draw_arrays(PRIMITIVE_POINT_LIST, (k->slot_id_) * database->get_primitives_per_node(), bvh->get_primitives_in_node(k->node_id_));
 
                                     ++actually_rendered_nodes;
                                 }
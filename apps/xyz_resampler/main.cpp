@@ -201,6 +201,12 @@ int main(int argc, const char *argv[])
         desc.translate_to_origin          = !vm.count("no-translate-to-origin");
         desc.resample                     = true;
         desc.outlier_ratio                = 0.0f;
+        desc.io_backend                   = lamure::pre::file_backend::stream;
+        desc.interm_compression           = lamure::pre::file_compression::none;
+        desc.split_algo                   = lamure::pre::split_algorithm::surfel_sort;
+        desc.downsweep_algo               = lamure::pre::downsweep_algorithm::per_node;
+        desc.lod_encoding                 = lamure::surfel_encoding::raw;
+        desc.lod_layout                   = lamure::node_layout::fixed;
         // preprocess
         lamure::pre::builder builder(desc);
         if (!builder.resample())
@@ -0,0 +1,112 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef COMMON_SURFEL_CODEC_H_
+#define COMMON_SURFEL_CODEC_H_
+
+#include <lamure/platform.h>
+#include <lamure/types.h>
+
+#include <cstdint>
+
+namespace lamure
+{
+
+/**
+* Encoding of the surfels in a .lod file. It is recorded in the tree
+* segment of the .bvh file, so that the loader can decode the nodes.
+*/
+enum class surfel_encoding : uint32_t {
+    raw       = 0, // 32 bytes: float xyz, rgb + padding, float radius, float normal
+    quantized = 1  // 16 bytes, see surfel_codec
+};
+
+/**
+* Placement of the nodes in a .lod file. With the fixed layout, node i
+* starts at surfel i * surfels_per_node and is padded with empty surfels.
+* With the compact layout, a node holds only its real surfels and the .bvh
+* file stores the extent of every node. The clustered layout is compact, but
+* places the nodes in van Emde Boas order, so that a subtree is stored in one
+* contiguous range of the file.
+*/
+enum class node_layout : uint32_t {
+    fixed     = 0,
+    compact   = 1,
+    clustered = 2
+};
+
+struct lod_node_extent {
+    uint64_t offset; // in surfels from the start of the .lod file
+    uint64_t length; // in surfels
+};
+
+/**
+* Conversion between the raw 32 byte surfel layout of a .lod node and the
+* quantized 16 byte layout:
+*
+* - position: 3 x 16 bit, relative to the bounding box of the node
+* - normal:   2 x 16 bit, octahedral mapping
+* - radius:   16 bit, logarithmic; code 0 is a radius of 0
+* - color:    3 x 8 bit, unchanged
+*
+* The bounding box must be the one that is stored for the node in the .bvh
+* file, the encoder and the decoder have to see the same float values.
+*/
+class COMMON_DLL surfel_codec
+{
+public:
+
+    struct raw_surfel {
+        float x, y, z;
+        uint8_t r, g, b, fake;
+        float size;
+        float nx, ny, nz;
+    };
+
+    struct quantized_surfel {
+        uint16_t x, y, z;
+        uint16_t normal_u, normal_v;
+        uint16_t size;
+        uint8_t r, g, b, fake;
+    };
+
+    static size_t       encoded_size(const surfel_encoding encoding);
+
+    static void         encode(const raw_surfel* input,
+                               quantized_surfel* output,
+                               const size_t num_surfels,
+                               const vec3f& box_min,
+                               const vec3f& box_max);
+
+    static void         decode(const quantized_surfel* input,
+                               raw_surfel* output,
+                               const size_t num_surfels,
+                               const vec3f& box_min,
+                               const vec3f& box_max);
+
+    /**
+     * Converts num_surfels surfels of a node between encodings. Input and
+     * output are the node data as stored in the .lod file.
+     */
+    static void         encode_node(const char* input,
+                                    char* output,
+                                    const size_t num_surfels,
+                                    const surfel_encoding encoding,
+                                    const vec3f& box_min,
+                                    const vec3f& box_max);
+
+    static void         decode_node(const char* input,
+                                    char* output,
+                                    const size_t num_surfels,
+                                    const surfel_encoding encoding,
+                                    const vec3f& box_min,
+                                    const vec3f& box_max);
+};
+
+} // namespace lamure
+
+#endif // COMMON_SURFEL_CODEC_H_
@@ -0,0 +1,203 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/surfel_codec.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace lamure
+{
+
+namespace {
+
+static_assert(sizeof(surfel_codec::raw_surfel) == 32, "raw surfel must be 32 bytes");
+static_assert(sizeof(surfel_codec::quantized_surfel) == 16, "quantized surfel must be 16 bytes");
+
+const float max_code = 65535.f;
+
+// radii are stored as log2 in [min_log_radius, max_log_radius]
+const float min_log_radius = -32.f;
+const float max_log_radius = 32.f;
+
+uint16_t
+quantize_unit(const float value)
+{
+    const float clamped = std::min(std::max(value, 0.f), 1.f);
+    return uint16_t(std::lround(clamped * max_code));
+}
+
+float
+dequantize_unit(const uint16_t code)
+{
+    return float(code) / max_code;
+}
+
+float
+sign_not_zero(const float value)
+{
+    return value >= 0.f ? 1.f : -1.f;
+}
+
+void
+encode_normal(const float nx, const float ny, const float nz,
+              uint16_t& u, uint16_t& v)
+{
+    const float l1_norm = std::abs(nx) + std::abs(ny) + std::abs(nz);
+    float px = 0.f, py = 0.f;
+    if (l1_norm > 0.f) {
+        px = nx / l1_norm;
+        py = ny / l1_norm;
+        if (nz < 0.f) {
+            const float fx = (1.f - std::abs(py)) * sign_not_zero(px);
+            const float fy = (1.f - std::abs(px)) * sign_not_zero(py);
+            px = fx;
+            py = fy;
+        }
+    }
+    u = quantize_unit(px * 0.5f + 0.5f);
+    v = quantize_unit(py * 0.5f + 0.5f);
+}
+
+void
+decode_normal(const uint16_t u, const uint16_t v,
+              float& nx, float& ny, float& nz)
+{
+    nx = dequantize_unit(u) * 2.f - 1.f;
+    ny = dequantize_unit(v) * 2.f - 1.f;
+    nz = 1.f - std::abs(nx) - std::abs(ny);
+    const float t = std::max(-nz, 0.f);
+    nx += nx >= 0.f ? -t : t;
+    ny += ny >= 0.f ? -t : t;
+    const float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+    nx /= length;
+    ny /= length;
+    nz /= length;
+}
+
+uint16_t
+encode_radius(const float radius)
+{
+    if (!(radius > 0.f))
+        return 0;
+    const float log_radius = std::min(std::max(std::log2(radius), min_log_radius), max_log_radius);
+    const float t = (log_radius - min_log_radius) / (max_log_radius - min_log_radius);
+    return uint16_t(1 + std::lround(t * (max_code - 1.f)));
+}
+
+float
+decode_radius(const uint16_t code)
+{
+    if (code == 0)
+        return 0.f;
+    const float t = float(code - 1) / (max_code - 1.f);
+    return std::exp2(min_log_radius + t * (max_log_radius - min_log_radius));
+}
+
+}
+
+size_t surfel_codec::
+encoded_size(const surfel_encoding encoding)
+{
+    switch (encoding) {
+        case surfel_encoding::raw:       return sizeof(raw_surfel);
+        case surfel_encoding::quantized: return sizeof(quantized_surfel);
+        default: break;
+    }
+    throw std::runtime_error("lamure: surfel_codec::Invalid surfel encoding");
+}
+
+void surfel_codec::
+encode(const raw_surfel* input,
+       quantized_surfel* output,
+       const size_t num_surfels,
+       const vec3f& box_min,
+       const vec3f& box_max)
+{
+    const vec3f extent = box_max - box_min;
+    auto relative = [&](const float value, const int axis) {
+        return extent[axis] > 0.f ? (value - box_min[axis]) / extent[axis] : 0.f;
+    };
+
+    for (size_t i = 0; i < num_surfels; ++i) {
+        const raw_surfel& in = input[i];
+        quantized_surfel& out = output[i];
+        out.x = quantize_unit(relative(in.x, 0));
+        out.y = quantize_unit(relative(in.y, 1));
+        out.z = quantize_unit(relative(in.z, 2));
+        encode_normal(in.nx, in.ny, in.nz, out.normal_u, out.normal_v);
+        out.size = encode_radius(in.size);
+        out.r = in.r;
+        out.g = in.g;
+        out.b = in.b;
+        out.fake = 0;
+    }
+}
+
+void surfel_codec::
+decode(const quantized_surfel* input,
+       raw_surfel* output,
+       const size_t num_surfels,
+       const vec3f& box_min,
+       const vec3f& box_max)
+{
+    const vec3f extent = box_max - box_min;
+
+    for (size_t i = 0; i < num_surfels; ++i) {
+        const quantized_surfel& in = input[i];
+        raw_surfel& out = output[i];
+        out.x = box_min.x + dequantize_unit(in.x) * extent.x;
+        out.y = box_min.y + dequantize_unit(in.y) * extent.y;
+        out.z = box_min.z + dequantize_unit(in.z) * extent.z;
+        out.r = in.r;
+        out.g = in.g;
+        out.b = in.b;
+        out.fake = 0;
+        out.size = decode_radius(in.size);
+        decode_normal(in.normal_u, in.normal_v, out.nx, out.ny, out.nz);
+    }
+}
+
+void surfel_codec::
+encode_node(const char* input,
+            char* output,
+            const size_t num_surfels,
+            const surfel_encoding encoding,
+            const vec3f& box_min,
+            const vec3f& box_max)
+{
+    if (encoding == surfel_encoding::quantized) {
+        encode(reinterpret_cast<const raw_surfel*>(input),
+               reinterpret_cast<quantized_surfel*>(output),
+               num_surfels, box_min, box_max);
+    }
+    else {
+        std::memcpy(output, input, num_surfels * encoded_size(encoding));
+    }
+}
+
+void surfel_codec::
+decode_node(const char* input,
+            char* output,
+            const size_t num_surfels,
+            const surfel_encoding encoding,
+            const vec3f& box_min,
+            const vec3f& box_max)
+{
+    if (encoding == surfel_encoding::quantized) {
+        decode(reinterpret_cast<const quantized_surfel*>(input),
+               reinterpret_cast<raw_surfel*>(output),
+               num_surfels, box_min, box_max);
+    }
+    else {
+        std::memcpy(output, input, num_surfels * encoded_size(encoding));
+    }
+}
+
+} // namespace lamure
@@ -13,6 +13,8 @@
 #include <lamure/pre/surfel_mem_array.h>
 #include <lamure/bounding_box.h>
 
+#include <vector>
+
 namespace lamure {
 namespace pre {
 
@@ -58,22 +60,70 @@ public:
                                      const bounding_box& box,
                                      const uint8_t split_axis,
                                      const uint8_t fan_factor, 
-                                     const bool parallelize = false);
+                                     const bool parallelize = false,
+                                     const split_algorithm split_algo = split_algorithm::surfel_sort);
 
     static void         sort_and_split(surfel_disk_array& sa,
                                      splitted_array<surfel_disk_array>& out,
                                      const bounding_box& box,
                                      const uint8_t split_axis,
                                      const uint8_t fan_factor, 
-                                     const size_t memory_limit);
+                                     const size_t memory_limit,
+                                     const split_algorithm split_algo = split_algorithm::surfel_sort);
+    /**
+     * Sorts the surfels along a Morton curve through box.
+     */
+    static void         sort_by_morton_code(surfel_disk_array& sa,
+                                            const bounding_box& box,
+                                            const size_t memory_limit);
+
+    /**
+     * Splits into fan_factor contiguous equal-count children without
+     * reordering. The children get invalid bounding boxes, which have to
+     * be computed from their content.
+     */
+    static void         split_by_count(surfel_disk_array& sa,
+                                       splitted_array<surfel_disk_array>& out,
+                                       const uint8_t fan_factor);
+
 private:
 
+    static std::vector<size_t>
+                        compute_child_bounds(const size_t length,
+                                             const uint8_t fan_factor);
+
+    /**
+     * Reorders the surfels so that the children along split_axis are
+     * separated, without sorting them. Returns the split positions
+     * between neighbouring children.
+     */
+    static std::vector<real>
+                        partition(surfel_mem_array& sa,
+                                  const uint8_t split_axis,
+                                  const uint8_t fan_factor,
+                                  const bool parallelize);
+
+    /**
+     * Out-of-core variant. Returns an empty vector and leaves the array
+     * untouched if the coordinates do not fit into memory_limit.
+     */
+    static std::vector<real>
+                        partition(surfel_disk_array& sa,
+                                  const uint8_t split_axis,
+                                  const uint8_t fan_factor,
+                                  const size_t memory_limit);
+
+    /**
+     * Splits into children. Split positions are taken from the children's
+     * boundary surfels if none are given, which requires a sorted array.
+     */
     template <class T>
     static void         split_surfel_array(T& sa,
                                          splitted_array<T>& out,
                                          const bounding_box& box,
                                          const uint8_t split_axis,
-                                         const uint8_t fan_factor);
+                                         const uint8_t fan_factor,
+                                         std::vector<real> splits = std::vector<real>());
 
 };
 
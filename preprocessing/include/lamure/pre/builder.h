@@ -12,6 +12,8 @@
 
 #include <lamure/pre/platform.h>
 #include <lamure/pre/common.h>
+#include <lamure/bounding_box.h>
+#include <lamure/surfel_codec.h>
 
 #include <boost/filesystem.hpp>
 
@@ -49,6 +51,12 @@ public:
         reduction_algorithm           reduction_algo;
         radius_computation_algorithm  radius_computation_algo;
         normal_computation_algorithm  normal_computation_algo;
+        file_backend                  io_backend;
+        file_compression              interm_compression;
+        split_algorithm               split_algo;
+        downsweep_algorithm           downsweep_algo;
+        surfel_encoding               lod_encoding;
+        node_layout                   lod_layout;
     };
 
     explicit            builder(const descriptor& desc);
@@ -64,8 +72,11 @@ private:
     reduction_strategy* get_reduction_strategy(reduction_algorithm algo) const;
     radius_computation_strategy* get_radius_strategy(radius_computation_algorithm algo) const;
     normal_computation_strategy* get_normal_strategy(normal_computation_algorithm algo) const;
-    boost::filesystem::path convert_to_binary(std::string const& input_type) const;
-    boost::filesystem::path downsweep(boost::filesystem::path input_file, uint16_t start_stage) const;
+    boost::filesystem::path convert_to_binary(std::string const& input_type,
+                                              bounding_box& output_bounding_box) const;
+    boost::filesystem::path downsweep(boost::filesystem::path input_file,
+                                      uint16_t start_stage,
+                                      bounding_box input_bounding_box = bounding_box()) const;
     boost::filesystem::path upsweep(boost::filesystem::path input_file,
                      uint16_t start_stage,
                      reduction_strategy const* reduction_strategy,
@@ -17,7 +17,10 @@
 #include <lamure/pre/normal_computation_strategy.h>
 #include <lamure/pre/radius_computation_strategy.h>
 #include <lamure/pre/logger.h>
-#include <lamure/atomic_counter.h>
+#include <lamure/pre/thread_pool.h>
+#include <lamure/pre/node_search_index.h>
+#include <lamure/pre/neighbour_graph.h>
+#include <lamure/surfel_codec.h>
 
 #include <lamure/pre/io/converter.h>
 
@@ -47,10 +50,14 @@ public:
 
     explicit            bvh(const size_t memory_limit,  // in bytes
                             const size_t buffer_size,   // in bytes
-                            const rep_radius_algorithm rep_radius_algo = rep_radius_algorithm::geometric_mean)
+                            const rep_radius_algorithm rep_radius_algo = rep_radius_algorithm::geometric_mean,
+                            const split_algorithm split_algo = split_algorithm::surfel_sort,
+                            const downsweep_algorithm downsweep_algo = downsweep_algorithm::per_node)
         : memory_limit_(memory_limit),
           buffer_size_(buffer_size),
-          rep_radius_algo_(rep_radius_algo) {}
+          rep_radius_algo_(rep_radius_algo),
+          split_algo_(split_algo),
+          downsweep_algo_(downsweep_algo) {}
 
     virtual             ~bvh() {}
 
@@ -70,11 +77,33 @@ public:
     size_t              max_surfels_per_node() const { return max_surfels_per_node_; }
     vec3r               translation() const { return translation_; }
 
+    /**
+     * Encoding of the surfels written by serialize_surfels_to_file. It is
+     * recorded in the tree file, so both have to be written with the same
+     * encoding.
+     */
+    surfel_encoding     lod_encoding() const { return lod_encoding_; }
+    void                set_lod_encoding(const surfel_encoding encoding) { lod_encoding_ = encoding; }
+
+    /**
+     * Placement of the nodes in the .lod file. The extents are known after
+     * serialize_surfels_to_file or after loading a serialized tree.
+     */
+    node_layout         lod_layout() const { return lod_layout_; }
+    void                set_lod_layout(const node_layout layout) { lod_layout_ = layout; }
+    const std::vector<lod_node_extent>& lod_node_extents() const { return lod_node_extents_; }
+
     boost::filesystem::path base_path() const { return base_path_; }
 
     const std::vector<bvh_node>& nodes() const { return nodes_; }
     std::vector<bvh_node>& nodes() { return nodes_; }
 
+    /**
+     * Workers of the node jobs. Strategies called from a node job may use
+     * them for loops over their own data.
+     */
+    thread_pool&        pool() const { return thread_pool_; }
+
     // helper funtions
     uint32_t            get_depth_of_node(const uint32_t node_id) const;
     uint32_t            get_child_id(const uint32_t node_id, const uint32_t child_index) const;
@@ -82,7 +111,12 @@ public:
     const node_id_type        get_first_node_id_of_depth(uint32_t depth) const;
     const uint32_t      get_length_of_depth(uint32_t depth) const;
 
-    surfel_vector       get_resampled_leaf_lv_surfels() const {return resampled_leaf_level_;}
+    /**
+     * Ids of all nodes in van Emde Boas order: the top half of the tree
+     * first, followed by each bottom subtree, both laid out recursively.
+     */
+    std::vector<node_id_type> get_clustered_node_order() const;
+
     void                resample_based_on_overlap(surfel_mem_array const&  joined_input,
                                                   surfel_mem_array& output_mem_array,
                                                   std::vector<surfel_id_t> const& resample_candites) const;
@@ -109,6 +143,26 @@ public:
                             const std::vector<node_id_type>& target_nodes,
                             const uint32_t num_neighbours) const;
 
+    /**
+     * Computes the nearest neighbours of all surfels of the nodes in
+     * [first_node, last_node) in one pass. The surfels of a node share the
+     * traversal of the surrounding nodes.
+     */
+    neighbour_graph     get_neighbour_graph(
+                            const node_id_type first_node,
+                            const node_id_type last_node,
+                            const uint32_t num_neighbours,
+                            const bool do_local_search = false) const;
+
+    /**
+     * Same as get_neighbour_graph, but neighbours are only searched in
+     * the nodes of [first_node, last_node).
+     */
+    neighbour_graph     get_neighbour_graph_in_nodes(
+                            const node_id_type first_node,
+                            const node_id_type last_node,
+                            const uint32_t num_neighbours) const;
+
     std::vector<std::pair<surfel_id_t, real>>
                         get_natural_neighbours(
                             const surfel_id_t& target_surfel,
@@ -128,9 +182,16 @@ public:
     const node_id_type  first_leaf() const { return first_leaf_; }
 
     // processing functions
+
+    /**
+     * \param[in] input_bounding_box  bounding box of the input surfels if it
+     *                                is known already (e.g. from conversion),
+     *                                saves a pass over the input file
+     */
     void                downsweep(bool adjust_translation,
                                   const std::string& surfels_input_file,
-                                  bool bin_all_file_extension = false);
+                                  bool bin_all_file_extension = false,
+                                  const bounding_box& input_bounding_box = bounding_box());
 
     void                compute_normals_and_radii(const uint16_t number_of_neighbours);
 
@@ -143,15 +204,29 @@ public:
                                 const radius_computation_strategy& radius_comp_strategy,
                                 bool recompute_leaf_level = true,
                                 bool resample = false);
-    void                resample();
 
-    surfel_vector       remove_outliers_statistically(uint32_t num_outliers, uint16_t num_neighbours);
+    /**
+     * Resamples the leaf level and appends the result to output_file as
+     * binary surfels. Every worker fills its own buffer, which is appended
+     * as one chunk when it reaches its share of the buffer size, so neither
+     * the workers nor the memory footprint depend on the output size.
+     * Returns the number of surfels written.
+     */
+    size_t              resample(const std::string& output_file);
+
+    /**
+     * Removes the num_outliers leaf surfels with the largest average
+     * distance to their nearest neighbours. The leaves are compacted in
+     * place and the leaf level file is rewritten, the tree is kept.
+     * Returns the number of removed surfels.
+     */
+    size_t              remove_outliers_statistically(uint32_t num_outliers, uint16_t num_neighbours);
 
     void                serialize_tree_to_file(const std::string& output_file,
                                             bool write_intermediate_data);
 
     void                serialize_surfels_to_file(const std::string& output_file,
-                                               const size_t buffer_size) const;
+                                               const size_t buffer_size);
 
     /* resets all nodes and deletes temp files
      */
@@ -175,11 +250,14 @@ protected:
     void                set_nodes(const std::vector<bvh_node>& nodes) { nodes_ = nodes; };
     void                set_first_leaf(const node_id_type first_leaf) { first_leaf_ = first_leaf; };
     void                set_state(const state_type state) { state_ = state; };
+    void                set_lod_node_extents(const std::vector<lod_node_extent>& extents) {
+                            lod_node_extents_ = extents;
+                        }
+
+    void                append_clustered_subtree(const node_id_type root,
+                                                 const uint32_t height,
+                                                 std::vector<node_id_type>& order) const;
 
-    void                spawn_create_lod_jobs(const uint32_t first_node_of_level, 
-                                              const uint32_t last_node_of_level,
-                                              const reduction_strategy& reduction_strgy,
-                                              const bool resample);
     void                spawn_compute_attribute_jobs(const uint32_t first_node_of_level, 
                                                      const uint32_t last_node_of_level,
                                                      const normal_computation_strategy& normal_strategy, 
@@ -187,55 +265,38 @@ protected:
                                                      const bool is_leaf_level);
     void                spawn_compute_bounding_boxes_downsweep_jobs(const uint32_t slice_left, 
                                                                     const uint32_t slice_right);
-    void                spawn_compute_bounding_boxes_upsweep_jobs(const uint32_t first_node_of_level, 
-                                                                  const uint32_t last_node_of_level,
-                                                                  const int32_t level);
     void                spawn_split_node_jobs(size_t& slice_left,
                                               size_t& slice_right,
                                               size_t& new_slice_left,
                                               size_t& new_slice_right,
                                               const uint32_t level);
     
-    void                thread_remove_outlier_jobs(const uint32_t start_marker,
-                                                   const uint32_t end_marker,
-                                                   const uint32_t num_outliers,
-                                                   const uint16_t num_neighbours,
-                                                   std::vector< std::pair<surfel_id_t, real> >&  intermediate_outliers_for_thread);
-    void                thread_compute_attributes(const uint32_t start_marker,
-                                                  const uint32_t end_marker,
-                                                  const bool update_percentage,
-                                                  const normal_computation_strategy& normal_strategy, 
-                                                  const radius_computation_strategy& radius_strategy,
-                                                  const bool is_leaf_level);
-    void                thread_create_lod(const uint32_t start_marker,
-                                          const uint32_t end_marker,
-                                          const bool update_percentage,
-                                          const reduction_strategy& reduction_strgy,
-                                          const bool resample);
-    void                thread_compute_bounding_boxes_downsweep(const uint32_t slice_left,
-                                                                const uint32_t slice_right,
-                                                                const bool update_percentage,
-                                                                const uint32_t num_threads);
-    void                thread_compute_bounding_boxes_upsweep(const uint32_t start_marker,
-                                                              const uint32_t end_marker,
-                                                              const bool update_percentage,
-                                                              const int32_t level, 
-                                                              const uint32_t num_threads);
-    void                thread_split_node_jobs(      size_t& slice_left,
-                                                     size_t& slice_right,
-                                                     size_t& new_slice_left,
-                                                     size_t& new_slice_right,
-                                               const bool update_percentage,
-                                               const int32_t level,
-                                               const uint32_t num_threads);
-    void                thread_resample(const uint32_t start_marker,
-                                      const uint32_t end_marker,
-                                      const bool update_percentage);
+    void                compute_outlier_distances_job(const uint32_t node_idx,
+                                                      const uint16_t num_neighbours,
+                                                      real* avg_distances) const;
+    void                compute_attributes_job(const uint32_t node_index,
+                                               const normal_computation_strategy& normal_strategy, 
+                                               const radius_computation_strategy& radius_strategy,
+                                               const bool is_leaf_level);
+    void                create_lod_job(const uint32_t node_index,
+                                       const reduction_strategy& reduction_strgy,
+                                       const bool resample);
+    void                compute_bounding_boxes_downsweep_job(const uint32_t slice_index);
+    bounding_box        compute_bounding_boxes_upsweep_job(const uint32_t node_index,
+                                                           const int32_t level);
+    void                split_node_job(const uint32_t slice_index,
+                                       const size_t slice_left,
+                                       const size_t slice_right,
+                                       size_t& new_slice_left,
+                                       size_t& new_slice_right,
+                                       const int32_t level);
+    void                resample_job(const uint32_t node_index,
+                                     surfel_vector& output) const;
 private:
-    surfel_vector resampled_leaf_level_;
-    std::mutex resample_mutex_;
+    mutable thread_pool thread_pool_; ///< shared by all node jobs
 
-    atomic_counter<uint32_t> working_queue_head_counter_;
+    std::vector<std::shared_ptr<const node_search_index>>
+                        search_indices_; ///< per node, accessed atomically
 
     state_type          state_ = state_type::null;
 
@@ -256,9 +317,15 @@ private:
     size_t              memory_limit_;
     size_t              buffer_size_;
     rep_radius_algorithm  rep_radius_algo_;
+    split_algorithm     split_algo_;
+    downsweep_algorithm downsweep_algo_;
 
     vec3r               translation_ = vec3r(0.0); ///< translation of surfels
 
+    surfel_encoding     lod_encoding_ = surfel_encoding::raw;
+    node_layout         lod_layout_ = node_layout::fixed;
+    std::vector<lod_node_extent> lod_node_extents_;
+
     void                downsweep_subtree_in_core(
                             const bvh_node& node,
                             size_t& disk_leaf_destination,
@@ -271,11 +338,30 @@ private:
                             std::vector<node_id_type>& result,
                             const node_id_type first_leaf,
                             const std::unordered_set<size_t>& excluded_leaves) const;
-    void                get_descendant_nodes(
-                            const node_id_type node,
-                            std::vector<node_id_type>& result,
-                            const node_id_type desired_depth,
-                            const std::unordered_set<size_t>& excluded_nodes) const;
+
+    /**
+     * Adds the surfels of a node to the nearest neighbour candidates,
+     * through its search index if it has a valid one.
+     */
+    void                search_node(const node_id_type node_idx,
+                                    const vec3r& center,
+                                    const size_t excluded_surfel_idx,
+                                    node_search_index::candidates& candidates) const;
+
+    void                add_neighbour_rows(const node_id_type node_idx,
+                                           const uint32_t num_neighbours,
+                                           const bool do_local_search,
+                                           neighbour_graph& graph) const;
+    void                add_neighbour_rows_in_nodes(const node_id_type node_idx,
+                                                    const node_id_type first_node,
+                                                    const node_id_type last_node,
+                                                    const uint32_t num_neighbours,
+                                                    neighbour_graph& graph) const;
+
+    void                build_search_index(const node_id_type node_idx);
+    void                drop_search_index(const node_id_type node_idx);
+    void                build_search_indices(const node_id_type first_node,
+                                             const node_id_type last_node);
 
     surfel_mem_array    resample_node(uint32_t node_id) const;
 
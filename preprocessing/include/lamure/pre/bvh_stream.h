@@ -227,10 +227,11 @@ protected:
 
         uint32_t max_surfels_per_node_;
         uint32_t serialized_surfel_size_;
-        uint64_t reserved_0_;
+        uint32_t reserved_0_; //primitive type in the renderer
+        uint32_t surfel_encoding_;
 
         bvh_tree_state state_;
-        uint32_t reserved_1_;
+        uint32_t node_layout_;
         uint64_t reserved_2_;
 
         bvh_vector translation_;
@@ -262,9 +263,10 @@ protected:
             file.write((char*)&fan_factor_, 4);
             file.write((char*)&max_surfels_per_node_, 4);
             file.write((char*)&serialized_surfel_size_, 4);
-            file.write((char*)&reserved_0_, 8);
+            file.write((char*)&reserved_0_, 4);
+            file.write((char*)&surfel_encoding_, 4);
             file.write((char*)&state_, 4);
-            file.write((char*)&reserved_1_, 4);
+            file.write((char*)&node_layout_, 4);
             file.write((char*)&reserved_2_, 8);
             file.write((char*)&translation_.x_, 4);
             file.write((char*)&translation_.y_, 4);
@@ -282,9 +284,10 @@ protected:
             file.read((char*)&fan_factor_, 4);
             file.read((char*)&max_surfels_per_node_, 4);
             file.read((char*)&serialized_surfel_size_, 4);
-            file.read((char*)&reserved_0_, 8);
+            file.read((char*)&reserved_0_, 4);
+            file.read((char*)&surfel_encoding_, 4);
             file.read((char*)&state_, 4);
-            file.read((char*)&reserved_1_, 4);
+            file.read((char*)&node_layout_, 4);
             file.read((char*)&reserved_2_, 8);
             file.read((char*)&translation_.x_, 4);
             file.read((char*)&translation_.y_, 4);
@@ -41,6 +41,27 @@ enum class reduction_algorithm {
     hierarchical_clustering_extended    = 10
 };
 
+enum class file_backend {
+    stream     = 0, // single std::fstream, accesses serialized by a mutex
+    positional = 1  // pread/pwrite on a file descriptor, no global lock
+};
+
+enum class file_compression {
+    none  = 0, // surfels are stored as they are in memory
+    block = 1  // lossless, blocks of surfels compressed independently
+};
+
+enum class split_algorithm {
+    surfel_sort = 0, // comparison sort of whole surfels
+    key_sort    = 1, // radix sort of (key, index) pairs, then one permutation pass
+    partition   = 2  // multi-way selection, children are not sorted internally
+};
+
+enum class downsweep_algorithm {
+    per_node = 0, // sort and split every out-of-core node on its own
+    morton   = 1  // sort all surfels by Morton code once, carve out-of-core nodes from it
+};
+
 }}
 
 #endif // PRE_COMMON_H_
@@ -0,0 +1,68 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_EIGEN_SOLVER_H_
+#define PRE_EIGEN_SOLVER_H_
+
+#include <lamure/pre/platform.h>
+#include <lamure/types.h>
+
+#include <scm/core/math.h>
+
+namespace lamure {
+namespace pre
+{
+
+/**
+* Closed-form eigen decomposition of symmetric 3x3 matrices, such as the
+* covariance matrices of surfel neighbourhoods.
+*
+* The eigenvalues are the roots of the characteristic polynomial in
+* trigonometric form. The eigenvector of the best separated eigenvalue is
+* taken from cross products of the rows of A - lambda * I, the second one
+* from the 2x2 problem in its orthogonal complement. Nothing is allocated.
+*/
+class PREPROCESSING_DLL eigen_solver
+{
+public:
+                        eigen_solver() = delete;
+
+    /**
+     * \param[out] eigenvalues   in ascending order
+     * \param[out] eigenvectors  normalized, in the order of the eigenvalues
+     */
+    static void         solve(const scm::math::mat3d& matrix,
+                              real eigenvalues[3],
+                              vec3r eigenvectors[3]);
+
+    /**
+     * Covariance matrix of count points about their mean. The points are
+     * given as separate coordinate arrays.
+     */
+    static scm::math::mat3d
+                        compute_covariance(const real* x,
+                                           const real* y,
+                                           const real* z,
+                                           const size_t count);
+
+    /**
+     * Fits planes to a batch of neighbourhoods. Neighbourhood i consists of
+     * the points [offsets[i], offsets[i + 1]) of the coordinate arrays, its
+     * normal is the eigenvector of the smallest eigenvalue of their
+     * covariance, or zero for less than three points.
+     */
+    static void         compute_normals(const real* x,
+                                        const real* y,
+                                        const real* z,
+                                        const size_t* offsets,
+                                        const size_t count,
+                                        vec3f* normals);
+};
+
+} } // namespace lamure
+
+#endif // PRE_EIGEN_SOLVER_H_
@@ -1,7 +1,7 @@
 // Copyright (c) 2014 Bauhaus-Universitaet Weimar
 // This Software is distributed under the Modified BSD License, see license.txt.
 //
-// Virtual Reality and Visualization Research Group 
+// Virtual Reality and Visualization Research Group
 // Faculty of Media, Bauhaus-Universitaet Weimar
 // http://www.uni-weimar.de/medien/vr
 
@@ -10,6 +10,7 @@
 
 #include <lamure/pre/surfel_disk_array.h>
 #include <vector>
+#include <future>
 #include <lamure/pre/logger.h>
 
 namespace lamure {
@@ -20,72 +21,64 @@ class PREPROCESSING_DLL external_sort
 {
 public:
 
+    /**
+     * Sorts a surfel_disk_array with bounded memory.
+     *
+     * The comparator is a template parameter, so that comparisons are
+     * inlined in the run sorts and in the merge. Instantiated for
+     * surfel::axis_less and key_index_sort::key_less.
+     */
+    template <typename compare_type>
     static void         sort(surfel_disk_array& array,
                              const size_t memory_limit,
-                             const surfel::compare_function& compare);
+                             const compare_type& compare);
 
 private:
-    explicit            external_sort(const size_t memory_limit,
-                                     const surfel::compare_function& compare);
+    explicit            external_sort(const size_t memory_limit);
                         external_sort(const external_sort&) = delete;
                         external_sort& operator=(const external_sort&) = delete;
 
+    /**
+     * Double-buffered reader for one sorted run. While the merge consumes
+     * the current block, the next one is read in the background.
+     */
     class buffer
     {
         public:
-            surfel_disk_array run;
-            surfel_vector data;
-            size_t size;
-            size_t candidate_pos;
-            size_t file_offset;
-
-            buffer(const surfel_disk_array& array, const size_t buffer_size)
-                : run(array) {
-                size = buffer_size;
-                candidate_pos = size;
-                file_offset = 0;
-                data = surfel_vector(size);
-            }
-
-            bool front(surfel& s) {
-                invalidate();
-                if (size > 0) {
-                    s = data[candidate_pos];
-                    return true;
-                } else
-                    return false;
-            }
-
-            void pop_front() {
-                assert(size > 0);
-                candidate_pos++;
-            }
+                        buffer(const surfel_disk_array& array, const size_t buffer_size);
+                        buffer(const buffer&) = delete;
+                        buffer& operator=(const buffer&) = delete;
+                        ~buffer();
+
+            bool        empty() const { return candidate_pos_ >= size_; }
+            const surfel& front() const { return current_[candidate_pos_]; }
+            void        pop_front();
 
         private:
-            void invalidate() {
-                if (size > 0 && candidate_pos >= size) {
-                    if (file_offset >= run.length()) {
-                        size = 0;
-                        return;
-                    }
-
-                    size = std::min(size, run.length() - file_offset);
-                    run.file()->read(&data, 0, run.offset() + file_offset, size);
-                    file_offset += size;
-                    candidate_pos = 0;
-                }
-            }
+            void        prefetch();
+
+            surfel_disk_array run_;
+            surfel_vector current_;
+            surfel_vector next_;
+            size_t      size_;
+            size_t      next_size_;
+            size_t      candidate_pos_;
+            size_t      file_offset_;
+            std::future<void> pending_;
     };
 
+    template <typename compare_type>
     void                create_runs(surfel_disk_array& array,
-                                   const size_t run_length, 
-                                   const uint32_t runs_count);
-    void                merge(surfel_disk_array& array, const size_t buffer_size);
+                                   const size_t run_length,
+                                   const uint32_t runs_count,
+                                   const compare_type& compare);
 
-    size_t              memory_limit_;
+    template <typename compare_type>
+    void                merge(surfel_disk_array& array,
+                              const size_t buffer_size,
+                              const compare_type& compare);
 
-    surfel::compare_function
-                        compare_;
+    size_t              memory_limit_;
 
     shared_file          runs_file_;
 
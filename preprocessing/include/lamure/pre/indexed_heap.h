@@ -0,0 +1,127 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_INDEXED_HEAP_H_
+#define PRE_INDEXED_HEAP_H_
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace lamure {
+namespace pre
+{
+
+/**
+* Binary heap of the indices [0, capacity), addressable by index.
+*
+* The priorities are kept by the caller. compare(a, b) returns true if a
+* has to leave the heap before b. After the priority of a contained index
+* has changed, update restores the heap order in O(log n), so that entries
+* never have to be re-sorted or duplicated.
+*/
+template <typename Compare>
+class indexed_heap
+{
+public:
+    explicit            indexed_heap(const size_t capacity, const Compare& compare)
+                            : positions_(capacity, no_position()),
+                              compare_(compare) {}
+
+    bool                empty() const { return heap_.empty(); }
+    size_t              size() const { return heap_.size(); }
+
+    bool                contains(const size_t index) const {
+                            return positions_[index] != no_position();
+                        }
+
+    size_t              top() const {
+                            assert(!empty());
+                            return heap_.front();
+                        }
+
+    void                push(const size_t index) {
+                            assert(!contains(index));
+                            positions_[index] = heap_.size();
+                            heap_.push_back(index);
+                            sift_up(heap_.size() - 1);
+                        }
+
+    void                pop() { remove(top()); }
+
+    void                remove(const size_t index) {
+                            assert(contains(index));
+                            const size_t position = positions_[index];
+                            const size_t last = heap_.back();
+                            heap_.pop_back();
+                            positions_[index] = no_position();
+                            if (last != index) {
+                                heap_[position] = last;
+                                positions_[last] = position;
+                                update_at(position);
+                            }
+                        }
+
+    void                update(const size_t index) {
+                            assert(contains(index));
+                            update_at(positions_[index]);
+                        }
+
+private:
+    static size_t       no_position() { return std::numeric_limits<size_t>::max(); }
+
+    void                update_at(const size_t position) {
+                            if (position > 0 &&
+                                compare_(heap_[position], heap_[(position - 1) / 2]))
+                                sift_up(position);
+                            else
+                                sift_down(position);
+                        }
+
+    void                sift_up(size_t position) {
+                            const size_t index = heap_[position];
+                            while (position > 0) {
+                                const size_t parent = (position - 1) / 2;
+                                if (!compare_(index, heap_[parent]))
+                                    break;
+                                place(heap_[parent], position);
+                                position = parent;
+                            }
+                            place(index, position);
+                        }
+
+    void                sift_down(size_t position) {
+                            const size_t index = heap_[position];
+                            while (true) {
+                                size_t child = 2 * position + 1;
+                                if (child >= heap_.size())
+                                    break;
+                                if (child + 1 < heap_.size() &&
+                                    compare_(heap_[child + 1], heap_[child]))
+                                    ++child;
+                                if (!compare_(heap_[child], index))
+                                    break;
+                                place(heap_[child], position);
+                                position = child;
+                            }
+                            place(index, position);
+                        }
+
+    void                place(const size_t index, const size_t position) {
+                            heap_[position] = index;
+                            positions_[index] = position;
+                        }
+
+    std::vector<size_t> heap_;
+    std::vector<size_t> positions_;
+    Compare             compare_;
+};
+
+} } // namespace lamure
+
+#endif // PRE_INDEXED_HEAP_H_
@@ -0,0 +1,184 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_CHUNKED_PARSER_H_
+#define PRE_CHUNKED_PARSER_H_
+
+#include <lamure/pre/platform.h>
+#include <lamure/pre/surfel.h>
+#include <lamure/pre/logger.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <iostream>
+
+namespace lamure {
+namespace pre {
+
+/**
+* Read-only memory mapping of a whole file.
+*/
+class PREPROCESSING_DLL mapped_file
+{
+public:
+                        mapped_file() {}
+                        mapped_file(const mapped_file&) = delete;
+                        mapped_file& operator=(const mapped_file&) = delete;
+    virtual             ~mapped_file();
+
+    void                open(const std::string& file_name);
+    void                close();
+
+    const bool          is_open() const { return is_open_; }
+    const char*         data() const { return data_; }
+    const size_t        size() const { return size_; }
+
+private:
+    bool                is_open_ = false;
+    const char*         data_ = nullptr;
+    size_t              size_ = 0;
+
+#if WIN32
+    void*               file_handle_ = nullptr;
+    void*               mapping_handle_ = nullptr;
+#else
+    int                 fd_ = -1;
+#endif
+};
+
+namespace text {
+
+inline bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+inline bool is_blank(const char c) { return c == ' ' || c == '\t' || c == '\r' || c == ','; }
+
+/**
+* Parses a decimal floating point number from [first, last) without
+* allocating. Leading blanks are skipped. Numbers that cannot be parsed
+* exactly from at most 19 significant digits and a small exponent are
+* passed to strtod, those must not exceed 127 characters.
+*
+* \return pointer behind the parsed number, nullptr if there was none
+*/
+PREPROCESSING_DLL const char* parse_real(const char* first,
+                                         const char* last,
+                                         real& value);
+
+/**
+* Converts a parsed colour value to a channel, clamped to [0, 255].
+* NaN maps to 0.
+*/
+inline uint8_t to_color_channel(const real value)
+{
+    return value > real(0.0) ? (value < real(255.0) ? uint8_t(value) : 255) : 0;
+}
+
+} // namespace text
+
+/**
+* Parses a text file line by line on all cores.
+*
+* The file is memory-mapped and split into chunks at line boundaries.
+* A batch of chunks is parsed in parallel and the resulting surfels are
+* passed to the callback in file order, so the output is identical to
+* a sequential read.
+*
+* \param[in] parse_line     bool(const char* begin, const char* end, surfel&),
+*                           returns false for lines that do not hold a surfel
+* \param[in] memory_budget  bytes for the surfels of one batch, assuming
+*                           lines of at least 32 characters
+*/
+template <typename line_parser_type>
+void                    parse_lines_parallel(const std::string& file_name,
+                                             const line_parser_type& parse_line,
+                                             const std::function<void(const surfel&)>& callback,
+                                             const size_t memory_budget)
+{
+    const size_t min_line_length = 32;
+    const size_t min_chunk_size = 64 * 1024;
+
+    mapped_file input;
+    input.open(file_name);
+
+    const char* data = input.data();
+    const size_t size = input.size();
+
+    // two chunks per thread balance the load, the budget bounds the
+    // chunk size
+    const size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t chunks_per_batch = 2 * num_threads;
+    const size_t batch_size = memory_budget / sizeof(surfel) * min_line_length;
+    const size_t chunk_size = std::max(batch_size / chunks_per_batch, min_chunk_size);
+
+    std::vector<surfel_vector> parsed(chunks_per_batch);
+    std::vector<size_t> bounds;
+    bounds.reserve(chunks_per_batch + 1);
+
+    uint8_t percent_processed = 0;
+    size_t batch_begin = 0;
+
+    while (batch_begin < size) {
+        // cut the next batch into chunks that end behind a newline
+        bounds.clear();
+        bounds.push_back(batch_begin);
+        while (bounds.size() <= chunks_per_batch && bounds.back() < size) {
+            size_t end = std::min(bounds.back() + chunk_size, size);
+            const char* newline = static_cast<const char*>(
+                std::memchr(data + end, '\n', size - end));
+            bounds.push_back(newline ? size_t(newline - data) + 1 : size);
+        }
+        const int32_t num_chunks = int32_t(bounds.size()) - 1;
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int32_t c = 0; c < num_chunks; ++c) {
+            surfel_vector& out = parsed[c];
+            out.clear();
+            out.reserve((bounds[c + 1] - bounds[c]) / min_line_length);
+
+            const char* it = data + bounds[c];
+            const char* chunk_end = data + bounds[c + 1];
+            surfel s;
+
+            while (it < chunk_end) {
+                const char* line_end = static_cast<const char*>(
+                    std::memchr(it, '\n', chunk_end - it));
+                if (!line_end)
+                    line_end = chunk_end;
+
+                if (parse_line(it, line_end, s))
+                    out.push_back(s);
+
+                it = line_end + 1;
+            }
+        }
+
+        // emit in file order
+        for (int32_t c = 0; c < num_chunks; ++c) {
+            for (const auto& s : parsed[c])
+                callback(s);
+            parsed[c].clear();
+        }
+
+        batch_begin = bounds.back();
+
+        uint8_t new_percent_processed = uint8_t(double(batch_begin) / size * 100);
+        if (percent_processed != new_percent_processed) {
+            percent_processed = new_percent_processed;
+            std::cout << "\r" << (int)percent_processed << "% processed" << std::flush;
+        }
+    }
+
+    input.close();
+}
+
+} // namespace pre
+} // namespace lamure
+
+#endif // PRE_CHUNKED_PARSER_H_
@@ -0,0 +1,110 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_COMPRESSED_FILE_H_
+#define PRE_COMPRESSED_FILE_H_
+
+#include <lamure/pre/platform.h>
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lamure
+{
+namespace pre
+{
+
+/**
+* Surfel file stored as a sequence of losslessly compressed blocks of
+* block_length surfels each, followed by an index of the blocks.
+*
+* Random access works on whole blocks: a read decodes the blocks it touches,
+* several of them in parallel, and a write modifies the blocks in a small
+* cache. Modified blocks are compressed again when they leave the cache and
+* are appended to the file, the space of their old version is reclaimed
+* when the file is closed. The index and the header are written on close.
+*
+* Blocks and indices are only ever appended, and the header is written
+* last. A file that is not closed, e.g. because a build was interrupted,
+* therefore still holds the contents of the last time it was closed.
+*
+* Offsets and lengths are in surfels, all accesses are serialized by a
+* mutex except for the decoding of blocks that are read.
+*/
+class PREPROCESSING_DLL compressed_file
+{
+public:
+    static const size_t block_length = 16384;
+
+                        compressed_file() {}
+                        compressed_file(const compressed_file&) = delete;
+                        compressed_file& operator=(const compressed_file&) = delete;
+    virtual             ~compressed_file();
+
+    /**
+     * Checks for the header of a compressed file.
+     */
+    static bool         is_compressed(const std::string& file_name);
+
+    void                open(const std::string& file_name,
+                             const bool truncate);
+    void                close(const bool remove = false);
+    const bool          is_open() const { return stream_.is_open(); }
+    const size_t        get_size() const;
+    void                truncate(const size_t length);
+
+    void                append(const char* data, const size_t length);
+    void                write(const char* data,
+                              const size_t offset_in_file,
+                              const size_t length);
+    void                read(char* data,
+                             const size_t offset_in_file,
+                             const size_t length);
+
+private:
+
+    struct block_entry {
+        uint64_t        offset; // in bytes, 0 if the block was never written
+        uint64_t        size;   // compressed size in bytes
+    };
+
+    struct cached_block {
+        std::vector<char> data;
+        bool            dirty;
+        uint64_t        last_use;
+    };
+
+    void                write_blocks(const char* data,
+                                     const size_t offset_in_file,
+                                     const size_t length);
+    cached_block&       load_block(const size_t block_index, const bool overwrite);
+    void                evict_blocks(const size_t capacity);
+    void                store_block(const size_t block_index, const std::vector<char>& encoded);
+    void                read_encoded(const size_t block_index, std::vector<char>& encoded);
+    void                write_index(std::ostream& output);
+    void                compact();
+
+    mutable std::mutex  mutex_;
+    std::fstream        stream_;
+    std::string         file_name_;
+
+    size_t              num_surfels_ = 0;
+    uint64_t            end_of_data_ = 0; // in bytes
+    uint64_t            live_bytes_ = 0;  // compressed bytes of the current blocks
+    std::vector<block_entry> index_;
+    std::map<size_t, cached_block> cache_;
+    uint64_t            use_counter_ = 0;
+};
+
+} // namespace pre
+} // namespace lamure
+
+#endif // PRE_COMPRESSED_FILE_H_
@@ -15,6 +15,7 @@
 #include <lamure/pre/io/format_abstract.h>
 
 #include <lamure/pre/logger.h>
+#include <lamure/bounding_box.h>
 
 namespace lamure {
 namespace pre {
@@ -37,6 +38,7 @@ public:
                               discarded_(0)
                         {
                             surfels_in_buffer_ = buffer_size / sizeof(surfel);
+                            in_format_.buffer_size_ = buffer_size;
                         }
 
 
@@ -50,6 +52,11 @@ public:
 
     const size_t        surfels_in_buffer() const { return surfels_in_buffer_; }
 
+    /**
+     * Bounding box of the surfel positions written by the last conversion.
+     */
+    const bounding_box& output_bounding_box() const { return output_bounding_box_; }
+
     void                override_radius(const real radius) {
                             override_radius_ = true;
                             new_radius_ = radius;
@@ -93,6 +100,7 @@ private:
     surfel_modifier_function surfel_callback_;
 
     surfel_vector        buffer_;
+    bounding_box        output_bounding_box_;
 
     real                new_radius_;
     vec3b               new_color_;
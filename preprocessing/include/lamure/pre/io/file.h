@@ -9,8 +9,11 @@
 #define PRE_FILE_H_
 
 #include <lamure/pre/platform.h>
+#include <lamure/pre/common.h>
 #include <lamure/pre/surfel.h>
+#include <lamure/pre/io/compressed_file.h>
 
+#include <atomic>
 #include <mutex>
 #include <fstream>
 #include <vector>
@@ -25,7 +28,9 @@ namespace pre
 class PREPROCESSING_DLL file
 {
 public:
-                        file() {}
+    explicit            file(const file_backend backend = default_backend(),
+                                 const file_compression compression = default_compression())
+                            : backend_(backend), compression_(compression) {}
                         file(const file&) = delete;
                         file& operator=(const file&) = delete;
     virtual             ~file();
@@ -35,8 +40,42 @@ public:
                              const bool truncate = false);
     void                close(const bool remove = false);
     const bool          is_open() const;
+
+    /**
+     * Makes the data written through the stream backend visible to other
+     * instances that open the same file.
+     */
+    void                flush();
     const size_t        get_size() const;
+
+    /**
+     * Drops all surfels from position length on. Must not run concurrently
+     * with other accesses to the file.
+     */
+    void                truncate(const size_t length);
     const std::string&  file_name() const { return file_name_; }
+    const file_backend  backend() const { return backend_; }
+    const bool          is_compressed() const { return bool(compressed_); }
+
+    /**
+     * Backend used by instances that are created without an explicit one.
+     *
+     * The positional backend lets several threads read and write disjoint
+     * ranges of the same file concurrently. It is not available on Windows,
+     * where the stream backend is used instead.
+     */
+    static void         set_default_backend(const file_backend backend);
+    static file_backend default_backend();
+
+    /**
+     * Compression of files that are created without an explicit one. It
+     * applies to files that are truncated on open; existing files are
+     * opened in the format they are stored in.
+     *
+     * Compressed files ignore the backend, see compressed_file.
+     */
+    static void         set_default_compression(const file_compression compression);
+    static file_compression default_compression();
 
     void                append(const surfel_vector* data,
                                const size_t offset_in_mem,
@@ -57,13 +96,26 @@ public:
 
 private:
 
+    file_backend        backend_;
+    file_compression    compression_;
+    std::unique_ptr<compressed_file> compressed_;
+
     mutable std::mutex  read_write_mutex_;
     mutable std::fstream stream_;
     std::string         file_name_;
 
+    int                 fd_ = -1;
+    std::atomic<size_t> end_of_file_{0}; // in bytes, positional backend only
+
+    static file_backend default_backend_;
+    static file_compression default_compression_;
+
     void write_data(char *data, const size_t offset_in_file, const size_t length);
     void read_data(char *data, const size_t offset_in_file, const size_t length) const;
 
+    void write_bytes(const char *data, const size_t offset, const size_t bytes);
+    void read_bytes(char *data, const size_t offset, const size_t bytes) const;
+
 };
 
 typedef std::shared_ptr<file> shared_file;
@@ -29,7 +29,8 @@ public:
     explicit            format_abstract()
                             : has_normals_(false),
                               has_radii_(false),
-                              has_color_(false) {}
+                              has_color_(false),
+                              buffer_size_(256 * 1024 * 1024) {}
 
     virtual             ~format_abstract() {}
 
@@ -46,6 +47,9 @@ protected:
     bool                has_radii_;
     bool                has_color_;
 
+    // memory for buffering surfels while reading, in bytes. set by the converter
+    size_t              buffer_size_;
+
 };
 
 
@@ -33,6 +33,17 @@ protected:
 private:
     surfel              current_surfel_;
 
+    /**
+     * Decodes the vertex element of binary PLY files in bulk.
+     *
+     * Applies if the file is binary_little_endian or binary_big_endian
+     * and the vertex element comes first and holds scalar properties only.
+     *
+     * \return false if the file has to be read by the generic ply_parser
+     */
+    bool                read_binary_vertices(const std::string& filename,
+                                             surfel_callback_funtion callback);
+
     template <typename ScalarType> 
     std::function <void (ScalarType)> scalar_callback(const std::string& element_name, 
                                                       const std::string& property_name);
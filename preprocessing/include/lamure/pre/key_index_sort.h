@@ -0,0 +1,108 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_KEY_INDEX_SORT_H_
+#define PRE_KEY_INDEX_SORT_H_
+
+#include <lamure/pre/platform.h>
+#include <lamure/pre/surfel_mem_array.h>
+#include <lamure/pre/surfel_disk_array.h>
+#include <lamure/pre/logger.h>
+#include <lamure/bounding_box.h>
+
+#include <vector>
+#include <functional>
+
+namespace lamure {
+namespace pre
+{
+
+/**
+* Sorts surfels by a 64 bit key without moving them during the sort.
+*
+* The keys are extracted once into compact (key, index) entries, which
+* are ordered by a parallel LSD radix sort. The permutation is applied
+* to the surfels in a single gather pass in memory, or in one
+* distribution pass plus one placement pass out of core.
+*/
+class PREPROCESSING_DLL key_index_sort
+{
+public:
+    struct entry
+    {
+        uint64_t        key;
+        uint32_t        index;
+    };
+
+    using key_function = std::function<uint64_t(const surfel& s)>;
+
+    /**
+     * Comparator on a key function, for sorts that do not go through
+     * the key-index entries (e.g. external_sort).
+     */
+    struct key_less
+    {
+        explicit        key_less(const key_function& key) : key_(key) {}
+
+        bool            operator()(const surfel& left, const surfel& right) const
+                            { return key_(left) < key_(right); }
+
+        key_function    key_;
+    };
+
+                        key_index_sort() = delete;
+
+    /**
+     * Maps a coordinate to an unsigned key with the same ordering.
+     */
+    static uint64_t     to_key(const real value);
+
+    static key_function axis_key(const uint8_t axis);
+
+    /**
+     * 63 bit Morton code of the surfel position, quantized to 21 bits per
+     * axis within the cube that encloses box.
+     */
+    static key_function morton_key(const bounding_box& box);
+
+    /**
+     * Stable radix sort of entries by key.
+     */
+    static void         sort_entries(std::vector<entry>& entries,
+                                     const bool parallelize = true);
+
+    /**
+     * Stable radix sort of entries by key, with the entries split into
+     * num_blocks ranges that are counted and scattered in parallel.
+     */
+    static void         sort_entries_in_blocks(std::vector<entry>& entries,
+                                               const size_t num_blocks);
+
+    static void         sort(surfel_mem_array& array,
+                             const key_function& key,
+                             const bool parallelize = true);
+
+    /**
+     * Out-of-core variant.
+     *
+     * \return false if the keys do not fit into memory_limit. The array is
+     *         left untouched in that case.
+     */
+    static bool         sort(surfel_disk_array& array,
+                             const key_function& key,
+                             const size_t memory_limit);
+
+private:
+    static void         apply_permutation(surfel_vector& data,
+                                          const size_t offset,
+                                          const std::vector<entry>& entries,
+                                          const bool parallelize);
+};
+
+} } // namespace lamure
+
+#endif // PRE_KEY_INDEX_SORT_H_
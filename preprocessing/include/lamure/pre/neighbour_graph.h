@@ -0,0 +1,89 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_NEIGHBOUR_GRAPH_H_
+#define PRE_NEIGHBOUR_GRAPH_H_
+
+#include <lamure/pre/platform.h>
+#include <lamure/types.h>
+
+#include <vector>
+
+namespace lamure {
+namespace pre
+{
+
+/**
+* Nearest neighbours of all surfels of a contiguous range of bvh nodes.
+*
+* The neighbour lists are stored back to back in compressed sparse row
+* layout: one offset per node into the rows, one offset per row into the
+* neighbours. Every row is sorted by ascending squared distance.
+*/
+class PREPROCESSING_DLL neighbour_graph
+{
+public:
+    using neighbour = std::pair<surfel_id_t, real>;
+
+    /**
+     * Read-only view of the neighbours of one surfel.
+     */
+    class row
+    {
+    public:
+                        row(const neighbour* begin, const neighbour* end)
+                            : begin_(begin), end_(end) {}
+
+        const neighbour* begin() const { return begin_; }
+        const neighbour* end() const { return end_; }
+        size_t          size() const { return end_ - begin_; }
+        bool            empty() const { return begin_ == end_; }
+        const neighbour& operator[](const size_t index) const { return begin_[index]; }
+
+        std::vector<neighbour> to_vector() const { return std::vector<neighbour>(begin_, end_); }
+
+    private:
+        const neighbour* begin_;
+        const neighbour* end_;
+    };
+
+    explicit            neighbour_graph(const node_id_type first_node = 0);
+
+    node_id_type        first_node() const { return first_node_; }
+    node_id_type        last_node() const { return first_node_ + node_offsets_.size() - 1; }
+
+    size_t              num_surfels(const node_id_type node_idx) const;
+    size_t              num_neighbours() const { return neighbours_.size(); }
+
+    row                 neighbours(const surfel_id_t& surfel) const;
+
+    /**
+     * Starts the rows of the next node, i.e. of last_node().
+     */
+    void                begin_node();
+
+    /**
+     * Appends the row of the next surfel of the current node.
+     */
+    void                add_row(const std::vector<neighbour>& sorted_neighbours);
+
+    /**
+     * Appends all nodes of other, which must start at last_node().
+     */
+    void                append(const neighbour_graph& other);
+
+private:
+    node_id_type        first_node_;
+
+    std::vector<size_t> node_offsets_;
+    std::vector<size_t> row_offsets_;
+    std::vector<neighbour> neighbours_;
+};
+
+} } // namespace lamure
+
+#endif // PRE_NEIGHBOUR_GRAPH_H_
@@ -0,0 +1,109 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_NODE_SEARCH_INDEX_H_
+#define PRE_NODE_SEARCH_INDEX_H_
+
+#include <lamure/pre/platform.h>
+#include <lamure/pre/surfel_mem_array.h>
+#include <lamure/types.h>
+
+#include <limits>
+#include <vector>
+
+namespace lamure {
+namespace pre
+{
+
+/**
+* Compact kd-tree over the surfel positions of one bvh node.
+*
+* Only a permutation of the surfel indices and the split axis of every
+* inner kd-node are stored. Positions are read from the surfel array the
+* index was built for, which must not move its surfels while the index
+* is in use.
+*/
+class PREPROCESSING_DLL node_search_index
+{
+public:
+    using neighbour = std::pair<surfel_id_t, real>;
+
+    /**
+     * Bounded max-heap of the k nearest candidates found so far.
+     * Distances are squared.
+     */
+    class candidates
+    {
+    public:
+        explicit        candidates(const size_t k) : k_(k) { heap_.reserve(k); }
+
+        real            max_distance() const;
+        void            insert(const surfel_id_t& id, const real distance);
+
+        /**
+         * \return candidates in ascending order of distance. Leaves the
+         *         heap empty.
+         */
+        std::vector<neighbour> sorted();
+
+    private:
+        size_t          k_;
+        std::vector<neighbour> heap_;
+    };
+
+    explicit            node_search_index(const surfel_mem_array& array);
+
+    /**
+     * \return true if the index was built for this array.
+     */
+    bool                matches(const surfel_mem_array& array) const;
+
+    /**
+     * Adds the surfels of array closer to center than the current
+     * candidates. excluded_surfel_idx is skipped, e.g. the query surfel.
+     */
+    void                search(const surfel_mem_array& array,
+                               const node_id_type node_idx,
+                               const vec3r& center,
+                               const size_t excluded_surfel_idx,
+                               candidates& result) const;
+
+    /**
+     * Same as search for arrays without an index.
+     */
+    static void         search_linear(const surfel_mem_array& array,
+                                      const node_id_type node_idx,
+                                      const vec3r& center,
+                                      const size_t excluded_surfel_idx,
+                                      candidates& result);
+
+    static const size_t no_surfel = std::numeric_limits<size_t>::max();
+
+private:
+    void                build(const surfel* data,
+                              const uint32_t begin,
+                              const uint32_t end);
+
+    void                search(const surfel* data,
+                               const uint32_t begin,
+                               const uint32_t end,
+                               const node_id_type node_idx,
+                               const vec3r& center,
+                               const size_t excluded_surfel_idx,
+                               candidates& result) const;
+
+    const surfel_vector* mem_data_;
+    size_t              offset_;
+    size_t              length_;
+
+    std::vector<uint32_t> order_;
+    std::vector<uint8_t> axes_;
+};
+
+} } // namespace lamure
+
+#endif // PRE_NODE_SEARCH_INDEX_H_
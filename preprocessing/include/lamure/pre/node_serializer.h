@@ -12,10 +12,11 @@
 #include <lamure/pre/surfel.h>
 #include <lamure/pre/bvh_node.h>
 #include <lamure/pre/logger.h>
+#include <lamure/surfel_codec.h>
 
 #include <fstream>
 #include <string>
-#include <deque>
+#include <vector>
 
 
 namespace lamure {
@@ -29,7 +30,9 @@ class PREPROCESSING_DLL node_serializer
 {
 public:
     explicit            node_serializer(const size_t surfels_per_node,
-                                       const size_t buffer_size); // buffer_size - in bytes
+                                       const size_t buffer_size, // buffer_size - in bytes
+                                       const surfel_encoding encoding = surfel_encoding::raw,
+                                       const node_layout layout = node_layout::fixed);
 
                         node_serializer(const node_serializer&) = delete;
                         node_serializer& operator=(const node_serializer&) = delete;
@@ -39,8 +42,23 @@ public:
     void                close();
     const bool          is_open() const;
 
-    void                serialize_nodes(const std::vector<bvh_node>& nodes);
-
+    /**
+     * Writes the nodes in the given order of node ids, or in the order of
+     * the vector if no order is given. The nodes are read and converted
+     * in parallel, in batches of at most buffer_size bytes, and each batch
+     * is written while the next one is prepared. Input files with the
+     * stream backend are flushed and read through positional instances of
+     * their own, so that the reads do not serialize.
+     */
+    void                serialize_nodes(const std::vector<bvh_node>& nodes,
+                                        const std::vector<node_id_type>& order = {});
+
+    /**
+     * Extents of the nodes written since open, indexed by node id.
+     */
+    const std::vector<lod_node_extent>& node_extents() const { return node_extents_; }
+
+    // immediate access is for raw encoded files only
     void                read_node_immediate(surfel_vector& surfels, 
                                           const size_t offset);
     void                write_node_immediate(const surfel_vector& surfels, 
@@ -48,15 +66,16 @@ public:
 
 private:
 
-    void                write_node_streamed(const bvh_node& node);
-    void                flush_buffer();
+    void                write_bytes(const char* data, const size_t bytes);
 
     mutable std::fstream stream_;
     std::string         file_name_;
     size_t              surfels_per_node_;
 
-    std::deque<surfel_vector*> 
-                        buffer_;
+    surfel_encoding     encoding_;
+    node_layout         layout_;
+    std::vector<lod_node_extent> node_extents_;
+    uint64_t            end_of_file_ = 0; // in surfels
     size_t              max_nodes_in_buffer_;
 };
 
@@ -26,18 +26,24 @@ public:
 			number_of_neighbours_ = number_of_neighbours;
 		}
 
-	void eigsrt_jacobi(
-	    int dim,
-	    double* eigenvalues, 
-	    double** eigenvectors) const;
-
-	void jacobi_rotation(const scm::math::mat3d& _matrix,
-	                     double* eigenvalues,
-	                     double** eigenvectors) const;
-
 	vec3f  compute_normal(const bvh& tree,
 						  const surfel_id_t surfel,
                        	  std::vector<std::pair<surfel_id_t, real>> const& nearest_neighbours) const override;
+
+	void   compute_normals(const bvh& tree,
+						   const neighbour_graph& graph,
+						   const node_id_type node_idx,
+						   std::vector<vec3f>& normals) const override;
+
+private:
+	void   add_neighbourhood(const bvh& tree,
+							 const surfel_id_t target_surfel,
+							 const std::pair<surfel_id_t, real>* begin,
+							 const std::pair<surfel_id_t, real>* end,
+							 std::vector<real>& x,
+							 std::vector<real>& y,
+							 std::vector<real>& z,
+							 std::vector<size_t>& offsets) const;
 };
 
 }// namespace pre
@@ -11,6 +11,9 @@
 
 // #include <lamure/pre/bvh.h>
 #include <lamure/pre/surfel.h>
+#include <lamure/pre/neighbour_graph.h>
+
+#include <vector>
 
 namespace lamure{
 namespace pre {
@@ -23,6 +26,16 @@ public:
 	virtual vec3f compute_normal(const bvh& tree,
 								 const surfel_id_t surfel,
                        			 std::vector<std::pair<surfel_id_t, real>> const& nearest_neighbours) const = 0;
+
+	/**
+	 * Computes the normals of all surfels of a node from their rows in
+	 * graph. By default, compute_normal is called for every surfel.
+	 */
+	virtual void compute_normals(const bvh& tree,
+								 const neighbour_graph& graph,
+								 const node_id_type node_idx,
+								 std::vector<vec3f>& normals) const;
+
 	uint16_t const number_of_neighbours() const {return number_of_neighbours_;}
 
 protected:
@@ -12,8 +12,8 @@
 #include <lamure/pre/bvh.h>
 #include <lamure/pre/surfel.h>
 
+#include <unordered_map>
 #include <vector>
-#include <queue>
 
 
 namespace lamure {
@@ -27,8 +27,10 @@ class bvh;
 	bool validity;
 	double entropy;
 	uint16_t level;
-	std::vector<std::shared_ptr<entropy_surfel> > neighbours;
-	std::shared_ptr<surfel> contained_surfel;
+	// indices into the entropy surfel array of the node, may contain
+	// invalidated surfels and duplicates
+	std::vector<uint32_t> neighbours;
+	surfel contained_surfel;
 
 	entropy_surfel(surfel const&  in_surfel, 
 				   uint32_t const in_surfel_id, 
@@ -39,29 +41,35 @@ class bvh;
 												node_id(in_node_id),
 												validity(in_validity),
 												entropy(in_entropy),
-												level(0)
-												 {
-		contained_surfel = std::make_shared<surfel>(in_surfel);
-	}
+												level(0),
+												contained_surfel(in_surfel)
+												 {}
 };
 
+using entropy_surfel_vector = std::vector<entropy_surfel>;
+
 struct min_entropy_order{
-	bool operator ()(std::shared_ptr<entropy_surfel> const entropy_first, std::shared_ptr<entropy_surfel> const entropy_second){
+	explicit min_entropy_order(entropy_surfel_vector const& in_entropy_surfels)
+		: entropy_surfels(in_entropy_surfels) {}
+
+	bool operator ()(uint32_t const first_id, uint32_t const second_id) const {
 
 		// true  : first goes to the front, second to the back
 		// false : first goes to the back, first to the front 
 
 		// if first is not valid, sort it to the front
+		entropy_surfel const& entropy_first = entropy_surfels[first_id];
+		entropy_surfel const& entropy_second = entropy_surfels[second_id];
 
 		bool is_rightmost = false;
-		if ( entropy_first->validity == false && entropy_second->validity == true) {
+		if ( entropy_first.validity == false && entropy_second.validity == true) {
 
 			is_rightmost = true;
-		} else if (entropy_first->validity == true && entropy_second->validity == true){
-			if(entropy_first->entropy > entropy_second->entropy) {
+		} else if (entropy_first.validity == true && entropy_second.validity == true){
+			if(entropy_first.entropy > entropy_second.entropy) {
 				is_rightmost = true;
-			} else if (entropy_first->entropy == entropy_second->entropy) {
-				if(entropy_first->contained_surfel->radius() > entropy_second->contained_surfel->radius() ) {
+			} else if (entropy_first.entropy == entropy_second.entropy) {
+				if(entropy_first.contained_surfel.radius() > entropy_second.contained_surfel.radius() ) {
 					is_rightmost = true;
 					// both entropies are the same, but the one with the larger radius is considered later
 				}
@@ -73,11 +81,68 @@ struct min_entropy_order{
 		// but for ambiguous cases also according to radius
 		return is_rightmost;
 	}
+
+	entropy_surfel_vector const& entropy_surfels;
+};
+
+// order of the merge queue: the valid surfel that min_entropy_order sorts to
+// the back leaves first. entropy and radius ties are broken by index to keep
+// the order deterministic
+struct min_entropy_first{
+	explicit min_entropy_first(entropy_surfel_vector const& in_entropy_surfels)
+		: entropy_surfels(in_entropy_surfels) {}
+
+	bool operator ()(size_t const left_id, size_t const right_id) const {
+		entropy_surfel const& left = entropy_surfels[left_id];
+		entropy_surfel const& right = entropy_surfels[right_id];
+
+		if (left.entropy != right.entropy) {
+			return left.entropy < right.entropy;
+		}
+		if (left.contained_surfel.radius() != right.contained_surfel.radius()) {
+			return left.contained_surfel.radius() < right.contained_surfel.radius();
+		}
+		return left_id < right_id;
+	}
+
+	entropy_surfel_vector const& entropy_surfels;
 };
 
+// uniform grid over the centers of the valid entropy surfels of a node.
+// merged surfels move to a center of mass of input surfels, so they stay
+// within the input bounds, and they grow. candidates are therefore searched
+// up to the largest radius seen so far, and surfels are re-bucketed by
+// update() whenever they change
+class PREPROCESSING_DLL entropy_surfel_grid
+{
+public:
+	explicit entropy_surfel_grid(entropy_surfel_vector const& in_entropy_surfels);
 
-using shared_entropy_surfel = std::shared_ptr<entropy_surfel>;
-using shared_entropy_surfel_vector = std::vector<shared_entropy_surfel>;
+	// moves a surfel to the cell of its current position, or removes it
+	// from the grid once it is invalid
+	void update(uint32_t const en_surfel_id);
+
+	// collects the valid surfels other than target_id whose bounding
+	// sphere overlaps the one of target_id, in ascending order
+	void find_candidates(uint32_t const target_id,
+	                     std::vector<uint32_t>& candidate_ids) const;
+
+private:
+	uint64_t cell_key(vec3r const& pos) const;
+	uint32_t cell_coordinate(real const coordinate, int const axis) const;
+
+	entropy_surfel_vector const& entropy_surfels;
+
+	std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+	// key of the cell each surfel is stored in, or no_cell
+	std::vector<uint64_t> surfel_cells;
+
+	vec3r min_pos;
+	real cell_size;
+	real max_radius;
+
+	static const uint64_t no_cell = ~uint64_t(0);
+};
 
 class PREPROCESSING_DLL reduction_entropy: public reduction_strategy
 {
@@ -92,41 +157,44 @@ public:
           						  const size_t start_node_id) const override;
 private:
 
-	void add_neighbours(shared_entropy_surfel entropy_surfel_to_add_neighbours,
-                        shared_entropy_surfel_vector const& neighbour_ptrs_to_add) const;
-
-
-
-	vec3r compute_center_of_mass(shared_surfel current_surfel_ptr, 
-								shared_entropy_surfel_vector const& neighbour_ptrs) const;
+	vec3r compute_center_of_mass(surfel const& current_surfel, 
+								 entropy_surfel_vector const& entropy_surfels,
+								 std::vector<uint32_t> const& neighbour_ids) const;
 	real compute_enclosing_sphere_radius(vec3r const& center_of_mass, 
-										 shared_surfel current_surfel, 
-										 shared_entropy_surfel_vector const neighbour_ptrs) const;
-	
-	shared_entropy_surfel_vector const
-	get_locally_overlapping_neighbours(shared_entropy_surfel target_entropy_surfel_ptr,
-                                   	   shared_entropy_surfel_vector& entropy_surfel_ptr_array) const;
+										 surfel const& current_surfel, 
+										 entropy_surfel_vector const& entropy_surfels,
+										 std::vector<uint32_t> const& neighbour_ids) const;
+
+	void compute_overlapping_neighbours(entropy_surfel_vector& entropy_surfels,
+	                                    entropy_surfel_grid const& grid) const;
 
     bool
-	merge(shared_entropy_surfel current_entropy_surfel,
-		  shared_entropy_surfel_vector const& complete_entropy_surfel_array,
-          size_t& num_remaining_valid_surfel, size_t num_desired_surfel) const;
-
-	void update_color(shared_surfel current_surfel_ptr, shared_entropy_surfel_vector const& neighbour_ptrs) const;
-
-	void update_entropy(shared_entropy_surfel current_en_surfel, 
-						shared_entropy_surfel_vector const neighbour_ptrs) const;
-	void update_entropy_surfel_level(shared_entropy_surfel target_surfel_ptr, 
-                         		     shared_entropy_surfel_vector const& invalidated_neighbours) const;
-	void update_normal(shared_surfel current_surfel_ptr, 
-		               shared_entropy_surfel_vector const neighbour_ptrs) const;
-	void update_position(shared_surfel current_surfel_ptr, 
-					   shared_entropy_surfel_vector const neighbour_ptrs) const;
-	void update_radius(shared_surfel current_surfel_ptr, 
-					   shared_entropy_surfel_vector const neighbour_ptrs) const;
-
-	void update_surfel_attributes(shared_surfel target_surfel_ptr, 
-                         		  shared_entropy_surfel_vector const invalidated_neighbours) const;
+	merge(uint32_t target_id,
+		  entropy_surfel_vector& entropy_surfels,
+		  entropy_surfel_grid& grid,
+		  std::vector<uint8_t>& merge_marks,
+          size_t& num_remaining_valid_surfel, size_t num_desired_surfel,
+          std::vector<uint32_t>& invalidated_neighbours) const;
+
+	void update_color(surfel& current_surfel,
+					  entropy_surfel_vector const& entropy_surfels,
+					  std::vector<uint32_t> const& neighbour_ids) const;
+
+	void update_entropy(entropy_surfel& current_en_surfel, 
+						entropy_surfel_vector const& entropy_surfels) const;
+	void update_normal(surfel& current_surfel, 
+					   entropy_surfel_vector const& entropy_surfels,
+					   std::vector<uint32_t> const& neighbour_ids) const;
+	void update_position(surfel& current_surfel, 
+						 entropy_surfel_vector const& entropy_surfels,
+						 std::vector<uint32_t> const& neighbour_ids) const;
+	void update_radius(surfel& current_surfel, 
+					   entropy_surfel_vector const& entropy_surfels,
+					   std::vector<uint32_t> const& neighbour_ids) const;
+
+	void update_surfel_attributes(surfel& target_surfel, 
+								  entropy_surfel_vector const& entropy_surfels,
+                         		  std::vector<uint32_t> const& invalidated_neighbours) const;
 	
 
 };
@@ -69,10 +69,6 @@ private:
 	surfel create_surfel_from_cluster(const std::vector<surfel*>& surfels_to_sample) const;
 
 	real point_plane_distance(const vec3r& centroid, const vec3f& normal, const vec3r& point) const;
-
-	void jacobi_rotation(const scm::math::mat3d& _matrix, double* eigenvalues, double** eigenvectors) const;
-
-	void eigsrt_jacobi(int dim, double* eigenvalues, double** eigenvectors) const;
 };
 
 } // namespace pre
@@ -16,9 +16,26 @@
 namespace lamure {
 namespace pre {
 
+// surfels of one create_lod call. a cluster is a range of order, which is
+// partitioned in place whenever a cluster is split
+struct hierarchical_cluster_surfels_mk5
+{
+	std::vector<surfel const*> surfels;
+	std::vector<vec3r> positions;
+	std::vector<vec3r> colors;
+
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> partition_buffer;
+};
+
+
+
 struct hierarchical_cluster_mk5
 {
-	std::vector<surfel*> surfels;
+	uint32_t begin;
+	uint32_t end;
+
+	uint32_t size() const { return end - begin; }
 	
 	vec3r centroid_pos;
 	vec3r centroid_color;
@@ -36,9 +53,9 @@ struct cluster_comparator_mk5
 {
   bool operator()(const hierarchical_cluster_mk5& lhs, const hierarchical_cluster_mk5& rhs) const
   {
-    if(lhs.surfels.size() != rhs.surfels.size())
+    if(lhs.size() != rhs.size())
 	{
-		return lhs.surfels.size() < rhs.surfels.size();
+		return lhs.size() < rhs.size();
 	}
 	else
 	{
@@ -49,6 +66,10 @@ struct cluster_comparator_mk5
   }
 };
 
+using cluster_queue_mk5 = std::priority_queue<hierarchical_cluster_mk5, 
+											  std::vector<hierarchical_cluster_mk5>, 
+											  cluster_comparator_mk5>;
+
 
 
 class PREPROCESSING_DLL reduction_hierarchical_clustering_mk5 : public reduction_strategy
@@ -65,30 +86,46 @@ public:
 
 private:
 
-	std::vector<std::vector<surfel*>> split_point_cloud(const std::vector<surfel*>& input_surfels, 
-														uint32_t max_cluster_size, 
-														real max_variation_position,
-														real max_variation_color, 
-														const uint32_t& max_clusters) const;
+	std::vector<hierarchical_cluster_mk5> split_point_cloud(hierarchical_cluster_surfels_mk5& cluster_surfels, 
+															uint32_t max_cluster_size, 
+															real max_variation_position,
+															real max_variation_color, 
+															const uint32_t& max_clusters,
+															thread_pool& pool) const;
 
-	void split_cluster_by_position(const hierarchical_cluster_mk5& input_cluster,
+	void split_cluster_by_position(hierarchical_cluster_surfels_mk5& cluster_surfels,
+								const hierarchical_cluster_mk5& input_cluster,
 								const uint32_t& max_cluster_size,
 								const real& max_variation,
-								std::priority_queue<hierarchical_cluster_mk5, std::vector<hierarchical_cluster_mk5>, cluster_comparator_mk5>& cluster_queue) const;
+								cluster_queue_mk5& cluster_queue,
+								thread_pool& pool) const;
+
+	// computes the data of the two halves [begin, middle) and [middle, end),
+	// large halves concurrently
+	void calculate_cluster_data(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+								uint32_t begin, uint32_t middle, uint32_t end,
+								hierarchical_cluster_mk5 (&halves)[2],
+								thread_pool& pool) const;
 
-	hierarchical_cluster_mk5 calculate_cluster_data(const std::vector<surfel*>& input_surfels) const;
+	hierarchical_cluster_mk5 calculate_cluster_data(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+													uint32_t begin, uint32_t end) const;
 
 	real calculate_variation(const scm::math::mat3d& covariance_matrix, vec3f& normal) const;
 
-	scm::math::mat3d calculate_covariance_matrix(const std::vector<surfel*>& surfels_to_sample, vec3r& centroid) const;
+	scm::math::mat3d calculate_covariance_matrix(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+												 uint32_t begin, uint32_t end, vec3r& centroid) const;
 
-	scm::math::mat3d calculate_covariance_matrix_color(const std::vector<surfel*>& surfels_to_sample, vec3r& centroid) const;
+	scm::math::mat3d calculate_covariance_matrix_color(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+													   uint32_t begin, uint32_t end, vec3r& centroid) const;
 
-	vec3r calculate_centroid(const std::vector<surfel*>& surfels_to_sample) const;
+	vec3r calculate_centroid(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+							 uint32_t begin, uint32_t end) const;
 
-	vec3r calculate_centroid_color(const std::vector<surfel*>& surfels_to_sample) const;
+	vec3r calculate_centroid_color(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+								   uint32_t begin, uint32_t end) const;
 
-	surfel create_surfel_from_cluster(const std::vector<surfel*>& surfels_to_sample) const;
+	surfel create_surfel_from_cluster(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+									  const hierarchical_cluster_mk5& cluster) const;
 
 	real point_plane_distance(const vec3r& centroid, const vec3f& normal, const vec3r& point) const;
 
@@ -102,10 +139,6 @@ private:
 
 	vec3r transform_color(const vec3b& color) const;
 
-	void jacobi_rotation(const scm::math::mat3d& _matrix, double* eigenvalues, double** eigenvectors) const;
-
-	void eigsrt_jacobi(int dim, double* eigenvalues, double** eigenvectors) const;
-
 	int color_space_mode_;
 };
 
@@ -11,127 +11,36 @@
 #include <lamure/pre/reduction_strategy.h>
 
 #include <lamure/pre/surfel.h>
-#include <memory>
 #include <vector>
-#include <list>
 
 namespace lamure {
 namespace pre {
 
-struct cluster_surfel_with_neighbours{
-    uint32_t surfel_id;
-    uint32_t node_id;
-    bool member_of_M; 
-    real overlap;
-    real deviation;
-    std::vector<std::shared_ptr<cluster_surfel_with_neighbours> > neighbours;
-    std::shared_ptr<surfel> contained_surfel;
-    cluster_surfel_with_neighbours(surfel const&  in_surfel, uint32_t const in_surfel_id, uint32_t const in_node_id) :
-                                                surfel_id(in_surfel_id),
-                                                node_id(in_node_id),
-                                                member_of_M(false),
-                                                overlap(0),
-                                                deviation(0)
-                                                 {
-        contained_surfel = std::make_shared<surfel>(in_surfel);
+/**
+* Surfels of one k-clustering run, addressed by their index in the input.
+* The overlapping neighbours of surfel i are the ascending indices
+* neighbour_ids[neighbour_offsets[i], neighbour_offsets[i + 1]).
+*/
+struct cluster_surfel_set {
+    std::vector<surfel> surfels;
+    std::vector<uint32_t> neighbour_offsets;
+    std::vector<uint32_t> neighbour_ids;
+    std::vector<real> overlaps;
+    std::vector<uint8_t> member_of_M;
+
+    size_t size() const { return surfels.size(); }
+
+    uint32_t const* neighbours_begin(uint32_t const surfel_id) const {
+        return neighbour_ids.data() + neighbour_offsets[surfel_id];
     }
-
-};
-
-using cluster_surfel        = cluster_surfel_with_neighbours;
-using shared_cluster_surfel = std::shared_ptr<cluster_surfel_with_neighbours>;
-using shared_cluster_surfel_vector = std::vector<shared_cluster_surfel>;
-
-struct max_overlap_order {
-    bool operator() (shared_cluster_surfel const& first_surfel, shared_cluster_surfel const& second_surfel){
-        if(!first_surfel || !second_surfel){
-            throw std::exception();
-        }
-        if(first_surfel->overlap == second_surfel->overlap){
-            if(first_surfel->node_id < second_surfel->node_id) {
-                if(first_surfel->surfel_id < second_surfel->surfel_id) {
-                    return true;
-                }
-                else return false;
-            }
-            else return false;
-        }
-        if(first_surfel->overlap > second_surfel->overlap){
-           return false;
-        }
-        else
-           return true;
-    }
-};
-
-struct  min_SN_id_order{
-    bool operator() (shared_cluster_surfel const& first_surfel, shared_cluster_surfel const& second_surfel) {
-        if(!first_surfel || !second_surfel){
-            throw std::exception();
-        }
-
-        if(first_surfel->node_id < second_surfel->node_id) {
-            return true;
-        } else if (first_surfel->node_id > second_surfel->node_id) {
-            return false;
-        } else if (first_surfel->node_id == second_surfel->node_id) {
-            if(first_surfel->surfel_id < second_surfel->surfel_id){
-                return true;
-            }
-            else {
-                return false;
-            }
-        }
-        else return false;
+    uint32_t const* neighbours_end(uint32_t const surfel_id) const {
+        return neighbour_ids.data() + neighbour_offsets[surfel_id + 1];
     }
-    
-};
-
-struct min_overlap_order {
-    bool operator() (shared_cluster_surfel const& first_surfel, shared_cluster_surfel const& second_surfel){
-        if(!first_surfel || !second_surfel){
-            throw std::exception();
-        }
-        if(first_surfel->overlap == second_surfel->overlap){
-            if(first_surfel->node_id < second_surfel->node_id) {
-                if(first_surfel->surfel_id < second_surfel->surfel_id) {
-                    return true;
-                }
-                else return false;
-            }
-            else return false;
-        }
-        if(first_surfel->overlap < second_surfel->overlap){
-           return false;
-        }
-        else
-           return true;
+    size_t num_neighbours(uint32_t const surfel_id) const {
+        return neighbour_offsets[surfel_id + 1] - neighbour_offsets[surfel_id];
     }
 };
 
-struct min_deviation_order {
-    bool operator() (shared_cluster_surfel const& first_surfel, shared_cluster_surfel const& second_surfel){
-        if(!first_surfel || !second_surfel){
-            throw std::exception();
-        }
-        if(first_surfel->overlap == second_surfel->overlap){
-            if(first_surfel->node_id < second_surfel->node_id) {
-                if(first_surfel->surfel_id < second_surfel->surfel_id) {
-                    return true;
-                }
-                else return false;
-            }
-            else return false;
-        }
-        if(first_surfel->deviation < second_surfel->deviation){
-           return false;
-        }
-        else
-           return true;
-    }
-};
-
-
 class PREPROCESSING_DLL reduction_k_clustering: public reduction_strategy
 {
 public:
@@ -154,38 +63,32 @@ private:
 
   //hash_based algorithm to provide set of min-overlap surfels
   //^no currently no collision handling
-  shared_cluster_surfel_vector get_initial_cluster_seeds(vec3f const& avg_normal, shared_cluster_surfel_vector const&  input_cluster_surfels) const;
+  void get_initial_cluster_seeds(vec3f const& avg_normal, cluster_surfel_set& cluster_surfels) const;
   int get_largest_dim(vec3f const& avg_normal) const;
-  vec3f compute_avg_normal(shared_cluster_surfel_vector const& input_surfels) const; 
-
-
-  void assign_locally_overlapping_neighbours(shared_cluster_surfel current_surfel_ptr,
-                                           shared_cluster_surfel_vector& input_surfel_ptr_array) const; //functionality taken from entropy reduction strategy
-
-  void compute_overlap(shared_cluster_surfel current_surfel_ptr, bool look_in_M) const; //use distance to neighbours to compute overlap
+  vec3f compute_avg_normal(cluster_surfel_set const& cluster_surfels) const;
 
-  void compute_deviation(shared_cluster_surfel current_surfel_ptr) const; //use neighbours to compute deviation
+  void assign_locally_overlapping_neighbours(cluster_surfel_set& cluster_surfels,
+                                             const bvh& tree) const; //functionality taken from entropy reduction strategy
 
-  real compute_distance(shared_cluster_surfel first_surfel_ptr,
-                        shared_cluster_surfel second_surfel_ptr) const;
+  void compute_overlap(cluster_surfel_set& cluster_surfels, uint32_t surfel_id, bool look_in_M) const; //use distance to neighbours to compute overlap
 
-  void resolve_oversampling(shared_cluster_surfel_vector& surfel_ptr_set_M) const;
+  real compute_deviation(cluster_surfel_set const& cluster_surfels, uint32_t surfel_id) const; //use neighbours to compute deviation
 
-  void resolve_undersampling(shared_cluster_surfel_vector& input_surfel_ptr_array) const;
+  real compute_distance(cluster_surfel_set const& cluster_surfels,
+                        uint32_t first_surfel_id,
+                        uint32_t second_surfel_id) const;
 
-  void update_cluster_membership(shared_cluster_surfel current_surfel_ptr, bool is_member) const;
+  void resolve_oversampling(cluster_surfel_set& cluster_surfels) const;
 
-  /*void assign_locally_nearest_neighbours(shared_cluster_surfel current_surfel_ptr,
-                                        const uint32_t number_of_neighbours,
-                                        shared_cluster_surfel_vector& input_surfel_ptr_array) const; //partially taken from get_nearest_neighbours();
-   */
+  void resolve_undersampling(cluster_surfel_set& cluster_surfels) const;
 
-  void remove_surfel(shared_cluster_surfel_vector& surfel_ptr_set_M) const;
+  //remove the members of least deviation until num_desired_surfels are left
+  void remove_surfels(cluster_surfel_set& cluster_surfels, size_t num_desired_surfels) const;
 
-  void add_surfel(shared_cluster_surfel_vector& surfel_ptr_set_M,
-                  shared_cluster_surfel_vector& total_surfel_set) const;
+  //add the non-members of least overlap with M until num_desired_surfels are reached
+  void add_surfels(cluster_surfel_set& cluster_surfels, size_t num_desired_surfels) const;
 
-  void merge(shared_cluster_surfel_vector& final_cluster_surfel_set) const;
+  void merge(cluster_surfel_set& cluster_surfels, surfel_vector& output_surfels) const;
 
   void subsample(surfel_mem_array& joined_input, real const avg_radius) const;
 
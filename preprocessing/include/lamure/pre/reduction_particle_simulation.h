@@ -41,7 +41,7 @@ private:
 
 	real 
 	compute_enclosing_sphere_radius(surfel const& target_surfel,
-                                	neighbours_t const& neighbour_ids,
+                                	neighbour_graph::row const& neighbour_ids,
                                 	bvh const& tree) const;
 
 };
@@ -0,0 +1,91 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_SPATIAL_HASH_H_
+#define PRE_SPATIAL_HASH_H_
+
+#include <lamure/pre/platform.h>
+#include <lamure/types.h>
+
+#include <scm/core/math.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace lamure {
+namespace pre
+{
+
+/**
+* Uniform grid over a set of points for radius and nearest neighbour
+* queries.
+*
+* The points are sorted by the key of their cell, so a cell is a range of
+* that order which is found by binary search. Building is O(n log n), no
+* memory besides the sorted keys and a copy of the positions is needed.
+* Query results are point indices in ascending order, so that sums over
+* them are independent of the grid.
+*/
+class PREPROCESSING_DLL spatial_hash
+{
+public:
+                        spatial_hash() {}
+
+    /**
+     * Replaces the contents by the given points. A non-positive cell size
+     * is replaced by one that fits the bounding box.
+     */
+    void                build(const std::vector<vec3r>& positions,
+                              real cell_size);
+
+    size_t              size() const { return positions_.size(); }
+    real                cell_size() const { return cell_size_; }
+
+    /**
+     * Indices of all points p with |p - center| <= radius.
+     */
+    void                find_in_radius(const vec3r& center,
+                                       const real radius,
+                                       std::vector<uint32_t>& indices) const;
+
+    /**
+     * Indices of the num_neighbours points closest to center. Points at
+     * equal distance are taken by ascending index.
+     */
+    void                find_nearest(const vec3r& center,
+                                     const size_t num_neighbours,
+                                     std::vector<uint32_t>& indices) const;
+
+private:
+    using cell_entry = std::pair<uint64_t, uint32_t>;
+
+    /**
+     * Cell coordinates of a position, clamped to one cell outside the grid.
+     */
+    scm::math::vec3i    cell_of(const vec3r& position) const;
+
+    /**
+     * Appends the points of all cells in [min_cell, max_cell] whose
+     * coordinates are not all within [skip_min, skip_max].
+     */
+    void                collect(const scm::math::vec3i& min_cell,
+                                const scm::math::vec3i& max_cell,
+                                const scm::math::vec3i& skip_min,
+                                const scm::math::vec3i& skip_max,
+                                std::vector<uint32_t>& indices) const;
+
+    std::vector<vec3r>  positions_;
+    std::vector<cell_entry> cells_;
+
+    vec3r               origin_ = vec3r(0.0);
+    real                cell_size_ = 1.0;
+    scm::math::vec3i    num_cells_ = scm::math::vec3i(0);
+};
+
+} } // namespace lamure
+
+#endif // PRE_SPATIAL_HASH_H_
@@ -14,6 +14,7 @@
 #include <vector>
 #include <functional>
 #include <memory>
+#include <cassert>
 
 namespace lamure {
 namespace pre
@@ -67,6 +68,20 @@ public:
 
     static compare_function compare(const uint8_t axis);
 
+    /**
+     * Statically typed alternative to compare(). Orders surfels by their
+     * position along one axis and can be inlined by sort algorithms.
+     */
+    struct axis_less
+    {
+        explicit        axis_less(const uint8_t axis) : axis_(axis) { assert(axis <= 2); }
+
+        bool            operator()(const surfel& left, const surfel& right) const
+                            { return left.pos_[axis_] < right.pos_[axis_]; }
+
+        uint8_t         axis_;
+    };
+
 private:
 
     /*static CGAL::Simple_cartesian<double>::Plane_3 
@@ -0,0 +1,146 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#ifndef PRE_THREAD_POOL_H_
+#define PRE_THREAD_POOL_H_
+
+#include <lamure/pre/platform.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lamure {
+namespace pre
+{
+
+/**
+* Persistent pool of worker threads for data parallel loops and task graphs.
+*
+* The index range of a loop is split into one slice per worker. Workers
+* take indices from the front of their own slice and, once it is empty,
+* steal the back half of the largest remaining slice, so that uneven task
+* costs are balanced. Dependent tasks are kept in one deque per worker,
+* which the owner uses as a stack and other workers steal from at the
+* front. The calling thread takes part as worker 0.
+*/
+class PREPROCESSING_DLL thread_pool
+{
+public:
+    using task_type = std::function<void(const size_t index, const size_t worker)>;
+    using schedule_type = std::function<void(const size_t index)>;
+    using dependent_task_type = std::function<void(const size_t index,
+                                                   const size_t worker,
+                                                   const schedule_type& schedule)>;
+
+    /**
+     * \param[in] num_threads  number of workers including the calling
+     *                         thread, 0 for hardware concurrency
+     */
+    explicit            thread_pool(const size_t num_threads = 0);
+                        thread_pool(const thread_pool&) = delete;
+                        thread_pool& operator=(const thread_pool&) = delete;
+                        ~thread_pool();
+
+    size_t              num_threads() const { return workers_.size() + 1; }
+
+    /**
+     * Calls task(index, worker) for all indices in [first, last) and
+     * returns when all calls have finished. worker is in [0, num_threads())
+     * and unique among concurrently running tasks, so it can address per
+     * thread state. The first exception thrown by a task is rethrown.
+     *
+     * Calls from within a task of run_tasks are shared with the workers
+     * that are idle in that task graph. Calls from within other tasks run
+     * sequentially on the calling worker.
+     */
+    void                parallel_for(const size_t first,
+                                     const size_t last,
+                                     const task_type& task,
+                                     const size_t grain_size = 1);
+
+    /**
+     * Calls task(index, worker, schedule) for all indices in initial and
+     * for every index that a running task passes to schedule, and returns
+     * when no task is left. This allows task graphs in which a task
+     * schedules its successors once their dependencies are met.
+     */
+    void                run_tasks(const std::vector<size_t>& initial,
+                                  const dependent_task_type& task);
+
+private:
+    struct slice
+    {
+        std::mutex      mutex;
+        size_t          begin = 0;
+        size_t          end = 0;
+    };
+
+    struct queue
+    {
+        std::mutex      mutex;
+        std::deque<size_t> indices;
+    };
+
+    struct job
+    {
+        const task_type* task = nullptr;
+        const dependent_task_type* dependent_task = nullptr;
+        size_t          grain_size = 1;
+        std::vector<slice> slices;
+        std::vector<queue> queues;
+        std::atomic<size_t> remaining;
+        std::atomic<size_t> queued;
+        std::mutex      wait_mutex;
+        std::condition_variable wait_condition;
+        std::mutex      error_mutex;
+        std::exception_ptr error;
+
+        job*            parent = nullptr;   ///< task graph of a nested loop
+        size_t          helpers = 0;        ///< guarded by the parent's wait_mutex
+        std::vector<job*> nested;           ///< open nested loops, guarded by wait_mutex
+    };
+
+    void                submit(job& current_job);
+    void                run_nested(job& graph,
+                                   const size_t first,
+                                   const size_t last,
+                                   const task_type& task,
+                                   const size_t grain_size);
+    void                help_nested(job& graph,
+                                    std::unique_lock<std::mutex>& graph_lock,
+                                    const size_t worker);
+    void                worker_loop(const size_t worker);
+    void                run(job& current_job, const size_t worker);
+    void                run_dependent(job& current_job, const size_t worker);
+    bool                steal(job& current_job, const size_t worker);
+    bool                pop(job& current_job, const size_t worker, size_t& index);
+    void                finish(job& current_job, const size_t count);
+    void                set_error(job& current_job);
+
+    std::vector<std::thread> workers_;
+
+    std::mutex          mutex_;
+    std::mutex          submit_mutex_;
+    std::condition_variable wake_condition_;
+    std::condition_variable done_condition_;
+
+    job*                job_ = nullptr;
+    size_t              generation_ = 0;
+    size_t              active_workers_ = 0;
+    bool                stop_ = false;
+};
+
+} } // namespace lamure
+
+#endif // PRE_THREAD_POOL_H_
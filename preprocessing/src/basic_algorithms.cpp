@@ -9,6 +9,7 @@
 
 #include <lamure/pre/io/file.h>
 #include <lamure/pre/external_sort.h>
+#include <lamure/pre/key_index_sort.h>
 
 #if WIN32
   #include <ppl.h>
@@ -17,6 +18,7 @@
 #endif
 
 #include <cstring>
+#include <algorithm>
 
 namespace lamure {
 namespace pre 
@@ -207,29 +209,38 @@ sort_and_split(surfel_mem_array& sa,
              const bounding_box& box,
              const uint8_t split_axis,
              const uint8_t fan_factor,
-             const bool parallelize)
+             const bool parallelize,
+             const split_algorithm split_algo)
 {
     assert(!sa.is_empty());
     assert(sa.length() > 0);
 
-    if (parallelize) {
+    std::vector<real> splits;
+
+    if (split_algo == split_algorithm::partition && sa.length() >= fan_factor) {
+        splits = partition(sa, split_axis, fan_factor, parallelize);
+    }
+    else if (split_algo == split_algorithm::key_sort) {
+        key_index_sort::sort(sa, key_index_sort::axis_key(split_axis), parallelize);
+    }
+    else if (parallelize) {
 #if WIN32
       // todo: find platform independent sort
       Concurrency::parallel_sort(sa.mem_data()->begin() + sa.offset(),
         sa.mem_data()->begin() + sa.offset() + sa.length(),
-        surfel::compare(split_axis));
+        surfel::axis_less(split_axis));
 #else
       __gnu_parallel::sort(sa.mem_data()->begin() + sa.offset(),
         sa.mem_data()->begin() + sa.offset() + sa.length(),
-        surfel::compare(split_axis));
+        surfel::axis_less(split_axis));
 #endif
     } else {
       std::sort(sa.mem_data()->begin() + sa.offset(),
         sa.mem_data()->begin() + sa.offset() + sa.length(),
-        surfel::compare(split_axis));
+        surfel::axis_less(split_axis));
     }
 
-    split_surfel_array<surfel_mem_array>(sa, out, box, split_axis, fan_factor);
+    split_surfel_array<surfel_mem_array>(sa, out, box, split_axis, fan_factor, splits);
 }
 
 void basic_algorithms::
@@ -238,10 +249,247 @@ sort_and_split(surfel_disk_array& sa,
              const bounding_box& box,
              const uint8_t split_axis,
              const uint8_t fan_factor,
-             const size_t memory_limit)
+             const size_t memory_limit,
+             const split_algorithm split_algo)
+{
+    std::vector<real> splits;
+
+    if (split_algo == split_algorithm::partition)
+        splits = partition(sa, split_axis, fan_factor, memory_limit);
+
+    // fall back to the external merge sort if the keys exceed the memory limit
+    if (splits.empty() &&
+        (split_algo != split_algorithm::key_sort ||
+         !key_index_sort::sort(sa, key_index_sort::axis_key(split_axis), memory_limit)))
+        external_sort::sort(sa, memory_limit, surfel::axis_less(split_axis));
+
+    split_surfel_array<surfel_disk_array>(sa, out, box, split_axis, fan_factor, splits);
+}
+
+void basic_algorithms::
+sort_by_morton_code(surfel_disk_array& sa,
+                    const bounding_box& box,
+                    const size_t memory_limit)
+{
+    const key_index_sort::key_function key = key_index_sort::morton_key(box);
+
+    if (!key_index_sort::sort(sa, key, memory_limit))
+        external_sort::sort(sa, memory_limit, key_index_sort::key_less(key));
+}
+
+void basic_algorithms::
+split_by_count(surfel_disk_array& sa,
+               splitted_array<surfel_disk_array>& out,
+               const uint8_t fan_factor)
+{
+    const std::vector<size_t> bounds = compute_child_bounds(sa.length(), fan_factor);
+
+    for (uint32_t i = 0; i < fan_factor; ++i) {
+        auto child_array = surfel_disk_array(sa, sa.offset() + bounds[i], bounds[i + 1] - bounds[i]);
+        out.push_back(std::make_pair(child_array, bounding_box()));
+    }
+}
+
+std::vector<size_t> basic_algorithms::
+compute_child_bounds(const size_t length,
+                     const uint8_t fan_factor)
+{
+    // the first (length % fan_factor) children get one surfel more
+    const size_t child_size = length / fan_factor;
+    const size_t remainder = length % fan_factor;
+
+    std::vector<size_t> bounds(fan_factor + 1, 0);
+    for (size_t i = 0; i < fan_factor; ++i)
+        bounds[i + 1] = bounds[i] + child_size + (i < remainder ? 1 : 0);
+
+    return bounds;
+}
+
+template <class iterator_type, class compare_type>
+static void
+select_child_bounds(iterator_type begin,
+                    const std::vector<size_t>& bounds,
+                    const compare_type& compare,
+                    const bool parallelize)
+{
+    // select the middle bound of a range of children first, then both halves
+    std::vector<std::pair<size_t, size_t>> ranges(1, std::make_pair(0, bounds.size() - 1));
+
+    while (!ranges.empty()) {
+        const size_t lo = ranges.back().first;
+        const size_t hi = ranges.back().second;
+        ranges.pop_back();
+
+        if (hi - lo < 2)
+            continue;
+
+        const size_t mid = (lo + hi) / 2;
+#if WIN32
+        std::nth_element(begin + bounds[lo], begin + bounds[mid], begin + bounds[hi], compare);
+#else
+        if (parallelize)
+            __gnu_parallel::nth_element(begin + bounds[lo], begin + bounds[mid], begin + bounds[hi], compare);
+        else
+            std::nth_element(begin + bounds[lo], begin + bounds[mid], begin + bounds[hi], compare);
+#endif
+        ranges.push_back(std::make_pair(lo, mid));
+        ranges.push_back(std::make_pair(mid, hi));
+    }
+}
+
+std::vector<real> basic_algorithms::
+partition(surfel_mem_array& sa,
+          const uint8_t split_axis,
+          const uint8_t fan_factor,
+          const bool parallelize)
+{
+    assert(sa.length() >= fan_factor);
+
+    const std::vector<size_t> bounds = compute_child_bounds(sa.length(), fan_factor);
+    const auto begin = sa.mem_data()->begin() + sa.offset();
+    const surfel::axis_less compare(split_axis);
+
+    select_child_bounds(begin, bounds, compare, parallelize);
+
+    // the children are unordered internally, so the surfels next to
+    // each split have to be searched
+    std::vector<real> splits;
+    for (size_t i = 1; i < fan_factor; ++i) {
+        real p0 = std::max_element(begin + bounds[i - 1], begin + bounds[i], compare)->pos()[split_axis];
+        real p1 = std::min_element(begin + bounds[i], begin + bounds[i + 1], compare)->pos()[split_axis];
+
+        splits.push_back((p1 - p0) / 2.0 + p0);
+    }
+    return splits;
+}
+
+std::vector<real> basic_algorithms::
+partition(surfel_disk_array& sa,
+          const uint8_t split_axis,
+          const uint8_t fan_factor,
+          const size_t memory_limit)
 {
-    external_sort::sort(sa, memory_limit, surfel::compare(split_axis));
-    split_surfel_array<surfel_disk_array>(sa, out, box, split_axis, fan_factor);
+    assert(!sa.is_empty());
+    assert(sa.file());
+
+    const size_t length = sa.length();
+
+    if (length < fan_factor)
+        return std::vector<real>();
+
+    if (length <= memory_limit / sizeof(surfel) / 3u) {
+        // the whole array fits, partition it in memory
+        shared_surfel_vector data = sa.read_all();
+        surfel_mem_array mem_array(data, 0, length);
+        std::vector<real> splits = partition(mem_array, split_axis, fan_factor, true);
+        sa.write_all(data, 0);
+        return splits;
+    }
+
+    // the coordinates along the split axis and a read buffer have to fit
+    if (length * sizeof(real) * 2u > memory_limit)
+        return std::vector<real>();
+
+    LOGGER_INFO("Partition out-of-core. Length: " << length);
+
+    const size_t block_length = std::max(size_t(1), memory_limit / sizeof(surfel) / 4u);
+    const std::vector<size_t> bounds = compute_child_bounds(length, fan_factor);
+
+    std::vector<real> coords(length);
+    surfel_vector block(block_length);
+
+    for (size_t first = 0; first < length; first += block_length) {
+        const size_t len = std::min(block_length, length - first);
+        sa.file()->read(&block, 0, sa.offset() + first, len);
+
+        for (size_t i = 0; i < len; ++i)
+            coords[first + i] = block[i].pos()[split_axis];
+    }
+
+    select_child_bounds(coords.begin(), bounds, std::less<real>(), true);
+
+    std::vector<real> boundary_values, splits;
+    for (size_t i = 1; i < fan_factor; ++i) {
+        real p0 = *std::max_element(coords.begin() + bounds[i - 1], coords.begin() + bounds[i]);
+        real p1 = *std::min_element(coords.begin() + bounds[i], coords.begin() + bounds[i + 1]);
+
+        boundary_values.push_back(p1);
+        splits.push_back((p1 - p0) / 2.0 + p0);
+    }
+
+    // surfels that equal a boundary value are assigned by their rank among
+    // equal coordinates, so that every child gets exactly its share
+    std::vector<size_t> less_count(fan_factor - 1, 0);
+    std::vector<size_t> tie_count(fan_factor - 1, 0);
+
+    for (const real x : coords)
+        for (size_t i = 0; i < boundary_values.size(); ++i)
+            if (x < boundary_values[i])
+                ++less_count[i];
+
+    std::vector<real>().swap(coords);
+
+    auto child_of = [&](const real x) -> size_t {
+        size_t child = 0;
+        for (size_t i = 0; i < boundary_values.size(); ++i) {
+            if (x == boundary_values[i]) {
+                const size_t rank = less_count[i] + tie_count[i]++;
+                return std::upper_bound(bounds.begin() + 1, bounds.end() - 1, rank) -
+                       (bounds.begin() + 1);
+            }
+            if (x > boundary_values[i])
+                child = i + 1;
+        }
+        return child;
+    };
+
+    // distribute into the child ranges of a temporary file, it is written
+    // in scattered pieces and never kept, so it is not compressed
+    shared_file children_file = std::make_shared<file>(file::default_backend(),
+                                                       file_compression::none);
+    children_file->open(sa.file()->file_name() + ".part", true);
+
+    const size_t staging_length = std::max(size_t(1), block_length / fan_factor);
+    std::vector<surfel_vector> staging(fan_factor);
+    std::vector<size_t> written(fan_factor, 0);
+
+    for (auto& s : staging)
+        s.reserve(staging_length);
+
+    auto flush = [&](const size_t child) {
+        if (staging[child].empty())
+            return;
+        children_file->write(&staging[child], 0, bounds[child] + written[child],
+                             staging[child].size());
+        written[child] += staging[child].size();
+        staging[child].clear();
+    };
+
+    for (size_t first = 0; first < length; first += block_length) {
+        const size_t len = std::min(block_length, length - first);
+        sa.file()->read(&block, 0, sa.offset() + first, len);
+
+        for (size_t i = 0; i < len; ++i) {
+            const size_t child = child_of(block[i].pos()[split_axis]);
+            staging[child].push_back(block[i]);
+            if (staging[child].size() >= staging_length)
+                flush(child);
+        }
+    }
+    for (size_t child = 0; child < fan_factor; ++child) {
+        flush(child);
+        assert(written[child] == bounds[child + 1] - bounds[child]);
+    }
+
+    // copy back
+    for (size_t first = 0; first < length; first += block_length) {
+        const size_t len = std::min(block_length, length - first);
+        children_file->read(&block, 0, first, len);
+        sa.file()->write(&block, 0, sa.offset() + first, len);
+    }
+
+    children_file->close(true);
+    return splits;
 }
 
 template <class T>
@@ -250,40 +498,28 @@ split_surfel_array(T& sa,
                  splitted_array<T>& out,
                  const bounding_box& box,
                  const uint8_t split_axis,
-                 const uint8_t fan_factor)
+                 const uint8_t fan_factor,
+                 std::vector<real> splits)
 {
     using Traits = surfel_array_traits<T>;
     static_assert(Traits::is_in_core || Traits::is_out_of_core, "Wrong type");
 
-    const uint32_t child_size = (int)sa.length() / fan_factor;
-    uint32_t remainder = sa.length() % fan_factor;
+    const std::vector<size_t> bounds = compute_child_bounds(sa.length(), fan_factor);
 
     for (uint32_t i = 0; i < fan_factor; ++i) {
-        uint32_t child_first;
-        if (i == 0)
-            child_first = sa.offset();
-        else
-            child_first = out[i-1].first.length()+out[i-1].first.offset();
-
-        uint32_t child_last = child_first+child_size;
-        if (remainder > 0) {
-            ++child_last;
-            --remainder;
-        }
-
-        auto child_array = T(sa, child_first, child_last - child_first);
+        auto child_array = T(sa, sa.offset() + bounds[i], bounds[i + 1] - bounds[i]);
         out.push_back(std::make_pair(child_array, bounding_box()));
     }
 
     // compute bounding boxes
 
-    std::vector<real> splits;
-
-    for (size_t i = 0; i < out.size() - 1; ++i) {
-        real p0 = out[i].first.read_surfel(out[i].first.length() - 1).pos()[split_axis];
-        real p1 = out[i + 1].first.read_surfel(0).pos()[split_axis];
+    if (splits.empty()) {
+        for (size_t i = 0; i < out.size() - 1; ++i) {
+            real p0 = out[i].first.read_surfel(out[i].first.length() - 1).pos()[split_axis];
+            real p1 = out[i + 1].first.read_surfel(0).pos()[split_axis];
 
-        splits.push_back((p1 - p0) / 2.0 + p0);
+            splits.push_back((p1 - p0) / 2.0 + p0);
+        }
     }
 
     for (size_t i = 0; i < out.size(); ++i) {
@@ -50,6 +50,9 @@ builder(const descriptor& desc)
 {
     base_path_ = fs::path(desc_.working_directory) 
                  / fs::path(desc_.input_file).stem().string();
+
+    file::set_default_backend(desc_.io_backend);
+    file::set_default_compression(desc_.interm_compression);
 }
 
 builder::~builder()
@@ -108,7 +111,8 @@ normal_computation_strategy* builder::get_normal_strategy(normal_computation_alg
     };
 }
 
-boost::filesystem::path builder::convert_to_binary(std::string const& input_type) const{
+boost::filesystem::path builder::convert_to_binary(std::string const& input_type,
+                                                   bounding_box& output_bounding_box) const{
     std::cout << std::endl;
     std::cout << "--------------------------------" << std::endl;
     std::cout << "convert input file" << std::endl;
@@ -146,106 +150,69 @@ boost::filesystem::path builder::convert_to_binary(std::string const& input_type
 
     CPU_TIMER;
     conv.convert(input_file.string(), binary_file.string());
+    output_bounding_box = conv.output_bounding_box();
     // LOGGER_DEBUG("Used memory: " << GetProcessUsedMemory() / 1024 / 1024 << " MiB");
     return binary_file;
 }
 
-boost::filesystem::path builder::downsweep(boost::filesystem::path input_file, uint16_t start_stage) const{
-    bool performed_outlier_removal = false;
-    do {
-        std::string status_suffix = "";
-        if ( true == performed_outlier_removal ) {
-            status_suffix = " (after outlier removal)";
-        }
-
-        std::cout << std::endl;
-        std::cout << "--------------------------------" << std::endl;
-        std::cout << "bvh properties" << status_suffix << std::endl;
-        std::cout << "--------------------------------" << std::endl;
-
-        lamure::pre::bvh bvh(memory_limit_, desc_.buffer_size, desc_.rep_radius_algo);
-
-        bvh.init_tree(input_file.string(),
-                          desc_.max_fan_factor,
-                          desc_.surfels_per_node,
-                          base_path_);
-
-        bvh.print_tree_properties();
-        std::cout << std::endl;
-
-        std::cout << "--------------------------------" << std::endl;
-        std::cout << "downsweep" << status_suffix << std::endl;
-        std::cout << "--------------------------------" << std::endl;
-        LOGGER_TRACE("downsweep stage");
-
-        CPU_TIMER;
-        bvh.downsweep(desc_.translate_to_origin, input_file.string());
-
-        auto bvhd_file = add_to_path(base_path_, ".bvhd");
-
-        bvh.serialize_tree_to_file(bvhd_file.string(), true);
-
-        if ((!desc_.keep_intermediate_files) && (start_stage < 1))
-        {
-            // do not remove input file
-            std::remove(input_file.string().c_str());
-        }
-
-        input_file = bvhd_file;
-
-        // LOGGER_DEBUG("Used memory: " << GetProcessUsedMemory() / 1024 / 1024 << " MiB");
-
-        if ( 3 <= start_stage ) {
-            break;
-        }
-
-        if ( performed_outlier_removal ) {
-            break;
-        }
-
-        if(start_stage <= 2 ) {
-
-            if(desc_.outlier_ratio != 0.0) {
-
-                size_t num_outliers = desc_.outlier_ratio * (bvh.nodes().size() - bvh.first_leaf()) * bvh.max_surfels_per_node();
-                size_t ten_percent_of_surfels = std::max( size_t(0.1 * (bvh.nodes().size() - bvh.first_leaf()) * bvh.max_surfels_per_node()), size_t(1) );
-                num_outliers = std::min(std::max(num_outliers, size_t(1) ), ten_percent_of_surfels); // remove at least 1 surfel, for any given ratio != 0.0
+boost::filesystem::path builder::downsweep(boost::filesystem::path input_file,
+                                           uint16_t start_stage,
+                                           bounding_box input_bounding_box) const{
+    std::cout << std::endl;
+    std::cout << "--------------------------------" << std::endl;
+    std::cout << "bvh properties" << std::endl;
+    std::cout << "--------------------------------" << std::endl;
 
+    lamure::pre::bvh bvh(memory_limit_, desc_.buffer_size, desc_.rep_radius_algo,
+                         desc_.split_algo, desc_.downsweep_algo);
 
-                std::cout << std::endl;
-                std::cout << "--------------------------------" << std::endl;
-                std::cout << "outlier removal ( " << int(desc_.outlier_ratio * 100) << " percent = " << num_outliers << " surfels)" << std::endl;
-                std::cout << "--------------------------------" << std::endl;
-                LOGGER_TRACE("outlier removal stage");
+    bvh.init_tree(input_file.string(),
+                      desc_.max_fan_factor,
+                      desc_.surfels_per_node,
+                      base_path_);
 
-                surfel_vector kept_surfels = bvh.remove_outliers_statistically(num_outliers, desc_.number_of_outlier_neighbours);
+    bvh.print_tree_properties();
+    std::cout << std::endl;
 
-                format_bin format_out;
+    std::cout << "--------------------------------" << std::endl;
+    std::cout << "downsweep" << std::endl;
+    std::cout << "--------------------------------" << std::endl;
+    LOGGER_TRACE("downsweep stage");
 
-                std::unique_ptr<format_abstract> dummy_format_in{new format_xyz()};
+    CPU_TIMER;
+    bvh.downsweep(desc_.translate_to_origin, input_file.string(), false, input_bounding_box);
 
-                converter conv(*dummy_format_in, format_out, desc_.buffer_size);
+    // outliers are removed from the leaves of the finished tree, which
+    // keeps its structure
+    if(start_stage <= 2 && desc_.outlier_ratio != 0.0) {
 
-                conv.set_surfel_callback([](surfel &s, bool& keep) { if (s.pos() == vec3r(0.0,0.0,0.0)) keep = false; });
+        size_t num_outliers = desc_.outlier_ratio * (bvh.nodes().size() - bvh.first_leaf()) * bvh.max_surfels_per_node();
+        size_t ten_percent_of_surfels = std::max( size_t(0.1 * (bvh.nodes().size() - bvh.first_leaf()) * bvh.max_surfels_per_node()), size_t(1) );
+        num_outliers = std::min(std::max(num_outliers, size_t(1) ), ten_percent_of_surfels); // remove at least 1 surfel, for any given ratio != 0.0
 
-                auto binary_outlier_removed_file = add_to_path(base_path_, ".bin_wo_outlier");
 
-                conv.write_in_core_surfels_out(kept_surfels, binary_outlier_removed_file.string());
+        std::cout << std::endl;
+        std::cout << "--------------------------------" << std::endl;
+        std::cout << "outlier removal ( " << int(desc_.outlier_ratio * 100) << " percent = " << num_outliers << " surfels)" << std::endl;
+        std::cout << "--------------------------------" << std::endl;
+        LOGGER_TRACE("outlier removal stage");
 
-                bvh.reset_nodes();
+        bvh.remove_outliers_statistically(num_outliers, desc_.number_of_outlier_neighbours);
+    }
 
-                input_file = fs::canonical(binary_outlier_removed_file);
+    auto bvhd_file = add_to_path(base_path_, ".bvhd");
 
-                performed_outlier_removal = true;
-            } else {
-                break;
-            }
+    bvh.serialize_tree_to_file(bvhd_file.string(), true);
 
-        }
+    if ((!desc_.keep_intermediate_files) && (start_stage < 1))
+    {
+        // do not remove input file
+        std::remove(input_file.string().c_str());
+    }
 
-    } while( true );
+    // LOGGER_DEBUG("Used memory: " << GetProcessUsedMemory() / 1024 / 1024 << " MiB");
 
-    return input_file;
+    return bvhd_file;
 }
 
 boost::filesystem::path builder::upsweep(boost::filesystem::path input_file,
@@ -259,7 +226,8 @@ boost::filesystem::path builder::upsweep(boost::filesystem::path input_file,
     std::cout << "--------------------------------" << std::endl;
     LOGGER_TRACE("upsweep stage");
 
-    lamure::pre::bvh bvh(memory_limit_, desc_.buffer_size, desc_.rep_radius_algo);
+    lamure::pre::bvh bvh(memory_limit_, desc_.buffer_size, desc_.rep_radius_algo,
+                         desc_.split_algo, desc_.downsweep_algo);
 
     if (!bvh.load_tree(input_file.string())) {
         return boost::filesystem::path{};
@@ -297,7 +265,8 @@ bool builder::resample_surfels(boost::filesystem::path const& input_file) const
     std::cout << "--------------------------------" << std::endl;
     LOGGER_TRACE("resample stage");
 
-    lamure::pre::bvh bvh(memory_limit_, desc_.buffer_size, desc_.rep_radius_algo);
+    lamure::pre::bvh bvh(memory_limit_, desc_.buffer_size, desc_.rep_radius_algo,
+                         desc_.split_algo, desc_.downsweep_algo);
 
     if (!bvh.load_tree(input_file.string())) {
         return false;
@@ -309,17 +278,11 @@ bool builder::resample_surfels(boost::filesystem::path const& input_file) const
     }
 
     CPU_TIMER;
-    // perform resample
-    bvh.resample();
-
-    //write resampled leaf level out
-    format_xyz format_out;
-    std::unique_ptr<format_xyz> dummy_format_in{new format_xyz()};
-    auto xyz_res_file = add_to_path(base_path_, "_res.xyz");
-    converter conv(*dummy_format_in, format_out, desc_.buffer_size);
-    surfel_vector resampled_ll = bvh.get_resampled_leaf_lv_surfels();
-    conv.write_in_core_surfels_out(resampled_ll, xyz_res_file.string());
-    
+    // perform resample, the leaf level is written out as binary surfels
+    auto bin_res_file = add_to_path(base_path_, "_res.bin");
+    const size_t num_resampled = bvh.resample(bin_res_file.string());
+    LOGGER_INFO("Resampled surfels: " << num_resampled << " written to " << bin_res_file.string());
+
     std::remove(input_file.string().c_str());
 
 // LOGGER_DEBUG("Used memory: " << GetProcessUsedMemory() / 1024 / 1024 << " MiB");
@@ -332,7 +295,8 @@ bool builder::reserialize(boost::filesystem::path const& input_file, uint16_t st
     std::cout << "serialize to file" << std::endl;
     std::cout << "--------------------------------" << std::endl;
 
-    lamure::pre::bvh bvh(memory_limit_, desc_.buffer_size, desc_.rep_radius_algo);
+    lamure::pre::bvh bvh(memory_limit_, desc_.buffer_size, desc_.rep_radius_algo,
+                         desc_.split_algo, desc_.downsweep_algo);
     if (!bvh.load_tree(input_file.string())) {
         return false;
     }
@@ -346,6 +310,8 @@ bool builder::reserialize(boost::filesystem::path const& input_file, uint16_t st
     auto kdn_file = add_to_path(base_path_, ".bvh");
 
     std::cout << "serialize surfels to file" << std::endl;
+    bvh.set_lod_encoding(desc_.lod_encoding);
+    bvh.set_lod_layout(desc_.lod_layout);
     bvh.serialize_surfels_to_file(lod_file.string(), desc_.buffer_size);
 
     std::cout << "serialize bvh to file" << std::endl << std::endl;
@@ -397,18 +363,19 @@ bool builder::resample() {
     }
 
     // convert to binary file
+    bounding_box input_bounding_box;
     if (0 >= start_stage) {
-        input_file = convert_to_binary(input_file_type);
+        input_file = convert_to_binary(input_file_type, input_bounding_box);
         if(input_file.empty()) return false;
     }
 
     // downsweep (create bvh)
     if (3 >= start_stage) {
-        input_file = downsweep(input_file, start_stage);
+        input_file = downsweep(input_file, start_stage, input_bounding_box);
         if(input_file.empty()) return false;
     }
 
-    // resample (create new xzy)
+    // resample (create new _res.bin)
    bool resample_success = resample_surfels(input_file);
    return resample_success;
 }
@@ -452,14 +419,15 @@ construct()
     std::unique_ptr<radius_computation_strategy> radius_comp_strategy{get_radius_strategy(desc_.radius_computation_algo)};
 
     // convert to binary file
+    bounding_box input_bounding_box;
     if ((0 >= start_stage) && (0 <= final_stage)) {
-        input_file = convert_to_binary(input_file_type);
+        input_file = convert_to_binary(input_file_type, input_bounding_box);
         if(input_file.empty()) return false;
     }
 
     // downsweep (create bvh)
     if ((3 >= start_stage) && (3 <= final_stage)) {
-        input_file = downsweep(input_file, start_stage);
+        input_file = downsweep(input_file, start_stage, input_bounding_box);
         if(input_file.empty()) return false;
     }
 
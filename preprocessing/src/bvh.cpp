@@ -18,7 +18,6 @@
 #include <lamure/pre/basic_algorithms.h>
 #include <lamure/pre/serialized_surfel.h>
 #include <lamure/pre/plane.h>
-#include <lamure/atomic_counter.h>
 #include <lamure/utils.h>
 #include <lamure/sphere.h>
 
@@ -27,6 +26,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <fstream>
 #include <thread>
@@ -177,6 +178,46 @@ get_length_of_depth(uint32_t depth) const {
     return pow((double)fan_factor_, (double)depth);
 }
 
+std::vector<node_id_type> bvh::
+get_clustered_node_order() const
+{
+    std::vector<node_id_type> order;
+    order.reserve(nodes_.size());
+    if (!nodes_.empty())
+        append_clustered_subtree(0, depth_ + 1, order);
+    assert(order.size() == nodes_.size());
+    return order;
+}
+
+void bvh::
+append_clustered_subtree(const node_id_type root,
+                         const uint32_t height,
+                         std::vector<node_id_type>& order) const
+{
+    if (height == 1) {
+        order.push_back(root);
+        return;
+    }
+
+    const uint32_t top_height = height / 2;
+    append_clustered_subtree(root, top_height, order);
+
+    // roots of the bottom subtrees, from left to right
+    std::vector<node_id_type> bottom_roots(1, root);
+    for (uint32_t level = 0; level < top_height; ++level) {
+        std::vector<node_id_type> children;
+        children.reserve(bottom_roots.size() * fan_factor_);
+        for (const auto node_id: bottom_roots) {
+            for (uint8_t i = 0; i < fan_factor_; ++i)
+                children.push_back(get_child_id(node_id, i));
+        }
+        bottom_roots.swap(children);
+    }
+
+    for (const auto node_id: bottom_roots)
+        append_clustered_subtree(node_id, height - top_height, order);
+}
+
 std::pair<node_id_type, node_id_type> bvh::
 get_node_ranges(const uint32_t depth) const
 {
@@ -203,7 +244,8 @@ print_tree_properties() const
 void bvh::
 downsweep(bool adjust_translation,
           const std::string& surfels_input_file,
-          bool bin_all_file_extension)
+          bool bin_all_file_extension,
+          const bounding_box& input_bounding_box)
 {
     assert(state_ == state_type::empty);
 
@@ -243,9 +285,15 @@ downsweep(bool adjust_translation,
     bounding_box input_bb;
 
     // check if the root can be switched to in-core
-    if (final_depth == 0) {
-        LOGGER_TRACE("Compute root bounding box in-core");
+    if (final_depth == 0)
         nodes_[0].load_from_disk();
+
+    if (input_bounding_box.is_valid()) {
+        LOGGER_TRACE("Use known root bounding box");
+        input_bb = input_bounding_box;
+    }
+    else if (final_depth == 0) {
+        LOGGER_TRACE("Compute root bounding box in-core");
         input_bb = basic_algorithms::compute_aabb(nodes_[0].mem_array());
 
     }
@@ -256,7 +304,12 @@ downsweep(bool adjust_translation,
     }
     LOGGER_DEBUG("Root AABB: " << input_bb.min() << " - " << input_bb.max());
 
-    // translate all surfels by the root AABB center
+    // translate all surfels by the root AABB center. Out-of-core, the
+    // translation is deferred until the nodes are loaded in-core, which
+    // saves a pass over the input file. The order of the surfels does not
+    // depend on it.
+    vec3r deferred_translation = vec3r(0.0);
+
     if (adjust_translation) {
         vec3r translation = (input_bb.min() + input_bb.max()) * vec3r(0.5);
         translation.x = std::floor(translation.x);
@@ -266,16 +319,15 @@ downsweep(bool adjust_translation,
 
         LOGGER_INFO("The surfels will be translated by: " << translation);
 
-        input_bb.min() -= translation;
-        input_bb.max() -= translation;
-
         if (final_depth == 0) {
+            input_bb.min() -= translation;
+            input_bb.max() -= translation;
             basic_algorithms::translate_surfels(nodes_[0].mem_array(), -translation);
+            LOGGER_DEBUG("New root AABB: " << input_bb.min() << " - " << input_bb.max());
         }
         else {
-            basic_algorithms::translate_surfels(nodes_[0].disk_array(), -translation, buffer_size_);
+            deferred_translation = translation;
         }
-        LOGGER_DEBUG("New root AABB: " << input_bb.min() << " - " << input_bb.max());
     }
     else {
         translation_ = vec3r(0.0);
@@ -283,6 +335,14 @@ downsweep(bool adjust_translation,
 
     nodes_[0].set_bounding_box(input_bb);
 
+    // in Morton mode, a single sort orders all out-of-core levels at once
+    const bool carve_out_of_core = downsweep_algo_ == downsweep_algorithm::morton &&
+                                   final_depth > 0;
+    if (carve_out_of_core) {
+        LOGGER_TRACE("Sort surfels by Morton code");
+        basic_algorithms::sort_by_morton_code(nodes_[0].disk_array(), input_bb, memory_limit_);
+    }
+
     // construct out-of-core
 
     uint32_t processed_nodes = 0;
@@ -301,12 +361,20 @@ downsweep(bool adjust_translation,
             // split and compute child bounding boxes
             basic_algorithms::splitted_array<surfel_disk_array> surfel_arrays;
 
-            basic_algorithms::sort_and_split(current_node.disk_array(),
-                                             surfel_arrays,
-                                             current_node.get_bounding_box(),
-                                             current_node.get_bounding_box().get_longest_axis(),
-                                             fan_factor_,
-                                             memory_limit_);
+            if (carve_out_of_core) {
+                basic_algorithms::split_by_count(current_node.disk_array(),
+                                                 surfel_arrays,
+                                                 fan_factor_);
+            }
+            else {
+                basic_algorithms::sort_and_split(current_node.disk_array(),
+                                                 surfel_arrays,
+                                                 current_node.get_bounding_box(),
+                                                 current_node.get_bounding_box().get_longest_axis(),
+                                                 fan_factor_,
+                                                 memory_limit_,
+                                                 split_algo_);
+            }
 
             // iterate through children
             for (size_t i = 0; i < surfel_arrays.size(); ++i) {
@@ -338,6 +406,16 @@ downsweep(bool adjust_translation,
         slice_right = new_slice_right;
     }
 
+    // move the out-of-core levels into the translated space
+    if (deferred_translation != vec3r(0.0)) {
+        for (size_t nid = 0; nid <= slice_right; ++nid) {
+            const bounding_box& bb = nodes_[nid].get_bounding_box();
+            if (bb.is_valid())
+                nodes_[nid].set_bounding_box(bounding_box(bb.min() - deferred_translation,
+                                                          bb.max() - deferred_translation));
+        }
+    }
+
     // construct next level in-core
     for (size_t nid = slice_left; nid <= slice_right; ++nid) {
         bvh_node& current_node = nodes_[nid];
@@ -347,6 +425,12 @@ downsweep(bool adjust_translation,
             assert(current_node.is_out_of_core());
             current_node.load_from_disk();
         }
+        if (deferred_translation != vec3r(0.0))
+            basic_algorithms::translate_surfels(current_node.mem_array(), -deferred_translation);
+        // carved nodes have no bounding box yet
+        if (carve_out_of_core)
+            current_node.set_bounding_box(basic_algorithms::compute_aabb(current_node.mem_array()));
+
         LOGGER_TRACE("Process subbvh in-core at node " << nid);
         // process subbvh and save leafs
         downsweep_subtree_in_core(current_node, disk_leaf_destination, processed_nodes,
@@ -355,6 +439,19 @@ downsweep(bool adjust_translation,
     }
     //std::cout << std::endl << std::endl;
 
+    // the carved out-of-core levels enclose their children
+    if (carve_out_of_core) {
+        for (int32_t level = int32_t(final_depth) - 1; level >= 0; --level) {
+            const node_id_type first = get_first_node_id_of_depth(level);
+            for (node_id_type nid = first; nid < first + get_length_of_depth(level); ++nid) {
+                bounding_box node_bounding_box;
+                for (uint32_t i = 0; i < fan_factor_; ++i)
+                    node_bounding_box.expand(nodes_[get_child_id(nid, i)].get_bounding_box());
+                nodes_[nid].set_bounding_box(node_bounding_box);
+            }
+        }
+    }
+
     input_file_disk_access->close();
     state_ = state_type::after_downsweep;
 }
@@ -388,13 +485,20 @@ downsweep_subtree_in_core( const bvh_node& node,
     spawn_compute_bounding_boxes_downsweep_jobs(slice_left, slice_right);
 
     LOGGER_TRACE("Save leaves to disk");
-    // save leaves to disk
+    // the leaves are stored consecutively, so every destination is known
+    // upfront and the leaves can be written in parallel
+    std::vector<size_t> leaf_destinations;
+    leaf_destinations.reserve(slice_right - slice_left + 1);
     for (size_t nid = slice_left; nid <= slice_right; ++nid) {
-        bvh_node& current_node = nodes_[nid];
-        current_node.flush_to_disk(leaf_level_access,
-                                 disk_leaf_destination, true);
-        disk_leaf_destination += current_node.disk_array().length();
+        leaf_destinations.push_back(disk_leaf_destination);
+        disk_leaf_destination += nodes_[nid].mem_array().length();
     }
+
+    thread_pool_.parallel_for(slice_left, slice_right + 1,
+        [&](const size_t nid, const size_t) {
+            nodes_[nid].flush_to_disk(leaf_level_access,
+                                      leaf_destinations[nid - slice_left], true);
+        }, 16);
 }
 
 void bvh::compute_normal_and_radius(
@@ -402,28 +506,34 @@ void bvh::compute_normal_and_radius(
     const normal_computation_strategy& normal_computation_strategy,
     const radius_computation_strategy& radius_computation_strategy)
 {
-    for (size_t k = 0; k < max_surfels_per_node_; ++k)
-    {
-        if (k < source_node->mem_array().length())
-        {
-            // read surfel
-            surfel surf = source_node->mem_array().read_surfel(k);
+    const node_id_type node_idx = source_node->node_id();
+    uint16_t num_nearest_neighbours_to_search = std::max(radius_computation_strategy.number_of_neighbours(),
+                                                         normal_computation_strategy.number_of_neighbours());
 
-            uint16_t num_nearest_neighbours_to_search = std::max(radius_computation_strategy.number_of_neighbours(),
-                                                                 normal_computation_strategy.number_of_neighbours());
+    // both strategies share the neighbourhoods of the node
+    const neighbour_graph graph = get_neighbour_graph(node_idx, node_idx + 1, num_nearest_neighbours_to_search);
 
-            auto const& max_nearest_neighbours = get_nearest_neighbours(surfel_id_t(source_node->node_id(), k), num_nearest_neighbours_to_search);
-            // compute radius
-            real radius = radius_computation_strategy.compute_radius(*this, surfel_id_t(source_node->node_id(), k), max_nearest_neighbours);
+    // compute normals
+    std::vector<vec3f> normals;
+    normal_computation_strategy.compute_normals(*this, graph, node_idx, normals);
 
-            // compute normal
-            vec3f normal = normal_computation_strategy.compute_normal(*this, surfel_id_t(source_node->node_id(), k), max_nearest_neighbours);            
+    std::vector<std::pair<surfel_id_t, real>> max_nearest_neighbours;
 
-            // write surfel
-            surf.radius() = radius;
-            surf.normal() = normal;
-            source_node->mem_array().write_surfel(surf, k);
-        }
+    for (size_t k = 0; k < source_node->mem_array().length(); ++k)
+    {
+        // read surfel
+        surfel surf = source_node->mem_array().read_surfel(k);
+
+        const neighbour_graph::row neighbours = graph.neighbours(surfel_id_t(node_idx, k));
+        max_nearest_neighbours.assign(neighbours.begin(), neighbours.end());
+
+        // compute radius
+        real radius = radius_computation_strategy.compute_radius(*this, surfel_id_t(node_idx, k), max_nearest_neighbours);
+
+        // write surfel
+        surf.radius() = radius;
+        surf.normal() = normals[k];
+        source_node->mem_array().write_surfel(surf, k);
     }
 }
 
@@ -449,33 +559,53 @@ void bvh::get_descendant_leaves(
     }
 }
 
-void bvh::get_descendant_nodes(
-     const node_id_type node,
-     std::vector<node_id_type>& result,
-     const node_id_type desired_depth,
-     const std::unordered_set<size_t>& excluded_nodes) const
+void bvh::
+search_node(const node_id_type node_idx,
+            const vec3r& center,
+            const size_t excluded_surfel_idx,
+            node_search_index::candidates& candidates) const
 {
-    size_t node_depth = std::log((node + 1) * (fan_factor_ - 1)) / std::log(fan_factor_);
-    if (node_depth == desired_depth)
-    {
-        if (excluded_nodes.find(node) == excluded_nodes.end())
-        {
-            result.push_back(node);
-        }
-    }
-    //node is above desired depth
+    const surfel_mem_array& mem_array = nodes_[node_idx].mem_array();
+
+    std::shared_ptr<const node_search_index> index;
+    if (node_idx < search_indices_.size())
+        index = std::atomic_load(&search_indices_[node_idx]);
+
+    if (index && index->matches(mem_array))
+        index->search(mem_array, node_idx, center, excluded_surfel_idx, candidates);
     else
-    {
-        for (uint16_t i = 0; i < fan_factor_; ++i)
-        {
-            get_descendant_nodes(get_child_id(node, i), result, desired_depth, excluded_nodes);
-        }
-    }
+        node_search_index::search_linear(mem_array, node_idx, center, excluded_surfel_idx, candidates);
 }
 
+void bvh::
+build_search_index(const node_id_type node_idx)
+{
+    assert(node_idx < search_indices_.size());
+    std::shared_ptr<const node_search_index> index;
+    if (nodes_[node_idx].is_in_core())
+        index = std::make_shared<node_search_index>(nodes_[node_idx].mem_array());
+    std::atomic_store(&search_indices_[node_idx], index);
+}
 
+void bvh::
+drop_search_index(const node_id_type node_idx)
+{
+    if (node_idx < search_indices_.size())
+        std::atomic_store(&search_indices_[node_idx], std::shared_ptr<const node_search_index>());
+}
 
+void bvh::
+build_search_indices(const node_id_type first_node,
+                     const node_id_type last_node)
+{
+    if (search_indices_.size() != nodes_.size())
+        search_indices_ = std::vector<std::shared_ptr<const node_search_index>>(nodes_.size());
 
+    thread_pool_.parallel_for(first_node, last_node,
+        [&](const size_t node_idx, const size_t) {
+            build_search_index(node_idx);
+        });
+}
 
 std::vector<std::pair<surfel_id_t, real>> bvh::
 get_nearest_neighbours(
@@ -484,113 +614,59 @@ get_nearest_neighbours(
     const bool do_local_search) const
 {
     node_id_type current_node = target_surfel.node_idx;
-    std::unordered_set<size_t> processed_nodes;
     vec3r center = nodes_[target_surfel.node_idx].mem_array().read_surfel_ref(target_surfel.surfel_idx).pos();
 
-    std::vector<std::pair<surfel_id_t, real>> candidates;
-    real max_candidate_distance = std::numeric_limits<real>::infinity();
+    node_search_index::candidates candidates(number_of_neighbours);
 
     // check own node
-    for (size_t i = 0; i < nodes_[current_node].mem_array().length(); ++i)
-    {
-        if (i != target_surfel.surfel_idx)
-        {
-            const surfel& current_surfel = nodes_[current_node].mem_array().read_surfel_ref(i);
-            real distance_to_center = scm::math::length_sqr(center - current_surfel.pos());
-
-            if (candidates.size() < number_of_neighbours || (distance_to_center < max_candidate_distance))
-            {
-                if (candidates.size() == number_of_neighbours)
-                    candidates.pop_back();
-
-                candidates.emplace_back(surfel_id_t{current_node, i}, distance_to_center);
-
-                for (uint16_t k = candidates.size() - 1; k > 0; --k)
-                {
-                    if (candidates[k].second < candidates[k - 1].second)
-                    {
-                        std::swap(candidates[k], candidates[k - 1]);
-                    }
-                    else
-                        break;
-                }
+    search_node(current_node, center, target_surfel.surfel_idx, candidates);
 
-                max_candidate_distance = candidates.back().second;
+    if (do_local_search){return candidates.sorted();}
 
-            }
+    // check rest of kd-bvh. The nodes at the target depth below an ancestor
+    // form a contiguous id range, which includes the range of the previous
+    // ancestor that has been searched already
+    const uint32_t target_depth = nodes_[target_surfel.node_idx].depth();
+    uint32_t current_depth = target_depth;
+    node_id_type searched_first = current_node;
+    node_id_type searched_count = 1;
 
-        }
-
-    }
-
-    if (do_local_search){return candidates;}
-
-    processed_nodes.insert(current_node);
-
-    // check rest of kd-bvh
-    sphere candidates_sphere = sphere(center, sqrt(max_candidate_distance));
+    sphere candidates_sphere = sphere(center, sqrt(candidates.max_distance()));
 
     while ( (!nodes_[current_node].get_bounding_box().contains(candidates_sphere)) &&
             (current_node != 0) )
     {
-
         current_node = get_parent_id(current_node);
+        --current_depth;
 
-        std::vector<node_id_type> unvisited_descendant_nodes;
-
-        get_descendant_nodes(current_node, unvisited_descendant_nodes, nodes_[target_surfel.node_idx].depth(), processed_nodes);
-
+        node_id_type first = current_node;
+        node_id_type count = 1;
+        for (uint32_t depth = current_depth; depth < target_depth; ++depth) {
+            first = first * fan_factor_ + 1;
+            count *= fan_factor_;
+        }
 
-        for (auto adjacent_node : unvisited_descendant_nodes)
+        for (node_id_type adjacent_node = first; adjacent_node < first + count; ++adjacent_node)
         {
+            if (adjacent_node == searched_first) {
+                adjacent_node += searched_count - 1;
+                continue;
+            }
 
             if (candidates_sphere.intersects_or_contains(nodes_[adjacent_node].get_bounding_box()))
             {
-                // assert(nodes_[adjacent_node].is_out_of_core());
-
-                for (size_t i = 0; i < nodes_[adjacent_node].mem_array().length(); ++i)
-                {
-                    if (!(adjacent_node == target_surfel.node_idx && i == target_surfel.surfel_idx))
-                    {
-                        const surfel& current_surfel = nodes_[adjacent_node].mem_array().read_surfel_ref(i);
-                        real distance_to_center = scm::math::length_sqr(center - current_surfel.pos());
-
-                        if (candidates.size() < number_of_neighbours || (distance_to_center < max_candidate_distance))
-                        {
-                            if (candidates.size() == number_of_neighbours)
-                                candidates.pop_back();
-
-                            candidates.emplace_back(surfel_id_t{adjacent_node, i}, distance_to_center);
-
-                            for (uint16_t k = candidates.size() - 1; k > 0; --k)
-                            {
-                                if (candidates[k].second < candidates[k - 1].second)
-                                {
-                                    std::swap(candidates[k], candidates[k - 1]);
-                                }
-                                else
-                                    break;
-                            }
-
-                            max_candidate_distance = candidates.back().second;
-
-                        }
-                    }
-
-                }
-
-                processed_nodes.insert(adjacent_node);
-                candidates_sphere = sphere(center, sqrt(max_candidate_distance));
+                search_node(adjacent_node, center, node_search_index::no_surfel, candidates);
+                candidates_sphere = sphere(center, sqrt(candidates.max_distance()));
             }
-
         }
 
+        searched_first = first;
+        searched_count = count;
     }
 
-    return candidates;
+    return candidates.sorted();
 }
 
-
 std::vector<std::pair<surfel_id_t, real>> bvh::
 get_nearest_neighbours_in_nodes(
     const surfel_id_t target_surfel,
@@ -600,83 +676,197 @@ get_nearest_neighbours_in_nodes(
     node_id_type current_node = target_surfel.node_idx;
     vec3r center = nodes_[target_surfel.node_idx].mem_array().read_surfel_ref(target_surfel.surfel_idx).pos();
 
-    std::vector<std::pair<surfel_id_t, real>> candidates;
-    real max_candidate_distance = std::numeric_limits<real>::infinity();
+    node_search_index::candidates candidates(number_of_neighbours);
 
     // check own node
-    for (size_t i = 0; i < nodes_[current_node].mem_array().length(); ++i)
+    search_node(current_node, center, target_surfel.surfel_idx, candidates);
+
+    // check remaining nodes in vector
+    sphere candidates_sphere = sphere(center, sqrt(candidates.max_distance()));
+    for (auto adjacent_node: target_nodes)
     {
-        if (i != target_surfel.surfel_idx)
+        if (adjacent_node != current_node)
         {
-            const surfel& current_surfel = nodes_[current_node].mem_array().read_surfel_ref(i);
-            real distance_to_center = scm::math::length_sqr(center - current_surfel.pos());
-
-            if (candidates.size() < number_of_neighbours || (distance_to_center < max_candidate_distance))
+            if (candidates_sphere.intersects_or_contains(nodes_[adjacent_node].get_bounding_box()))
             {
-                if (candidates.size() == number_of_neighbours)
-                    candidates.pop_back();
+                search_node(adjacent_node, center, node_search_index::no_surfel, candidates);
+            }
 
-                candidates.emplace_back(surfel_id_t{current_node, i}, distance_to_center);
+            candidates_sphere = sphere(center, sqrt(candidates.max_distance()));
+        }
+    }
+    return candidates.sorted();
+}
 
-                for (uint16_t k = candidates.size() - 1; k > 0; --k)
-                {
-                    if (candidates[k].second < candidates[k - 1].second)
-                    {
-                        std::swap(candidates[k], candidates[k - 1]);
-                    }
-                    else
-                        break;
+neighbour_graph bvh::
+get_neighbour_graph(
+    const node_id_type first_node,
+    const node_id_type last_node,
+    const uint32_t number_of_neighbours,
+    const bool do_local_search) const
+{
+    neighbour_graph graph(first_node);
+    for (node_id_type node_idx = first_node; node_idx < last_node; ++node_idx)
+        add_neighbour_rows(node_idx, number_of_neighbours, do_local_search, graph);
+    return graph;
+}
+
+neighbour_graph bvh::
+get_neighbour_graph_in_nodes(
+    const node_id_type first_node,
+    const node_id_type last_node,
+    const uint32_t number_of_neighbours) const
+{
+    neighbour_graph graph(first_node);
+    for (node_id_type node_idx = first_node; node_idx < last_node; ++node_idx)
+        add_neighbour_rows_in_nodes(node_idx, first_node, last_node, number_of_neighbours, graph);
+    return graph;
+}
+
+void bvh::
+add_neighbour_rows(const node_id_type node_idx,
+                   const uint32_t number_of_neighbours,
+                   const bool do_local_search,
+                   neighbour_graph& graph) const
+{
+    const surfel_mem_array& mem_array = nodes_[node_idx].mem_array();
+    const size_t num_surfels = mem_array.length();
+
+    std::vector<vec3r> centers(num_surfels);
+    std::vector<node_search_index::candidates> candidates(num_surfels,
+        node_search_index::candidates(number_of_neighbours));
+
+    // check own node
+    for (size_t surfel_idx = 0; surfel_idx < num_surfels; ++surfel_idx) {
+        centers[surfel_idx] = mem_array.read_surfel_ref(surfel_idx).pos();
+        search_node(node_idx, centers[surfel_idx], surfel_idx, candidates[surfel_idx]);
+    }
+
+    if (!do_local_search && number_of_neighbours > 0) {
+        // climb the ancestors like get_nearest_neighbours, but for all
+        // surfels whose candidates sphere still leaves the current ancestor
+        const uint32_t target_depth = nodes_[node_idx].depth();
+        uint32_t current_depth = target_depth;
+        node_id_type current_node = node_idx;
+        node_id_type searched_first = node_idx;
+        node_id_type searched_count = 1;
+
+        std::vector<size_t> active(num_surfels);
+        for (size_t surfel_idx = 0; surfel_idx < num_surfels; ++surfel_idx)
+            active[surfel_idx] = surfel_idx;
+        std::vector<node_id_type> adjacent_nodes;
+
+        while (current_node != 0) {
+            const bounding_box& current_box = nodes_[current_node].get_bounding_box();
+            bounding_box search_box;
+            size_t num_active = 0;
+            for (const size_t surfel_idx : active) {
+                const sphere candidates_sphere(centers[surfel_idx],
+                                               sqrt(candidates[surfel_idx].max_distance()));
+                if (current_box.contains(candidates_sphere))
+                    continue;
+                search_box.expand(centers[surfel_idx], candidates_sphere.radius());
+                active[num_active++] = surfel_idx;
+            }
+            active.resize(num_active);
+            if (active.empty())
+                break;
+
+            current_node = get_parent_id(current_node);
+            --current_depth;
+
+            node_id_type first = current_node;
+            node_id_type count = 1;
+            for (uint32_t depth = current_depth; depth < target_depth; ++depth) {
+                first = first * fan_factor_ + 1;
+                count *= fan_factor_;
+            }
+
+            // nodes outside of the union of all candidates spheres are
+            // skipped for the whole node at once
+            adjacent_nodes.clear();
+            for (node_id_type adjacent_node = first; adjacent_node < first + count; ++adjacent_node) {
+                if (adjacent_node == searched_first) {
+                    adjacent_node += searched_count - 1;
+                    continue;
                 }
+                const bounding_box& adjacent_box = nodes_[adjacent_node].get_bounding_box();
+                if (adjacent_box.is_invalid() || adjacent_box.intersects(search_box))
+                    adjacent_nodes.push_back(adjacent_node);
+            }
 
-                max_candidate_distance = candidates.back().second;
+            for (const size_t surfel_idx : active) {
+                sphere candidates_sphere(centers[surfel_idx],
+                                         sqrt(candidates[surfel_idx].max_distance()));
+                for (const node_id_type adjacent_node : adjacent_nodes) {
+                    if (candidates_sphere.intersects_or_contains(nodes_[adjacent_node].get_bounding_box())) {
+                        search_node(adjacent_node, centers[surfel_idx], node_search_index::no_surfel,
+                                    candidates[surfel_idx]);
+                        candidates_sphere = sphere(centers[surfel_idx],
+                                                   sqrt(candidates[surfel_idx].max_distance()));
+                    }
+                }
             }
+
+            searched_first = first;
+            searched_count = count;
         }
     }
 
-    // check remaining nodes in vector
-    sphere candidates_sphere = sphere(center, sqrt(max_candidate_distance));
-    for (auto adjacent_node: target_nodes)
-    {
-        if (adjacent_node != current_node)
-        {
-            if (candidates_sphere.intersects_or_contains(nodes_[adjacent_node].get_bounding_box()))
-            {
-                // assert(nodes_[adjacent_node].is_out_of_core());
+    graph.begin_node();
+    for (size_t surfel_idx = 0; surfel_idx < num_surfels; ++surfel_idx)
+        graph.add_row(candidates[surfel_idx].sorted());
+}
 
-                for (size_t i = 0; i < nodes_[adjacent_node].mem_array().length(); ++i)
-                {
-                    if (!(adjacent_node == target_surfel.node_idx && i == target_surfel.surfel_idx))
-                    {
-                        const surfel& current_surfel = nodes_[adjacent_node].mem_array().read_surfel_ref(i);
-                        real distance_to_center = scm::math::length_sqr(center - current_surfel.pos());
-
-                        if (candidates.size() < number_of_neighbours || (distance_to_center < max_candidate_distance))
-                        {
-                            if (candidates.size() == number_of_neighbours)
-                                candidates.pop_back();
-
-                            candidates.emplace_back(surfel_id_t{adjacent_node, i}, distance_to_center);
-
-                            for (uint16_t k = candidates.size() - 1; k > 0; --k)
-                            {
-                                if (candidates[k].second < candidates[k - 1].second)
-                                {
-                                    std::swap(candidates[k], candidates[k - 1]);
-                                }
-                                else
-                                    break;
-                            }
-
-                            max_candidate_distance = candidates.back().second;
-                        }
-                    }
+void bvh::
+add_neighbour_rows_in_nodes(const node_id_type node_idx,
+                            const node_id_type first_node,
+                            const node_id_type last_node,
+                            const uint32_t number_of_neighbours,
+                            neighbour_graph& graph) const
+{
+    const surfel_mem_array& mem_array = nodes_[node_idx].mem_array();
+    const size_t num_surfels = mem_array.length();
+
+    std::vector<vec3r> centers(num_surfels);
+    std::vector<node_search_index::candidates> candidates(num_surfels,
+        node_search_index::candidates(number_of_neighbours));
+
+    // check own node
+    bounding_box search_box;
+    for (size_t surfel_idx = 0; surfel_idx < num_surfels; ++surfel_idx) {
+        centers[surfel_idx] = mem_array.read_surfel_ref(surfel_idx).pos();
+        search_node(node_idx, centers[surfel_idx], surfel_idx, candidates[surfel_idx]);
+        search_box.expand(centers[surfel_idx], sqrt(candidates[surfel_idx].max_distance()));
+    }
+
+    if (num_surfels > 0 && number_of_neighbours > 0) {
+        std::vector<node_id_type> adjacent_nodes;
+        for (node_id_type adjacent_node = first_node; adjacent_node < last_node; ++adjacent_node) {
+            if (adjacent_node == node_idx)
+                continue;
+            const bounding_box& adjacent_box = nodes_[adjacent_node].get_bounding_box();
+            if (adjacent_box.is_invalid() || adjacent_box.intersects(search_box))
+                adjacent_nodes.push_back(adjacent_node);
+        }
+
+        for (size_t surfel_idx = 0; surfel_idx < num_surfels; ++surfel_idx) {
+            sphere candidates_sphere(centers[surfel_idx],
+                                     sqrt(candidates[surfel_idx].max_distance()));
+            for (const node_id_type adjacent_node : adjacent_nodes) {
+                if (candidates_sphere.intersects_or_contains(nodes_[adjacent_node].get_bounding_box())) {
+                    search_node(adjacent_node, centers[surfel_idx], node_search_index::no_surfel,
+                                candidates[surfel_idx]);
                 }
+                candidates_sphere = sphere(centers[surfel_idx],
+                                           sqrt(candidates[surfel_idx].max_distance()));
             }
-
-            candidates_sphere = sphere(center, sqrt(max_candidate_distance));
         }
     }
-    return candidates;
+
+    graph.begin_node();
+    for (size_t surfel_idx = 0; surfel_idx < num_surfels; ++surfel_idx)
+        graph.add_row(candidates[surfel_idx].sorted());
 }
 
 std::vector<std::pair<surfel_id_t, real> > bvh::
@@ -835,72 +1025,39 @@ get_locally_natural_neighbours(std::vector<surfel> const& potential_neighbour_ve
     return nni_weight_pairs;
 }
 
-void bvh::
-spawn_create_lod_jobs(const uint32_t first_node_of_level, 
-                      const uint32_t last_node_of_level,
-                      const reduction_strategy& reduction_strgy,
-                      const bool resample) {
-    uint32_t const num_threads = std::thread::hardware_concurrency();
-
-    working_queue_head_counter_.initialize(first_node_of_level); //let the threads fetch a node idx
-    std::vector<std::thread> threads;
-
-    for(uint32_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-        bool update_percentage = (0 == thread_idx);
-        threads.push_back(std::thread(&bvh::thread_create_lod, this, 
-                                      first_node_of_level, last_node_of_level, 
-                                      update_percentage, 
-                                      std::cref(reduction_strgy),
-                                      resample) );
-    }
-
-    for(auto& thread : threads){
-        thread.join();
-    }
-}
-
 void bvh::
 spawn_compute_attribute_jobs(const uint32_t first_node_of_level, 
                              const uint32_t last_node_of_level,
                              const normal_computation_strategy& normal_strategy, 
                              const radius_computation_strategy& radius_strategy,
                              const bool is_leaf_level) {
-    uint32_t const num_threads = std::thread::hardware_concurrency();
-    working_queue_head_counter_.initialize(first_node_of_level); //let the threads fetch a node idx
-    std::vector<std::thread> threads;
-
-    for(uint32_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-        bool update_percentage = (0 == thread_idx);
-        threads.push_back(std::thread(&bvh::thread_compute_attributes, this, 
-                                      first_node_of_level, last_node_of_level, 
-                                      update_percentage, 
-                                      std::cref(normal_strategy), std::cref(radius_strategy),
-                                      is_leaf_level  ) );
-    }
+    std::atomic<uint32_t> processed_nodes(0);
+    uint16_t percentage = 0;
+    uint32_t length_of_level = (last_node_of_level-first_node_of_level) + 1;
 
-    for(auto& thread : threads){
-        thread.join();
-    }
+    thread_pool_.parallel_for(first_node_of_level, last_node_of_level,
+        [&](const size_t node_index, const size_t worker) {
+            compute_attributes_job(node_index, normal_strategy, radius_strategy, is_leaf_level);
+
+            uint32_t processed = ++processed_nodes;
+            if (worker == 0) {
+                uint16_t new_percentage = int32_t(float(processed)/(length_of_level) * 100);
+                if (percentage < new_percentage)
+                {
+                    percentage = new_percentage;
+                    std::cout << "\r" << percentage << "% processed" << std::flush;
+                }
+            }
+        });
 }
 
 void bvh::
 spawn_compute_bounding_boxes_downsweep_jobs(const uint32_t slice_left, 
                                             const uint32_t slice_right) {
-    uint32_t const num_threads = std::thread::hardware_concurrency();
-    working_queue_head_counter_.initialize(0); //let the threads fetch a local thread idx
-    std::vector<std::thread> threads;
-
-    for(uint32_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-        bool update_percentage = (0 == thread_idx);
-        threads.push_back(std::thread(&bvh::thread_compute_bounding_boxes_downsweep, this, 
-                                      slice_left, slice_right, 
-                                      update_percentage,
-                                      num_threads) );
-    }
-
-    for(auto& thread : threads){
-        thread.join();
-    }
+    thread_pool_.parallel_for(slice_left, size_t(slice_right) + 1,
+        [&](const size_t slice_index, const size_t) {
+            compute_bounding_boxes_downsweep_job(slice_index);
+        });
 }
 
 
@@ -993,10 +1150,11 @@ find_resample_candidates(const uint32_t node_idx) const {
     const uint16_t num_neighbours = 10;
     std::vector<surfel_id_t> surfel_id_vector;
 
-    for(size_t surfel_idx = 0; surfel_idx < node_mem_data->size(); ++surfel_idx){
+    const neighbour_graph graph = get_neighbour_graph(node_idx, node_idx + 1, num_neighbours, true);
+
+    for(size_t surfel_idx = 0; surfel_idx < graph.num_surfels(node_idx); ++surfel_idx){
 
-        std::vector<std::pair<surfel_id_t, real>> const nearest_neighbour_vector
-                = get_nearest_neighbours(surfel_id_t(node_idx, surfel_idx), num_neighbours, true);
+        const neighbour_graph::row nearest_neighbour_vector = graph.neighbours(surfel_id_t(node_idx, surfel_idx));
         int overlap_counter = 0;
 
         real current_radius = node_mem_data->at(surfel_idx).radius();
@@ -1023,111 +1181,70 @@ find_resample_candidates(const uint32_t node_idx) const {
 }
 
 
-void bvh::
-spawn_compute_bounding_boxes_upsweep_jobs(const uint32_t first_node_of_level, 
-                                          const uint32_t last_node_of_level,
-                                          const int32_t level) {
-    uint32_t const num_threads = std::thread::hardware_concurrency();
-    working_queue_head_counter_.initialize(0); //let the threads fetch a local thread idx
-    std::vector<std::thread> threads;
-
-    for(uint32_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-        bool update_percentage = (0 == thread_idx);
-        threads.push_back(std::thread(&bvh::thread_compute_bounding_boxes_upsweep, this, 
-                                      first_node_of_level, last_node_of_level, 
-                                      update_percentage,
-                                      level, num_threads) );
-    }
-
-    for(auto& thread : threads){
-        thread.join();
-    }
-}
-
 void bvh::
 spawn_split_node_jobs(size_t& slice_left,
                       size_t& slice_right,
                       size_t& new_slice_left,
                       size_t& new_slice_right,
                       const uint32_t level) {
-    uint32_t const num_threads = std::thread::hardware_concurrency();
-    working_queue_head_counter_.initialize(0); //let the threads fetch a local thread idx
-    std::vector<std::thread> threads;
-
-    for(uint32_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-        bool update_percentage = (0 == thread_idx);
-        threads.push_back(std::thread(&bvh::thread_split_node_jobs, this, 
-                                      std::ref(slice_left), std::ref(slice_right), 
-                                      std::ref(new_slice_left), std::ref(new_slice_right),
-                                      update_percentage,
-                                      level, num_threads) );
-    }
-
-    for(auto& thread : threads){
-        thread.join();
-    }
+    thread_pool_.parallel_for(slice_left, slice_right + 1,
+        [&](const size_t slice_index, const size_t) {
+            split_node_job(slice_index, slice_left, slice_right,
+                           new_slice_left, new_slice_right, level);
+        });
 }
 
 void bvh::
-thread_create_lod(const uint32_t start_marker,
-                  const uint32_t end_marker,
-                  const bool update_percentage,
-                  const reduction_strategy& reduction_strgy,
-                  const bool do_resample) {
-    uint32_t node_index = working_queue_head_counter_.increment_head();
-    
-    while(node_index < end_marker) {
-        bvh_node* current_node = &nodes_.at(node_index);
-        // If a node has no data yet, calculate it based on child nodes.
-        if (!current_node->is_in_core() && !current_node->is_out_of_core()) {
-
-            std::vector<surfel_mem_array> resampled_arrays;
-            std::vector<surfel_mem_array*> input_mem_arrays;
-            
-            //simplified data will be stored here
-            surfel_mem_array reduction_result (std::make_shared<surfel_vector>(surfel_vector()), 0, 0);
-
-            if (do_resample){
-               for (uint8_t child_index = 0; child_index < fan_factor_; ++child_index) {
-                    size_t child_id = this->get_child_id(current_node->node_id(), child_index);
-                    resampled_arrays.push_back(resample_node(child_id));
-                }
-               for (uint8_t child_index = 0; child_index < fan_factor_; ++child_index) {
-                    input_mem_arrays.push_back(&resampled_arrays[child_index]);
-                }
+create_lod_job(const uint32_t node_index,
+               const reduction_strategy& reduction_strgy,
+               const bool do_resample) {
+    bvh_node* current_node = &nodes_.at(node_index);
+    // If a node has no data yet, calculate it based on child nodes.
+    if (!current_node->is_in_core() && !current_node->is_out_of_core()) {
+
+        std::vector<surfel_mem_array> resampled_arrays;
+        std::vector<surfel_mem_array*> input_mem_arrays;
+        
+        //simplified data will be stored here
+        surfel_mem_array reduction_result (std::make_shared<surfel_vector>(surfel_vector()), 0, 0);
+
+        if (do_resample){
+           for (uint8_t child_index = 0; child_index < fan_factor_; ++child_index) {
+                size_t child_id = this->get_child_id(current_node->node_id(), child_index);
+                resampled_arrays.push_back(resample_node(child_id));
+            }
+           for (uint8_t child_index = 0; child_index < fan_factor_; ++child_index) {
+                input_mem_arrays.push_back(&resampled_arrays[child_index]);
             }
-            else{
-                for (uint8_t child_index = 0; child_index < fan_factor_; ++child_index) {
-                    size_t child_id = this->get_child_id(current_node->node_id(), child_index);
-                    bvh_node* child_node = &nodes_.at(child_id);
+        }
+        else{
+            for (uint8_t child_index = 0; child_index < fan_factor_; ++child_index) {
+                size_t child_id = this->get_child_id(current_node->node_id(), child_index);
+                bvh_node* child_node = &nodes_.at(child_id);
 
-                    input_mem_arrays.push_back(&child_node->mem_array());
-                }
+                input_mem_arrays.push_back(&child_node->mem_array());
             }
+        }
 
-            real reduction_error;
-            reduction_result = reduction_strgy.create_lod(reduction_error, 
-                                               input_mem_arrays, max_surfels_per_node_, 
-                                               (*this), get_child_id(current_node->node_id(), 0) );
+        real reduction_error;
+        reduction_result = reduction_strgy.create_lod(reduction_error, 
+                                           input_mem_arrays, max_surfels_per_node_, 
+                                           (*this), get_child_id(current_node->node_id(), 0) );
 
-            current_node->reset(reduction_result);
-            current_node->set_reduction_error(reduction_error);
+        current_node->reset(reduction_result);
+        current_node->set_reduction_error(reduction_error);
 
-            // Unload all child nodes, if not in leaf level
-            if (get_depth_of_node(current_node->node_id()) != depth()) {
-                for (uint8_t child_index = 0; child_index < fan_factor_; ++child_index) {
-                    size_t child_id = get_child_id(current_node->node_id(), child_index);
-                    bvh_node& child_node = nodes_.at(child_id);
+        // Unload all child nodes
+        for (uint8_t child_index = 0; child_index < fan_factor_; ++child_index) {
+            size_t child_id = get_child_id(current_node->node_id(), child_index);
+            bvh_node& child_node = nodes_.at(child_id);
 
-                    if (child_node.is_in_core()) {
-                        child_node.mem_array().reset();
-                    }
-                }
+            if (child_node.is_in_core()) {
+                child_node.mem_array().reset();
             }
-
+            drop_search_index(child_id);
         }
 
-        node_index = working_queue_head_counter_.increment_head();
     }
 }
 
@@ -1148,331 +1265,331 @@ surfel_mem_array bvh::resample_node(uint32_t node_index) const {
 }
 
 void bvh::
-thread_resample(const uint32_t start_marker,
-                  const uint32_t end_marker,
-                  const bool update_percentage) {
-    uint32_t node_index = working_queue_head_counter_.increment_head();
-    
-    while(node_index < end_marker) {
-        surfel_mem_array current_mem_array = resample_node(node_index);
+resample_job(const uint32_t node_index,
+             surfel_vector& output) const {
+    surfel_mem_array current_mem_array = resample_node(node_index);
 
-        //surfels after first resampling to be written in a file
-        resample_mutex_.lock();
-        for (int index = 0; index < current_mem_array.mem_data()->size(); ++index){
-           resampled_leaf_level_.push_back(current_mem_array.mem_data()->at(index));
-        }
-        resample_mutex_.unlock();
+    output.insert(output.end(),
+                  current_mem_array.mem_data()->begin(),
+                  current_mem_array.mem_data()->end());
+}
+
+void bvh::
+compute_attributes_job(const uint32_t node_index,
+                       const normal_computation_strategy& normal_strategy, 
+                       const radius_computation_strategy& radius_strategy,
+                       const bool is_leaf_level) {
 
-        node_index = working_queue_head_counter_.increment_head();
+    bvh_node* current_node = &nodes_.at(node_index);
+
+    // Calculate and set node properties.
+    if(is_leaf_level){
+        uint16_t number_of_neighbours = 100;
+        auto normal_comp_algo = normal_computation_plane_fitting(number_of_neighbours);
+        auto radius_comp_algo = radius_computation_average_distance(number_of_neighbours, 1.0f);
+        compute_normal_and_radius(current_node,
+                                  normal_comp_algo,
+                                  radius_comp_algo );
+    }
+    else{
+        compute_normal_and_radius(current_node, normal_strategy, radius_strategy);
     }
 }
 
+
 void bvh::
-thread_compute_attributes(const uint32_t start_marker,
-                          const uint32_t end_marker,
-                          const bool update_percentage,
-                          const normal_computation_strategy& normal_strategy, 
-                          const radius_computation_strategy& radius_strategy,
-                          const bool is_leaf_level) {
-
-    uint32_t node_index = working_queue_head_counter_.increment_head();
-    
-    uint16_t percentage = 0;
-    uint32_t length_of_level = (end_marker-start_marker) + 1;
+compute_bounding_boxes_downsweep_job(const uint32_t slice_index) {
+    bvh_node& current_node = nodes_[slice_index];
+    auto props = basic_algorithms::compute_properties(current_node.mem_array(), rep_radius_algo_, false);
+    current_node.set_avg_surfel_radius(props.rep_radius);
+    current_node.set_centroid(props.centroid);
+    current_node.set_bounding_box(props.bbox);
+}
 
-    while(node_index < end_marker) {
-        bvh_node* current_node = &nodes_.at(node_index);
+bounding_box bvh::
+compute_bounding_boxes_upsweep_job(const uint32_t node_index,
+                                   const int32_t level) {
+    bvh_node* current_node = &nodes_.at(node_index);
 
+    basic_algorithms::surfel_group_properties props = basic_algorithms::compute_properties(current_node->mem_array(), 
+                                                                                            rep_radius_algo_);
 
-        // Calculate and set node properties.
-        if(is_leaf_level){
-            uint16_t number_of_neighbours = 100;
-            auto normal_comp_algo = normal_computation_plane_fitting(number_of_neighbours);
-            auto radius_comp_algo = radius_computation_average_distance(number_of_neighbours, 1.0f);
-            compute_normal_and_radius(current_node,
-                                      normal_comp_algo,
-                                      radius_comp_algo );
-        }
-        else{
-            compute_normal_and_radius(current_node, normal_strategy, radius_strategy);
-        }
+    bounding_box node_bounding_box;
+    node_bounding_box.expand(props.bbox);
 
-        if(update_percentage) {
-            uint16_t new_percentage = int32_t(float(node_index-start_marker)/(length_of_level) * 100);
-            if (percentage < new_percentage)
-            {
-                percentage = new_percentage;
-                std::cout << "\r" << percentage << "% processed" << std::flush;
-            }
+    if (level < int32_t(depth_) ) {
+        for (int32_t child_index = 0; child_index < fan_factor_; ++child_index) {
+            uint32_t child_id = this->get_child_id(current_node->node_id(), child_index);
+            bvh_node* child_node = &nodes_.at(child_id);
+
+            node_bounding_box.expand(child_node->get_bounding_box());
         }
-        node_index = working_queue_head_counter_.increment_head();
     }
-};
 
+    current_node->set_avg_surfel_radius(props.rep_radius);
+    current_node->set_centroid(props.centroid);
+    current_node->calculate_statistics();
+
+    return node_bounding_box;
+}
 
 void bvh::
-thread_compute_bounding_boxes_downsweep(const uint32_t slice_left,
-                                        const uint32_t slice_right,
-                                        const bool update_percentage,
-                                        const uint32_t num_threads) {
+compute_outlier_distances_job(const uint32_t node_idx,
+                              const uint16_t num_neighbours,
+                              real* avg_distances) const {
 
-    uint32_t thread_idx = working_queue_head_counter_.increment_head();
+    const bvh_node* current_node = &nodes_.at(node_idx);
+    
+    const neighbour_graph graph = get_neighbour_graph(node_idx, node_idx + 1, num_neighbours);
 
-    uint32_t total_num_slices= (slice_right-slice_left) + 2;
-    uint32_t num_slices_per_thread = std::ceil(float(total_num_slices) / num_threads);
+    for( size_t surfel_idx = 0; surfel_idx < current_node->mem_array().length(); ++surfel_idx) {
 
-    uint32_t local_start_index = slice_left + thread_idx * num_slices_per_thread;
-    uint32_t local_end_index   = slice_left + (thread_idx + 1) * num_slices_per_thread;
+        const neighbour_graph::row nearest_neighbour_vector = graph.neighbours(surfel_id_t(node_idx, surfel_idx));
 
-    for(uint32_t slice_index = local_start_index; num_slices_per_thread < local_end_index; ++slice_index) {
-        //early termination if number of nodes could not be evenly divided
-        if(slice_index > slice_right) {
-            break;
+        double avg_dist = 0.0;
+
+        if( nearest_neighbour_vector.size() ) {
+            for( auto const& nearest_neighbour_pair : nearest_neighbour_vector ) {
+                avg_dist += nearest_neighbour_pair.second;
+            }
+
+            avg_dist /= nearest_neighbour_vector.size();
         }
 
-        bvh_node& current_node = nodes_[slice_index];
-        auto props = basic_algorithms::compute_properties(current_node.mem_array(), rep_radius_algo_, false);
-        current_node.set_avg_surfel_radius(props.rep_radius);
-        current_node.set_centroid(props.centroid);
-        current_node.set_bounding_box(props.bbox);
+        avg_distances[surfel_idx] = avg_dist;
     }
 }
 
 void bvh::
-thread_compute_bounding_boxes_upsweep(const uint32_t start_marker,
-                                      const uint32_t end_marker,
-                                      const bool update_percentage,
-                                      const int32_t level,
-                                      const uint32_t num_threads) {
+split_node_job(const uint32_t slice_index,
+               const size_t slice_left,
+               const size_t slice_right,
+               size_t& new_slice_left,
+               size_t& new_slice_right,
+               const int32_t level) {
 
-    uint32_t thread_idx = working_queue_head_counter_.increment_head();
+    const uint32_t sort_parallelizm_thres = 2;
 
-    uint32_t total_num_nodes = (end_marker-start_marker) + 1;
-    uint32_t num_nodes_per_thread = std::ceil(float(total_num_nodes) / num_threads);
+    bvh_node& current_node = nodes_[slice_index];
+    // make sure that current node is in-core
+    assert(current_node.is_in_core());
+
+    // split and compute child bounding boxes
+    basic_algorithms::splitted_array<surfel_mem_array> surfel_arrays;
+    basic_algorithms::sort_and_split(current_node.mem_array(),
+                                    surfel_arrays,
+                                    current_node.get_bounding_box(),
+                                    current_node.get_bounding_box().get_longest_axis(),
+                                    fan_factor_,
+                                    (slice_right - slice_left) < sort_parallelizm_thres,
+                                    split_algo_);
+
+    // iterate through children
+    for (size_t i = 0; i < surfel_arrays.size(); ++i) {
+        uint32_t child_id = get_child_id(slice_index, i);
+        nodes_[child_id] = bvh_node(child_id, level + 1,
+                                   surfel_arrays[i].second,
+                                   surfel_arrays[i].first);
+        if (slice_index == slice_left && i == 0)
+            new_slice_left = child_id;
+        if (slice_index == slice_right && i == surfel_arrays.size() - 1)
+            new_slice_right = child_id;
+    }
+
+    current_node.reset();
+}
 
-    uint32_t local_start_index = start_marker + thread_idx * num_nodes_per_thread;
-    uint32_t local_end_index   = start_marker + (thread_idx + 1) * num_nodes_per_thread;
+void bvh::
+upsweep(const reduction_strategy& reduction_strgy, 
+        const normal_computation_strategy& normal_strategy, 
+        const radius_computation_strategy& radius_strategy,
+        bool recompute_leaf_level,
+        bool resample) {
 
-    for(uint32_t node_index = local_start_index; node_index < local_end_index; ++node_index) {
-        //early termination if number of nodes could not be evenly divided
-        if(node_index >= end_marker) {
-            break;
-        }
+    // Create level temp files
+    std::vector<shared_file> level_temp_files;
+    for (uint32_t level = 0; level <= depth_; ++level)
+    {
+        level_temp_files.push_back(std::make_shared<file>());
+        std::string ext = ".lv" + std::to_string(level);
+        level_temp_files.back()->open(add_to_path(base_path_, ext).string(), level != depth_);
+    }
 
+    // Loading is not thread-safe, so load everything before starting parallel operations.
+    for (uint32_t node_index = first_leaf_; node_index < nodes_.size(); ++node_index) {
         bvh_node* current_node = &nodes_.at(node_index);
+        if (current_node->is_out_of_core()) {
+            current_node->load_from_disk();
+        }
+    }
 
-        basic_algorithms::surfel_group_properties props = basic_algorithms::compute_properties(current_node->mem_array(), 
-                                                                                                rep_radius_algo_);
-
-        bounding_box node_bounding_box;
-        node_bounding_box.expand(props.bbox);
+    // every node gets a search index once its surfels are final
+    build_search_indices(first_leaf_, nodes_.size());
 
-        if (level < int32_t(depth_) ) {
-            for (int32_t child_index = 0; child_index < fan_factor_; ++child_index) {
-                uint32_t child_id = this->get_child_id(current_node->node_id(), child_index);
-                bvh_node* child_node = &nodes_.at(child_id);
+    // Nodes are processed as soon as their dependencies are met instead of
+    // level by level. The neighbour search of the attribute computation
+    // crosses node boundaries, so it needs the reduced surfels of the whole
+    // level, and the nodes of a level may be reduced into their parents and
+    // unloaded only after it is done. Everything else only waits for the
+    // children of a node.
+    enum stage : size_t {
+        create_lod_stage = 0,
+        compute_attributes_stage = 1,
+        finish_stage = 2
+    };
 
-                node_bounding_box.expand(child_node->get_bounding_box());
-            }
-        }
+    const size_t num_nodes = nodes_.size();
 
-        current_node->set_avg_surfel_radius(props.rep_radius);
-        current_node->set_centroid(props.centroid);
+    auto has_attribute_stage = [&](const int32_t level) {
+        return level != int32_t(depth_) || recompute_leaf_level;
+    };
 
-        current_node->set_bounding_box(node_bounding_box);
-        current_node->calculate_statistics();
+    std::vector<int32_t> node_levels(num_nodes);
+    for (uint32_t level = 0; level <= depth_; ++level) {
+        const uint32_t first_node_of_level = get_first_node_id_of_depth(level);
+        std::fill(node_levels.begin() + first_node_of_level,
+                  node_levels.begin() + first_node_of_level + get_length_of_depth(level), level);
     }
-}
 
-void bvh::
-thread_remove_outlier_jobs(const uint32_t start_marker,
-                           const uint32_t end_marker,
-                           const uint32_t num_outliers,
-                           const uint16_t num_neighbours,
-                           std::vector< std::pair<surfel_id_t, real> >&  intermediate_outliers_for_thread) {
+    // a parent waits for its children and, if they compute attributes,
+    // for the attributes of the children's level
+    std::vector<std::atomic<uint32_t>> pending_dependencies(first_leaf_);
+    for (uint32_t node_index = 0; node_index < first_leaf_; ++node_index) {
+        pending_dependencies[node_index] = fan_factor_ + (has_attribute_stage(node_levels[node_index] + 1) ? 1 : 0);
+    }
 
-    uint32_t node_idx = working_queue_head_counter_.increment_head();
+    std::vector<std::atomic<uint32_t>> reduced_nodes(depth_ + 1);
+    std::vector<std::atomic<uint32_t>> attributed_nodes(depth_ + 1);
+    for (uint32_t level = 0; level <= depth_; ++level) {
+        reduced_nodes[level] = 0;
+        attributed_nodes[level] = 0;
+    }
 
-    while(node_idx < end_marker ) {
+    // bounding boxes of a level are applied after its neighbour searches
+    std::vector<bounding_box> pending_bounding_boxes(num_nodes);
+    std::vector<uint8_t> has_pending_bounding_box(num_nodes, 0);
+    std::vector<uint8_t> level_searched(depth_ + 1, 0);
+    std::vector<std::mutex> level_mutexes(depth_ + 1);
 
-        bvh_node* current_node = &nodes_.at(node_idx);
-        
-        for( size_t surfel_idx = 0; surfel_idx < current_node->mem_array().length(); ++surfel_idx) {
+    std::atomic<uint32_t> finished_nodes(0);
+    uint16_t percentage = 0;
 
-            std::vector<std::pair<surfel_id_t, real>> const nearest_neighbour_vector 
-                = get_nearest_neighbours(surfel_id_t(node_idx, surfel_idx), num_neighbours);
+    auto release_dependency = [&](const uint32_t node_index, const thread_pool::schedule_type& schedule) {
+        if (--pending_dependencies[node_index] == 0) {
+            schedule(create_lod_stage * num_nodes + node_index);
+        }
+    };
 
-            double avg_dist = 0.0;
+    auto process = [&](const size_t task, const size_t worker, const thread_pool::schedule_type& schedule) {
+        const uint32_t node_index = task % num_nodes;
+        const int32_t level = node_levels[node_index];
+        const uint32_t first_node_of_level = get_first_node_id_of_depth(level);
+        const uint32_t length_of_level = get_length_of_depth(level);
 
-            if( nearest_neighbour_vector.size() ) {
-                for( auto const& nearest_neighbour_pair : nearest_neighbour_vector ) {
-                    avg_dist += nearest_neighbour_pair.second;
-                }
+        switch (task / num_nodes) {
+        case create_lod_stage:
+            create_lod_job(node_index, reduction_strgy, resample);
+            build_search_index(node_index);
 
-                avg_dist /= nearest_neighbour_vector.size();
+            if (!has_attribute_stage(level)) {
+                schedule(finish_stage * num_nodes + node_index);
             }
-
-            bool insert_element = false;
-            if( intermediate_outliers_for_thread.size() < num_outliers ) {
-                insert_element = true;
-
-            } else if ( avg_dist > intermediate_outliers_for_thread.back().second ) {
-                intermediate_outliers_for_thread.pop_back();
-                insert_element = true;
+            else if (++reduced_nodes[level] == length_of_level) {
+                for (uint32_t node_of_level = first_node_of_level; node_of_level < first_node_of_level + length_of_level; ++node_of_level) {
+                    schedule(compute_attributes_stage * num_nodes + node_of_level);
+                }
             }
+            break;
 
-            if( insert_element ) {
-                intermediate_outliers_for_thread.emplace_back(surfel_id_t{node_idx, surfel_idx}, avg_dist);
+        case compute_attributes_stage:
+            compute_attributes_job(node_index, normal_strategy, radius_strategy, false);
 
-                for (uint32_t k = intermediate_outliers_for_thread.size() - 1; k > 0; --k)
+            if (++attributed_nodes[level] == length_of_level) {
                 {
-                    if (intermediate_outliers_for_thread[k].second > intermediate_outliers_for_thread[k - 1].second)
-                    {
-                        std::swap(intermediate_outliers_for_thread[k], intermediate_outliers_for_thread[k - 1]);
+                    std::lock_guard<std::mutex> lock(level_mutexes[level]);
+                    level_searched[level] = 1;
+                    for (uint32_t node_of_level = first_node_of_level; node_of_level < first_node_of_level + length_of_level; ++node_of_level) {
+                        if (has_pending_bounding_box[node_of_level]) {
+                            nodes_[node_of_level].set_bounding_box(pending_bounding_boxes[node_of_level]);
+                        }
+                    }
+                }
+                if (level > 0) {
+                    const uint32_t first_parent = get_first_node_id_of_depth(level - 1);
+                    for (uint32_t parent = first_parent; parent < first_node_of_level; ++parent) {
+                        release_dependency(parent, schedule);
                     }
-                    else
-                        break;
-                }             
+                }
             }
-        }
-
-        node_idx = working_queue_head_counter_.increment_head();
-    }
-
-}
-
-void bvh::
-thread_split_node_jobs(size_t& slice_left,
-                       size_t& slice_right,
-                       size_t& new_slice_left,
-                       size_t& new_slice_right,
-                       const bool update_percentage,
-                       const int32_t level,
-                       const uint32_t num_threads) {
-
-    const uint32_t sort_parallelizm_thres = 2;
-
-    uint32_t thread_idx = working_queue_head_counter_.increment_head();
+            schedule(finish_stage * num_nodes + node_index);
+            break;
 
-    uint32_t total_num_slices = (slice_right-slice_left) + 2;
-    uint32_t num_slices_per_thread = std::ceil(float(total_num_slices) / num_threads);
+        case finish_stage:
+        {
+            bounding_box node_bounding_box = compute_bounding_boxes_upsweep_job(node_index, level);
+            {
+                std::lock_guard<std::mutex> lock(level_mutexes[level]);
+                if (level_searched[level] || !has_attribute_stage(level)) {
+                    nodes_[node_index].set_bounding_box(node_bounding_box);
+                }
+                else {
+                    pending_bounding_boxes[node_index] = node_bounding_box;
+                    has_pending_bounding_box[node_index] = 1;
+                }
+            }
 
-    uint32_t local_start_index = slice_left + thread_idx * num_slices_per_thread;
-    uint32_t local_end_index   = slice_left + (thread_idx + 1) * num_slices_per_thread;
+            // save computed node to disk
+            nodes_[node_index].flush_to_disk(level_temp_files[level],
+                                             size_t(node_index - first_node_of_level) * max_surfels_per_node_, false);
 
-    for(uint32_t slice_index = local_start_index; slice_index < local_end_index; ++slice_index) {
+            if (node_index != 0) {
+                release_dependency(get_parent_id(node_index), schedule);
+            }
 
-        //early termination if number of nodes could not be evenly divided
-        if(slice_index > slice_right) {
+            uint32_t processed = ++finished_nodes;
+            if (worker == 0) {
+                uint16_t new_percentage = int32_t(float(processed)/(num_nodes) * 100);
+                if (percentage < new_percentage)
+                {
+                    percentage = new_percentage;
+                    std::cout << "\r" << percentage << "% processed" << std::flush;
+                }
+            }
             break;
         }
-
-        bvh_node& current_node = nodes_[slice_index];
-        // make sure that current node is in-core
-        assert(current_node.is_in_core());
-
-        // split and compute child bounding boxes
-        basic_algorithms::splitted_array<surfel_mem_array> surfel_arrays;
-        basic_algorithms::sort_and_split(current_node.mem_array(),
-                                        surfel_arrays,
-                                        current_node.get_bounding_box(),
-                                        current_node.get_bounding_box().get_longest_axis(),
-                                        fan_factor_,
-                                        (slice_right - slice_left) < sort_parallelizm_thres);
-
-        // iterate through children
-        for (size_t i = 0; i < surfel_arrays.size(); ++i) {
-            uint32_t child_id = get_child_id(slice_index, i);
-            nodes_[child_id] = bvh_node(child_id, level + 1,
-                                       surfel_arrays[i].second,
-                                       surfel_arrays[i].first);
-            if (slice_index == slice_left && i == 0)
-                new_slice_left = child_id;
-            if (slice_index == slice_right && i == surfel_arrays.size() - 1)
-                new_slice_right = child_id;
         }
+    };
 
-        current_node.reset();
-
+    std::vector<size_t> leaf_tasks;
+    const size_t leaf_stage = has_attribute_stage(depth_) ? compute_attributes_stage : finish_stage;
+    for (uint32_t node_index = first_leaf_; node_index < num_nodes; ++node_index) {
+        leaf_tasks.push_back(leaf_stage * num_nodes + node_index);
     }
-}
-
-void bvh::
-upsweep(const reduction_strategy& reduction_strgy, 
-        const normal_computation_strategy& normal_strategy, 
-        const radius_computation_strategy& radius_strategy,
-        bool recompute_leaf_level,
-        bool resample) {
 
-    // Create level temp files
-    std::vector<shared_file> level_temp_files;
-    for (uint32_t level = 0; level <= depth_; ++level)
-    {
-        level_temp_files.push_back(std::make_shared<file>());
-        std::string ext = ".lv" + std::to_string(level);
-        level_temp_files.back()->open(add_to_path(base_path_, ext).string(), level != depth_);
-    }
+    thread_pool_.run_tasks(leaf_tasks, process);
+    std::cout << std::endl;
 
-    // Start at bottom level and move up towards root.
     for (int32_t level = depth_; level >= 0; --level)
     {
-        std::cout << "Entering level: " << level << std::endl;
-    
         uint32_t first_node_of_level = get_first_node_id_of_depth(level);
         uint32_t last_node_of_level = get_first_node_id_of_depth(level) + get_length_of_depth(level);
 
-        // Loading is not thread-safe, so load everything before starting parallel operations.
-        for (uint32_t node_index = first_node_of_level; node_index < last_node_of_level; ++node_index)
-        {
-            bvh_node* current_node = &nodes_.at(node_index);
-            // if necessary, load leaf-level nodes from disk
-            if (level == int32_t(depth_) && current_node->is_out_of_core()) {
-                current_node->load_from_disk();
-            }
-        }
-
-        // Iterate over nodes of current tree level.
-        // First apply reduction strategy, since calculation of attributes might depend on surfel data of nodes in same level.
-        if(level != int32_t(depth_) ) {
-            spawn_create_lod_jobs(first_node_of_level, last_node_of_level, reduction_strgy, resample);
-        }
-    
-        // skip the leaf level attribute computation if it was not requested or necessary
-        if( (level != int32_t(depth_) || recompute_leaf_level  ) ) {
-            spawn_compute_attribute_jobs(first_node_of_level, last_node_of_level, normal_strategy, radius_strategy, false);
-        }
-
-        spawn_compute_bounding_boxes_upsweep_jobs(first_node_of_level, last_node_of_level, level);
-
-        std::cout << std::endl;
-
         real mean_radius_sd = 0.0;
         unsigned counter = 1;
         for(uint32_t node_index = first_node_of_level; node_index < last_node_of_level; ++node_index){
-
-            bvh_node* current_node = &nodes_.at(node_index);
-
-            mean_radius_sd = mean_radius_sd + (*current_node).node_stats().radius_sd();
+            mean_radius_sd = mean_radius_sd + nodes_.at(node_index).node_stats().radius_sd();
             counter++;
-
-            // compute node offset in file
-            int32_t nid = current_node->node_id();
-            for (uint32_t write_level = 0; write_level < uint32_t(level); ++write_level)
-                nid -= uint32_t(pow(fan_factor_, write_level));
-            nid = std::max(0, nid);
-
-            // save computed node to disk
-            current_node->flush_to_disk(level_temp_files[level], size_t(nid) * max_surfels_per_node_, false);
         }
         mean_radius_sd = mean_radius_sd/counter;
-        std::cout<< "average radius deviation pro level: "<< mean_radius_sd << "\n";
+        std::cout<< "average radius deviation pro level " << level << ": "<< mean_radius_sd << "\n";
     }
-    
+
+    search_indices_.clear();
     state_ = state_type::after_upsweep;
 }
 
-void bvh::
-resample() {
+size_t bvh::
+resample(const std::string& output_file) {
     uint32_t first_node_of_level = get_first_node_id_of_depth(depth_);
     uint32_t last_node_of_level = get_first_node_id_of_depth(depth_) + get_length_of_depth(depth_);
 
@@ -1486,27 +1603,41 @@ resample() {
         }
     }
 
+    build_search_indices(first_node_of_level, last_node_of_level);
+
     uint16_t number_of_neighbours = 175;
     auto normal_comp_algo = normal_computation_plane_fitting(number_of_neighbours);
     auto radius_comp_algo = radius_computation_average_distance(number_of_neighbours, 1.0f);
     spawn_compute_attribute_jobs(first_node_of_level, last_node_of_level, normal_comp_algo, radius_comp_algo, false);
 
-    // spawn_resample jobs directly instead of calling another function
-    uint32_t const num_threads = std::thread::hardware_concurrency();
-
-    working_queue_head_counter_.initialize(first_node_of_level); //let the threads fetch a node idx
-    std::vector<std::thread> threads;
+    file output;
+    output.open(output_file, true);
+
+    // a worker appends its buffer once it holds its share of the buffer size
+    const size_t num_workers = thread_pool_.num_threads();
+    const size_t chunk_size = std::max(size_t(1), buffer_size_ / sizeof(surfel) / num_workers);
+    std::vector<surfel_vector> worker_buffers(num_workers);
+    std::atomic<size_t> num_written{0};
+
+    auto flush = [&](surfel_vector& buffer) {
+        if (buffer.empty())
+            return;
+        output.append(&buffer, 0, buffer.size());
+        num_written += buffer.size();
+        buffer.clear();
+    };
 
-    for(uint32_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-        bool update_percentage = (0 == thread_idx);
-        threads.push_back(std::thread(&bvh::thread_resample, this, 
-                                      first_node_of_level, last_node_of_level, 
-                                      update_percentage));
-    }
+    thread_pool_.parallel_for(first_node_of_level, last_node_of_level,
+        [&](const size_t node_index, const size_t worker) {
+            surfel_vector& buffer = worker_buffers[worker];
+            resample_job(node_index, buffer);
+            if (buffer.size() >= chunk_size)
+                flush(buffer);
+        });
 
-    for(auto& thread : threads){
-        thread.join();
-    }
+    for (auto& buffer : worker_buffers)
+        flush(buffer);
+    output.close();
 
     real mean_radius_sd = 0.0;
     unsigned counter = 1;
@@ -1519,19 +1650,16 @@ resample() {
     }
     mean_radius_sd = mean_radius_sd/counter;
     std::cout<< "average radius deviation pro level: "<< mean_radius_sd << "\n";
-    
+
+    search_indices_.clear();
     state_ = state_type::after_upsweep;
+    return num_written;
 }
 
-surfel_vector bvh::
+size_t bvh::
 remove_outliers_statistically(uint32_t num_outliers, uint16_t num_neighbours) {
 
-    std::vector<std::vector< std::pair<surfel_id_t, real> > > intermediate_outliers;
-
-    uint32_t const num_threads = std::thread::hardware_concurrency();
-    intermediate_outliers.resize(num_threads);
-    //already_resized.resize(omp_get_max_threads())
-
+    const size_t num_leaves = nodes_.size() - first_leaf_;
 
     for(uint32_t node_idx = first_leaf_; node_idx < nodes_.size(); ++node_idx) {
         bvh_node* current_node = &nodes_.at(node_idx);
@@ -1542,82 +1670,109 @@ remove_outliers_statistically(uint32_t num_outliers, uint16_t num_neighbours) {
         }
     }
 
-
-    working_queue_head_counter_.initialize(first_leaf_);
-    std::vector<std::thread> threads;
-
-    for(uint32_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-        threads.push_back(std::thread(&bvh::thread_remove_outlier_jobs, this, 
-                                      first_leaf_, nodes_.size(),
-                                      num_outliers, num_neighbours,
-                                      std::ref(intermediate_outliers[thread_idx]) ) );
+    // the average neighbour distances of all leaf surfels, stored
+    // consecutively by leaf
+    std::vector<size_t> leaf_offsets(num_leaves + 1, 0);
+    for (size_t leaf_idx = 0; leaf_idx < num_leaves; ++leaf_idx) {
+        leaf_offsets[leaf_idx + 1] = leaf_offsets[leaf_idx] + nodes_[first_leaf_ + leaf_idx].mem_array().length();
     }
+    std::vector<real> avg_distances(leaf_offsets.back());
 
-    for(auto& thread : threads){
-        thread.join();
-    }
+    build_search_indices(first_leaf_, nodes_.size());
 
-    std::vector< std::pair<surfel_id_t, real> >  final_outliers;
+    thread_pool_.parallel_for(first_leaf_, nodes_.size(),
+        [&](const size_t node_idx, const size_t) {
+            compute_outlier_distances_job(node_idx, num_neighbours,
+                                          avg_distances.data() + leaf_offsets[node_idx - first_leaf_]);
+        });
 
-    for (auto const& ve : intermediate_outliers) {
+    search_indices_.clear();
 
-        for(auto const& element : ve) {
-            bool insert_element = false;
-            if( final_outliers.size() < num_outliers ) {
-                insert_element = true;
-            } else if( element.second > final_outliers.back().second ) {
-                final_outliers.pop_back();
-                insert_element = true;
-            }
+    // the surfels with the num_outliers largest distances are outliers. of
+    // the surfels at the threshold distance, the first ones in leaf order
+    // are taken
+    num_outliers = std::min(size_t(num_outliers), avg_distances.size());
+    real threshold = std::numeric_limits<real>::max();
+    size_t num_outliers_at_threshold = 0;
 
-            if( insert_element ) {
-                final_outliers.push_back(element);
+    if (num_outliers > 0) {
+        std::vector<real> selection(avg_distances);
+        std::nth_element(selection.begin(), selection.begin() + (num_outliers - 1), selection.end(),
+                         std::greater<real>());
+        threshold = selection[num_outliers - 1];
 
-                for (uint32_t k = final_outliers.size() - 1; k > 0; --k)
-                {
-                    if (final_outliers[k].second > final_outliers[k - 1].second)
-                    {
-                        std::swap(final_outliers[k], final_outliers[k - 1]);
-                    }
-                    else
-                        break;
-                }
+        size_t num_outliers_above_threshold = std::count_if(avg_distances.begin(), avg_distances.end(),
+            [threshold](const real avg_dist) { return avg_dist > threshold; });
+        num_outliers_at_threshold = num_outliers - num_outliers_above_threshold;
+    }
 
-            }
-        }
+    std::vector<size_t> leaf_ties(num_leaves + 1, 0);
+    for (size_t leaf_idx = 0; leaf_idx < num_leaves; ++leaf_idx) {
+        leaf_ties[leaf_idx + 1] = leaf_ties[leaf_idx] +
+            std::count(avg_distances.begin() + leaf_offsets[leaf_idx],
+                       avg_distances.begin() + leaf_offsets[leaf_idx + 1], threshold);
     }
 
-    intermediate_outliers.clear();
+    // compact the leaves in place. only leaves which lost surfels need new
+    // properties, the inner nodes still enclose them
+    thread_pool_.parallel_for(first_leaf_, nodes_.size(),
+        [&](const size_t node_idx, const size_t) {
+            const size_t leaf_idx = node_idx - first_leaf_;
+            surfel_mem_array& leaf_surfels = nodes_[node_idx].mem_array();
+            const real* leaf_distances = avg_distances.data() + leaf_offsets[leaf_idx];
+            size_t tie_idx = leaf_ties[leaf_idx];
 
-    std::set<surfel_id_t> outlier_ids;
-    for(auto const& el : final_outliers) {
-        outlier_ids.insert(el.first);
-    }
+            size_t num_kept = 0;
+            size_t closest_surfel_idx = 0;
+            for (size_t surfel_idx = 0; surfel_idx < leaf_surfels.length(); ++surfel_idx) {
+                const real avg_dist = leaf_distances[surfel_idx];
+                const bool is_outlier = avg_dist > threshold ||
+                                        (avg_dist == threshold && tie_idx++ < num_outliers_at_threshold);
 
-    surfel_vector cleaned_surfels;
+                if (avg_dist < leaf_distances[closest_surfel_idx]) {
+                    closest_surfel_idx = surfel_idx;
+                }
+                if (!is_outlier) {
+                    leaf_surfels.write_surfel(leaf_surfels.read_surfel_ref(surfel_idx), num_kept++);
+                }
+            }
 
+            if (num_kept == leaf_surfels.length()) {
+                return;
+            }
 
-    for(uint32_t node_idx = first_leaf_; node_idx < nodes_.size(); ++node_idx) {
+            // leaves must not become empty, keep the least isolated surfel
+            if (num_kept == 0) {
+                leaf_surfels.write_surfel(leaf_surfels.read_surfel_ref(closest_surfel_idx), num_kept++);
+            }
 
+            leaf_surfels.mem_data()->resize(leaf_surfels.offset() + num_kept);
+            leaf_surfels.set_length(num_kept);
+            compute_bounding_boxes_downsweep_job(node_idx);
+        }, 16);
 
-        bvh_node* current_node = &nodes_.at(node_idx);
-        
-        if (current_node->is_out_of_core())
-        {
-            current_node->load_from_disk();
-        } 
+    // write the leaves back consecutively, every destination precedes the
+    // old position of the leaf
+    shared_file leaf_level_access = nodes_[first_leaf_].disk_array().file();
+    std::vector<size_t> leaf_destinations(num_leaves, 0);
+    for (size_t leaf_idx = 1; leaf_idx < num_leaves; ++leaf_idx) {
+        leaf_destinations[leaf_idx] = leaf_destinations[leaf_idx - 1] + nodes_[first_leaf_ + leaf_idx - 1].mem_array().length();
+    }
 
-        for( uint32_t surfel_idx = 0; surfel_idx < current_node->mem_array().length(); ++surfel_idx) {
+    const size_t num_removed = avg_distances.size() - (leaf_destinations.back() + nodes_.back().mem_array().length());
 
-            if( outlier_ids.end() == outlier_ids.find( surfel_id_t(node_idx, surfel_idx) ) ) {
-                cleaned_surfels.emplace_back(current_node->mem_array().read_surfel(surfel_idx) );
+    thread_pool_.parallel_for(first_leaf_, nodes_.size(),
+        [&](const size_t node_idx, const size_t) {
+            nodes_[node_idx].flush_to_disk(leaf_level_access,
+                                           leaf_destinations[node_idx - first_leaf_], true);
+        }, 16);
 
-            }
-        }
+    // drop the old records of the removed surfels at the end of the file
+    leaf_level_access->truncate(avg_distances.size() - num_removed);
 
-    }
+    LOGGER_INFO("Removed " << num_removed << " outliers");
 
-    return cleaned_surfels;
+    return num_removed;
 }
 
 void bvh::
@@ -1638,12 +1793,17 @@ serialize_tree_to_file(const std::string& output_file,
 
 
 void bvh::
-serialize_surfels_to_file(const std::string& output_file, const size_t buffer_size) const
+serialize_surfels_to_file(const std::string& output_file, const size_t buffer_size)
 {
     LOGGER_TRACE("Serialize surfels to file: \"" << output_file << "\"");
-    node_serializer serializer(max_surfels_per_node_, buffer_size);
+    node_serializer serializer(max_surfels_per_node_, buffer_size, lod_encoding_, lod_layout_);
     serializer.open(output_file);
-    serializer.serialize_nodes(nodes_);
+    if (lod_layout_ == node_layout::clustered)
+        serializer.serialize_nodes(nodes_, get_clustered_node_order());
+    else
+        serializer.serialize_nodes(nodes_);
+    serializer.close();
+    lod_node_extents_ = serializer.node_extents();
 }
 
 void bvh::
@@ -259,6 +259,8 @@ read_bvh(const std::string& filename, bvh& bvh) {
                                  tree.translation_.y_,
                                  tree.translation_.z_);
     bvh.set_translation(vec3r(translation));
+    bvh.set_lod_encoding((surfel_encoding)tree.surfel_encoding_);
+    bvh.set_lod_layout((node_layout)tree.node_layout_);
     if (tree.num_nodes_ != node_id) {
         throw std::runtime_error(
             "PLOD: bvh_stream::Stream corrupt -- Invalid number of node segments");
@@ -353,6 +355,19 @@ read_bvh(const std::string& filename, bvh& bvh) {
 
     }
 
+    if (!interm_state && bvh.lod_layout() != node_layout::fixed) {
+        if (nodes_ext.size() != tree.num_nodes_) {
+            throw std::runtime_error(
+                "PLOD: bvh_stream::Stream corrupt -- Compact layout without node extents");
+        }
+        std::vector<lod_node_extent> extents;
+        for (const auto& node_ext : nodes_ext) {
+            extents.push_back(lod_node_extent{node_ext.disk_array_.offset_,
+                                              node_ext.disk_array_.length_});
+        }
+        bvh.set_lod_node_extents(extents);
+    }
+
     bvh.set_first_leaf(tree.num_nodes_ - std::pow(tree.fan_factor_, tree.depth_));
     bvh.set_state(current_state);
     bvh.set_nodes(bvh_nodes);
@@ -390,10 +405,11 @@ write_bvh(const std::string& filename, bvh& bvh, const bool intermediate) {
    tree.num_nodes_ = bvh.nodes().size();
    tree.fan_factor_ = bvh.fan_factor();
    tree.max_surfels_per_node_ = bvh.max_surfels_per_node();
-   tree.serialized_surfel_size_ = serialized_surfel::get_size();
+   tree.serialized_surfel_size_ = surfel_codec::encoded_size(bvh.lod_encoding());
    tree.reserved_0_ = 0;
+   tree.surfel_encoding_ = (uint32_t)bvh.lod_encoding();
    tree.state_ = (bvh_stream::bvh_tree_state)bvh.state();
-   tree.reserved_1_ = 0;
+   tree.node_layout_ = (uint32_t)bvh.lod_layout();
    tree.reserved_2_ = 0;
    tree.translation_.x_ = bvh.translation().x;
    tree.translation_.y_ = bvh.translation().y;
@@ -426,6 +442,27 @@ write_bvh(const std::string& filename, bvh& bvh, const bool intermediate) {
        write(node);
    }
 
+   // the extents of a compact .lod are stored as node extensions
+   if (!intermediate && bvh.lod_layout() != node_layout::fixed) {
+       const auto& extents = bvh.lod_node_extents();
+       if (extents.size() != bvh_nodes.size()) {
+           throw std::runtime_error(
+               "PLOD: bvh_stream::Node extents of compact layout are missing");
+       }
+       for (uint32_t i = 0; i < bvh_nodes.size(); ++i) {
+           bvh_node_extension_seg node_ext;
+           node_ext.segment_id_ = num_segments_++;
+           node_ext.node_id_ = i;
+           node_ext.empty_ = extents[i].length == 0 ? 1 : 0;
+           node_ext.reserved_ = 0;
+           node_ext.disk_array_.disk_access_ref_ = 0;
+           node_ext.disk_array_.reserved_ = 0;
+           node_ext.disk_array_.offset_ = extents[i].offset;
+           node_ext.disk_array_.length_ = extents[i].length;
+           write(node_ext);
+       }
+   }
+
    if (intermediate) {
        bvh_tree_extension_seg tree_ext;
        tree_ext.segment_id_ = num_segments_++;
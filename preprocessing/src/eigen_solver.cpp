@@ -0,0 +1,281 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/eigen_solver.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace lamure {
+namespace pre
+{
+
+namespace {
+
+// unit vectors u, v with u, v and w orthogonal, w must be normalized
+void
+orthogonal_complement(const vec3r& w, vec3r& u, vec3r& v)
+{
+    if (std::abs(w.x) > std::abs(w.y)) {
+        const real inv_length = 1.0 / std::sqrt(w.x * w.x + w.z * w.z);
+        u = vec3r(-w.z * inv_length, 0.0, w.x * inv_length);
+    }
+    else {
+        const real inv_length = 1.0 / std::sqrt(w.y * w.y + w.z * w.z);
+        u = vec3r(0.0, w.z * inv_length, -w.y * inv_length);
+    }
+    v = scm::math::cross(w, u);
+}
+
+// eigenvector of a well separated eigenvalue
+vec3r
+separated_eigenvector(const real a00, const real a01, const real a02,
+                      const real a11, const real a12, const real a22,
+                      const real eigenvalue)
+{
+    const vec3r row0(a00 - eigenvalue, a01, a02);
+    const vec3r row1(a01, a11 - eigenvalue, a12);
+    const vec3r row2(a02, a12, a22 - eigenvalue);
+
+    // the rows span the plane orthogonal to the eigenvector, use the
+    // longest of their cross products
+    const vec3r r0xr1 = scm::math::cross(row0, row1);
+    const vec3r r0xr2 = scm::math::cross(row0, row2);
+    const vec3r r1xr2 = scm::math::cross(row1, row2);
+    const real d0 = scm::math::dot(r0xr1, r0xr1);
+    const real d1 = scm::math::dot(r0xr2, r0xr2);
+    const real d2 = scm::math::dot(r1xr2, r1xr2);
+
+    if (d0 >= d1 && d0 >= d2 && d0 > 0.0)
+        return r0xr1 / std::sqrt(d0);
+    if (d1 >= d2 && d1 > 0.0)
+        return r0xr2 / std::sqrt(d1);
+    if (d2 > 0.0)
+        return r1xr2 / std::sqrt(d2);
+    return vec3r(1.0, 0.0, 0.0);
+}
+
+// eigenvector of the middle eigenvalue, orthogonal to the separated one
+vec3r
+middle_eigenvector(const real a00, const real a01, const real a02,
+                   const real a11, const real a12, const real a22,
+                   const vec3r& separated, const real eigenvalue)
+{
+    vec3r u, v;
+    orthogonal_complement(separated, u, v);
+
+    const vec3r au(a00 * u.x + a01 * u.y + a02 * u.z,
+                   a01 * u.x + a11 * u.y + a12 * u.z,
+                   a02 * u.x + a12 * u.y + a22 * u.z);
+    const vec3r av(a00 * v.x + a01 * v.y + a02 * v.z,
+                   a01 * v.x + a11 * v.y + a12 * v.z,
+                   a02 * v.x + a12 * v.y + a22 * v.z);
+
+    // 2x2 problem in the basis u, v
+    real m00 = scm::math::dot(u, au) - eigenvalue;
+    real m01 = scm::math::dot(u, av);
+    real m11 = scm::math::dot(v, av) - eigenvalue;
+
+    const real abs_m00 = std::abs(m00);
+    const real abs_m01 = std::abs(m01);
+    const real abs_m11 = std::abs(m11);
+
+    if (abs_m00 >= abs_m11) {
+        if (std::max(abs_m00, abs_m01) <= 0.0)
+            return u;
+        if (abs_m00 >= abs_m01) {
+            m01 /= m00;
+            m00 = 1.0 / std::sqrt(1.0 + m01 * m01);
+            m01 *= m00;
+        }
+        else {
+            m00 /= m01;
+            m01 = 1.0 / std::sqrt(1.0 + m00 * m00);
+            m00 *= m01;
+        }
+        return u * m01 - v * m00;
+    }
+    else {
+        if (std::max(abs_m11, abs_m01) <= 0.0)
+            return u;
+        if (abs_m11 >= abs_m01) {
+            m01 /= m11;
+            m11 = 1.0 / std::sqrt(1.0 + m01 * m01);
+            m01 *= m11;
+        }
+        else {
+            m11 /= m01;
+            m01 = 1.0 / std::sqrt(1.0 + m11 * m11);
+            m11 *= m01;
+        }
+        return u * m11 - v * m01;
+    }
+}
+
+}
+
+void eigen_solver::
+solve(const scm::math::mat3d& matrix,
+      real eigenvalues[3],
+      vec3r eigenvectors[3])
+{
+    // scale to avoid overflow and underflow in the cubic terms
+    real scale = 0.0;
+    for (int i = 0; i < 9; ++i)
+        scale = std::max(scale, std::abs(real(matrix[i])));
+
+    if (scale <= 0.0) {
+        for (int i = 0; i < 3; ++i) {
+            eigenvalues[i] = 0.0;
+            eigenvectors[i] = vec3r(0.0);
+            eigenvectors[i][i] = 1.0;
+        }
+        return;
+    }
+
+    const real a00 = matrix[0] / scale;
+    const real a01 = matrix[1] / scale;
+    const real a02 = matrix[2] / scale;
+    const real a11 = matrix[4] / scale;
+    const real a12 = matrix[5] / scale;
+    const real a22 = matrix[8] / scale;
+
+    const real off_diagonal = a01 * a01 + a02 * a02 + a12 * a12;
+
+    if (off_diagonal <= 0.0) {
+        // diagonal, sort the axes by their entries
+        const real diagonal[3] = {a00, a11, a22};
+        int order[3] = {0, 1, 2};
+        std::sort(order, order + 3, [&](const int l, const int r) { return diagonal[l] < diagonal[r]; });
+        for (int i = 0; i < 3; ++i) {
+            eigenvalues[i] = diagonal[order[i]] * scale;
+            eigenvectors[i] = vec3r(0.0);
+            eigenvectors[i][order[i]] = 1.0;
+        }
+        return;
+    }
+
+    // eigenvalues q + 2p cos(phi + 2k pi / 3) of A = p B + q I
+    const real q = (a00 + a11 + a22) / 3.0;
+    const real b00 = a00 - q;
+    const real b11 = a11 - q;
+    const real b22 = a22 - q;
+    const real p = std::sqrt((b00 * b00 + b11 * b11 + b22 * b22 + 2.0 * off_diagonal) / 6.0);
+
+    const real c00 = b11 * b22 - a12 * a12;
+    const real c01 = a01 * b22 - a12 * a02;
+    const real c02 = a01 * a12 - b11 * a02;
+    const real half_det = std::min(std::max(
+        (b00 * c00 - a01 * c01 + a02 * c02) / (2.0 * p * p * p), real(-1.0)), real(1.0));
+
+    const real angle = std::acos(half_det) / 3.0;
+    const real two_thirds_pi = 2.09439510239319549;
+    const real beta2 = 2.0 * std::cos(angle);
+    const real beta0 = 2.0 * std::cos(angle + two_thirds_pi);
+    const real beta1 = -(beta0 + beta2);
+
+    eigenvalues[0] = q + p * beta0;
+    eigenvalues[1] = q + p * beta1;
+    eigenvalues[2] = q + p * beta2;
+
+    // start with the eigenvalue farther from the middle one
+    if (half_det >= 0.0) {
+        eigenvectors[2] = separated_eigenvector(a00, a01, a02, a11, a12, a22, eigenvalues[2]);
+        eigenvectors[1] = middle_eigenvector(a00, a01, a02, a11, a12, a22, eigenvectors[2], eigenvalues[1]);
+        eigenvectors[0] = scm::math::cross(eigenvectors[1], eigenvectors[2]);
+    }
+    else {
+        eigenvectors[0] = separated_eigenvector(a00, a01, a02, a11, a12, a22, eigenvalues[0]);
+        eigenvectors[1] = middle_eigenvector(a00, a01, a02, a11, a12, a22, eigenvectors[0], eigenvalues[1]);
+        eigenvectors[2] = scm::math::cross(eigenvectors[0], eigenvectors[1]);
+    }
+
+    // the angle is ill-conditioned for close eigenvalues, their Rayleigh
+    // quotients are accurate to the square of the eigenvector error
+    for (int i = 0; i < 3; ++i) {
+        const vec3r& v = eigenvectors[i];
+        eigenvalues[i] = a00 * v.x * v.x + a11 * v.y * v.y + a22 * v.z * v.z +
+                         2.0 * (a01 * v.x * v.y + a02 * v.x * v.z + a12 * v.y * v.z);
+    }
+    // they may swap places within a cluster of close eigenvalues
+    for (int i = 1; i < 3; ++i)
+        for (int j = i; j > 0 && eigenvalues[j] < eigenvalues[j - 1]; --j) {
+            std::swap(eigenvalues[j], eigenvalues[j - 1]);
+            std::swap(eigenvectors[j], eigenvectors[j - 1]);
+        }
+
+    for (int i = 0; i < 3; ++i)
+        eigenvalues[i] *= scale;
+}
+
+scm::math::mat3d eigen_solver::
+compute_covariance(const real* x,
+                   const real* y,
+                   const real* z,
+                   const size_t count)
+{
+    scm::math::mat3d covariance = scm::math::mat3d::zero();
+    if (count == 0)
+        return covariance;
+
+    real sum_x = 0.0, sum_y = 0.0, sum_z = 0.0;
+    #pragma omp simd reduction(+:sum_x,sum_y,sum_z)
+    for (size_t i = 0; i < count; ++i) {
+        sum_x += x[i];
+        sum_y += y[i];
+        sum_z += z[i];
+    }
+    const real mean_x = sum_x / count;
+    const real mean_y = sum_y / count;
+    const real mean_z = sum_z / count;
+
+    real xx = 0.0, xy = 0.0, xz = 0.0, yy = 0.0, yz = 0.0, zz = 0.0;
+    #pragma omp simd reduction(+:xx,xy,xz,yy,yz,zz)
+    for (size_t i = 0; i < count; ++i) {
+        const real dx = x[i] - mean_x;
+        const real dy = y[i] - mean_y;
+        const real dz = z[i] - mean_z;
+        xx += dx * dx;
+        xy += dx * dy;
+        xz += dx * dz;
+        yy += dy * dy;
+        yz += dy * dz;
+        zz += dz * dz;
+    }
+
+    covariance[0] = xx; covariance[1] = xy; covariance[2] = xz;
+    covariance[3] = xy; covariance[4] = yy; covariance[5] = yz;
+    covariance[6] = xz; covariance[7] = yz; covariance[8] = zz;
+    return covariance;
+}
+
+void eigen_solver::
+compute_normals(const real* x,
+                const real* y,
+                const real* z,
+                const size_t* offsets,
+                const size_t count,
+                vec3f* normals)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const size_t begin = offsets[i];
+        const size_t length = offsets[i + 1] - begin;
+        if (length < 3) {
+            normals[i] = vec3f(0.0f);
+            continue;
+        }
+
+        const scm::math::mat3d covariance = compute_covariance(x + begin, y + begin, z + begin, length);
+
+        real eigenvalues[3];
+        vec3r eigenvectors[3];
+        solve(covariance, eigenvalues, eigenvectors);
+        normals[i] = vec3f(eigenvectors[0]);
+    }
+}
+
+} } // namespace lamure
@@ -1,11 +1,12 @@
 // Copyright (c) 2014 Bauhaus-Universitaet Weimar
 // This Software is distributed under the Modified BSD License, see license.txt.
 //
-// Virtual Reality and Visualization Research Group 
+// Virtual Reality and Visualization Research Group
 // Faculty of Media, Bauhaus-Universitaet Weimar
 // http://www.uni-weimar.de/medien/vr
 
 #include <lamure/pre/external_sort.h>
+#include <lamure/pre/key_index_sort.h>
 
 #if WIN32
   #include <ppl.h>
@@ -14,6 +15,9 @@
 #endif
 
 #include <numeric>
+#include <memory>
+#include <functional>
+#include <cmath>
 
 namespace lamure {
 namespace pre
@@ -24,17 +28,16 @@ const size_t      MIN_MERGE_BUFFER_SIZE = 3;
 const std::string TEMP_FILE_EXT = ".runs";
 
 external_sort::
-external_sort(const size_t memory_limit,
-             const surfel::compare_function& compare)
+external_sort(const size_t memory_limit)
     : memory_limit_(memory_limit),
-      compare_(compare),
-      runs_file_(std::make_shared<file>())
+      runs_file_(std::make_shared<file>(file::default_backend(), file_compression::none))
 {}
 
+template <typename compare_type>
 void external_sort::
 sort(surfel_disk_array& array,
      const size_t memory_limit,
-     const surfel::compare_function& compare)
+     const compare_type& compare)
 {
     assert(!array.is_empty());
     assert(array.file());
@@ -42,16 +45,18 @@ sort(surfel_disk_array& array,
     if (!array.length())
         return;
 
-    external_sort es(memory_limit, compare);
-    
+    external_sort es(memory_limit);
+
     // compute sort parameters
     const size_t run_length = memory_limit / sizeof(surfel) / 3u;
     const uint32_t runs_count = std::ceil(array.length() / double(run_length));
-    const size_t merge_buffer_size = memory_limit / sizeof(surfel) / (runs_count + 1u);
+
+    // every run and the output are double-buffered during the merge
+    const size_t merge_buffer_size = memory_limit / sizeof(surfel) / (2u * runs_count + 2u);
 
     LOGGER_INFO("External sort. Length: " << array.length());
-    LOGGER_INFO("Max run length: " << run_length << 
-            " surfels. runs: " << runs_count << 
+    LOGGER_INFO("Max run length: " << run_length <<
+            " surfels. runs: " << runs_count <<
             ". merge buffer size: " << merge_buffer_size << " surfels.");
 
 
@@ -71,9 +76,9 @@ sort(surfel_disk_array& array,
         // external sort
         es.runs_file_->open(array.file()->file_name() + TEMP_FILE_EXT, true);
         LOGGER_TRACE("create runs");
-        es.create_runs(array, run_length, runs_count);
+        es.create_runs(array, run_length, runs_count, compare);
         LOGGER_TRACE("merge");
-        es.merge(array, merge_buffer_size);
+        es.merge(array, std::max(merge_buffer_size, MIN_MERGE_BUFFER_SIZE), compare);
         es.runs_file_->close(true);
         es.runs_.clear();
     }
@@ -82,18 +87,20 @@ sort(surfel_disk_array& array,
         shared_surfel_vector data = array.read_all();
 
 #if WIN32
-        Concurrency::parallel_sort(data->begin(), data->end(), es.compare_);
+        Concurrency::parallel_sort(data->begin(), data->end(), compare);
 #else
-        __gnu_parallel::sort(data->begin(), data->end(), es.compare_);
+        __gnu_parallel::sort(data->begin(), data->end(), compare);
 #endif
         array.write_all(data, 0);
     }
 }
 
+template <typename compare_type>
 void external_sort::
 create_runs(surfel_disk_array& array,
-           const size_t run_length, 
-           const uint32_t runs_count)
+           const size_t run_length,
+           const uint32_t runs_count,
+           const compare_type& compare)
 {
     // construct runs' surfel_disk_arrays
     size_t offset = 0;
@@ -101,7 +108,7 @@ create_runs(surfel_disk_array& array,
         runs_.push_back(surfel_disk_array(array, array.offset() + offset, run_length));
         offset += run_length;
     }
-    runs_.push_back(surfel_disk_array(array, array.offset() + offset, 
+    runs_.push_back(surfel_disk_array(array, array.offset() + offset,
                                            array.length() - offset));
 
     assert(std::accumulate(runs_.begin(), runs_.end(), 0u,
@@ -112,9 +119,9 @@ create_runs(surfel_disk_array& array,
     shared_surfel_vector next_data;
 
     for (uint32_t i = 0; i < runs_.size(); ++i) {
-        
+
         shared_surfel_vector data;
-        
+
         if (next_data) {
             data = next_data;
             next_data.reset();
@@ -129,9 +136,9 @@ create_runs(surfel_disk_array& array,
             {
                 LOGGER_TRACE("sort run " << i);
 #if WIN32
-                Concurrency::parallel_sort(data->begin(), data->end(), compare_);           
+                Concurrency::parallel_sort(data->begin(), data->end(), compare);
 #else
-                __gnu_parallel::sort(data->begin(), data->end(), compare_);
+                __gnu_parallel::sort(data->begin(), data->end(), compare);
 #endif
             }
             #pragma omp section
@@ -144,56 +151,152 @@ create_runs(surfel_disk_array& array,
         }
         LOGGER_TRACE("Save run " << i);
         runs_file_->append(&(*data));
-        runs_[i].reset(runs_file_, runs_[i].offset() - array.offset(), 
+        runs_[i].reset(runs_file_, runs_[i].offset() - array.offset(),
                                    runs_[i].length());
     }
 }
 
+template <typename compare_type>
 void external_sort::
-merge(surfel_disk_array& array, const size_t buffer_size)
+merge(surfel_disk_array& array,
+      const size_t buffer_size,
+      const compare_type& compare)
 {
-    size_t file_offset = 0;
-    surfel_vector output;
-    output.reserve(buffer_size);
-
-    std::vector<buffer> buffers;
-    for (auto r: runs_)
-        buffers.push_back(buffer(r, buffer_size));
+    std::vector<std::unique_ptr<buffer>> buffers;
+    for (const auto& r: runs_)
+        buffers.emplace_back(new buffer(r, buffer_size));
 
-    surfel least;
-    int least_idx;
+    const size_t k = buffers.size();
 
-    do {
-        least_idx = -1;
-        for (size_t i = 0; i < buffers.size(); ++i) {
-            surfel current_surfel;
+    // true if the front of run a has to be written before the front of run b.
+    // Exhausted runs lose every match, ties go to the lower run index
+    auto precedes = [&](const size_t a, const size_t b) {
+        if (buffers[a]->empty()) return false;
+        if (buffers[b]->empty()) return true;
+        if (compare(buffers[a]->front(), buffers[b]->front())) return true;
+        if (compare(buffers[b]->front(), buffers[a]->front())) return false;
+        return a < b;
+    };
 
-            if (buffers[i].front(current_surfel) && (least_idx == -1 || 
-                        compare_(current_surfel, least))) {
-                least = current_surfel;
-                least_idx = i;
-            }
-        }
-        if (least_idx != -1) {
-            buffers[least_idx].pop_front();
-            output.push_back(least);
-            if (output.size() >= buffer_size) {
-                array.file()->write(&output, 0, array.offset() + file_offset, 
-                                                output.size());
-                file_offset += output.size();
-                output.clear();
-            }
+    // loser tree: inner nodes 1..k-1 hold the loser of their match,
+    // leaves k..2k-1 stand for the runs
+    std::vector<size_t> losers(k, 0);
+    std::function<size_t(size_t)> play = [&](const size_t node) -> size_t {
+        if (node >= k)
+            return node - k;
+        size_t left = play(2 * node);
+        size_t right = play(2 * node + 1);
+        if (precedes(right, left)) {
+            losers[node] = left;
+            return right;
         }
-    } while (least_idx != -1);
+        losers[node] = right;
+        return left;
+    };
+    size_t winner = play(1);
 
-    if (output.size() > 0) {
-        array.file()->write(&output, 0, array.offset() + file_offset, 
-                                        output.size());
-        file_offset += output.size();
+    // output is written in the background while the next block is merged
+    surfel_vector output, output_in_flight;
+    output.reserve(buffer_size);
+    output_in_flight.reserve(buffer_size);
+    std::future<void> pending_write;
+    size_t file_offset = 0;
+
+    auto write_output = [&]() {
+        if (pending_write.valid())
+            pending_write.get();
+        std::swap(output, output_in_flight);
         output.clear();
+
+        const size_t offset = array.offset() + file_offset;
+        file_offset += output_in_flight.size();
+        pending_write = std::async(std::launch::async, [&array, &output_in_flight, offset]() {
+            array.file()->write(&output_in_flight, 0, offset, output_in_flight.size());
+        });
+    };
+
+    while (!buffers[winner]->empty()) {
+        output.push_back(buffers[winner]->front());
+        buffers[winner]->pop_front();
+
+        if (output.size() >= buffer_size)
+            write_output();
+
+        // replay the matches on the path from the winner's leaf to the root
+        size_t candidate = winner;
+        for (size_t node = (winner + k) / 2; node >= 1; node /= 2) {
+            if (precedes(losers[node], candidate))
+                std::swap(losers[node], candidate);
+        }
+        winner = candidate;
     }
+
+    if (output.size() > 0)
+        write_output();
+    if (pending_write.valid())
+        pending_write.get();
+
     assert(file_offset == array.length());
 }
 
-} } // namespace lamure
+external_sort::buffer::
+buffer(const surfel_disk_array& array, const size_t buffer_size)
+    : run_(array),
+      current_(buffer_size),
+      next_(buffer_size),
+      size_(0),
+      next_size_(0),
+      candidate_pos_(0),
+      file_offset_(0)
+{
+    prefetch();
+    pop_front();
+}
+
+external_sort::buffer::
+~buffer()
+{
+    if (pending_.valid())
+        pending_.wait();
+}
+
+void external_sort::buffer::
+pop_front()
+{
+    ++candidate_pos_;
 
+    if (candidate_pos_ >= size_ && (pending_.valid() || next_size_ > 0)) {
+        // switch to the prefetched block and start reading the following one
+        if (pending_.valid())
+            pending_.get();
+        std::swap(current_, next_);
+        size_ = next_size_;
+        next_size_ = 0;
+        candidate_pos_ = 0;
+        prefetch();
+    }
+}
+
+void external_sort::buffer::
+prefetch()
+{
+    if (file_offset_ >= run_.length())
+        return;
+
+    next_size_ = std::min(next_.size(), run_.length() - file_offset_);
+    const size_t offset = run_.offset() + file_offset_;
+    file_offset_ += next_size_;
+
+    pending_ = std::async(std::launch::async, [this, offset]() {
+        run_.file()->read(&next_, 0, offset, next_size_);
+    });
+}
+
+template void external_sort::sort<surfel::axis_less>(surfel_disk_array&,
+                                                     const size_t,
+                                                     const surfel::axis_less&);
+template void external_sort::sort<key_index_sort::key_less>(surfel_disk_array&,
+                                                            const size_t,
+                                                            const key_index_sort::key_less&);
+
+} } // namespace lamure
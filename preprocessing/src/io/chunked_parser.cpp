@@ -0,0 +1,213 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/io/chunked_parser.h>
+
+#include <stdexcept>
+#include <cstdlib>
+#include <cerrno>
+
+#if WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+namespace lamure {
+namespace pre {
+
+mapped_file::
+~mapped_file()
+{
+    try {
+        close();
+    }
+    catch (...) {}
+}
+
+void mapped_file::
+open(const std::string& file_name)
+{
+    if (is_open()) {
+        LOGGER_ERROR("Attempt to open file when the instance of "
+                     "mapped_file is already in open state. "
+                     "file: \"" << file_name << "\"");
+        exit(1);
+    }
+
+#if WIN32
+    file_handle_ = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                               NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_handle_ == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Unable to open file: " + file_name);
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle_, &file_size);
+    size_ = size_t(file_size.QuadPart);
+
+    if (size_ > 0) {
+        mapping_handle_ = CreateFileMappingA(file_handle_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping_handle_ == NULL)
+            throw std::runtime_error("Unable to map file: " + file_name);
+        data_ = static_cast<const char*>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+        if (data_ == nullptr)
+            throw std::runtime_error("Unable to map file: " + file_name);
+    }
+#else
+    fd_ = ::open(file_name.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        throw std::runtime_error("Unable to open file: " + file_name);
+
+    struct stat st;
+    if (fstat(fd_, &st))
+        throw std::runtime_error("Unable to stat file: " + file_name);
+    size_ = size_t(st.st_size);
+
+    if (size_ > 0) {
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (mapping == MAP_FAILED) {
+            LOGGER_ERROR("Failed to map file: \"" << file_name <<
+                         "\". " << strerror(errno));
+            throw std::runtime_error("Unable to map file: " + file_name);
+        }
+        madvise(mapping, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapping);
+    }
+#endif
+
+    is_open_ = true;
+}
+
+void mapped_file::
+close()
+{
+    if (!is_open())
+        return;
+
+#if WIN32
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_handle_)
+        CloseHandle(mapping_handle_);
+    CloseHandle(file_handle_);
+    mapping_handle_ = nullptr;
+    file_handle_ = nullptr;
+#else
+    if (data_)
+        munmap(const_cast<char*>(data_), size_);
+    ::close(fd_);
+    fd_ = -1;
+#endif
+
+    data_ = nullptr;
+    size_ = 0;
+    is_open_ = false;
+}
+
+namespace text {
+
+const char*
+parse_real(const char* first, const char* last, real& value)
+{
+    static const double powers_of_ten[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    while (first != last && is_blank(*first))
+        ++first;
+
+    const char* it = first;
+    bool negative = false;
+    if (it != last && (*it == '-' || *it == '+')) {
+        negative = (*it == '-');
+        ++it;
+    }
+
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    uint32_t significant_digits = 0;
+    bool has_digits = false;
+    bool truncated = false;
+
+    for (; it != last && is_digit(*it); ++it) {
+        has_digits = true;
+        if (significant_digits < 19) {
+            mantissa = mantissa * 10 + uint64_t(*it - '0');
+            if (mantissa) ++significant_digits;
+        }
+        else {
+            ++exponent;
+            truncated = true;
+        }
+    }
+
+    if (it != last && *it == '.') {
+        for (++it; it != last && is_digit(*it); ++it) {
+            has_digits = true;
+            if (significant_digits < 19) {
+                mantissa = mantissa * 10 + uint64_t(*it - '0');
+                if (mantissa) ++significant_digits;
+                --exponent;
+            }
+            else {
+                truncated = true;
+            }
+        }
+    }
+
+    if (!has_digits)
+        return nullptr;
+
+    if (it != last && (*it == 'e' || *it == 'E')) {
+        const char* exp_it = it + 1;
+        bool negative_exp = false;
+        if (exp_it != last && (*exp_it == '-' || *exp_it == '+')) {
+            negative_exp = (*exp_it == '-');
+            ++exp_it;
+        }
+        if (exp_it != last && is_digit(*exp_it)) {
+            int32_t exp_value = 0;
+            for (; exp_it != last && is_digit(*exp_it); ++exp_it) {
+                if (exp_value < 100000)
+                    exp_value = exp_value * 10 + (*exp_it - '0');
+            }
+            exponent += negative_exp ? -exp_value : exp_value;
+            it = exp_it;
+        }
+    }
+
+    // mantissa and 10^|exponent| are exact doubles, so a single
+    // multiplication or division rounds correctly
+    if (!truncated && mantissa <= (uint64_t(1) << 53) &&
+        exponent >= -22 && exponent <= 22) {
+        double result = double(mantissa);
+        result = exponent < 0 ? result / powers_of_ten[-exponent]
+                              : result * powers_of_ten[exponent];
+        value = negative ? -result : result;
+        return it;
+    }
+
+    // rare slow path for very long or very large/small numbers. strtod
+    // needs a terminated copy, tokens that do not fit are no number
+    char token[128];
+    const size_t length = size_t(it - first);
+    if (length >= sizeof(token))
+        return nullptr;
+    std::memcpy(token, first, length);
+    token[length] = '\0';
+    value = std::strtod(token, nullptr);
+    return it;
+}
+
+} // namespace text
+
+} // namespace pre
+} // namespace lamure
@@ -0,0 +1,583 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/io/compressed_file.h>
+
+#include <lamure/pre/surfel.h>
+#include <lamure/pre/logger.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace lamure {
+namespace pre
+{
+
+namespace {
+
+const char file_magic[8] = {'L', 'M', 'R', 'B', 'L', 'K', '0', '1'};
+
+const size_t surfel_size = sizeof(surfel);
+const size_t block_bytes = compressed_file::block_length * surfel_size;
+
+// number of decoded blocks that are kept per file
+const size_t cache_capacity = 16;
+
+struct file_header {
+    char                magic[8];
+    uint64_t            surfel_size;
+    uint64_t            block_length;
+    uint64_t            num_surfels;
+    uint64_t            index_offset;
+    uint64_t            num_blocks;
+    uint64_t            reserved[2];
+};
+
+const uint64_t header_size = sizeof(file_header);
+static_assert(header_size == 64, "compressed file header must be 64 bytes");
+
+enum block_method : uint8_t {
+    stored     = 0, // the raw surfels
+    planes_rle = 1  // delta coded byte planes, runs of zeros collapsed
+};
+
+// Byte j of all surfels of a block forms plane j. Each plane is delta
+// coded along the surfels, so that bytes that do not change between
+// neighbouring surfels (exponents, high bytes of nearby coordinates,
+// padding) become zero. The planes are then stored as runs of up to 128
+// literal bytes or zeros, each preceded by a control byte.
+void
+encode_block(const char* raw, std::vector<char>& encoded)
+{
+    const size_t n = compressed_file::block_length;
+
+    std::vector<uint8_t> planes(block_bytes);
+    for (size_t j = 0; j < surfel_size; ++j) {
+        uint8_t* plane = &planes[j * n];
+        uint8_t previous = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const uint8_t value = uint8_t(raw[i * surfel_size + j]);
+            plane[i] = uint8_t(value - previous);
+            previous = value;
+        }
+    }
+
+    encoded.clear();
+    encoded.push_back(char(planes_rle));
+
+    size_t i = 0;
+    while (i < planes.size()) {
+        size_t run = 0;
+        while (i + run < planes.size() && run < 128 && planes[i + run] == 0)
+            ++run;
+        if (run > 0) {
+            encoded.push_back(char(0x80 | (run - 1)));
+            i += run;
+            continue;
+        }
+
+        // literals up to the next pair of zeros
+        size_t length = 0;
+        while (i + length < planes.size() && length < 128 &&
+               !(planes[i + length] == 0 &&
+                 (i + length + 1 == planes.size() || planes[i + length + 1] == 0)))
+            ++length;
+        encoded.push_back(char(length - 1));
+        encoded.insert(encoded.end(), planes.begin() + i, planes.begin() + i + length);
+        i += length;
+
+        if (encoded.size() > block_bytes)
+            break;
+    }
+
+    if (encoded.size() > block_bytes) {
+        encoded.assign(1, char(stored));
+        encoded.insert(encoded.end(), raw, raw + block_bytes);
+    }
+}
+
+bool
+decode_block(const std::vector<char>& encoded, char* raw)
+{
+    if (encoded.empty())
+        return false;
+
+    if (uint8_t(encoded[0]) == stored) {
+        if (encoded.size() != block_bytes + 1)
+            return false;
+        std::memcpy(raw, encoded.data() + 1, block_bytes);
+        return true;
+    }
+    if (uint8_t(encoded[0]) != planes_rle)
+        return false;
+
+    std::vector<uint8_t> planes(block_bytes, 0);
+    size_t pos = 1, out = 0;
+    while (pos < encoded.size()) {
+        const uint8_t control = uint8_t(encoded[pos++]);
+        const size_t length = (control & 0x7f) + 1;
+        if (out + length > block_bytes)
+            return false;
+        if (!(control & 0x80)) {
+            if (pos + length > encoded.size())
+                return false;
+            std::memcpy(&planes[out], encoded.data() + pos, length);
+            pos += length;
+        }
+        out += length;
+    }
+    if (out != block_bytes)
+        return false;
+
+    const size_t n = compressed_file::block_length;
+    for (size_t j = 0; j < surfel_size; ++j) {
+        const uint8_t* plane = &planes[j * n];
+        uint8_t value = 0;
+        for (size_t i = 0; i < n; ++i) {
+            value = uint8_t(value + plane[i]);
+            raw[i * surfel_size + j] = char(value);
+        }
+    }
+    return true;
+}
+
+}
+
+const size_t compressed_file::block_length;
+
+compressed_file::
+~compressed_file()
+{
+    try {
+        close();
+    }
+    catch (...) {}
+}
+
+bool compressed_file::
+is_compressed(const std::string& file_name)
+{
+    std::ifstream input(file_name, std::ios::in | std::ios::binary);
+    char magic[sizeof(file_magic)];
+    if (!input.read(magic, sizeof(magic)))
+        return false;
+    return std::memcmp(magic, file_magic, sizeof(magic)) == 0;
+}
+
+void compressed_file::
+open(const std::string& file_name, const bool truncate)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    file_name_ = file_name;
+    index_.clear();
+    cache_.clear();
+    num_surfels_ = 0;
+    end_of_data_ = header_size;
+    live_bytes_ = 0;
+    use_counter_ = 0;
+
+    std::ios::openmode mode = std::ios::in |
+                              std::ios::out |
+                              std::ios::binary;
+    if (truncate)
+        mode |= std::ios::trunc;
+
+    stream_.open(file_name_, mode);
+    if (!stream_.is_open()) {
+        LOGGER_ERROR("Failed to open file: \"" << file_name_ <<
+                                "\". " << strerror(errno));
+        throw std::runtime_error("Failed to open file: " + file_name_);
+    }
+    stream_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    if (truncate) {
+        write_index(stream_);
+        return;
+    }
+
+    file_header header;
+    stream_.seekg(0);
+    stream_.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+        header.surfel_size != surfel_size ||
+        header.block_length != block_length) {
+        LOGGER_ERROR("Incompatible compressed file: \"" << file_name_ << "\"");
+        throw std::runtime_error("Incompatible compressed file: " + file_name_);
+    }
+
+    num_surfels_ = header.num_surfels;
+    index_.resize(header.num_blocks);
+    if (!index_.empty()) {
+        stream_.seekg(header.index_offset);
+        stream_.read(reinterpret_cast<char*>(index_.data()),
+                     index_.size() * sizeof(block_entry));
+    }
+    for (const auto& entry : index_)
+        live_bytes_ += entry.size;
+
+    // new blocks and the new index go behind the old index, so that the
+    // header and the old index describe a valid file until close
+    end_of_data_ = header.index_offset + index_.size() * sizeof(block_entry);
+}
+
+void compressed_file::
+close(const bool remove)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!stream_.is_open())
+        return;
+
+    if (!remove) {
+        evict_blocks(0);
+
+        // old versions of rewritten blocks are dropped once they take up
+        // a quarter of the size of the current ones
+        const uint64_t unused_bytes = end_of_data_ - header_size - live_bytes_;
+        if (unused_bytes > live_bytes_ / 4)
+            compact();
+        else
+            write_index(stream_);
+    }
+
+    if (stream_.is_open()) {
+        stream_.close();
+        if (stream_.fail()) {
+            LOGGER_ERROR("Failed to close file: \"" << file_name_ <<
+                                     "\". " << strerror(errno));
+        }
+    }
+    stream_.exceptions(std::ifstream::failbit);
+
+    if (remove)
+        if (std::remove(file_name_.c_str())) {
+            LOGGER_WARN("Unable to delete file: \"" << file_name_ <<
+                                   "\". " << strerror(errno));
+        }
+
+    index_.clear();
+    cache_.clear();
+    file_name_ = "";
+}
+
+const size_t compressed_file::
+get_size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_surfels_;
+}
+
+void compressed_file::
+truncate(const size_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (length >= num_surfels_)
+        return;
+
+    // blocks behind the new end are dropped, the tail of the last block
+    // is cleared so that it reads as zeros like a never written range
+    const size_t num_blocks = (length + block_length - 1) / block_length;
+    for (auto it = cache_.lower_bound(num_blocks); it != cache_.end();)
+        it = cache_.erase(it);
+    for (size_t b = num_blocks; b < index_.size(); ++b)
+        live_bytes_ -= index_[b].size;
+    if (index_.size() > num_blocks)
+        index_.resize(num_blocks);
+
+    const size_t first = length % block_length;
+    if (first != 0) {
+        cached_block& block = load_block(num_blocks - 1, false);
+        std::memset(block.data.data() + first * surfel_size, 0,
+                    (block_length - first) * surfel_size);
+        block.dirty = true;
+    }
+
+    num_surfels_ = length;
+    evict_blocks(cache_capacity);
+}
+
+void compressed_file::
+append(const char* data, const size_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_blocks(data, num_surfels_, length);
+}
+
+void compressed_file::
+write(const char* data,
+      const size_t offset_in_file,
+      const size_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_blocks(data, offset_in_file, length);
+}
+
+void compressed_file::
+read(char* data,
+     const size_t offset_in_file,
+     const size_t length)
+{
+    assert(length > 0);
+
+    const size_t first_block = offset_in_file / block_length;
+    const size_t last_block = (offset_in_file + length - 1) / block_length;
+
+    auto copy_part = [&](const size_t block_index, const char* block_data) {
+        const size_t first = std::max(offset_in_file, block_index * block_length);
+        const size_t last = std::min(offset_in_file + length, (block_index + 1) * block_length);
+        char* output = data + (first - offset_in_file) * surfel_size;
+        if (block_data)
+            std::memcpy(output, block_data + (first - block_index * block_length) * surfel_size,
+                        (last - first) * surfel_size);
+        else
+            std::memset(output, 0, (last - first) * surfel_size);
+    };
+
+    std::vector<size_t> missing;
+    std::vector<block_entry> missing_entries;
+    std::vector<std::vector<char>> encoded;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t b = first_block; b <= last_block; ++b) {
+            auto it = cache_.find(b);
+            if (it != cache_.end()) {
+                it->second.last_use = ++use_counter_;
+                copy_part(b, it->second.data.data());
+            }
+            else if (b >= index_.size() || index_[b].offset == 0) {
+                copy_part(b, nullptr);
+            }
+            else {
+                missing.push_back(b);
+                missing_entries.push_back(index_[b]);
+                encoded.emplace_back();
+                read_encoded(b, encoded.back());
+            }
+        }
+    }
+
+    if (missing.empty())
+        return;
+
+    // blocks are decoded without holding the lock
+    std::vector<std::vector<char>> decoded(missing.size());
+    bool corrupt = false;
+    #pragma omp parallel for schedule(dynamic) reduction(||:corrupt)
+    for (size_t i = 0; i < missing.size(); ++i) {
+        decoded[i].resize(block_bytes);
+        corrupt = !decode_block(encoded[i], decoded[i].data()) || corrupt;
+    }
+    if (corrupt) {
+        LOGGER_ERROR("Corrupt block in compressed file: \"" << file_name_ << "\"");
+        throw std::runtime_error("Corrupt block in compressed file: " + file_name_);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // small reads keep their blocks, large ones would only flush the cache
+    const bool keep = missing.size() <= cache_capacity / 2;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        const size_t b = missing[i];
+
+        // the block may have been written in the meantime
+        auto it = cache_.find(b);
+        if (it != cache_.end()) {
+            copy_part(b, it->second.data.data());
+            continue;
+        }
+        if (index_[b].offset != missing_entries[i].offset) {
+            copy_part(b, load_block(b, false).data.data());
+            continue;
+        }
+
+        copy_part(b, decoded[i].data());
+        if (keep)
+            cache_.emplace(b, cached_block{std::move(decoded[i]), false, ++use_counter_});
+    }
+    evict_blocks(cache_capacity);
+}
+
+void compressed_file::
+write_blocks(const char* data,
+             const size_t offset_in_file,
+             const size_t length)
+{
+    assert(stream_.is_open());
+    assert(length > 0);
+
+    size_t done = 0;
+    while (done < length) {
+        const size_t position = offset_in_file + done;
+        const size_t block_index = position / block_length;
+        const size_t first = position % block_length;
+        const size_t count = std::min(length - done, block_length - first);
+
+        cached_block& block = load_block(block_index, count == block_length);
+        std::memcpy(block.data.data() + first * surfel_size,
+                    data + done * surfel_size,
+                    count * surfel_size);
+        block.dirty = true;
+        done += count;
+    }
+
+    num_surfels_ = std::max(num_surfels_, offset_in_file + length);
+    evict_blocks(cache_capacity);
+}
+
+compressed_file::cached_block& compressed_file::
+load_block(const size_t block_index, const bool overwrite)
+{
+    auto it = cache_.find(block_index);
+    if (it == cache_.end()) {
+        cached_block block{std::vector<char>(block_bytes, 0), false, 0};
+        if (!overwrite && block_index < index_.size() && index_[block_index].offset != 0) {
+            std::vector<char> encoded;
+            read_encoded(block_index, encoded);
+            if (!decode_block(encoded, block.data.data())) {
+                LOGGER_ERROR("Corrupt block in compressed file: \"" << file_name_ << "\"");
+                throw std::runtime_error("Corrupt block in compressed file: " + file_name_);
+            }
+        }
+        it = cache_.emplace(block_index, std::move(block)).first;
+    }
+    it->second.last_use = ++use_counter_;
+    return it->second;
+}
+
+void compressed_file::
+evict_blocks(const size_t capacity)
+{
+    if (cache_.size() <= capacity)
+        return;
+
+    std::vector<std::pair<uint64_t, size_t>> blocks_by_use;
+    for (const auto& block : cache_)
+        blocks_by_use.emplace_back(block.second.last_use, block.first);
+    std::sort(blocks_by_use.begin(), blocks_by_use.end());
+    blocks_by_use.resize(cache_.size() - capacity);
+
+    std::vector<size_t> dirty;
+    std::vector<const char*> dirty_data;
+    for (const auto& block : blocks_by_use) {
+        const cached_block& cached = cache_.at(block.second);
+        if (cached.dirty) {
+            dirty.push_back(block.second);
+            dirty_data.push_back(cached.data.data());
+        }
+    }
+
+    // blocks are compressed in parallel, then appended in order
+    std::vector<std::vector<char>> encoded(dirty.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < dirty.size(); ++i)
+        encode_block(dirty_data[i], encoded[i]);
+
+    for (size_t i = 0; i < dirty.size(); ++i)
+        store_block(dirty[i], encoded[i]);
+
+    for (const auto& block : blocks_by_use)
+        cache_.erase(block.second);
+}
+
+void compressed_file::
+store_block(const size_t block_index, const std::vector<char>& encoded)
+{
+    if (index_.size() <= block_index)
+        index_.resize(block_index + 1, block_entry{0, 0});
+
+    stream_.seekp(end_of_data_);
+    stream_.write(encoded.data(), encoded.size());
+
+    live_bytes_ -= index_[block_index].size;
+    index_[block_index] = block_entry{end_of_data_, encoded.size()};
+    live_bytes_ += encoded.size();
+    end_of_data_ += encoded.size();
+}
+
+void compressed_file::
+read_encoded(const size_t block_index, std::vector<char>& encoded)
+{
+    const block_entry& entry = index_[block_index];
+    encoded.resize(entry.size);
+    stream_.seekg(entry.offset);
+    stream_.read(encoded.data(), entry.size);
+}
+
+void compressed_file::
+write_index(std::ostream& output)
+{
+    output.seekp(end_of_data_);
+    output.write(reinterpret_cast<const char*>(index_.data()),
+                 index_.size() * sizeof(block_entry));
+    output.flush();
+
+    file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.surfel_size = surfel_size;
+    header.block_length = block_length;
+    header.num_surfels = num_surfels_;
+    header.index_offset = end_of_data_;
+    header.num_blocks = index_.size();
+
+    output.seekp(0);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.flush();
+}
+
+void compressed_file::
+compact()
+{
+    // copies the current version of every block to a new file
+    const std::string compact_name = file_name_ + ".compact";
+    std::fstream output(compact_name, std::ios::in | std::ios::out |
+                                      std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        LOGGER_WARN("Unable to compact file: \"" << file_name_ <<
+                               "\". " << strerror(errno));
+        write_index(stream_);
+        return;
+    }
+    output.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    std::vector<block_entry> index(index_.size(), block_entry{0, 0});
+    uint64_t offset = header_size;
+    std::vector<char> encoded;
+    output.seekp(offset);
+    for (size_t b = 0; b < index_.size(); ++b) {
+        if (index_[b].offset == 0)
+            continue;
+        read_encoded(b, encoded);
+        output.write(encoded.data(), encoded.size());
+        index[b] = block_entry{offset, encoded.size()};
+        offset += encoded.size();
+    }
+
+    index_.swap(index);
+    end_of_data_ = offset;
+    write_index(output);
+    output.close();
+
+    stream_.close();
+#if WIN32
+    std::remove(file_name_.c_str());
+#endif
+    if (std::rename(compact_name.c_str(), file_name_.c_str())) {
+        LOGGER_ERROR("Failed to replace file: \"" << file_name_ <<
+                                "\". " << strerror(errno));
+        throw std::runtime_error("Failed to replace file: " + file_name_);
+    }
+}
+
+} // namespace pre
+} // namespace lamure
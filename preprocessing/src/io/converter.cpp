@@ -19,6 +19,7 @@ convert(const std::string& input_filename,
     discarded_ = 0;
     flush_ready_ = false;
     flush_done_ = false;
+    output_bounding_box_ = bounding_box();
 
     auto buf_callback = [&](surfel_vector& surfels) {
         std::unique_lock<std::mutex> lk(mtx_);
@@ -65,6 +66,7 @@ write_in_core_surfels_out(const surfel_vector& surf_vec,
     discarded_ = 0;
     flush_ready_ = false;
     flush_done_ = false;
+    output_bounding_box_ = bounding_box();
 
     std::string extended_output_filename = output_filename;
 
@@ -140,6 +142,7 @@ append_surfel(const surfel& surf)
 
         //LOGGER_DEBUG("Pos: " << s.pos());
 
+        output_bounding_box_.expand(s.pos());
         buffer_.push_back(s);
 
         if (buffer_.size() > surfels_in_buffer_)
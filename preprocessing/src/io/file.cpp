@@ -10,13 +10,50 @@
 #include <stdexcept>
 #include <cstdio>
 #include <cstring>
+#include <cerrno>
+
+#if !WIN32
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
 
 #include <lamure/pre/logger.h>
 
+#include <boost/filesystem.hpp>
+
 namespace lamure {
 namespace pre
 {
 
+file_backend file::default_backend_ = file_backend::stream;
+file_compression file::default_compression_ = file_compression::none;
+
+void file::
+set_default_backend(const file_backend backend)
+{
+    default_backend_ = backend;
+}
+
+file_backend file::
+default_backend()
+{
+    return default_backend_;
+}
+
+void file::
+set_default_compression(const file_compression compression)
+{
+    default_compression_ = compression;
+}
+
+file_compression file::
+default_compression()
+{
+    return default_compression_;
+}
+
 file::
 ~file()
 {
@@ -38,6 +75,46 @@ open(const std::string& file_name, const bool truncate)
     }
 
     file_name_ = file_name;
+
+    const bool compressed = truncate ? compression_ == file_compression::block
+                                     : compressed_file::is_compressed(file_name_);
+    if (compressed) {
+        compressed_ = std::unique_ptr<compressed_file>(new compressed_file());
+        compressed_->open(file_name_, truncate);
+        return;
+    }
+
+#if WIN32
+    if (backend_ == file_backend::positional) {
+        LOGGER_WARN("Positional file backend is not supported on this "
+                    "platform. Falling back to stream backend.");
+        backend_ = file_backend::stream;
+    }
+#else
+    if (backend_ == file_backend::positional) {
+        int flags = O_RDWR;
+        if (truncate)
+            flags |= O_CREAT | O_TRUNC;
+
+        fd_ = ::open(file_name_.c_str(), flags, 0644);
+
+        if (fd_ < 0) {
+            LOGGER_ERROR("Failed to open file: \"" << file_name_ << 
+                                    "\". " << strerror(errno));
+            throw std::runtime_error("Failed to open file: " + file_name_);
+        }
+
+        struct stat st;
+        if (fstat(fd_, &st)) {
+            LOGGER_ERROR("Failed to stat file: \"" << file_name_ << 
+                                    "\". " << strerror(errno));
+            throw std::runtime_error("Failed to stat file: " + file_name_);
+        }
+        end_of_file_ = size_t(st.st_size);
+        return;
+    }
+#endif
+
     std::ios::openmode mode = std::ios::in |
                               std::ios::out |
                               std::ios::binary;
@@ -57,6 +134,34 @@ open(const std::string& file_name, const bool truncate)
 void file::
 close(const bool remove)
 {
+    if (compressed_) {
+        compressed_->close(remove);
+        compressed_.reset();
+        file_name_ = "";
+        return;
+    }
+
+#if !WIN32
+    if (backend_ == file_backend::positional) {
+        if (fd_ >= 0) {
+            if (::close(fd_)) {
+                LOGGER_ERROR("Failed to close file: \"" << file_name_ << 
+                                         "\". " << strerror(errno));
+            }
+            fd_ = -1;
+            end_of_file_ = 0;
+
+            if (remove)
+                if (std::remove(file_name_.c_str())) {
+                    LOGGER_WARN("Unable to delete file: \"" << file_name_ << 
+                                           "\". " << strerror(errno));
+                }
+            file_name_ = "";
+        }
+        return;
+    }
+#endif
+
     if (is_open()) {
         stream_.flush();
         stream_.close();
@@ -75,15 +180,38 @@ close(const bool remove)
     }
 }
 
+void file::
+flush()
+{
+    if (compressed_ || backend_ == file_backend::positional)
+        return;
+
+    std::lock_guard<std::mutex> lock(read_write_mutex_);
+    if (stream_.is_open())
+        stream_.flush();
+}
+
 const bool file::
 is_open() const
 {
+    if (compressed_)
+        return compressed_->is_open();
+    if (backend_ == file_backend::positional)
+        return fd_ >= 0;
     return stream_.is_open();
 }
 
 const size_t file::
 get_size() const
 {
+    if (compressed_)
+        return compressed_->get_size();
+
+    if (backend_ == file_backend::positional) {
+        assert(is_open());
+        return end_of_file_.load() / sizeof(surfel);
+    }
+
     std::lock_guard<std::mutex> lock(read_write_mutex_);
 
     assert(is_open());
@@ -98,17 +226,76 @@ get_size() const
     return len / sizeof(surfel);
 }
 
+void file::
+truncate(const size_t length)
+{
+    assert(is_open());
+
+    if (compressed_) {
+        compressed_->truncate(length);
+        return;
+    }
+
+    const size_t bytes = length * sizeof(surfel);
+
+#if !WIN32
+    if (backend_ == file_backend::positional) {
+        if (::ftruncate(fd_, off_t(bytes))) {
+            LOGGER_ERROR("truncate failed. file: \"" << file_name_ << 
+                                    "\". (len: " << length << "). " << strerror(errno));
+            throw std::runtime_error("Failed to truncate file: " + file_name_);
+        }
+        end_of_file_ = bytes;
+        return;
+    }
+#endif
+
+    // the stream is reopened, so that the file can be resized on all platforms
+    std::lock_guard<std::mutex> lock(read_write_mutex_);
+    stream_.flush();
+    stream_.close();
+
+    boost::system::error_code error;
+    boost::filesystem::resize_file(file_name_, bytes, error);
+    if (error) {
+        LOGGER_ERROR("truncate failed. file: \"" << file_name_ << 
+                                "\". (len: " << length << "). " << error.message());
+    }
+
+    stream_.open(file_name_, std::ios::in | std::ios::out | std::ios::binary);
+    if (!stream_.is_open()) {
+        LOGGER_ERROR("Failed to open file: \"" << file_name_ << 
+                                "\". " << strerror(errno));
+        throw std::runtime_error("Failed to open file: " + file_name_);
+    }
+    stream_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+}
+
 void file::
 append(const surfel_vector* data,
        const size_t offset_in_mem,
        const size_t length)
 {
-    std::lock_guard<std::mutex> lock(read_write_mutex_);
-
     assert(is_open());
     assert(length > 0);
     assert(offset_in_mem + length <= data->size());
 
+    if (compressed_) {
+        compressed_->append(reinterpret_cast<const char*>(&(*data)[offset_in_mem]), length);
+        return;
+    }
+
+    if (backend_ == file_backend::positional) {
+        // reserve the range at the end of the file, then write it without lock
+        const size_t bytes = length * sizeof(surfel);
+        const size_t offset = end_of_file_.fetch_add(bytes);
+        write_bytes(reinterpret_cast<const char*>(&(*data)[offset_in_mem]),
+                    offset, bytes);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(read_write_mutex_);
+
     stream_.seekp(0, stream_.end);
     stream_.write(reinterpret_cast<char*>(
                   const_cast<surfel*>(&(*data)[offset_in_mem])),
@@ -176,6 +363,23 @@ write_data(char *data, const size_t offset_in_file, const size_t length)
 {
     assert(is_open());
 
+    if (compressed_) {
+        compressed_->write(data, offset_in_file, length);
+        return;
+    }
+
+    if (backend_ == file_backend::positional) {
+        const size_t offset = offset_in_file * sizeof(surfel);
+        const size_t bytes = length * sizeof(surfel);
+        write_bytes(data, offset, bytes);
+
+        // keep track of the file end for subsequent appends
+        size_t end = end_of_file_.load();
+        while (end < offset + bytes &&
+               !end_of_file_.compare_exchange_weak(end, offset + bytes)) {}
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(read_write_mutex_);
     stream_.seekp(offset_in_file * sizeof(surfel));
     stream_.write(data, length * sizeof(surfel));
@@ -193,6 +397,16 @@ read_data(char *data, const size_t offset_in_file, const size_t length) const
 {
     assert(is_open());
 
+    if (compressed_) {
+        compressed_->read(data, offset_in_file, length);
+        return;
+    }
+
+    if (backend_ == file_backend::positional) {
+        read_bytes(data, offset_in_file * sizeof(surfel), length * sizeof(surfel));
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(read_write_mutex_);
     stream_.seekg(offset_in_file * sizeof(surfel));
     stream_.read(data, length * sizeof(surfel));
@@ -205,5 +419,45 @@ read_data(char *data, const size_t offset_in_file, const size_t length) const
     stream_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 }
 
+void file::
+write_bytes(const char *data, const size_t offset, const size_t bytes)
+{
+#if !WIN32
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t res = ::pwrite(fd_, data + done, bytes - done, off_t(offset + done));
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0) {
+            LOGGER_ERROR("write failed. file: \"" << file_name_ << 
+                                    "\". (offset: " << offset / sizeof(surfel) << 
+                                    ", len: " << bytes / sizeof(surfel) << "). " << strerror(errno));
+            throw std::runtime_error("Failed to write file: " + file_name_);
+        }
+        done += size_t(res);
+    }
+#endif
+}
+
+void file::
+read_bytes(char *data, const size_t offset, const size_t bytes) const
+{
+#if !WIN32
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t res = ::pread(fd_, data + done, bytes - done, off_t(offset + done));
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0) {
+            LOGGER_ERROR("read failed. file: \"" << file_name_ << 
+                                    "\". (offset: " << offset / sizeof(surfel) << 
+                                    ", len: " << bytes / sizeof(surfel) << "). " << strerror(errno));
+            throw std::runtime_error("Failed to read file: " + file_name_);
+        }
+        done += size_t(res);
+    }
+#endif
+}
+
 } } // namespace lamure
 
@@ -14,13 +14,243 @@
 #include <stdexcept>
 #include <tuple>
 #include <memory>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
 
 namespace lamure {
 namespace pre {
 
+namespace {
+
+enum class ply_scalar {
+    int8, uint8, int16, uint16, int32, uint32, float32, float64, invalid
+};
+
+enum class vertex_attribute {
+    x, y, z, nx, ny, nz, red, green, blue, ignored
+};
+
+struct vertex_property {
+    ply_scalar       type;
+    vertex_attribute attribute;
+    size_t           offset;
+};
+
+ply_scalar
+to_ply_scalar(const std::string& name)
+{
+    if (name == "char"   || name == "int8")    return ply_scalar::int8;
+    if (name == "uchar"  || name == "uint8")   return ply_scalar::uint8;
+    if (name == "short"  || name == "int16")   return ply_scalar::int16;
+    if (name == "ushort" || name == "uint16")  return ply_scalar::uint16;
+    if (name == "int"    || name == "int32")   return ply_scalar::int32;
+    if (name == "uint"   || name == "uint32")  return ply_scalar::uint32;
+    if (name == "float"  || name == "float32") return ply_scalar::float32;
+    if (name == "double" || name == "float64") return ply_scalar::float64;
+    return ply_scalar::invalid;
+}
+
+size_t
+size_of(const ply_scalar type)
+{
+    switch (type) {
+        case ply_scalar::int8: case ply_scalar::uint8:     return 1;
+        case ply_scalar::int16: case ply_scalar::uint16:   return 2;
+        case ply_scalar::int32: case ply_scalar::uint32:
+        case ply_scalar::float32:                          return 4;
+        case ply_scalar::float64:                          return 8;
+        default:                                           return 0;
+    }
+}
+
+vertex_attribute
+to_vertex_attribute(const std::string& name)
+{
+    if (name == "x")  return vertex_attribute::x;
+    if (name == "y")  return vertex_attribute::y;
+    if (name == "z")  return vertex_attribute::z;
+    if (name == "nx") return vertex_attribute::nx;
+    if (name == "ny") return vertex_attribute::ny;
+    if (name == "nz") return vertex_attribute::nz;
+    if (name == "red"   || name == "diffuse_red")   return vertex_attribute::red;
+    if (name == "green" || name == "diffuse_green") return vertex_attribute::green;
+    if (name == "blue"  || name == "diffuse_blue")  return vertex_attribute::blue;
+    return vertex_attribute::ignored;
+}
+
+template <typename T>
+inline double
+load(const char* bytes, const bool swap)
+{
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    if (swap)
+        io::ply::swap_byte_order(value);
+    return double(value);
+}
+
+inline double
+decode(const char* bytes, const ply_scalar type, const bool swap)
+{
+    switch (type) {
+        case ply_scalar::int8:    return load<int8_t>(bytes, swap);
+        case ply_scalar::uint8:   return load<uint8_t>(bytes, swap);
+        case ply_scalar::int16:   return load<int16_t>(bytes, swap);
+        case ply_scalar::uint16:  return load<uint16_t>(bytes, swap);
+        case ply_scalar::int32:   return load<int32_t>(bytes, swap);
+        case ply_scalar::uint32:  return load<uint32_t>(bytes, swap);
+        case ply_scalar::float32: return load<float>(bytes, swap);
+        case ply_scalar::float64: return load<double>(bytes, swap);
+        default:                  return 0.0;
+    }
+}
+
+inline uint8_t
+to_color_channel(const double value, const ply_scalar type)
+{
+    // floating point colors are expected in [0, 1]
+    double c = (type == ply_scalar::float32 || type == ply_scalar::float64) ?
+               value * 255.0 : value;
+    return uint8_t(std::min(255.0, std::max(0.0, c)));
+}
+
+}
+
+bool format_ply::
+read_binary_vertices(const std::string& filename, surfel_callback_funtion callback)
+{
+    std::ifstream ply_file_stream(filename, std::ios::in | std::ios::binary);
+
+    if (!ply_file_stream.is_open())
+        throw std::runtime_error("Unable to open file: " + filename);
+
+    std::string line;
+    if (!std::getline(ply_file_stream, line) || line.compare(0, 3, "ply") != 0)
+        return false;
+
+    bool is_binary = false;
+    bool swap = false;
+    bool vertex_first = false;
+    bool in_vertex_element = false;
+    size_t element_index = 0;
+    size_t num_vertices = 0;
+    size_t stride = 0;
+    std::vector<vertex_property> properties;
+
+    while (std::getline(ply_file_stream, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+
+        if (keyword == "format") {
+            std::string format_string;
+            tokens >> format_string;
+            if (format_string == "binary_little_endian") {
+                is_binary = true;
+                swap = (io::ply::host_byte_order != io::ply::little_endian_byte_order);
+            }
+            else if (format_string == "binary_big_endian") {
+                is_binary = true;
+                swap = (io::ply::host_byte_order != io::ply::big_endian_byte_order);
+            }
+        }
+        else if (keyword == "element") {
+            std::string name;
+            size_t count = 0;
+            tokens >> name >> count;
+            in_vertex_element = (name == "vertex");
+            if (in_vertex_element) {
+                vertex_first = (element_index == 0);
+                num_vertices = count;
+            }
+            ++element_index;
+        }
+        else if (keyword == "property" && in_vertex_element) {
+            std::string type_name, name;
+            tokens >> type_name >> name;
+            ply_scalar type = to_ply_scalar(type_name);
+
+            // list properties have no fixed stride
+            if (type == ply_scalar::invalid)
+                return false;
+
+            properties.push_back({type, to_vertex_attribute(name), stride});
+            stride += size_of(type);
+        }
+        else if (keyword == "end_header") {
+            break;
+        }
+    }
+
+    if (!is_binary || !vertex_first || stride == 0 || !ply_file_stream)
+        return false;
+
+    LOGGER_TRACE("Binary PLY fast path. vertices: " << num_vertices <<
+                 ", stride: " << stride << " bytes");
+
+    const size_t vertices_in_block = std::max(size_t(1), size_t(4 * 1024 * 1024) / stride);
+    std::vector<char> block(vertices_in_block * stride);
+
+    size_t num_read = 0;
+    uint8_t percent_processed = 0;
+
+    while (num_read < num_vertices) {
+        const size_t count = std::min(vertices_in_block, num_vertices - num_read);
+        ply_file_stream.read(block.data(), count * stride);
+
+        if (size_t(ply_file_stream.gcount()) != count * stride)
+            throw std::runtime_error("format_ply::read() : Unexpected end of file!");
+
+        for (size_t v = 0; v < count; ++v) {
+            const char* vertex = block.data() + v * stride;
+            surfel s;
+
+            for (const auto& prop : properties) {
+                if (prop.attribute == vertex_attribute::ignored)
+                    continue;
+
+                const double value = decode(vertex + prop.offset, prop.type, swap);
+
+                switch (prop.attribute) {
+                    case vertex_attribute::x:     s.pos().x = value; break;
+                    case vertex_attribute::y:     s.pos().y = value; break;
+                    case vertex_attribute::z:     s.pos().z = value; break;
+                    case vertex_attribute::nx:    s.normal().x = float(value); break;
+                    case vertex_attribute::ny:    s.normal().y = float(value); break;
+                    case vertex_attribute::nz:    s.normal().z = float(value); break;
+                    case vertex_attribute::red:   s.color().x = to_color_channel(value, prop.type); break;
+                    case vertex_attribute::green: s.color().y = to_color_channel(value, prop.type); break;
+                    case vertex_attribute::blue:  s.color().z = to_color_channel(value, prop.type); break;
+                    default: break;
+                }
+            }
+            callback(s);
+        }
+
+        num_read += count;
+
+        uint8_t new_percent_processed = uint8_t(double(num_read) / num_vertices * 100);
+        if (percent_processed != new_percent_processed) {
+            percent_processed = new_percent_processed;
+            std::cout << "\r" << (int)percent_processed << "% processed" << std::flush;
+        }
+    }
+
+    ply_file_stream.close();
+    return true;
+}
+
 void format_ply::
 read(const std::string& filename, surfel_callback_funtion callback)
 {
+    if (read_binary_vertices(filename, callback))
+        return;
+
     using namespace std::placeholders;
     typedef std::tuple<std::function<void()>, std::function<void()>> FuncTuple;
 
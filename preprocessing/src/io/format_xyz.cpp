@@ -6,10 +6,11 @@
 // http://www.uni-weimar.de/medien/vr
 
 #include <lamure/pre/io/format_xyz.h>
+#include <lamure/pre/io/chunked_parser.h>
 
 #include <stdexcept>
 #include <fstream>
-#include <sstream>
+#include <iomanip>
 #include <iostream>
 
 #define DEFAULT_PRECISION 15
@@ -20,46 +21,28 @@ namespace pre {
 void format_xyz::
 read(const std::string& filename, surfel_callback_funtion callback)
 {
-    std::ifstream xyz_file_stream(filename);
-
-    if (!xyz_file_stream.is_open())
-        throw std::runtime_error("Unable to open file: " +
-                                 filename);
-
-    std::string line;
-
-    real pos[3];
-    unsigned int color[3];
-
-    xyz_file_stream.seekg (0, std::ios::end);
-    std::streampos end_pos = xyz_file_stream.tellg();
-    xyz_file_stream.seekg (0, std::ios::beg);
-    uint8_t percent_processed = 0;
-
-    while (getline(xyz_file_stream, line)) {
-
-        uint8_t new_percent_processed = (xyz_file_stream.tellg()/float(end_pos)) * 100;
-        if (percent_processed + 1 == new_percent_processed) {
-            percent_processed = new_percent_processed;
-            std::cout << "\r" << (int)percent_processed << "% processed" << std::flush;
+    // x y z [r g b]
+    auto parse_line = [](const char* first, const char* last, surfel& s) {
+        real pos[3];
+        real color[3] = {0.0, 0.0, 0.0};
+
+        for (int i = 0; i < 3; ++i) {
+            first = text::parse_real(first, last, pos[i]);
+            if (!first)
+                return false;
+        }
+        for (int i = 0; i < 3 && first; ++i) {
+            first = text::parse_real(first, last, color[i]);
         }
 
-        std::stringstream sstream;
-
-        sstream << line;
-
-        sstream >> pos[0];
-        sstream >> pos[1];
-        sstream >> pos[2];
-        sstream >> color[0];
-        sstream >> color[1];
-        sstream >> color[2];
-
-        callback(surfel(vec3r(pos[0], pos[1], pos[2]),
-                        vec3b(color[0], color[1], color[2])));
-    }
+        s = surfel(vec3r(pos[0], pos[1], pos[2]),
+                   vec3b(text::to_color_channel(color[0]),
+                         text::to_color_channel(color[1]),
+                         text::to_color_channel(color[2])));
+        return true;
+    };
 
-    xyz_file_stream.close();
+    parse_lines_parallel(filename, parse_line, callback, buffer_size_);
 }
 
 void format_xyz::
@@ -6,11 +6,9 @@
 // http://www.uni-weimar.de/medien/vr
 
 #include <lamure/pre/io/format_xyz_all.h>
+#include <lamure/pre/io/chunked_parser.h>
 
 #include <stdexcept>
-#include <iostream>
-#include <fstream>
-#include <sstream>
 
 namespace lamure {
 namespace pre {
@@ -18,54 +16,29 @@ namespace pre {
 void format_xyzall::
 read(const std::string& filename, surfel_callback_funtion callback)
 {
-    std::ifstream xyz_file_stream(filename);
-
-    if (!xyz_file_stream.is_open())
-        throw std::runtime_error("Unable to open input file: " +
-                                 filename);
-
-    std::string line;
-
-    real pos[3];
-    float norm[3];
-    unsigned int color[3];
-    real radius;
-
-    xyz_file_stream.seekg (0, std::ios::end);
-    std::streampos end_pos = xyz_file_stream.tellg();
-    xyz_file_stream.seekg (0, std::ios::beg);
-    uint8_t percent_processed = 0;
-
-    while (getline(xyz_file_stream, line)) {
-
-        uint8_t new_percent_processed = (xyz_file_stream.tellg()/float(end_pos)) * 100;
-        if (percent_processed + 1 == new_percent_processed) {
-            percent_processed = new_percent_processed;
-            std::cout << "\r" << (int)percent_processed << "% processed" << std::flush;
+    // x y z nx ny nz r g b radius
+    auto parse_line = [](const char* first, const char* last, surfel& s) {
+        real values[10] = {0.0};
+
+        for (int i = 0; i < 3; ++i) {
+            first = text::parse_real(first, last, values[i]);
+            if (!first)
+                return false;
+        }
+        for (int i = 3; i < 10 && first; ++i) {
+            first = text::parse_real(first, last, values[i]);
         }
 
-        std::stringstream sstream;
-
-        sstream << line;
-
-        sstream >> pos[0];
-        sstream >> pos[1];
-        sstream >> pos[2];
-        sstream >> norm[0];
-        sstream >> norm[1];
-        sstream >> norm[2];
-        sstream >> color[0];
-        sstream >> color[1];
-        sstream >> color[2];
-        sstream >> radius;
-
-        callback(surfel(vec3r(pos[0], pos[1], pos[2]),
-                        vec3b(color[0], color[1], color[2]),
-                        radius,
-                        vec3f(norm[0], norm[1], norm[2])));
-    }
+        s = surfel(vec3r(values[0], values[1], values[2]),
+                   vec3b(text::to_color_channel(values[6]),
+                         text::to_color_channel(values[7]),
+                         text::to_color_channel(values[8])),
+                   values[9],
+                   vec3f(values[3], values[4], values[5]));
+        return true;
+    };
 
-    xyz_file_stream.close();
+    parse_lines_parallel(filename, parse_line, callback, buffer_size_);
 }
 
 void format_xyzall::
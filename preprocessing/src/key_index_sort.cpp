@@ -0,0 +1,337 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/key_index_sort.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace lamure {
+namespace pre
+{
+
+const size_t      RADIX_BITS = 11;
+const size_t      RADIX_BUCKETS = 1u << RADIX_BITS;
+const size_t      RADIX_PASSES = (64 + RADIX_BITS - 1) / RADIX_BITS;
+const size_t      MIN_PARALLEL_LENGTH = 1u << 16;
+const std::string TEMP_FILE_EXT = ".keys";
+
+uint64_t key_index_sort::
+to_key(const real value)
+{
+    // flip the sign bit of positive numbers and all bits of negative
+    // numbers, so that the unsigned order matches the floating point order
+    const double v = value;
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return (bits & (uint64_t(1) << 63)) ? ~bits : bits | (uint64_t(1) << 63);
+}
+
+key_index_sort::key_function key_index_sort::
+axis_key(const uint8_t axis)
+{
+    assert(axis <= 2);
+    return [axis](const surfel& s) { return to_key(s.pos()[axis]); };
+}
+
+// spreads the lower 21 bits of v so that there are two zero bits between each
+static uint64_t
+spread_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffff;
+    v = (v | v << 16) & 0x1f0000ff0000ff;
+    v = (v | v << 8)  & 0x100f00f00f00f00f;
+    v = (v | v << 4)  & 0x10c30c30c30c30c3;
+    v = (v | v << 2)  & 0x1249249249249249;
+    return v;
+}
+
+key_index_sort::key_function key_index_sort::
+morton_key(const bounding_box& box)
+{
+    assert(box.is_valid());
+
+    const vec3r min = box.min();
+    const vec3r extent = box.max() - box.min();
+    const real max_extent = std::max(extent.x, std::max(extent.y, extent.z));
+    const real max_cell = real((1u << 21) - 1);
+    const real scale = max_extent > 0.0 ? max_cell / max_extent : 0.0;
+
+    return [min, scale, max_cell](const surfel& s) {
+        const vec3r p = s.pos();
+        const uint64_t x = uint64_t(std::min(std::max((p.x - min.x) * scale, 0.0), max_cell));
+        const uint64_t y = uint64_t(std::min(std::max((p.y - min.y) * scale, 0.0), max_cell));
+        const uint64_t z = uint64_t(std::min(std::max((p.z - min.z) * scale, 0.0), max_cell));
+        return spread_bits(x) | spread_bits(y) << 1 | spread_bits(z) << 2;
+    };
+}
+
+void key_index_sort::
+sort_entries(std::vector<entry>& entries,
+             const bool parallelize)
+{
+    const size_t length = entries.size();
+    const size_t num_blocks = (parallelize && length >= MIN_PARALLEL_LENGTH) ?
+        std::max(1u, std::thread::hardware_concurrency()) : 1;
+    sort_entries_in_blocks(entries, num_blocks);
+}
+
+void key_index_sort::
+sort_entries_in_blocks(std::vector<entry>& entries,
+                       const size_t num_blocks)
+{
+    assert(num_blocks >= 1);
+
+    const size_t length = entries.size();
+    if (length < 2)
+        return;
+
+    // totals of all digits are gathered in a single pass, they only
+    // decide which passes can be skipped
+    std::vector<size_t> totals(RADIX_PASSES * RADIX_BUCKETS, 0);
+    {
+        std::vector<size_t> block_totals(num_blocks * totals.size(), 0);
+
+        #pragma omp parallel for if (num_blocks > 1)
+        for (size_t b = 0; b < num_blocks; ++b) {
+            size_t* histogram = &block_totals[b * totals.size()];
+            const size_t last = length * (b + 1) / num_blocks;
+            for (size_t i = length * b / num_blocks; i < last; ++i) {
+                const uint64_t key = entries[i].key;
+                for (size_t pass = 0; pass < RADIX_PASSES; ++pass)
+                    ++histogram[pass * RADIX_BUCKETS + ((key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1))];
+            }
+        }
+
+        for (size_t b = 0; b < num_blocks; ++b)
+            for (size_t d = 0; d < totals.size(); ++d)
+                totals[d] += block_totals[b * totals.size() + d];
+    }
+
+    // per-block counts of the current digit, laid out as [block][digit]
+    std::vector<size_t> histograms(num_blocks * RADIX_BUCKETS);
+
+    std::vector<entry> temp(length);
+    entry* source = entries.data();
+    entry* target = temp.data();
+
+    for (size_t pass = 0; pass < RADIX_PASSES; ++pass) {
+        const size_t shift = pass * RADIX_BITS;
+
+        // skip digits that are the same for all keys
+        const size_t first_digit = (source[0].key >> shift) & (RADIX_BUCKETS - 1);
+        if (totals[pass * RADIX_BUCKETS + first_digit] == length)
+            continue;
+
+        // the blocks are ranges of the current order, which every pass changes
+        std::fill(histograms.begin(), histograms.end(), 0);
+
+        #pragma omp parallel for if (num_blocks > 1)
+        for (size_t b = 0; b < num_blocks; ++b) {
+            size_t* histogram = &histograms[b * RADIX_BUCKETS];
+            const size_t last = length * (b + 1) / num_blocks;
+            for (size_t i = length * b / num_blocks; i < last; ++i)
+                ++histogram[(source[i].key >> shift) & (RADIX_BUCKETS - 1)];
+        }
+
+        // turn counts into scatter positions, digit-major so the sort is stable
+        size_t sum = 0;
+        for (size_t d = 0; d < RADIX_BUCKETS; ++d) {
+            for (size_t b = 0; b < num_blocks; ++b) {
+                size_t& count = histograms[b * RADIX_BUCKETS + d];
+                const size_t c = count;
+                count = sum;
+                sum += c;
+            }
+        }
+
+        #pragma omp parallel for if (num_blocks > 1)
+        for (size_t b = 0; b < num_blocks; ++b) {
+            size_t* positions = &histograms[b * RADIX_BUCKETS];
+            const size_t last = length * (b + 1) / num_blocks;
+            for (size_t i = length * b / num_blocks; i < last; ++i)
+                target[positions[(source[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = source[i];
+        }
+
+        std::swap(source, target);
+    }
+
+    if (source != entries.data())
+        entries.swap(temp);
+}
+
+void key_index_sort::
+apply_permutation(surfel_vector& data,
+                  const size_t offset,
+                  const std::vector<entry>& entries,
+                  const bool parallelize)
+{
+    const size_t length = entries.size();
+    surfel_vector sorted(length);
+
+    #pragma omp parallel for if (parallelize)
+    for (size_t i = 0; i < length; ++i)
+        sorted[i] = data[offset + entries[i].index];
+
+    if (offset == 0 && length == data.size())
+        data.swap(sorted);
+    else
+        std::copy(sorted.begin(), sorted.end(), data.begin() + offset);
+}
+
+void key_index_sort::
+sort(surfel_mem_array& array,
+     const key_function& key,
+     const bool parallelize)
+{
+    assert(!array.is_empty());
+    assert(array.length() <= std::numeric_limits<uint32_t>::max());
+
+    const size_t length = array.length();
+    if (length < 2)
+        return;
+
+    surfel_vector& data = *array.mem_data();
+    const size_t offset = array.offset();
+
+    std::vector<entry> entries(length);
+
+    #pragma omp parallel for if (parallelize)
+    for (size_t i = 0; i < length; ++i) {
+        entries[i].key = key(data[offset + i]);
+        entries[i].index = uint32_t(i);
+    }
+
+    sort_entries(entries, parallelize);
+    apply_permutation(data, offset, entries, parallelize);
+}
+
+bool key_index_sort::
+sort(surfel_disk_array& array,
+     const key_function& key,
+     const size_t memory_limit)
+{
+    assert(!array.is_empty());
+    assert(array.file());
+    assert(array.length() <= std::numeric_limits<uint32_t>::max());
+
+    const size_t length = array.length();
+    if (length < 2)
+        return true;
+
+    // entries and the radix sort buffer have to fit at once
+    if (length * sizeof(entry) * 2u > memory_limit)
+        return false;
+
+    const size_t bucket_length = std::max(size_t(1), memory_limit / sizeof(surfel) / 3u);
+
+    if (length <= bucket_length) {
+        // the whole array fits, sort it in memory
+        shared_surfel_vector data = array.read_all();
+        surfel_mem_array mem_array(data, 0, length);
+        sort(mem_array, key, true);
+        array.write_all(data, 0);
+        return true;
+    }
+
+    LOGGER_INFO("Key-index sort. Length: " << length);
+
+    // extract keys
+    std::vector<entry> entries(length);
+    surfel_vector block(bucket_length);
+
+    for (size_t first = 0; first < length; first += bucket_length) {
+        const size_t block_length = std::min(bucket_length, length - first);
+        array.file()->read(&block, 0, array.offset() + first, block_length);
+
+        #pragma omp parallel for
+        for (size_t i = 0; i < block_length; ++i) {
+            entries[first + i].key = key(block[i]);
+            entries[first + i].index = uint32_t(first + i);
+        }
+    }
+
+    sort_entries(entries, true);
+
+    std::vector<uint32_t> ranks(length);
+    for (size_t r = 0; r < length; ++r)
+        ranks[entries[r].index] = uint32_t(r);
+    std::vector<entry>().swap(entries);
+
+    // distribute the surfels into buckets of consecutive ranks. Each bucket
+    // occupies its final range in a temporary file, so that the source
+    // range can be overwritten afterwards
+    const size_t buckets_count = (length + bucket_length - 1) / bucket_length;
+    const size_t staging_length = std::max(size_t(1), bucket_length / buckets_count);
+
+    shared_file buckets_file = std::make_shared<file>(file::default_backend(),
+                                                      file_compression::none);
+    buckets_file->open(array.file()->file_name() + TEMP_FILE_EXT, true);
+
+    std::vector<surfel_vector> staging(buckets_count);
+    std::vector<std::vector<uint32_t>> local_ranks(buckets_count);
+    std::vector<size_t> written(buckets_count, 0);
+
+    for (size_t b = 0; b < buckets_count; ++b) {
+        staging[b].reserve(staging_length);
+        local_ranks[b].reserve(std::min(bucket_length, length - b * bucket_length));
+    }
+
+    auto flush = [&](const size_t b) {
+        if (staging[b].empty())
+            return;
+        buckets_file->write(&staging[b], 0, b * bucket_length + written[b], staging[b].size());
+        written[b] += staging[b].size();
+        staging[b].clear();
+    };
+
+    for (size_t first = 0; first < length; first += bucket_length) {
+        const size_t block_length = std::min(bucket_length, length - first);
+        array.file()->read(&block, 0, array.offset() + first, block_length);
+
+        for (size_t i = 0; i < block_length; ++i) {
+            const size_t rank = ranks[first + i];
+            const size_t b = rank / bucket_length;
+            staging[b].push_back(block[i]);
+            local_ranks[b].push_back(uint32_t(rank - b * bucket_length));
+            if (staging[b].size() >= staging_length)
+                flush(b);
+        }
+    }
+    for (size_t b = 0; b < buckets_count; ++b)
+        flush(b);
+
+    std::vector<uint32_t>().swap(ranks);
+    std::vector<surfel_vector>().swap(staging);
+
+    // place the surfels of every bucket and write it back
+    surfel_vector sorted(bucket_length);
+
+    for (size_t b = 0; b < buckets_count; ++b) {
+        const size_t first = b * bucket_length;
+        const size_t current_length = std::min(bucket_length, length - first);
+        assert(written[b] == current_length);
+
+        buckets_file->read(&block, 0, first, current_length);
+
+        const std::vector<uint32_t>& bucket_ranks = local_ranks[b];
+        #pragma omp parallel for
+        for (size_t i = 0; i < current_length; ++i)
+            sorted[bucket_ranks[i]] = block[i];
+
+        array.file()->write(&sorted, 0, array.offset() + first, current_length);
+        std::vector<uint32_t>().swap(local_ranks[b]);
+    }
+
+    buckets_file->close(true);
+    return true;
+}
+
+} } // namespace lamure
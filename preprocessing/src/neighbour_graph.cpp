@@ -0,0 +1,71 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/neighbour_graph.h>
+
+#include <cassert>
+
+namespace lamure {
+namespace pre
+{
+
+neighbour_graph::
+neighbour_graph(const node_id_type first_node)
+    : first_node_(first_node),
+      node_offsets_(1, 0),
+      row_offsets_(1, 0)
+{
+}
+
+size_t neighbour_graph::
+num_surfels(const node_id_type node_idx) const
+{
+    assert(node_idx >= first_node_ && node_idx < last_node());
+    const size_t local_node = node_idx - first_node_;
+    return node_offsets_[local_node + 1] - node_offsets_[local_node];
+}
+
+neighbour_graph::row neighbour_graph::
+neighbours(const surfel_id_t& surfel) const
+{
+    assert(surfel.surfel_idx < num_surfels(surfel.node_idx));
+    const size_t row_idx = node_offsets_[surfel.node_idx - first_node_] + surfel.surfel_idx;
+    const neighbour* data = neighbours_.data();
+    return row(data + row_offsets_[row_idx], data + row_offsets_[row_idx + 1]);
+}
+
+void neighbour_graph::
+begin_node()
+{
+    node_offsets_.push_back(node_offsets_.back());
+}
+
+void neighbour_graph::
+add_row(const std::vector<neighbour>& sorted_neighbours)
+{
+    assert(node_offsets_.size() > 1);
+    neighbours_.insert(neighbours_.end(), sorted_neighbours.begin(), sorted_neighbours.end());
+    row_offsets_.push_back(neighbours_.size());
+    ++node_offsets_.back();
+}
+
+void neighbour_graph::
+append(const neighbour_graph& other)
+{
+    assert(other.first_node_ == last_node());
+
+    const size_t row_base = node_offsets_.back();
+    const size_t neighbour_base = neighbours_.size();
+
+    for (size_t i = 1; i < other.node_offsets_.size(); ++i)
+        node_offsets_.push_back(row_base + other.node_offsets_[i]);
+    for (size_t i = 1; i < other.row_offsets_.size(); ++i)
+        row_offsets_.push_back(neighbour_base + other.row_offsets_[i]);
+    neighbours_.insert(neighbours_.end(), other.neighbours_.begin(), other.neighbours_.end());
+}
+
+} } // namespace lamure
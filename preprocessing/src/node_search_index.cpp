@@ -0,0 +1,193 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/node_search_index.h>
+
+#include <algorithm>
+
+namespace lamure {
+namespace pre
+{
+
+// ranges of at most this many surfels are scanned linearly
+const uint32_t LEAF_SIZE = 8;
+
+static bool
+closer(const node_search_index::neighbour& left,
+       const node_search_index::neighbour& right)
+{
+    return left.second < right.second;
+}
+
+real node_search_index::candidates::
+max_distance() const
+{
+    if (k_ == 0)
+        return -std::numeric_limits<real>::infinity();
+    if (heap_.size() < k_)
+        return std::numeric_limits<real>::infinity();
+    return heap_.front().second;
+}
+
+void node_search_index::candidates::
+insert(const surfel_id_t& id, const real distance)
+{
+    if (heap_.size() < k_) {
+        heap_.emplace_back(id, distance);
+        std::push_heap(heap_.begin(), heap_.end(), closer);
+    }
+    else if (k_ > 0 && distance < heap_.front().second) {
+        std::pop_heap(heap_.begin(), heap_.end(), closer);
+        heap_.back() = neighbour(id, distance);
+        std::push_heap(heap_.begin(), heap_.end(), closer);
+    }
+}
+
+std::vector<node_search_index::neighbour> node_search_index::candidates::
+sorted()
+{
+    std::sort_heap(heap_.begin(), heap_.end(), closer);
+    return std::move(heap_);
+}
+
+node_search_index::
+node_search_index(const surfel_mem_array& array)
+    : mem_data_(array.mem_data().get()),
+      offset_(array.offset()),
+      length_(array.length())
+{
+    assert(length_ <= std::numeric_limits<uint32_t>::max());
+
+    order_.resize(length_);
+    axes_.resize(length_, 0);
+    for (uint32_t i = 0; i < length_; ++i)
+        order_[i] = i;
+
+    if (length_ > 0)
+        build(mem_data_->data() + offset_, 0, uint32_t(length_));
+}
+
+bool node_search_index::
+matches(const surfel_mem_array& array) const
+{
+    return array.mem_data().get() == mem_data_ &&
+           array.offset() == offset_ &&
+           array.length() == length_;
+}
+
+void node_search_index::
+build(const surfel* data,
+      const uint32_t begin,
+      const uint32_t end)
+{
+    if (end - begin <= LEAF_SIZE)
+        return;
+
+    // split along the longest axis of the range
+    vec3r min = data[order_[begin]].pos();
+    vec3r max = min;
+    for (uint32_t i = begin + 1; i < end; ++i) {
+        const vec3r& p = data[order_[i]].pos();
+        for (uint8_t axis = 0; axis < 3; ++axis) {
+            min[axis] = std::min(min[axis], p[axis]);
+            max[axis] = std::max(max[axis], p[axis]);
+        }
+    }
+
+    const vec3r extent = max - min;
+    uint8_t axis = 0;
+    if (extent[1] > extent[axis]) axis = 1;
+    if (extent[2] > extent[axis]) axis = 2;
+
+    const uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+        [data, axis](const uint32_t left, const uint32_t right) {
+            return data[left].pos()[axis] < data[right].pos()[axis];
+        });
+    axes_[mid] = axis;
+
+    build(data, begin, mid);
+    build(data, mid + 1, end);
+}
+
+void node_search_index::
+search(const surfel_mem_array& array,
+       const node_id_type node_idx,
+       const vec3r& center,
+       const size_t excluded_surfel_idx,
+       candidates& result) const
+{
+    assert(matches(array));
+
+    if (length_ > 0)
+        search(mem_data_->data() + offset_, 0, uint32_t(length_),
+               node_idx, center, excluded_surfel_idx, result);
+}
+
+void node_search_index::
+search(const surfel* data,
+       const uint32_t begin,
+       const uint32_t end,
+       const node_id_type node_idx,
+       const vec3r& center,
+       const size_t excluded_surfel_idx,
+       candidates& result) const
+{
+    if (end - begin <= LEAF_SIZE) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const uint32_t surfel_idx = order_[i];
+            if (surfel_idx == excluded_surfel_idx)
+                continue;
+            const real distance = scm::math::length_sqr(center - data[surfel_idx].pos());
+            if (distance < result.max_distance())
+                result.insert(surfel_id_t(node_idx, surfel_idx), distance);
+        }
+        return;
+    }
+
+    const uint32_t mid = begin + (end - begin) / 2;
+    const uint32_t surfel_idx = order_[mid];
+    const vec3r& split = data[surfel_idx].pos();
+
+    if (surfel_idx != excluded_surfel_idx) {
+        const real distance = scm::math::length_sqr(center - split);
+        if (distance < result.max_distance())
+            result.insert(surfel_id_t(node_idx, surfel_idx), distance);
+    }
+
+    // descend into the side of the query first, the other side only if
+    // it may contain closer surfels
+    const real offset = center[axes_[mid]] - split[axes_[mid]];
+    if (offset < 0.0) {
+        search(data, begin, mid, node_idx, center, excluded_surfel_idx, result);
+        if (offset * offset < result.max_distance())
+            search(data, mid + 1, end, node_idx, center, excluded_surfel_idx, result);
+    }
+    else {
+        search(data, mid + 1, end, node_idx, center, excluded_surfel_idx, result);
+        if (offset * offset < result.max_distance())
+            search(data, begin, mid, node_idx, center, excluded_surfel_idx, result);
+    }
+}
+
+void node_search_index::
+search_linear(const surfel_mem_array& array,
+              const node_id_type node_idx,
+              const vec3r& center,
+              const size_t excluded_surfel_idx,
+              candidates& result)
+{
+    for (size_t i = 0; i < array.length(); ++i) {
+        if (i == excluded_surfel_idx)
+            continue;
+        const real distance = scm::math::length_sqr(center - array.read_surfel_ref(i).pos());
+        if (distance < result.max_distance())
+            result.insert(surfel_id_t(node_idx, i), distance);
+    }
+}
+
+} } // namespace lamure
@@ -8,7 +8,11 @@
 #include <lamure/pre/node_serializer.h>
 
 #include <lamure/pre/serialized_surfel.h>
+
+#include <algorithm>
 #include <cstring>
+#include <future>
+#include <map>
 
 namespace lamure {
 namespace pre
@@ -16,8 +20,12 @@ namespace pre
 
 node_serializer::
 node_serializer(const size_t surfels_per_node, 
-               const size_t buffer_size)
-    : surfels_per_node_(surfels_per_node)
+               const size_t buffer_size,
+               const surfel_encoding encoding,
+               const node_layout layout)
+    : surfels_per_node_(surfels_per_node),
+      encoding_(encoding),
+      layout_(layout)
 {
     max_nodes_in_buffer_ = buffer_size / sizeof(surfel) / surfels_per_node;
 }
@@ -35,7 +43,8 @@ void node_serializer::
 open(const std::string& file_name, const bool read_write_mode)
 {
     file_name_ = file_name;
-    buffer_.clear();
+    node_extents_.clear();
+    end_of_file_ = 0;
 
     if (read_write_mode)
         stream_.open(file_name, std::ios::in |std::ios::out | std::ios::binary);
@@ -54,8 +63,6 @@ void node_serializer::
 close()
 {
     if (is_open()) {
-        flush_buffer();
-        buffer_.clear();
         stream_.close();
         if (stream_.fail()) {
             LOGGER_ERROR("Failed to close file: \"" << file_name_ << 
@@ -119,67 +126,131 @@ write_node_immediate(const surfel_vector& surfels,
 }
 
 void node_serializer::
-serialize_nodes(const std::vector<bvh_node>& nodes)
-{
-    for (const auto& n: nodes)
-        write_node_streamed(n);
-}
-
-void node_serializer::
-write_node_streamed(const bvh_node& node)
+serialize_nodes(const std::vector<bvh_node>& nodes,
+                const std::vector<node_id_type>& order)
 {
     assert(max_nodes_in_buffer_ != 0);
     assert(is_open());
-    assert(node.is_out_of_core());
+    assert(order.empty() || order.size() == nodes.size());
 
-    const size_t read_length = (node.disk_array().length() > surfels_per_node_)? 
-                               surfels_per_node_ : 
-                               node.disk_array().length();
-    
-    surfel_vector* surfel_buffer = new surfel_vector(read_length);
-    node.disk_array().file()->read(surfel_buffer, 0, 
-                                   node.disk_array().offset(), 
-                                   read_length);
-    buffer_.push_back(surfel_buffer);
-
-    if (buffer_.size() >= max_nodes_in_buffer_)
-        flush_buffer();
-}
+    auto node_at = [&](const size_t i) -> const bvh_node& {
+        return order.empty() ? nodes[i] : nodes[order[i]];
+    };
 
-void node_serializer::
-flush_buffer()
-{
-    if (buffer_.size()) {
-        const size_t output_buffer_size = serialized_surfel::get_size() * surfels_per_node_ * buffer_.size();
-        char* output_buffer = new char[output_buffer_size];
-
-        LOGGER_ERROR("Flush buffer to disk. buffer size: " << 
-                                buffer_.size() << " nodes (" << 
-                                output_buffer_size / 1024 / 1024 << " MiB)");
-
-        #pragma omp parallel for
-        for (size_t k = 0; k < buffer_.size(); ++k) {
-            for (size_t i = 0; i < surfels_per_node_; ++i) {
-                char* buf = output_buffer + k * serialized_surfel::get_size() * surfels_per_node_ + 
-                            i * serialized_surfel::get_size();
-                if (i < buffer_[k]->size())
-                    serialized_surfel(buffer_[k]->at(i)).serialize(buf);
-                else
-                    serialized_surfel().serialize(buf);
-            }
-            delete buffer_[k];
+    // the extents follow from the disk arrays, so every node's place in
+    // the file is known before anything is read
+    std::vector<lod_node_extent> extents(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const bvh_node& node = node_at(i);
+        assert(node.is_out_of_core());
+        const uint64_t read_length = std::min<uint64_t>(node.disk_array().length(), surfels_per_node_);
+        const uint64_t length = (layout_ == node_layout::fixed) ? surfels_per_node_ : read_length;
+        extents[i] = lod_node_extent{end_of_file_, length};
+        end_of_file_ += length;
+        if (node_extents_.size() <= node.node_id())
+            node_extents_.resize(node.node_id() + 1, lod_node_extent{0, 0});
+        node_extents_[node.node_id()] = extents[i];
+    }
+
+    // the nodes are read by all threads at once. the stream backend
+    // serializes every access, so such files are read through a positional
+    // instance of their own. compressed files decode in parallel anyway
+    std::map<const file*, shared_file> input_files;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const shared_file& input = node_at(i).disk_array().file();
+        if (input_files.count(input.get()))
+            continue;
+
+        shared_file reader = input;
+#if !WIN32
+        if (input->backend() == file_backend::stream && !input->is_compressed()) {
+            input->flush();
+            reader = std::make_shared<file>(file_backend::positional);
+            reader->open(input->file_name());
         }
+#endif
+        input_files[input.get()] = reader;
+    }
+
+    // a batch is written in the background while the next one is read
+    // and converted; both buffers are reused for all batches
+    const size_t surfel_size = surfel_codec::encoded_size(encoding_);
+    std::vector<char> output, output_in_flight;
+    std::future<void> pending_write;
+
+    auto write_output = [&]() {
+        if (pending_write.valid())
+            pending_write.get();
+        std::swap(output, output_in_flight);
+        pending_write = std::async(std::launch::async, [this, &output_in_flight]() {
+            write_bytes(output_in_flight.data(), output_in_flight.size());
+        });
+    };
+
+    for (size_t first = 0; first < nodes.size(); first += max_nodes_in_buffer_) {
+        const size_t last = std::min(first + max_nodes_in_buffer_, nodes.size());
+        const uint64_t batch_offset = extents[first].offset;
+        const uint64_t batch_end = extents[last - 1].offset + extents[last - 1].length;
+        output.resize((batch_end - batch_offset) * surfel_size);
 
-        stream_.seekp(0, stream_.end);
-        stream_.write(output_buffer, output_buffer_size);
-        if (stream_.fail() || stream_.bad()) {
-            LOGGER_ERROR("write failed. file: \"" << file_name_ << 
-                                    "\". " << strerror(errno));
+        LOGGER_TRACE("Serialize batch of " << last - first << " nodes (" <<
+                     output.size() / 1024 / 1024 << " MiB)");
+
+        #pragma omp parallel
+        {
+            surfel_vector surfels(surfels_per_node_);
+
+            // encoded nodes are serialized raw first, then converted
+            std::vector<char> raw_node;
+            if (encoding_ != surfel_encoding::raw)
+                raw_node.resize(serialized_surfel::get_size() * surfels_per_node_);
+
+            #pragma omp for schedule(dynamic)
+            for (size_t k = first; k < last; ++k) {
+                const bvh_node& node = node_at(k);
+                const lod_node_extent& extent = extents[k];
+                const size_t read_length = std::min(node.disk_array().length(), surfels_per_node_);
+                if (read_length > 0) {
+                    input_files.at(node.disk_array().file().get())->read(&surfels, 0,
+                                                                         node.disk_array().offset(),
+                                                                         read_length);
+                }
+
+                char* node_out = output.data() + (extent.offset - batch_offset) * surfel_size;
+                char* node_buf = raw_node.empty() ? node_out : raw_node.data();
+                for (size_t i = 0; i < extent.length; ++i) {
+                    char* buf = node_buf + i * serialized_surfel::get_size();
+                    if (i < read_length)
+                        serialized_surfel(surfels[i]).serialize(buf);
+                    else
+                        serialized_surfel().serialize(buf);
+                }
+                if (!raw_node.empty()) {
+                    const bounding_box& box = node.get_bounding_box();
+                    surfel_codec::encode_node(node_buf, node_out,
+                                              extent.length, encoding_,
+                                              vec3f(box.min()), vec3f(box.max()));
+                }
+            }
         }
-        buffer_.clear();
-        delete[] output_buffer;
-        stream_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+        write_output();
+    }
+
+    if (pending_write.valid())
+        pending_write.get();
+}
+
+void node_serializer::
+write_bytes(const char* data, const size_t bytes)
+{
+    stream_.seekp(0, stream_.end);
+    stream_.write(data, bytes);
+    if (stream_.fail() || stream_.bad()) {
+        LOGGER_ERROR("write failed. file: \"" << file_name_ << 
+                                "\". " << strerror(errno));
     }
+    stream_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 }
 
 } } // namespace lamure
@@ -0,0 +1,33 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group 
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/bvh.h>
+#include <lamure/pre/normal_computation_strategy.h>
+
+namespace lamure {
+namespace pre {
+
+void normal_computation_strategy::
+compute_normals(const bvh& tree,
+                const neighbour_graph& graph,
+                const node_id_type node_idx,
+                std::vector<vec3f>& normals) const {
+
+    const size_t num_surfels = graph.num_surfels(node_idx);
+    normals.resize(num_surfels);
+
+    std::vector<std::pair<surfel_id_t, real>> nearest_neighbours;
+    for (size_t surfel_idx = 0; surfel_idx < num_surfels; ++surfel_idx) {
+        const surfel_id_t target_surfel(node_idx, surfel_idx);
+        const neighbour_graph::row neighbours = graph.neighbours(target_surfel);
+        nearest_neighbours.assign(neighbours.begin(), neighbours.end());
+        normals[surfel_idx] = compute_normal(tree, target_surfel, nearest_neighbours);
+    }
+}
+
+} // namespace pre
+} // namespace lamure
@@ -6,14 +6,13 @@
 // http://www.uni-weimar.de/medien/vr
 
 #include <lamure/pre/reduction_entropy.h>
+#include <lamure/pre/indexed_heap.h>
 
 //#include <math.h>
-#include <functional>
-#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <vector>
-#include <queue>
-#include <map>
-#include <set>
 
 namespace lamure {
 namespace pre {
@@ -28,13 +27,15 @@ create_lod(real& reduction_error,
     //create output array
     surfel_mem_array mem_array(std::make_shared<surfel_vector>(surfel_vector()), 0, 0);
 
-    //container for all input surfels including entropy (entropy_surfel_array = ESA)
-    shared_entropy_surfel_vector entropy_surfel_array;
-    //priority queue as vector with min entropy surfels at the back
-    shared_entropy_surfel_vector min_entropy_surfel_ptr_queue;
+    //container for all input surfels including entropy (entropy_surfel_array = ESA),
+    //all other containers refer to its elements by index
+    entropy_surfel_vector entropy_surfel_array;
 
-    //final surfels
-    shared_entropy_surfel_vector finalized_surfels;
+    size_t num_input_surfels = 0;
+    for (auto const& node_array : input) {
+        num_input_surfels += node_array->length();
+    }
+    entropy_surfel_array.reserve(num_input_surfels);
 
     // wrap all surfels of the input array to entropy_surfels and push them in the ESA
     for (size_t node_id = 0; node_id < input.size(); ++node_id) {
@@ -43,110 +44,92 @@ create_lod(real& reduction_error,
                     ++surfel_id){
             
             //this surfel will be referenced in the entropy surfel
-            auto current_surfel = input[node_id]->mem_data()->at(input[node_id]->offset() + surfel_id);
+            auto const& current_surfel = input[node_id]->mem_data()->at(input[node_id]->offset() + surfel_id);
             
             // ignore outlier radii of any kind
             if (current_surfel.radius() == 0.0) {
                 continue;
             } 
-            //create new entropy surfel
-            entropy_surfel current_entropy_surfel(current_surfel, surfel_id, node_id);
 
-        // only place where shared pointers should be created
-        entropy_surfel_array.push_back( std::make_shared<entropy_surfel>(current_entropy_surfel) );
+            entropy_surfel_array.emplace_back(current_surfel, surfel_id, node_id);
        }
     }   
 
-    // iterate all wrapped surfels 
-    for ( auto& current_entropy_surfel_ptr : entropy_surfel_array ){
+    entropy_surfel_grid surfel_grid(entropy_surfel_array);
+    compute_overlapping_neighbours(entropy_surfel_array, surfel_grid);
+
+    //priority queue with the min entropy surfel on top
+    indexed_heap<min_entropy_first> min_entropy_surfel_queue(entropy_surfel_array.size(),
+                                                             min_entropy_first(entropy_surfel_array));
 
-        shared_entropy_surfel_vector overlapping_neighbour_ptrs 
-            = get_locally_overlapping_neighbours(current_entropy_surfel_ptr, entropy_surfel_array);
+    //final surfels
+    std::vector<uint32_t> finalized_surfels;
+
+    // iterate all wrapped surfels 
+    for (uint32_t en_surfel_id = 0; en_surfel_id < entropy_surfel_array.size(); ++en_surfel_id) {
+        entropy_surfel& current_entropy_surfel = entropy_surfel_array[en_surfel_id];
 
-        //assign/compute missing attributes
-        current_entropy_surfel_ptr->neighbours = overlapping_neighbour_ptrs;
-        update_entropy( current_entropy_surfel_ptr, overlapping_neighbour_ptrs);
+        update_entropy(current_entropy_surfel, entropy_surfel_array);
 
-        //if overlapping neighbours were found, put the entropy surfel back into the priority_queue
-        if( !overlapping_neighbour_ptrs.empty() ) {
-            min_entropy_surfel_ptr_queue.push_back( current_entropy_surfel_ptr );
+        //if overlapping neighbours were found, put the entropy surfel into the priority_queue
+        if( !current_entropy_surfel.neighbours.empty() ) {
+            min_entropy_surfel_queue.push(en_surfel_id);
         } else { //otherwise, consider this surfel to be finalized
-            //std::cout << "**Pushing into finalized surfels (size so far: "<<finalized_surfels.size() << "): " << (int)current_entropy_surfel_ptr->contained_surfel->color()[0] << "\n";
-            finalized_surfels.push_back( current_entropy_surfel_ptr );
-            //std::cout << "did not find any Neighbours!!!!\n";
-            //std::cout << current_entropy_surfel_ptr->contained_surfel->pos() << " -- " << current_entropy_surfel_ptr->contained_surfel->radius() << " ------\n";
+            finalized_surfels.push_back(en_surfel_id);
         }
     }
 
-    // the queue was modified, therefore it is resorted
-    std::sort(min_entropy_surfel_ptr_queue.begin(), min_entropy_surfel_ptr_queue.end(), min_entropy_order());
+    size_t num_valid_surfels = min_entropy_surfel_queue.size() + finalized_surfels.size();
 
-    size_t num_valid_surfels = min_entropy_surfel_ptr_queue.size() + finalized_surfels.size();
+    std::vector<uint8_t> merge_marks(entropy_surfel_array.size(), 0);
+    std::vector<uint32_t> invalidated_neighbours;
 
+    while( !min_entropy_surfel_queue.empty() ) {
+        uint32_t const current_id = min_entropy_surfel_queue.top();
 
-    while(true) {
-
-        if( !min_entropy_surfel_ptr_queue.empty() ){
-            shared_entropy_surfel current_entropy_surfel = min_entropy_surfel_ptr_queue.back();
-            
-            min_entropy_surfel_ptr_queue.pop_back();
-
-            //the back element is still valid, so we still got something to do
-            if(current_entropy_surfel->validity){
-                //std::cout << "Working on the surfel\n";
-                // if merge returns true, the surfel still has neighbours
-
-                
-                if( merge(current_entropy_surfel, entropy_surfel_array, num_valid_surfels, surfels_per_node) ) {
-                    min_entropy_surfel_ptr_queue.push_back(current_entropy_surfel);
-                    /*min_entropy_surfel_ptr_queue.insert(min_entropy_surfel_ptr_queue.end(),
-                                                        finalized_surfels.begin(),
-                                                        finalized_surfels.end());
-                    */
-                    //finalized_surfels.clear();
-
-                } else { //otherwise we can push it directly into the finalized surfel list
-                    finalized_surfels.push_back(current_entropy_surfel);
-                }
-
-
-                std::sort(min_entropy_surfel_ptr_queue.begin(), min_entropy_surfel_ptr_queue.end(), min_entropy_order());
+        invalidated_neighbours.clear();
+        bool const has_neighbours = merge(current_id, entropy_surfel_array, surfel_grid, merge_marks,
+                                          num_valid_surfels, surfels_per_node,
+                                          invalidated_neighbours);
 
+        // if merge returns true, the surfel still has neighbours and its
+        // changed entropy is restored in the queue. this has to happen before
+        // any other queue operation
+        if( has_neighbours ) {
+            min_entropy_surfel_queue.update(current_id);
+        } else { //otherwise we can push it directly into the finalized surfel list
+            min_entropy_surfel_queue.remove(current_id);
+            finalized_surfels.push_back(current_id);
+        }
 
-                if(num_valid_surfels <= surfels_per_node) {
-                    break;
-                } else {
-                    //break
-                }
-            }    
+        // invalid surfels never leave the queue again
+        for (auto const invalidated_id : invalidated_neighbours) {
+            if (min_entropy_surfel_queue.contains(invalidated_id)) {
+                min_entropy_surfel_queue.remove(invalidated_id);
+            }
+        }
 
-        } else {
+        if(num_valid_surfels <= surfels_per_node) {
             break;
         }
-
     }
 
 
     // put valid surfels into final array
 
     //end of entropy simplification
-    while( (!min_entropy_surfel_ptr_queue.empty()) ) {
-        shared_entropy_surfel en_surfel_to_push = min_entropy_surfel_ptr_queue.back();
-
-        if(en_surfel_to_push->validity == true) {
-            finalized_surfels.push_back(en_surfel_to_push);
-        }
-        
-        min_entropy_surfel_ptr_queue.pop_back();
+    while( !min_entropy_surfel_queue.empty() ) {
+        finalized_surfels.push_back(min_entropy_surfel_queue.top());
+        min_entropy_surfel_queue.pop();
     }
 
 
-    std::sort(finalized_surfels.begin(), finalized_surfels.end(), min_entropy_order());
+    std::sort(finalized_surfels.begin(), finalized_surfels.end(), min_entropy_order(entropy_surfel_array));
 
     while( num_valid_surfels > surfels_per_node ) {
-        auto const& min_entropy_surfel = finalized_surfels.back();
+        auto const& min_entropy_surfel = entropy_surfel_array[finalized_surfels.back()];
 
-        if(min_entropy_surfel->validity) {
+        if(min_entropy_surfel.validity) {
             --num_valid_surfels;
         }
 
@@ -154,11 +137,12 @@ create_lod(real& reduction_error,
     }
 
     size_t chosen_surfels = 0;
-    for(auto const& en_surf : finalized_surfels) {
+    for(auto const en_surfel_id : finalized_surfels) {
+        auto const& en_surf = entropy_surfel_array[en_surfel_id];
 
-        if(en_surf->validity) {
+        if(en_surf.validity) {
             if(chosen_surfels++ < surfels_per_node) {
-                mem_array.mem_data()->push_back(*(en_surf->contained_surfel));
+                mem_array.mem_data()->push_back(en_surf.contained_surfel);
             } else {   
                 break;
             }
@@ -172,52 +156,45 @@ create_lod(real& reduction_error,
 };
 
 void reduction_entropy::
-add_neighbours(shared_entropy_surfel entropy_surfel_to_add_neighbours,
-               shared_entropy_surfel_vector const& neighbour_ptrs_to_add) const {
-
-    entropy_surfel_to_add_neighbours->neighbours.insert(std::end(entropy_surfel_to_add_neighbours->neighbours),
-                                                        std::begin(neighbour_ptrs_to_add),
-                                                        std::end(neighbour_ptrs_to_add));
-}
-
-void reduction_entropy::
-update_color(shared_surfel target_surfel, 
-              shared_entropy_surfel_vector const& neighbour_ptrs) const{
+update_color(surfel& target_surfel, 
+             entropy_surfel_vector const& entropy_surfels,
+             std::vector<uint32_t> const& neighbour_ids) const{
 
     vec3r accumulated_color(0.0, 0.0, 0.0);
     double accumulated_weight = 0.0;
 
-    accumulated_color = target_surfel->color();
+    accumulated_color = target_surfel.color();
     accumulated_weight = 1.0;
 
-    for(auto const curr_neighbour_ptr : neighbour_ptrs){
+    for(auto const neighbour_id : neighbour_ids){
         accumulated_weight += 1.0;
-        accumulated_color += curr_neighbour_ptr->contained_surfel->color();
+        accumulated_color += entropy_surfels[neighbour_id].contained_surfel.color();
     }
 
     vec3b normalized_color = vec3b(accumulated_color[0] / accumulated_weight,
                                    accumulated_color[1] / accumulated_weight,
                                    accumulated_color[2] / accumulated_weight );
-    target_surfel->color() = normalized_color;
+    target_surfel.color() = normalized_color;
 }
 
 void reduction_entropy::
-update_normal(shared_surfel target_surfel_ptr, 
-               shared_entropy_surfel_vector const neighbour_ptrs) const{
+update_normal(surfel& target_surfel, 
+              entropy_surfel_vector const& entropy_surfels,
+              std::vector<uint32_t> const& neighbour_ids) const{
     vec3f new_normal(0.0, 0.0, 0.0);
 
     real weight_sum = 0.f;
 
-    new_normal = target_surfel_ptr->normal();
+    new_normal = target_surfel.normal();
     weight_sum = 1.0;   
 
-    for(auto const neighbour_ptr : neighbour_ptrs){
-    shared_surfel target_surfel_ptr = neighbour_ptr->contained_surfel;
+    for(auto const neighbour_id : neighbour_ids){
+        surfel const& neighbour_surfel = entropy_surfels[neighbour_id].contained_surfel;
 
-        real weight = target_surfel_ptr->radius();
+        real weight = neighbour_surfel.radius();
         weight_sum += weight;
 
-        new_normal += weight * target_surfel_ptr->normal();
+        new_normal += weight * neighbour_surfel.normal();
     }
 
     if( weight_sum != 0.0 ) {
@@ -226,33 +203,34 @@ update_normal(shared_surfel target_surfel_ptr,
         new_normal = vec3r(0.0, 0.0, 0.0);
     }
 
-    target_surfel_ptr->normal() = scm::math::normalize(new_normal);
+    target_surfel.normal() = scm::math::normalize(new_normal);
 } 
 
 // to verify: the center of mass is the point that allows for the minimal enclosing sphere
 vec3r reduction_entropy::
-compute_center_of_mass(shared_surfel target_surfel_ptr, 
-                       shared_entropy_surfel_vector const & neighbour_ptrs) const {
+compute_center_of_mass(surfel const& target_surfel, 
+                       entropy_surfel_vector const& entropy_surfels,
+                       std::vector<uint32_t> const& neighbour_ids) const {
 
     //volume of a sphere (4/3) * pi * r^3
-    real target_surfel_radius = target_surfel_ptr->radius();
+    real target_surfel_radius = target_surfel.radius();
     real rad_pow_3 = target_surfel_radius * target_surfel_radius * target_surfel_radius;
     real target_surfel_mass = (4.0/3.0) * M_PI * rad_pow_3;
 
-    vec3r center_of_mass_enumerator = target_surfel_mass * target_surfel_ptr->pos();
+    vec3r center_of_mass_enumerator = target_surfel_mass * target_surfel.pos();
     real center_of_mass_denominator = target_surfel_mass;
 
     //center of mass equation: c_o_m = ( sum_of( m_i*x_i) ) / ( sum_of(m_i) )
-    for (auto const curr_neighbour_ptr : neighbour_ptrs) {
+    for (auto const neighbour_id : neighbour_ids) {
 
-    shared_surfel current_neighbour_surfel = curr_neighbour_ptr->contained_surfel;
+        surfel const& current_neighbour_surfel = entropy_surfels[neighbour_id].contained_surfel;
 
-        real neighbour_radius = current_neighbour_surfel->radius();
+        real neighbour_radius = current_neighbour_surfel.radius();
 
         real neighbour_mass = (4.0/3.0) * M_PI * 
                                 neighbour_radius * neighbour_radius * neighbour_radius;
 
-        center_of_mass_enumerator += neighbour_mass * current_neighbour_surfel->pos();
+        center_of_mass_enumerator += neighbour_mass * current_neighbour_surfel.pos();
 
         center_of_mass_denominator += neighbour_mass;
     }
@@ -262,17 +240,18 @@ compute_center_of_mass(shared_surfel target_surfel_ptr,
 
 real reduction_entropy::
 compute_enclosing_sphere_radius(vec3r const& center_of_mass, 
-                                shared_surfel target_surfel_ptr, 
-                                std::vector< shared_entropy_surfel > const neighbour_ptrs) const {
+                                surfel const& target_surfel, 
+                                entropy_surfel_vector const& entropy_surfels,
+                                std::vector<uint32_t> const& neighbour_ids) const {
 
     real enclosing_radius = 0.0;
 
-    enclosing_radius = scm::math::length(center_of_mass - target_surfel_ptr->pos()) + target_surfel_ptr->radius();
+    enclosing_radius = scm::math::length(center_of_mass - target_surfel.pos()) + target_surfel.radius();
 
-    for (auto const curr_neighbour_ptr : neighbour_ptrs) {
+    for (auto const neighbour_id : neighbour_ids) {
 
-    shared_surfel current_neighbour_surfel = curr_neighbour_ptr->contained_surfel;
-        real neighbour_enclosing_radius = scm::math::length(center_of_mass - current_neighbour_surfel->pos()) + current_neighbour_surfel->radius();
+        surfel const& current_neighbour_surfel = entropy_surfels[neighbour_id].contained_surfel;
+        real neighbour_enclosing_radius = scm::math::length(center_of_mass - current_neighbour_surfel.pos()) + current_neighbour_surfel.radius();
         
         if(neighbour_enclosing_radius > enclosing_radius) {
             enclosing_radius = neighbour_enclosing_radius;
@@ -282,251 +261,321 @@ compute_enclosing_sphere_radius(vec3r const& center_of_mass,
     return enclosing_radius;
 }
 
-shared_entropy_surfel_vector const reduction_entropy::
-get_locally_overlapping_neighbours(shared_entropy_surfel target_entropy_surfel_ptr,
-                                   shared_entropy_surfel_vector& entropy_surfel_ptr_array
-                                   ) const {
-    shared_surfel target_surfel = target_entropy_surfel_ptr->contained_surfel;
+void reduction_entropy::
+compute_overlapping_neighbours(entropy_surfel_vector& entropy_surfels,
+                               entropy_surfel_grid const& grid) const {
+
+    std::vector<uint32_t> candidate_ids;
+    for (uint32_t target_id = 0; target_id < entropy_surfels.size(); ++target_id) {
+        surfel const& target_surfel = entropy_surfels[target_id].contained_surfel;
+        std::vector<uint32_t>& overlapping_neighbours = entropy_surfels[target_id].neighbours;
+
+        // candidates come in the order of the entropy surfel array
+        grid.find_candidates(target_id, candidate_ids);
+        for (auto const neighbour_id : candidate_ids) {
+            if (surfel::intersect(target_surfel, entropy_surfels[neighbour_id].contained_surfel)) {
+                overlapping_neighbours.push_back(neighbour_id);
+            }
+        }
+    }
+}
+
+const uint64_t entropy_surfel_grid::no_cell;
+
+entropy_surfel_grid::
+entropy_surfel_grid(entropy_surfel_vector const& in_entropy_surfels)
+    : entropy_surfels(in_entropy_surfels),
+      surfel_cells(in_entropy_surfels.size(), no_cell),
+      min_pos(std::numeric_limits<real>::max()),
+      cell_size(1.0),
+      max_radius(0.0) {
+
+    vec3r max_pos(std::numeric_limits<real>::lowest());
+    for (auto const& current_entropy_surfel : entropy_surfels) {
+        surfel const& current_surfel = current_entropy_surfel.contained_surfel;
+        max_radius = std::max(max_radius, current_surfel.radius());
+        for (int axis = 0; axis < 3; ++axis) {
+            min_pos[axis] = std::min(min_pos[axis], current_surfel.pos()[axis]);
+            max_pos[axis] = std::max(max_pos[axis], current_surfel.pos()[axis]);
+        }
+    }
 
-    std::vector< shared_entropy_surfel > overlapping_neighbour_ptrs;
+    // two surfels can only overlap if their bounding spheres do. with cells
+    // of twice the largest input radius, all candidates of an input surfel
+    // are found in the 27 cells around its own. the cell coordinates are
+    // kept within 21 bits per axis
+    cell_size = 2.0 * max_radius;
+    for (int axis = 0; axis < 3; ++axis) {
+        cell_size = std::max(cell_size, (max_pos[axis] - min_pos[axis]) / ((1 << 21) - 2));
+    }
+    if (!(cell_size > 0.0)) {
+        cell_size = 1.0;
+    }
 
-    for ( auto const array_entr_surfel_ptr : entropy_surfel_ptr_array ) {
-        
-	// avoid overlaps with the surfel itself
-        if (target_entropy_surfel_ptr->surfel_id != array_entr_surfel_ptr->surfel_id || 
-	        target_entropy_surfel_ptr->node_id   != array_entr_surfel_ptr->node_id) {
+    for (uint32_t en_surfel_id = 0; en_surfel_id < entropy_surfels.size(); ++en_surfel_id) {
+        update(en_surfel_id);
+    }
+}
+
+uint32_t entropy_surfel_grid::
+cell_coordinate(real const coordinate, int const axis) const {
+    real const cell = std::floor((coordinate - min_pos[axis]) / cell_size);
+    return uint32_t(std::min(std::max(cell, real(0.0)), real((1 << 21) - 1)));
+}
+
+uint64_t entropy_surfel_grid::
+cell_key(vec3r const& pos) const {
+    return (uint64_t(cell_coordinate(pos.x, 0)) << 42) |
+           (uint64_t(cell_coordinate(pos.y, 1)) << 21) |
+            uint64_t(cell_coordinate(pos.z, 2));
+}
+
+void entropy_surfel_grid::
+update(uint32_t const en_surfel_id) {
+    entropy_surfel const& current_entropy_surfel = entropy_surfels[en_surfel_id];
+    uint64_t const new_cell = current_entropy_surfel.validity
+                            ? cell_key(current_entropy_surfel.contained_surfel.pos())
+                            : no_cell;
+    uint64_t& old_cell = surfel_cells[en_surfel_id];
+
+    if (current_entropy_surfel.validity) {
+        max_radius = std::max(max_radius, current_entropy_surfel.contained_surfel.radius());
+    }
+    if (new_cell == old_cell) {
+        return;
+    }
+
+    if (old_cell != no_cell) {
+        auto cell_it = cells.find(old_cell);
+        std::vector<uint32_t>& cell_ids = cell_it->second;
+        *std::find(cell_ids.begin(), cell_ids.end(), en_surfel_id) = cell_ids.back();
+        cell_ids.pop_back();
+        if (cell_ids.empty()) {
+            cells.erase(cell_it);
+        }
+    }
+    if (new_cell != no_cell) {
+        cells[new_cell].push_back(en_surfel_id);
+    }
+    old_cell = new_cell;
+}
 
-    	    shared_surfel contained_surfel_ptr = array_entr_surfel_ptr->contained_surfel;
+void entropy_surfel_grid::
+find_candidates(uint32_t const target_id,
+                std::vector<uint32_t>& candidate_ids) const {
+    candidate_ids.clear();
 
-            if( surfel::intersect(*target_surfel, *contained_surfel_ptr) ) {
-                overlapping_neighbour_ptrs.push_back( array_entr_surfel_ptr );  
+    surfel const& target_surfel = entropy_surfels[target_id].contained_surfel;
+    real const search_radius = target_surfel.radius() + max_radius;
+
+    auto const add_cell = [&](std::vector<uint32_t> const& cell_ids) {
+        for (auto const candidate_id : cell_ids) {
+            surfel const& candidate_surfel = entropy_surfels[candidate_id].contained_surfel;
+            if (candidate_id != target_id &&
+                scm::math::length(target_surfel.pos() - candidate_surfel.pos()) <= target_surfel.radius() + candidate_surfel.radius()) {
+                candidate_ids.push_back(candidate_id);
             }
+        }
+    };
+
+    uint32_t min_cell[3];
+    uint32_t max_cell[3];
+    uint64_t num_cells = 1;
+    for (int axis = 0; axis < 3; ++axis) {
+        min_cell[axis] = cell_coordinate(target_surfel.pos()[axis] - search_radius, axis);
+        max_cell[axis] = cell_coordinate(target_surfel.pos()[axis] + search_radius, axis);
+        num_cells *= max_cell[axis] - min_cell[axis] + 1;
+    }
 
+    // once merged surfels have grown large, visiting the occupied cells is
+    // cheaper than visiting every cell of the search range
+    if (num_cells > cells.size()) {
+        for (auto const& cell : cells) {
+            add_cell(cell.second);
+        }
+    }
+    else {
+        for (uint64_t x = min_cell[0]; x <= max_cell[0]; ++x) {
+            for (uint64_t y = min_cell[1]; y <= max_cell[1]; ++y) {
+                for (uint64_t z = min_cell[2]; z <= max_cell[2]; ++z) {
+                    auto const cell_it = cells.find((x << 42) | (y << 21) | z);
+                    if (cell_it != cells.end()) {
+                        add_cell(cell_it->second);
+                    }
+                }
+            }
         }
-        
     }
 
-    return overlapping_neighbour_ptrs;
+    std::sort(candidate_ids.begin(), candidate_ids.end());
 }
 
 
 
 void reduction_entropy::
-update_entropy(shared_entropy_surfel target_en_surfel, 
-               shared_entropy_surfel_vector const neighbour_ptrs) const
+update_entropy(entropy_surfel& target_en_surfel, 
+               entropy_surfel_vector const& entropy_surfels) const
 {       
     // base entropy for surfel
-    //double entropy = target_en_surfel->contained_surfel->radius();
     double entropy = 0.0;
 
-    vec3b const& target_surfel_color = target_en_surfel->contained_surfel->color();
-
     size_t num_surfels_considered = 1;
 
-    for(auto const curr_neighbour_ptr : neighbour_ptrs){
-
-        if( curr_neighbour_ptr->validity ) {
-    	    shared_surfel current_neighbour_surfel = curr_neighbour_ptr->contained_surfel;
-
-            vec3f const& neighbour_normal = current_neighbour_surfel->normal();  
-
-            vec3b const& neighbour_color = current_neighbour_surfel->color();
+    for(auto const neighbour_id : target_en_surfel.neighbours){
+        entropy_surfel const& current_neighbour = entropy_surfels[neighbour_id];
 
+        if( current_neighbour.validity ) {
+            vec3f const& neighbour_normal = current_neighbour.contained_surfel.normal();  
 
-            float normal_angle = std::fabs(scm::math::dot(target_en_surfel->contained_surfel->normal(), neighbour_normal));
-            entropy += (1 + target_en_surfel->level)/(1.0 + normal_angle);
-/*
-            real color_diff = scm::math::length( vec3r((target_surfel_color[0] - neighbour_color[0]),
-                                                       (target_surfel_color[1] - neighbour_color[1]),
-                                                       (target_surfel_color[2] - neighbour_color[2]) ) ) ;
-*/
-            //entropy += (1 + target_en_surfel->level) * (1 + (color_diff));
-
-            //entropy += current_neighbour_surfel->radius();
+            float normal_angle = std::fabs(scm::math::dot(target_en_surfel.contained_surfel.normal(), neighbour_normal));
+            entropy += (1 + target_en_surfel.level)/(1.0 + normal_angle);
 
             ++num_surfels_considered;
         }
     };    
     
-    target_en_surfel->entropy = entropy / num_surfels_considered;
-    //target_en_surfel->entropy = entropy;
-}
-
-
-
-void reduction_entropy::
-update_entropy_surfel_level(shared_entropy_surfel target_en_surfel_ptr, 
-                            shared_entropy_surfel_vector const& invalidated_neighbours) const {
-    //target_en_surfel_ptr->level += 1;
-    target_en_surfel_ptr->level += invalidated_neighbours.size() * 1000;
+    target_en_surfel.entropy = entropy / num_surfels_considered;
 }
 
 void reduction_entropy::
-update_position(shared_surfel target_surfel_ptr,
-                shared_entropy_surfel_vector const neighbour_ptrs) const {
-    target_surfel_ptr->pos() = compute_center_of_mass(target_surfel_ptr, 
-                                                      neighbour_ptrs);
+update_position(surfel& target_surfel,
+                entropy_surfel_vector const& entropy_surfels,
+                std::vector<uint32_t> const& neighbour_ids) const {
+    target_surfel.pos() = compute_center_of_mass(target_surfel, 
+                                                 entropy_surfels,
+                                                 neighbour_ids);
 }
 
 void reduction_entropy::
-update_radius(shared_surfel target_surfel_ptr, 
-              shared_entropy_surfel_vector const neighbour_ptrs) const {
-    target_surfel_ptr->radius() 
-        = compute_enclosing_sphere_radius(target_surfel_ptr->pos(), 
-                                          target_surfel_ptr, 
-                                          neighbour_ptrs);
+update_radius(surfel& target_surfel, 
+              entropy_surfel_vector const& entropy_surfels,
+              std::vector<uint32_t> const& neighbour_ids) const {
+    target_surfel.radius() 
+        = compute_enclosing_sphere_radius(target_surfel.pos(), 
+                                          target_surfel, 
+                                          entropy_surfels,
+                                          neighbour_ids);
 }
 
 void reduction_entropy::
-update_surfel_attributes(shared_surfel target_surfel_ptr, 
-                         shared_entropy_surfel_vector const invalidated_neighbours) const {
+update_surfel_attributes(surfel& target_surfel, 
+                         entropy_surfel_vector const& entropy_surfels,
+                         std::vector<uint32_t> const& invalidated_neighbours) const {
 
-    update_normal(target_surfel_ptr, invalidated_neighbours);
-    update_color(target_surfel_ptr, invalidated_neighbours);
+    update_normal(target_surfel, entropy_surfels, invalidated_neighbours);
+    update_color(target_surfel, entropy_surfels, invalidated_neighbours);
 
     // position needs to be updated before the radius is updated
-    update_position(target_surfel_ptr, invalidated_neighbours);
-    update_radius(target_surfel_ptr, invalidated_neighbours);
+    update_position(target_surfel, entropy_surfels, invalidated_neighbours);
+    update_radius(target_surfel, entropy_surfels, invalidated_neighbours);
 }
 
 bool reduction_entropy::
-merge(shared_entropy_surfel target_entropy_surfel,
-      shared_entropy_surfel_vector const& complete_entropy_surfel_array,
-      size_t& num_remaining_valid_surfel, size_t num_desired_surfel) const{
+merge(uint32_t const target_id,
+      entropy_surfel_vector& entropy_surfels,
+      entropy_surfel_grid& grid,
+      std::vector<uint8_t>& merge_marks,
+      size_t& num_remaining_valid_surfel, size_t num_desired_surfel,
+      std::vector<uint32_t>& invalidated_neighbours) const{
 
-    size_t num_invalidated_surfels = 0;
-
-    shared_entropy_surfel_vector neighbours_to_merge;
+    entropy_surfel& target_entropy_surfel = entropy_surfels[target_id];
+    surfel& target_surfel = target_entropy_surfel.contained_surfel;
 
-    //**replace own invalid neighbours by valid neighbours of invalid neighbours**
-    std::map<size_t, std::set<size_t> > added_neighbours_during_merge;
+    size_t num_invalidated_surfels = 0;
 
-    auto min_distance_ordering = [&target_entropy_surfel](shared_entropy_surfel const& left_entropy_surfel,
-                 shared_entropy_surfel const& right_entropy_surfel) {
-                    
+    auto min_distance_ordering = [&entropy_surfels, &target_surfel](uint32_t const left_id,
+                                                                    uint32_t const right_id) {
+                    surfel const& left_surfel = entropy_surfels[left_id].contained_surfel;
+                    surfel const& right_surfel = entropy_surfels[right_id].contained_surfel;
 
                     double left_en_surfel_distance_measure = 
-                        (target_entropy_surfel->contained_surfel->radius() +
-                         left_entropy_surfel->contained_surfel->radius()) - 
-                        scm::math::length(target_entropy_surfel->contained_surfel->pos() -
-                                          left_entropy_surfel->contained_surfel->pos());
+                        (target_surfel.radius() + left_surfel.radius()) - 
+                        scm::math::length(target_surfel.pos() - left_surfel.pos());
 
                     double right_en_surfel_distance_measure = 
-                        (target_entropy_surfel->contained_surfel->radius() +
-                         right_entropy_surfel->contained_surfel->radius()) - 
-                        scm::math::length(target_entropy_surfel->contained_surfel->pos() -
-                                          right_entropy_surfel->contained_surfel->pos());
-
-                    if(
-                        left_en_surfel_distance_measure
-                        < 
-                        right_en_surfel_distance_measure
-                    ) {
-                        return true;
-                    } else {
-                        return false;
-                    }
+                        (target_surfel.radius() + right_surfel.radius()) - 
+                        scm::math::length(target_surfel.pos() - right_surfel.pos());
+
+                    return left_en_surfel_distance_measure < right_en_surfel_distance_measure;
                 };
 
     //sort neighbours by increasing entropy to current neighbour
-    std::sort(target_entropy_surfel->neighbours.begin(),
-              target_entropy_surfel->neighbours.end(),
+    std::sort(target_entropy_surfel.neighbours.begin(),
+              target_entropy_surfel.neighbours.end(),
               min_distance_ordering);
 
+    for (auto const neighbour_id : target_entropy_surfel.neighbours){
+        entropy_surfel& actual_neighbour = entropy_surfels[neighbour_id];
 
-   shared_entropy_surfel_vector invalidated_neighbours;
+        if (actual_neighbour.validity) {
+            actual_neighbour.validity = false;
 
-   for (auto const actual_neighbour_ptr : target_entropy_surfel->neighbours){
-        
-        if (actual_neighbour_ptr->validity) {
-            actual_neighbour_ptr->validity = false;
-
-            invalidated_neighbours.push_back(actual_neighbour_ptr);
+            invalidated_neighbours.push_back(neighbour_id);
 
             ++num_invalidated_surfels;
             if( --num_remaining_valid_surfel == num_desired_surfel ) {
                 break;
             }
-
-
         }
-
-
     }
 
-    for (auto const actual_neighbour_ptr : invalidated_neighbours) {
+    //**replace own invalid neighbours by valid neighbours of invalid neighbours**
+    //merge_marks flags the 2nd neighbours added so far, it is reset below
+    std::vector<uint32_t> neighbours_to_merge;
+
+    for (auto const invalidated_id : invalidated_neighbours) {
 
             //iterate the neighbours of the invalid neighbour
-            for(auto const second_neighbour_ptr : actual_neighbour_ptr->neighbours){
+            for(auto const second_neighbour_id : entropy_surfels[invalidated_id].neighbours){
 
                 // we only have to consider valid neighbours, all the others are also our own neighbours and already invalid
-                if(second_neighbour_ptr->validity) {
-                    size_t n_id = second_neighbour_ptr->node_id;
-                    size_t s_id = second_neighbour_ptr->surfel_id;
-
-                    //avoid getting the surfel itself as neighbour
-                    if( n_id != target_entropy_surfel->node_id || 
-                        s_id != target_entropy_surfel->surfel_id) {
-                        //ignore 2nd neighbours which we found already at another neighbour
-                        if( (added_neighbours_during_merge[n_id]).find(s_id) == added_neighbours_during_merge[n_id].end() ) {
-                            (added_neighbours_during_merge[n_id]).insert(s_id);
-                            neighbours_to_merge.push_back(second_neighbour_ptr);
-                        }
+                // and we avoid getting the surfel itself as neighbour
+                if(entropy_surfels[second_neighbour_id].validity && second_neighbour_id != target_id) {
+                    //ignore 2nd neighbours which we found already at another neighbour
+                    if( !merge_marks[second_neighbour_id] ) {
+                        merge_marks[second_neighbour_id] = 1;
+                        neighbours_to_merge.push_back(second_neighbour_id);
                     }
                 }
             }
 
     }
 
-    add_neighbours(target_entropy_surfel, neighbours_to_merge);
+    target_entropy_surfel.neighbours.insert(target_entropy_surfel.neighbours.end(),
+                                            neighbours_to_merge.begin(),
+                                            neighbours_to_merge.end());
  
     //recompute values for merged surfel
-    //target_entropy_surfel->level += 1;
-    update_entropy_surfel_level(target_entropy_surfel, invalidated_neighbours);
-    update_surfel_attributes(target_entropy_surfel->contained_surfel, invalidated_neighbours);
+    target_entropy_surfel.level += invalidated_neighbours.size() * 1000;
+    update_surfel_attributes(target_surfel, entropy_surfels, invalidated_neighbours);
  
 
-    // now that we , we also have to look for neighbours that we suddenly overlap due to the higher radius
-    shared_entropy_surfel_vector additional_surfels_to_test_for_overlap;
-
-
-    for( auto const surfel_ptr : complete_entropy_surfel_array) {
-
-        if(surfel_ptr->validity) {
-            if( surfel_ptr->node_id != target_entropy_surfel->node_id || 
-                surfel_ptr->surfel_id != target_entropy_surfel->surfel_id) {
-
-                if( added_neighbours_during_merge[surfel_ptr->node_id].find(surfel_ptr->surfel_id) == 
-                    added_neighbours_during_merge[surfel_ptr->node_id].end()) {
-                    // we did not consider this surfel, we can check for an overlap.
-                    additional_surfels_to_test_for_overlap.push_back(surfel_ptr);
-
-                }
+    for (auto const invalidated_id : invalidated_neighbours) {
+        grid.update(invalidated_id);
+    }
+    grid.update(target_id);
 
-            }
+    // now that we , we also have to look for neighbours that we suddenly overlap due to the higher radius
+    std::vector<uint32_t> candidate_ids;
+    grid.find_candidates(target_id, candidate_ids);
+    for (auto const candidate_id : candidate_ids) {
+        // we did not consider this surfel yet, we can check for an overlap
+        if (!merge_marks[candidate_id] &&
+            surfel::intersect(target_surfel, entropy_surfels[candidate_id].contained_surfel)) {
+            target_entropy_surfel.neighbours.push_back(candidate_id);
         }
     }
 
-    auto const additional_overlapping_neighbours 
-        = get_locally_overlapping_neighbours(target_entropy_surfel, 
-                                             additional_surfels_to_test_for_overlap);
-
-    //if(additional_overlapping_neighbours.size() != 0)
-    //    std::cout << "Found something!\n";
-
-    add_neighbours(target_entropy_surfel, additional_overlapping_neighbours);
-
+    for (auto const merged_id : neighbours_to_merge) {
+        merge_marks[merged_id] = 0;
+    }
 
-    update_entropy(target_entropy_surfel, target_entropy_surfel->neighbours);
+    update_entropy(target_entropy_surfel, entropy_surfels);
 
 
     if(num_invalidated_surfels == 0)
         return false;
-    if(!target_entropy_surfel->neighbours.empty()) {
-        return true;
-    } else {
-        return false;
-    }
+    return !target_entropy_surfel.neighbours.empty();
 }
 
 
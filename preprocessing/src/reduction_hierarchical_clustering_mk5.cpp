@@ -6,6 +6,9 @@
 // http://www.uni-weimar.de/medien/vr
 
 #include <lamure/pre/reduction_hierarchical_clustering_mk5.h>
+#include <lamure/pre/eigen_solver.h>
+
+#include <algorithm>
 
 
 namespace lamure {
@@ -27,34 +30,51 @@ create_lod(real& reduction_error,
           	const size_t start_node_id) const
 {
 	// Create a single surfel vector to sample from.
-	std::vector<surfel*> surfels_to_sample;
+	hierarchical_cluster_surfels_mk5 cluster_surfels;
 	for (uint32_t child_mem_array_index = 0; child_mem_array_index < input.size(); ++child_mem_array_index)
     {
 		surfel_mem_array* child_mem_array = input.at(child_mem_array_index);
 
     	for (uint32_t surfel_index = 0; surfel_index < child_mem_array->length(); ++surfel_index)
     	{
-    		surfels_to_sample.push_back(&child_mem_array->mem_data()->at(surfel_index));
+    		cluster_surfels.surfels.push_back(&child_mem_array->mem_data()->at(surfel_index));
     	}
     }
 
+    // Positions and transformed colors are read on every split, keep them
+    // in flat arrays.
+    const uint32_t num_surfels = cluster_surfels.surfels.size();
+    cluster_surfels.positions.resize(num_surfels);
+    cluster_surfels.colors.resize(num_surfels);
+    cluster_surfels.order.resize(num_surfels);
+    cluster_surfels.partition_buffer.resize(num_surfels);
+
+    thread_pool& pool = tree.pool();
+    pool.parallel_for(0, num_surfels, [&](size_t surfel_index, size_t) {
+    	const surfel* current_surfel = cluster_surfels.surfels[surfel_index];
+    	cluster_surfels.positions[surfel_index] = current_surfel->pos();
+    	cluster_surfels.colors[surfel_index] = transform_color(current_surfel->color());
+    	cluster_surfels.order[surfel_index] = surfel_index;
+    }, 256);
+
     // Set initial parameters depending on input parameters.
     // These splitting thresholds adapt during the execution of the algorithm.
     // Maximum possible variation is 1/3.
     // TODO: optimize chosen parameters
-    uint32_t maximum_cluster_size = (surfels_to_sample.size() / surfels_per_node) * 2;
+    uint32_t maximum_cluster_size = (num_surfels / surfels_per_node) * 2;
     real maximum_variation_position = -1;
     real maximum_variation_color = 0.025;
 
-	std::vector<std::vector<surfel*>> clusters;
-	clusters = split_point_cloud(surfels_to_sample, maximum_cluster_size, maximum_variation_position, maximum_variation_color, surfels_per_node);
+	std::vector<hierarchical_cluster_mk5> clusters;
+	clusters = split_point_cloud(cluster_surfels, maximum_cluster_size, maximum_variation_position, maximum_variation_color, surfels_per_node, pool);
 
 	// Generate surfels from clusters.
 	surfel_mem_array surfels(std::make_shared<surfel_vector>(surfel_vector()), 0, 0);
+	surfels.mem_data()->reserve(clusters.size());
 
 	for(uint32_t cluster_index = 0; cluster_index < clusters.size(); ++cluster_index)
 	{
-		surfel new_surfel = create_surfel_from_cluster(clusters.at(cluster_index));
+		surfel new_surfel = create_surfel_from_cluster(cluster_surfels, clusters.at(cluster_index));
 		surfels.mem_data()->push_back(new_surfel);
 	}
 
@@ -66,17 +86,51 @@ create_lod(real& reduction_error,
 
 
 
-std::vector<std::vector<surfel*>> reduction_hierarchical_clustering_mk5::
-split_point_cloud(const std::vector<surfel*>& input_surfels, 
+namespace {
+
+// Moves the entries of order in [begin, end) for which is_first_half holds
+// to the front, keeping the relative order of both halves. Returns the end
+// of the first half.
+template <typename predicate>
+uint32_t
+partition_range(std::vector<uint32_t>& order, std::vector<uint32_t>& partition_buffer,
+				uint32_t begin, uint32_t end, const predicate& is_first_half)
+{
+	uint32_t middle = begin;
+	uint32_t num_second_half = 0;
+
+	for(uint32_t order_index = begin; order_index < end; ++order_index)
+	{
+		const uint32_t surfel_index = order[order_index];
+
+		if(is_first_half(surfel_index))
+		{
+			order[middle++] = surfel_index;
+		}
+		else
+		{
+			partition_buffer[num_second_half++] = surfel_index;
+		}
+	}
+
+	std::copy(partition_buffer.begin(), partition_buffer.begin() + num_second_half, order.begin() + middle);
+	return middle;
+}
+
+}
+
+
+
+std::vector<hierarchical_cluster_mk5> reduction_hierarchical_clustering_mk5::
+split_point_cloud(hierarchical_cluster_surfels_mk5& cluster_surfels, 
 				uint32_t max_cluster_size, 
 				real max_variation_position,
 				real max_variation_color, 
-				const uint32_t& max_clusters) const
+				const uint32_t& max_clusters,
+				thread_pool& pool) const
 {
-	std::priority_queue<hierarchical_cluster_mk5, 
-						std::vector<hierarchical_cluster_mk5>, 
-						cluster_comparator_mk5> cluster_queue;
-	cluster_queue.push(calculate_cluster_data(input_surfels));
+	cluster_queue_mk5 cluster_queue;
+	cluster_queue.push(calculate_cluster_data(cluster_surfels, 0, cluster_surfels.order.size()));
 
 	while(cluster_queue.size() < max_clusters)
 	{
@@ -90,41 +144,31 @@ split_point_cloud(const std::vector<surfel*>& input_surfels,
 		}
 
 		// Only do color splitting if color variation is above threshold and cluster is small (which means it is deep in the splitting hierarchy).
-		if(current_cluster.variation_color > max_variation_color && current_cluster.surfels.size() < (max_cluster_size * 2))
+		if(current_cluster.variation_color > max_variation_color && current_cluster.size() < (max_cluster_size * 2))
 		{
-			std::vector<surfel*> new_surfels_one;
-			std::vector<surfel*> new_surfels_two;
-
 			// Split the surfels into two sub-groups along splitting plane defined by eigenvector.
-			for(uint32_t surfel_index = 0; surfel_index < current_cluster.surfels.size(); ++surfel_index)
+			const uint32_t middle = partition_range(cluster_surfels.order, cluster_surfels.partition_buffer,
+													current_cluster.begin, current_cluster.end,
+				[&](uint32_t surfel_index) {
+					const vec3r& color_trans = cluster_surfels.colors[surfel_index];
+					real surfel_side = point_plane_distance(current_cluster.centroid_color, current_cluster.normal_color, color_trans);
+					return surfel_side >= 0;
+				});
+
+			hierarchical_cluster_mk5 halves[2];
+			calculate_cluster_data(cluster_surfels, current_cluster.begin, middle, current_cluster.end, halves, pool);
+
+			for(const auto& half : halves)
 			{
-				surfel* current_surfel = current_cluster.surfels.at(surfel_index);
-				
-				vec3r color_trans = transform_color(current_surfel->color());
-				real surfel_side = point_plane_distance(current_cluster.centroid_color, current_cluster.normal_color, color_trans);
-
-				if(surfel_side >= 0)
-				{
-					new_surfels_one.push_back(current_surfel);
-				}
-				else
+				if(half.size() > 0)
 				{
-					new_surfels_two.push_back(current_surfel);
+					split_cluster_by_position(cluster_surfels, half, max_cluster_size, max_variation_position, cluster_queue, pool);
 				}
 			}
-
-			if(new_surfels_one.size() > 0)
-			{
-				split_cluster_by_position(calculate_cluster_data(new_surfels_one), max_cluster_size, max_variation_position, cluster_queue);
-			}
-			if(new_surfels_two.size() > 0)
-			{
-				split_cluster_by_position(calculate_cluster_data(new_surfels_two), max_cluster_size, max_variation_position, cluster_queue);
-			}
 		}
-		else if (current_cluster.surfels.size() > max_cluster_size || current_cluster.variation_pos > max_variation_position)
+		else if (current_cluster.size() > max_cluster_size || current_cluster.variation_pos > max_variation_position)
 		{
-			split_cluster_by_position(current_cluster, max_cluster_size, max_variation_position, cluster_queue);
+			split_cluster_by_position(cluster_surfels, current_cluster, max_cluster_size, max_variation_position, cluster_queue, pool);
 		}
 		else
 		{
@@ -135,10 +179,11 @@ split_point_cloud(const std::vector<surfel*>& input_surfels,
 		}
 	}
 
-	std::vector<std::vector<surfel*>> output_clusters;
+	std::vector<hierarchical_cluster_mk5> output_clusters;
+	output_clusters.reserve(cluster_queue.size());
 	while(cluster_queue.size() > 0)
 	{
-		output_clusters.push_back(cluster_queue.top().surfels);
+		output_clusters.push_back(cluster_queue.top());
 		cluster_queue.pop();
 	}
 
@@ -148,39 +193,32 @@ split_point_cloud(const std::vector<surfel*>& input_surfels,
 
 
 void reduction_hierarchical_clustering_mk5::
-split_cluster_by_position(const hierarchical_cluster_mk5& input_cluster,
+split_cluster_by_position(hierarchical_cluster_surfels_mk5& cluster_surfels,
+	const hierarchical_cluster_mk5& input_cluster,
 	const uint32_t& max_cluster_size,
 	const real& max_variation,
-	std::priority_queue<hierarchical_cluster_mk5, std::vector<hierarchical_cluster_mk5>, cluster_comparator_mk5>& cluster_queue) const
+	cluster_queue_mk5& cluster_queue,
+	thread_pool& pool) const
 {
-	if(input_cluster.surfels.size() > max_cluster_size || input_cluster.variation_pos > max_variation)
+	if(input_cluster.size() > max_cluster_size || input_cluster.variation_pos > max_variation)
 	{
-		std::vector<surfel*> new_surfels_one;
-		std::vector<surfel*> new_surfels_two;
-
 		// Split the surfels into two sub-groups along splitting plane defined by eigenvector.
-		for(uint32_t surfel_index = 0; surfel_index < input_cluster.surfels.size(); ++surfel_index)
-		{
-			surfel* current_surfel = input_cluster.surfels.at(surfel_index);
-			real surfel_side = point_plane_distance(input_cluster.centroid_pos, input_cluster.normal_pos, current_surfel->pos());
+		const uint32_t middle = partition_range(cluster_surfels.order, cluster_surfels.partition_buffer,
+												input_cluster.begin, input_cluster.end,
+			[&](uint32_t surfel_index) {
+				real surfel_side = point_plane_distance(input_cluster.centroid_pos, input_cluster.normal_pos, cluster_surfels.positions[surfel_index]);
+				return surfel_side >= 0;
+			});
 
-			if(surfel_side >= 0)
-			{
-				new_surfels_one.push_back(current_surfel);
-			}
-			else
-			{
-				new_surfels_two.push_back(current_surfel);
-			}
-		}
+		hierarchical_cluster_mk5 halves[2];
+		calculate_cluster_data(cluster_surfels, input_cluster.begin, middle, input_cluster.end, halves, pool);
 
-		if(new_surfels_one.size() > 0)
-		{
-			cluster_queue.push(calculate_cluster_data(new_surfels_one));
-		}
-		if(new_surfels_two.size() > 0)
+		for(const auto& half : halves)
 		{
-			cluster_queue.push(calculate_cluster_data(new_surfels_two));
+			if(half.size() > 0)
+			{
+				cluster_queue.push(half);
+			}
 		}
 	}
 	else
@@ -191,14 +229,44 @@ split_cluster_by_position(const hierarchical_cluster_mk5& input_cluster,
 
 
 
+void reduction_hierarchical_clustering_mk5::
+calculate_cluster_data(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+					   uint32_t begin, uint32_t middle, uint32_t end,
+					   hierarchical_cluster_mk5 (&halves)[2],
+					   thread_pool& pool) const
+{
+	// Below this size a half is cheaper to process than to hand over.
+	const uint32_t min_concurrent_half_size = 4096;
+
+	const uint32_t bounds[3] = {begin, middle, end};
+	auto calculate_half = [&](size_t half_index, size_t) {
+		halves[half_index] = bounds[half_index] < bounds[half_index + 1]
+			? calculate_cluster_data(cluster_surfels, bounds[half_index], bounds[half_index + 1])
+			: hierarchical_cluster_mk5{bounds[half_index], bounds[half_index + 1]};
+	};
+
+	if(std::min(middle - begin, end - middle) >= min_concurrent_half_size)
+	{
+		pool.parallel_for(0, 2, calculate_half, 1);
+	}
+	else
+	{
+		calculate_half(0, 0);
+		calculate_half(1, 0);
+	}
+}
+
+
+
 hierarchical_cluster_mk5 reduction_hierarchical_clustering_mk5::
-calculate_cluster_data(const std::vector<surfel*>& input_surfels) const
+calculate_cluster_data(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+					   uint32_t begin, uint32_t end) const
 {
 	vec3r centroid_pos;
 	vec3r centroid_color;
 
-	scm::math::mat3d covariance_matrix_pos = calculate_covariance_matrix(input_surfels, centroid_pos);
-	scm::math::mat3d covariance_matrix_color = calculate_covariance_matrix_color(input_surfels, centroid_color);
+	scm::math::mat3d covariance_matrix_pos = calculate_covariance_matrix(cluster_surfels, begin, end, centroid_pos);
+	scm::math::mat3d covariance_matrix_color = calculate_covariance_matrix_color(cluster_surfels, begin, end, centroid_color);
 
 	vec3f normal_pos;
 	vec3f normal_color;
@@ -207,7 +275,8 @@ calculate_cluster_data(const std::vector<surfel*>& input_surfels) const
 	real variation_color = calculate_variation(covariance_matrix_color, normal_color);
 
 	hierarchical_cluster_mk5 new_cluster;
-	new_cluster.surfels = input_surfels;
+	new_cluster.begin = begin;
+	new_cluster.end = end;
 
 	new_cluster.centroid_pos = centroid_pos;
 	new_cluster.centroid_color = centroid_color;
@@ -224,29 +293,30 @@ calculate_cluster_data(const std::vector<surfel*>& input_surfels) const
 
 
 scm::math::mat3d reduction_hierarchical_clustering_mk5::
-calculate_covariance_matrix(const std::vector<surfel*>& surfels_to_sample, vec3r& centroid) const
+calculate_covariance_matrix(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+							uint32_t begin, uint32_t end, vec3r& centroid) const
 {
     scm::math::mat3d covariance_mat = scm::math::mat3d::zero();
-    centroid = calculate_centroid(surfels_to_sample);
+    centroid = calculate_centroid(cluster_surfels, begin, end);
     
     // TODO: The rounding is only necessary for some models (infinite loop otherwise), it would be good to get rid of it completely though.
     bool roundingNecessary = true;
 
-    for (uint32_t surfel_index = 0; surfel_index < surfels_to_sample.size(); ++surfel_index)
+    for (uint32_t order_index = begin; order_index < end; ++order_index)
     {
-		surfel* current_surfel = surfels_to_sample.at(surfel_index);
+		const vec3r& pos = cluster_surfels.positions[cluster_surfels.order[order_index]];
         
-        covariance_mat.m00 += std::pow(current_surfel->pos().x-centroid.x, 2);
-        covariance_mat.m01 += (current_surfel->pos().x-centroid.x) * (current_surfel->pos().y - centroid.y);
-        covariance_mat.m02 += (current_surfel->pos().x-centroid.x) * (current_surfel->pos().z - centroid.z);
+        covariance_mat.m00 += std::pow(pos.x-centroid.x, 2);
+        covariance_mat.m01 += (pos.x-centroid.x) * (pos.y - centroid.y);
+        covariance_mat.m02 += (pos.x-centroid.x) * (pos.z - centroid.z);
 
-        covariance_mat.m03 += (current_surfel->pos().y-centroid.y) * (current_surfel->pos().x - centroid.x);
-        covariance_mat.m04 += std::pow(current_surfel->pos().y-centroid.y, 2);
-        covariance_mat.m05 += (current_surfel->pos().y-centroid.y) * (current_surfel->pos().z - centroid.z);
+        covariance_mat.m03 += (pos.y-centroid.y) * (pos.x - centroid.x);
+        covariance_mat.m04 += std::pow(pos.y-centroid.y, 2);
+        covariance_mat.m05 += (pos.y-centroid.y) * (pos.z - centroid.z);
 
-        covariance_mat.m06 += (current_surfel->pos().z-centroid.z) * (current_surfel->pos().x - centroid.x);
-        covariance_mat.m07 += (current_surfel->pos().z-centroid.z) * (current_surfel->pos().y - centroid.y);
-        covariance_mat.m08 += std::pow(current_surfel->pos().z-centroid.z, 2);
+        covariance_mat.m06 += (pos.z-centroid.z) * (pos.x - centroid.x);
+        covariance_mat.m07 += (pos.z-centroid.z) * (pos.y - centroid.y);
+        covariance_mat.m08 += std::pow(pos.z-centroid.z, 2);
     }
 
     if (roundingNecessary)
@@ -264,15 +334,15 @@ calculate_covariance_matrix(const std::vector<surfel*>& surfels_to_sample, vec3r
 
 
 scm::math::mat3d reduction_hierarchical_clustering_mk5::
-calculate_covariance_matrix_color(const std::vector<surfel*>& surfels_to_sample, vec3r& centroid) const
+calculate_covariance_matrix_color(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+								  uint32_t begin, uint32_t end, vec3r& centroid) const
 {
     scm::math::mat3d covariance_mat = scm::math::mat3d::zero();
-    centroid = calculate_centroid_color(surfels_to_sample);
+    centroid = calculate_centroid_color(cluster_surfels, begin, end);
 
-    for (uint32_t surfel_index = 0; surfel_index < surfels_to_sample.size(); ++surfel_index)
+    for (uint32_t order_index = begin; order_index < end; ++order_index)
     {
-		surfel* current_surfel = surfels_to_sample.at(surfel_index);
-		vec3r color_trans = transform_color(current_surfel->color());
+		const vec3r& color_trans = cluster_surfels.colors[cluster_surfels.order[order_index]];
 
         covariance_mat.m00 += std::pow(color_trans.x - centroid.x, 2);
         covariance_mat.m01 += (color_trans.x-centroid.x) * (color_trans.y - centroid.y);
@@ -302,24 +372,14 @@ real reduction_hierarchical_clustering_mk5::
 calculate_variation(const scm::math::mat3d& covariance_matrix, vec3f& normal) const
 {
 	//solve for eigenvectors
-    real* eigenvalues = new real[3];
-    real** eigenvectors = new real*[3];
-    for (int i = 0; i < 3; ++i) {
-       eigenvectors[i] = new real[3];
-    }
-
-    jacobi_rotation(covariance_matrix, eigenvalues, eigenvectors);
+    real eigenvalues[3];
+    vec3r eigenvectors[3];
+    eigen_solver::solve(covariance_matrix, eigenvalues, eigenvectors);
 
     real variation = eigenvalues[0] / (eigenvalues[0] + eigenvalues[1] + eigenvalues[2]);
 
     // Use eigenvector with highest magnitude as splitting plane normal.
-    normal = scm::math::vec3f(eigenvectors[0][2], eigenvectors[1][2], eigenvectors[2][2]);
-
-    delete[] eigenvalues;
-    for (int i = 0; i < 3; ++i) {
-       delete[] eigenvectors[i];
-    }
-    delete[] eigenvectors;
+    normal = scm::math::vec3f(eigenvectors[2]);
 
 	return variation;
 }
@@ -327,64 +387,64 @@ calculate_variation(const scm::math::mat3d& covariance_matrix, vec3f& normal) co
 
 
 vec3r reduction_hierarchical_clustering_mk5::
-calculate_centroid(const std::vector<surfel*>& surfels_to_sample) const
+calculate_centroid(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+				   uint32_t begin, uint32_t end) const
 {
 	vec3r centroid = vec3r(0, 0, 0);
 
-	for(uint32_t surfel_index = 0; surfel_index < surfels_to_sample.size(); ++surfel_index)
+	for(uint32_t order_index = begin; order_index < end; ++order_index)
 	{
-		surfel* current_surfel = surfels_to_sample.at(surfel_index);
-		centroid = centroid + current_surfel->pos();
+		centroid = centroid + cluster_surfels.positions[cluster_surfels.order[order_index]];
 	}
 
-	return centroid / surfels_to_sample.size();
+	return centroid / (end - begin);
 }
 
 
 
 vec3r reduction_hierarchical_clustering_mk5::
-calculate_centroid_color(const std::vector<surfel*>& surfels_to_sample) const
+calculate_centroid_color(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+						 uint32_t begin, uint32_t end) const
 {
 	vec3r centroid = vec3r(0, 0, 0);
 
-	for(uint32_t surfel_index = 0; surfel_index < surfels_to_sample.size(); ++surfel_index)
+	for(uint32_t order_index = begin; order_index < end; ++order_index)
 	{
-		surfel* current_surfel = surfels_to_sample.at(surfel_index);
-		vec3r color_trans = transform_color(current_surfel->color());
-		centroid = centroid + color_trans;
+		centroid = centroid + cluster_surfels.colors[cluster_surfels.order[order_index]];
 	}
 
-	return centroid / surfels_to_sample.size();
+	return centroid / (end - begin);
 }
 
 
 
 surfel reduction_hierarchical_clustering_mk5::
-create_surfel_from_cluster(const std::vector<surfel*>& surfels_to_sample) const
+create_surfel_from_cluster(const hierarchical_cluster_surfels_mk5& cluster_surfels,
+						   const hierarchical_cluster_mk5& cluster) const
 {
 	vec3r centroid = vec3r(0, 0, 0);
 	vec3f normal = vec3f(0, 0, 0);
 	vec3r color_overrun = vec3r(0, 0, 0);
 	real radius = 0;
 
-	for(uint32_t surfel_index = 0; surfel_index < surfels_to_sample.size(); ++surfel_index)
+	for(uint32_t order_index = cluster.begin; order_index < cluster.end; ++order_index)
 	{
-		surfel* current_surfel = surfels_to_sample.at(surfel_index);
+		const surfel* current_surfel = cluster_surfels.surfels[cluster_surfels.order[order_index]];
 
 		centroid = centroid + current_surfel->pos();
 		normal = normal + current_surfel->normal();
 		color_overrun = color_overrun + current_surfel->color();
 	}
 
-	centroid = centroid / (double)surfels_to_sample.size();
-	normal = normal / surfels_to_sample.size();
-	color_overrun = color_overrun / surfels_to_sample.size();
+	centroid = centroid / (double)cluster.size();
+	normal = normal / cluster.size();
+	color_overrun = color_overrun / cluster.size();
 
 	// Compute radius by taking max radius of cluster surfels and max distance from centroid.
 	real highest_distance = 0;
-	for(uint32_t surfel_index = 0; surfel_index < surfels_to_sample.size(); ++surfel_index)
+	for(uint32_t order_index = cluster.begin; order_index < cluster.end; ++order_index)
 	{
-		surfel* current_surfel = surfels_to_sample.at(surfel_index);
+		const surfel* current_surfel = cluster_surfels.surfels[cluster_surfels.order[order_index]];
 		real distance_centroid_surfel = scm::math::length(centroid - current_surfel->pos());
 
 		if(distance_centroid_surfel > highest_distance)
@@ -523,140 +583,5 @@ transform_color(const vec3b& color) const
 
 
 
-void reduction_hierarchical_clustering_mk5::
-jacobi_rotation(const scm::math::mat3d& _matrix, double* eigenvalues, double** eigenvectors) const
-{
-    unsigned int max_iterations = 10;
-    double max_error = 0.00000001;
-    unsigned int dim = 3;
-
-    double iR1[3][3];
-    iR1[0][0] = _matrix[0];
-    iR1[0][1] = _matrix[1];
-    iR1[0][2] = _matrix[2];
-    iR1[1][0] = _matrix[3];
-    iR1[1][1] = _matrix[4];
-    iR1[1][2] = _matrix[5];
-    iR1[2][0] = _matrix[6];
-    iR1[2][1] = _matrix[7];
-    iR1[2][2] = _matrix[8];
-
-
-    for (uint32_t i = 0; i <= dim-1; ++i){
-        eigenvectors[i][i] = 1.0;
-        for (uint32_t j = 0; j <= dim-1; ++j){
-            if (i != j) {
-               eigenvectors[i][j] = 0.0;
-            }
-        }
-    }
-
-    uint32_t iteration = 0;
-    uint32_t p, q;
-
-    while (iteration < max_iterations){
-
-        double max_diff = 0.0;
-
-        for (uint32_t i = 0; i < dim-1 ; ++i){
-            for (uint32_t j = i+1; j < dim ; ++j){
-                long double diff = std::abs(iR1[i][j]);
-                if (i != j && diff >= max_diff){
-                    max_diff = diff;
-                    p = i;
-                    q = j;
-                }
-            }
-        }
-
-        if (max_diff < max_error){
-            for (uint32_t i = 0; i < dim; ++i){
-                eigenvalues[i] = iR1[i][i];
-            }
-            break;
-        }
-
-        long double x = -iR1[p][q];
-        long double y = (iR1[q][q] - iR1[p][p]) / 2.0;
-        long double omega = x / sqrt(x * x + y * y);
-
-        if (y < 0.0) {
-            omega = -omega;
-        }
-
-        long double sn = 1.0 + sqrt(1.0 - omega*omega);
-        sn = omega / sqrt(2.0 * sn);
-        long double cn = sqrt(1.0 - sn*sn);
-
-        max_diff = iR1[p][p];
-
-        iR1[p][p] = max_diff*cn*cn + iR1[q][q]*sn*sn + iR1[p][q]*omega;
-        iR1[q][q] = max_diff*sn*sn + iR1[q][q]*cn*cn - iR1[p][q]*omega;
-        iR1[p][q] = 0.0;
-        iR1[q][p] = 0.0;
-
-        for (uint32_t j = 0; j <= dim-1; ++j){
-            if (j != p && j != q){
-                max_diff = iR1[p][j];
-                iR1[p][j] = max_diff*cn + iR1[q][j]*sn;
-                iR1[q][j] = -max_diff*sn + iR1[q][j]*cn;
-            }
-        }
-
-        for (uint32_t i = 0; i <= dim-1; ++i){
-            if (i != p && i != q){
-                max_diff = iR1[i][p];
-                iR1[i][p] = max_diff*cn + iR1[i][q]*sn;
-                iR1[i][q] = -max_diff*sn + iR1[i][q]*cn;
-            }
-        }
-
-        for (uint32_t i = 0; i <= dim-1; ++i){
-            max_diff = eigenvectors[i][p];
-            eigenvectors[i][p] = max_diff*cn + eigenvectors[i][q]*sn;
-            eigenvectors[i][q] = -max_diff*sn + eigenvectors[i][q]*cn;
-        }
-
-        ++iteration;
-    }
-
-    
-    eigsrt_jacobi(dim, eigenvalues, eigenvectors);
-}
-
-
-
-void reduction_hierarchical_clustering_mk5::
-eigsrt_jacobi(int dim, double* eigenvalues, double** eigenvectors) const
-{
-    for (int i = 0; i < dim; ++i)
-    {
-        int k = i;
-        double v = eigenvalues[k];
-
-        for (int j = i + 1; j < dim; ++j)
-        {
-            if (eigenvalues[j] < v) // eigenvalues[j] <= v ?
-            { 
-                k = j;
-                v = eigenvalues[k];
-            }
-        }
-
-        if (k != i)
-        {
-            eigenvalues[k] = eigenvalues[i];
-            eigenvalues[i] = v;
-
-            for (int j = 0; j < dim; ++j)
-            {
-                v = eigenvectors[j][i];
-                eigenvectors[j][i] = eigenvectors[j][k];
-                eigenvectors[j][k] = v;
-            }
-        }
-    }
-}
-
 } // namespace pre
-} // namespace lamure
\ No newline at end of file
+} // namespace lamure
@@ -8,6 +8,9 @@
 #include <lamure/pre/reduction_k_clustering.h>
 
 #include <lamure/pre/basic_algorithms.h>
+#include <lamure/pre/bvh.h>
+#include <lamure/pre/indexed_heap.h>
+#include <lamure/pre/spatial_hash.h>
 #include <lamure/utils.h>
 
 #include <queue>
@@ -17,9 +20,6 @@
 #include <math.h>  //   floor
 #include <cmath>  //    std::fabs
 
-#include <forward_list>
-#include <iterator> 
-
 namespace lamure {
 namespace pre {
 
@@ -51,26 +51,27 @@ get_largest_dim(vec3f const& avg_normal) const{
 
 }
 
-shared_cluster_surfel_vector reduction_k_clustering::
-get_initial_cluster_seeds(vec3f const& avg_normal, shared_cluster_surfel_vector const& input_surfels) const{
+void reduction_k_clustering::
+get_initial_cluster_seeds(vec3f const& avg_normal, cluster_surfel_set& cluster_surfels) const{
     //hash-based grouping
     //reference: http://www.ifi.uzh.ch/vmml/publications/older-puclications/DeferredBlending.pdf 
 
     const int group_num = 8; //set as member var. if user-defind value needed  but then consider different index distribution function depending on this mun.
-    std::array <shared_cluster_surfel_vector, group_num> cluster_array; // container with 8 (in this case) subgroups
+    std::array <std::vector<uint32_t>, group_num> cluster_array; // container with 8 (in this case) subgroups
 
     //find largest dimention of the average normal vector
     int avg_dim = get_largest_dim(avg_normal); 
 
-    for (auto const& current_surfel : input_surfels){
+    for (uint32_t surfel_id = 0; surfel_id < cluster_surfels.size(); ++surfel_id){
+        surfel const& current_surfel = cluster_surfels.surfels[surfel_id];
 
         uint16_t x_coord, y_coord ;  //variables to store 2D coordinate mapping
 
-        x_coord = std::floor((current_surfel->contained_surfel->pos()[(avg_dim + 1) % 3] )/(current_surfel->contained_surfel->radius()));
-        y_coord = std::floor((current_surfel->contained_surfel->pos()[(avg_dim + 2) % 3] )/(current_surfel->contained_surfel->radius()));
+        x_coord = std::floor((current_surfel.pos()[(avg_dim + 1) % 3] )/(current_surfel.radius()));
+        y_coord = std::floor((current_surfel.pos()[(avg_dim + 2) % 3] )/(current_surfel.radius()));
         uint16_t group_id = (x_coord*3 + y_coord) % group_num; // formula might need to be reconsidered for different group_num
 
-        cluster_array[group_id].push_back(current_surfel);
+        cluster_array[group_id].push_back(surfel_id);
     }
 
     //determine which array member hast biggest simber of elememts
@@ -88,25 +89,23 @@ get_initial_cluster_seeds(vec3f const& avg_normal, shared_cluster_surfel_vector
     }
 
     //surfels hashed to the largest group become the cluster seed set M
-    for(auto const& current_surfel : cluster_array[max_size_group_id]){
-       update_cluster_membership(current_surfel, true);
+    for(auto const surfel_id : cluster_array[max_size_group_id]){
+        cluster_surfels.member_of_M[surfel_id] = true;
     }
-
-    return cluster_array[max_size_group_id];
 }
 
 
 vec3f reduction_k_clustering::  
-compute_avg_normal(shared_cluster_surfel_vector const& input_surfels) const{
+compute_avg_normal(cluster_surfel_set const& cluster_surfels) const{
 
     vec3f avg_normal (0.0, 0.0, 0.0);
-    if( input_surfels.size() != 0){
+    if( cluster_surfels.size() != 0){
 
-        for (auto const& current_cluster_surfel_ptr : input_surfels) {
-           avg_normal += current_cluster_surfel_ptr->contained_surfel->normal();
+        for (auto const& current_surfel : cluster_surfels.surfels) {
+           avg_normal += current_surfel.normal();
         }
 
-        avg_normal /= input_surfels.size();
+        avg_normal /= cluster_surfels.size();
 
         if( scm::math::length(avg_normal) != 0.0) {
             avg_normal = scm::math::normalize(avg_normal);
@@ -118,94 +117,136 @@ compute_avg_normal(shared_cluster_surfel_vector const& input_surfels) const{
 
 
 void reduction_k_clustering:: //functionality taken from entropy reduction strategy
-assign_locally_overlapping_neighbours(shared_cluster_surfel current_surfel_ptr,
-                                      shared_cluster_surfel_vector& input_surfel_ptr_array) const{
-
+assign_locally_overlapping_neighbours(cluster_surfel_set& cluster_surfels,
+                                      const bvh& tree) const{
+
+    // two surfels can only overlap if their bounding spheres do, so only
+    // surfels closer than the own radius plus the largest one are tested
+    real max_radius = 0.0;
+    std::vector<vec3r> positions;
+    positions.reserve(cluster_surfels.size());
+    for (auto const& current_surfel : cluster_surfels.surfels) {
+        max_radius = std::max(max_radius, current_surfel.radius());
+        positions.push_back(current_surfel.pos());
+    }
 
-    shared_cluster_surfel_vector neighbours_found;
-    shared_surfel target_surfel = current_surfel_ptr->contained_surfel;
+    spatial_hash surfel_hash;
+    surfel_hash.build(positions, 2.0 * max_radius);
 
-    for(auto const& input_sufrel_ptr : input_surfel_ptr_array){
+    thread_pool& pool = tree.pool();
+    std::vector<std::vector<uint32_t>> worker_candidates(pool.num_threads());
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> worker_neighbours(pool.num_threads());
 
-        // avoid overlaps with the surfel itself
-        if (current_surfel_ptr->surfel_id != input_sufrel_ptr->surfel_id ||
-            current_surfel_ptr->node_id   != input_sufrel_ptr->node_id) {
+    pool.parallel_for(0, cluster_surfels.size(), [&](size_t const surfel_id, size_t const worker) {
+        surfel const& target_surfel = cluster_surfels.surfels[surfel_id];
 
-            shared_surfel contained_surfel_ptr = input_sufrel_ptr->contained_surfel;
+        std::vector<uint32_t>& candidates = worker_candidates[worker];
+        surfel_hash.find_in_radius(target_surfel.pos(), target_surfel.radius() + max_radius, candidates);
 
-            if( surfel::intersect(*target_surfel, *contained_surfel_ptr) ) {
-                neighbours_found.push_back( input_sufrel_ptr );
-            } 
+        for (auto const candidate_id : candidates) {
+            // avoid overlaps with the surfel itself
+            if (candidate_id != surfel_id &&
+                surfel::intersect(target_surfel, cluster_surfels.surfels[candidate_id])) {
+                worker_neighbours[worker].emplace_back(uint32_t(surfel_id), candidate_id);
+            }
         }
+    }, 64);
+
+    std::vector<std::pair<uint32_t, uint32_t>> neighbour_pairs;
+    for (auto const& current_neighbours : worker_neighbours) {
+        neighbour_pairs.insert(neighbour_pairs.end(), current_neighbours.begin(), current_neighbours.end());
     }
+    std::sort(neighbour_pairs.begin(), neighbour_pairs.end());
 
-    current_surfel_ptr->neighbours.insert(current_surfel_ptr->neighbours.end(),
-                                        neighbours_found.begin(), neighbours_found.end());
+    cluster_surfels.neighbour_offsets.assign(cluster_surfels.size() + 1, 0);
+    cluster_surfels.neighbour_ids.resize(neighbour_pairs.size());
+    for (size_t pair_idx = 0; pair_idx < neighbour_pairs.size(); ++pair_idx) {
+        ++cluster_surfels.neighbour_offsets[neighbour_pairs[pair_idx].first + 1];
+        cluster_surfels.neighbour_ids[pair_idx] = neighbour_pairs[pair_idx].second;
+    }
+    for (size_t surfel_id = 0; surfel_id < cluster_surfels.size(); ++surfel_id) {
+        cluster_surfels.neighbour_offsets[surfel_id + 1] += cluster_surfels.neighbour_offsets[surfel_id];
+    }
 }
 
 void reduction_k_clustering::  
-compute_overlap(shared_cluster_surfel current_surfel_ptr, bool look_in_M) const {
+compute_overlap(cluster_surfel_set& cluster_surfels, uint32_t surfel_id, bool look_in_M) const {
     //use only neighbours belonging to either set M or set S-M in order to compute overlap
 
     real overlap = 0;
-    shared_surfel target_neighbour_surfel;
-    real distance = 0.0;
-
-    for(auto const& current_neighbour : current_surfel_ptr->neighbours){
-        if (current_neighbour->member_of_M == look_in_M){
-        target_neighbour_surfel = current_neighbour->contained_surfel;
-        distance = compute_distance(current_surfel_ptr, current_neighbour);
-        overlap += ((target_neighbour_surfel->radius() + current_surfel_ptr->contained_surfel->radius()) - distance);
+    real const radius = cluster_surfels.surfels[surfel_id].radius();
+
+    for(auto neighbour = cluster_surfels.neighbours_begin(surfel_id);
+        neighbour != cluster_surfels.neighbours_end(surfel_id); ++neighbour){
+        if (bool(cluster_surfels.member_of_M[*neighbour]) == look_in_M){
+            real distance = compute_distance(cluster_surfels, surfel_id, *neighbour);
+            overlap += ((cluster_surfels.surfels[*neighbour].radius() + radius) - distance);
         }
-        
     }
 
-    current_surfel_ptr->overlap = overlap;
+    cluster_surfels.overlaps[surfel_id] = overlap;
 }
 
 real reduction_k_clustering::
-compute_distance(shared_cluster_surfel first_surfel_ptr, shared_cluster_surfel second_surfel_ptr) const {
-    return scm::math::length(first_surfel_ptr->contained_surfel->pos() - second_surfel_ptr->contained_surfel->pos()); //
+compute_distance(cluster_surfel_set const& cluster_surfels,
+                 uint32_t first_surfel_id,
+                 uint32_t second_surfel_id) const {
+    return scm::math::length(cluster_surfels.surfels[first_surfel_id].pos() - cluster_surfels.surfels[second_surfel_id].pos());
 }
 
 // compute deviation to all neighbours, independent on their set membership 
-void reduction_k_clustering:: 
-compute_deviation(shared_cluster_surfel current_surfel_ptr) const {
+real reduction_k_clustering:: 
+compute_deviation(cluster_surfel_set const& cluster_surfels, uint32_t surfel_id) const {
 
     real deviation = 0;
-    shared_surfel target_neighbour_surfel;
-
+    vec3f const& normal = cluster_surfels.surfels[surfel_id].normal();
 
-    for(auto const& current_neighbour : current_surfel_ptr->neighbours){
-        target_neighbour_surfel = current_neighbour->contained_surfel;
-        deviation += 1 - std::fabs( scm::math::dot(current_surfel_ptr->contained_surfel->normal(), target_neighbour_surfel->normal()));
+    for(auto neighbour = cluster_surfels.neighbours_begin(surfel_id);
+        neighbour != cluster_surfels.neighbours_end(surfel_id); ++neighbour){
+        deviation += 1 - std::fabs( scm::math::dot(normal, cluster_surfels.surfels[*neighbour].normal()));
     }
 
-    current_surfel_ptr->deviation = deviation;
+    return deviation;
 }
 
 void reduction_k_clustering::
-resolve_oversampling(shared_cluster_surfel_vector& surfel_ptr_set_m) const {
-    std::sort(surfel_ptr_set_m.begin(), surfel_ptr_set_m.end(), max_overlap_order());
+resolve_oversampling(cluster_surfel_set& cluster_surfels) const {
     real min_overlap = 0;
-    shared_cluster_surfel_vector temp_neighbour_list;
 
-    //maximal overlap computed
-    shared_cluster_surfel m_member =  surfel_ptr_set_m.back();
-    
-    while( !surfel_ptr_set_m.empty() ) {
+    //members of M with maximal overlap on top, ties broken by index
+    auto const max_overlap_first = [&cluster_surfels](size_t const left_id, size_t const right_id) {
+        real const left_overlap = cluster_surfels.overlaps[left_id];
+        real const right_overlap = cluster_surfels.overlaps[right_id];
+        if (left_overlap != right_overlap) {
+            return left_overlap > right_overlap;
+        }
+        return left_id < right_id;
+    };
+    indexed_heap<decltype(max_overlap_first)> set_M(cluster_surfels.size(), max_overlap_first);
 
-        shared_cluster_surfel m_member =  surfel_ptr_set_m.back();
+    for (uint32_t surfel_id = 0; surfel_id < cluster_surfels.size(); ++surfel_id) {
+        if (cluster_surfels.member_of_M[surfel_id]) {
+            compute_overlap(cluster_surfels, surfel_id, true);
+            set_M.push(surfel_id);
+        }
+    }
+
+    //remove the member of maximal overlap until M is overlap-free, only the
+    //neighbours of a removed member change their overlap
+    while( !set_M.empty() ) {
+        uint32_t const m_member = set_M.top();
 
-        if(m_member->overlap > min_overlap){
-            temp_neighbour_list = surfel_ptr_set_m.back()->neighbours;
+        if(cluster_surfels.overlaps[m_member] > min_overlap){
+            cluster_surfels.member_of_M[m_member] = false;
+            set_M.pop();
 
-            update_cluster_membership(m_member, false);
-            surfel_ptr_set_m.pop_back();
-            for(auto const& current_temp_neighbour : temp_neighbour_list){
-                compute_overlap(current_temp_neighbour, true);
+            for(auto neighbour = cluster_surfels.neighbours_begin(m_member);
+                neighbour != cluster_surfels.neighbours_end(m_member); ++neighbour){
+                if (set_M.contains(*neighbour)) {
+                    compute_overlap(cluster_surfels, *neighbour, true);
+                    set_M.update(*neighbour);
+                }
             }
-            std::sort(surfel_ptr_set_m.begin(), surfel_ptr_set_m.end(), max_overlap_order());
         } else {
             break;
         }
@@ -214,104 +255,126 @@ resolve_oversampling(shared_cluster_surfel_vector& surfel_ptr_set_m) const {
 }
 
 void reduction_k_clustering::
-resolve_undersampling(shared_cluster_surfel_vector& input_surfel_ptr_array) const{
-
+resolve_undersampling(cluster_surfel_set& cluster_surfels) const{
 
-    shared_cluster_surfel_vector new_set_M;
-
-    for(auto const& current_surfel_ptr : input_surfel_ptr_array){
-        shared_cluster_surfel_vector neighbours = current_surfel_ptr->neighbours;
+    //surfels which are not covered by any member of M become members themselves
+    for (uint32_t surfel_id = 0; surfel_id < cluster_surfels.size(); ++surfel_id){
+        if(cluster_surfels.member_of_M[surfel_id]){
+            continue;
+        }
 
         bool member_neighbours = false; 
-        if(current_surfel_ptr->member_of_M == false){
-            for(auto const& current_neighbour : neighbours){
-                if(current_neighbour->member_of_M == true){
-                     member_neighbours = true;
-                }
-                    
+        for(auto neighbour = cluster_surfels.neighbours_begin(surfel_id);
+            neighbour != cluster_surfels.neighbours_end(surfel_id); ++neighbour){
+            if(cluster_surfels.member_of_M[*neighbour]){
+                member_neighbours = true;
+                break;
             }
-
-        }  
+        }
 
         if(!member_neighbours){
-            new_set_M.push_back(current_surfel_ptr);
-            update_cluster_membership(current_surfel_ptr, true);
+            cluster_surfels.member_of_M[surfel_id] = true;
         }
     }
-
-    input_surfel_ptr_array.insert(input_surfel_ptr_array.end(), new_set_M.begin(), new_set_M.end());    
 }
 
 void reduction_k_clustering::
-update_cluster_membership(shared_cluster_surfel current_surfel_ptr,
-                          bool is_member) const {
+remove_surfels(cluster_surfel_set& cluster_surfels, size_t num_desired_surfels) const {
+
+    //the deviation does not depend on the membership, so the members are
+    //ranked once
+    std::vector<std::pair<real, uint32_t>> deviation_members;
+    for (uint32_t surfel_id = 0; surfel_id < cluster_surfels.size(); ++surfel_id) {
+        if (cluster_surfels.member_of_M[surfel_id]) {
+            deviation_members.emplace_back(compute_deviation(cluster_surfels, surfel_id), surfel_id);
+        }
+    }
 
-    current_surfel_ptr->member_of_M = is_member;
+    if (deviation_members.size() <= num_desired_surfels) {
+        return;
+    }
 
-}
+    size_t const num_surfels_to_remove = deviation_members.size() - num_desired_surfels;
+    std::nth_element(deviation_members.begin(),
+                     deviation_members.begin() + (num_surfels_to_remove - 1),
+                     deviation_members.end());
 
-void reduction_k_clustering::
-remove_surfel(shared_cluster_surfel_vector& surfel_ptr_set_M) const {
-    std::sort(surfel_ptr_set_M.begin(), surfel_ptr_set_M.end(),  min_deviation_order());
-    surfel_ptr_set_M.pop_back();
+    for (size_t member_idx = 0; member_idx < num_surfels_to_remove; ++member_idx) {
+        cluster_surfels.member_of_M[deviation_members[member_idx].second] = false;
+    }
 }
 
 void reduction_k_clustering:: 
-add_surfel(shared_cluster_surfel_vector& surfel_ptr_set_M,
-           shared_cluster_surfel_vector& total_surfel_set) const {
+add_surfels(cluster_surfel_set& cluster_surfels, size_t num_desired_surfels) const {
 
-    
-    shared_cluster_surfel_vector complement_set;
-                          
-    //sort out and store the complement set of M                        
-    for (auto const& current_surfel_ptr : total_surfel_set){
-         if(current_surfel_ptr->member_of_M == false){
-            complement_set.push_back(current_surfel_ptr);
-         }
+    size_t num_members = std::count(cluster_surfels.member_of_M.begin(), cluster_surfels.member_of_M.end(), true);
+    if (num_members >= num_desired_surfels) {
+        return;
     }
 
-    //sum up total overlap of a compelement-member surfel with set-M-member neigbours
-    for (auto const& complement_set_current_cluster_surfel : complement_set) {
-         compute_overlap(complement_set_current_cluster_surfel, true);
-    }    
-
-    //creat new surfel to add to set M
-    shared_cluster_surfel cluster_surfel_to_add; 
-
-    //sort all surfels in the complement set base on overlap 
-    std::sort(complement_set.begin(), 
-              complement_set.end(), 
-              min_overlap_order() );
+    //complement of M with minimal overlap with M on top, ties broken by index
+    auto const min_overlap_first = [&cluster_surfels](size_t const left_id, size_t const right_id) {
+        real const left_overlap = cluster_surfels.overlaps[left_id];
+        real const right_overlap = cluster_surfels.overlaps[right_id];
+        if (left_overlap != right_overlap) {
+            return left_overlap < right_overlap;
+        }
+        return left_id < right_id;
+    };
+    indexed_heap<decltype(min_overlap_first)> complement_set(cluster_surfels.size(), min_overlap_first);
 
-        
-    cluster_surfel_to_add = complement_set.back();
-    surfel_ptr_set_M.push_back(complement_set.back());
-    update_cluster_membership(cluster_surfel_to_add, true);
-    //^complement_set.pop_back();    
+    //sum up total overlap of a compelement-member surfel with set-M-member neigbours
+    for (uint32_t surfel_id = 0; surfel_id < cluster_surfels.size(); ++surfel_id) {
+        if (!cluster_surfels.member_of_M[surfel_id]) {
+            compute_overlap(cluster_surfels, surfel_id, true);
+            complement_set.push(surfel_id);
+        }
+    }
 
+    //only the neighbours of an added surfel change their overlap with M
+    while (num_members < num_desired_surfels && !complement_set.empty()) {
+        uint32_t const surfel_to_add = complement_set.top();
+        complement_set.pop();
+        cluster_surfels.member_of_M[surfel_to_add] = true;
+        ++num_members;
+
+        for(auto neighbour = cluster_surfels.neighbours_begin(surfel_to_add);
+            neighbour != cluster_surfels.neighbours_end(surfel_to_add); ++neighbour){
+            if (complement_set.contains(*neighbour)) {
+                compute_overlap(cluster_surfels, *neighbour, true);
+                complement_set.update(*neighbour);
+            }
+        }
+    }
 }
 
 void reduction_k_clustering::
-merge(shared_cluster_surfel_vector& final_cluster_surfel_set) const
+merge(cluster_surfel_set& cluster_surfels, surfel_vector& output_surfels) const
 {   
-    vec3r avg_position = vec3r(0.0, 0.0, 0.0);    
-    vec3r avg_color = vec3r(0.0, 0.0, 0.0);
-
-    shared_cluster_surfel_vector current_temp_neighbour_vector;
-    for(auto const& current_surfel_ptr : final_cluster_surfel_set){
-        avg_position = current_surfel_ptr->contained_surfel->pos();
-        avg_color = current_surfel_ptr->contained_surfel->color();
-        current_temp_neighbour_vector = current_surfel_ptr->neighbours;
-
-        for(auto const& current_neighbour : current_temp_neighbour_vector){
-            avg_position += current_neighbour->contained_surfel->pos();
-            avg_color += current_neighbour->contained_surfel->color();
-          
+    //average color and position of the members of M with their neighbours.
+    //members are merged in place, later ones see the merged attributes
+    for (uint32_t surfel_id = 0; surfel_id < cluster_surfels.size(); ++surfel_id) {
+        if (!cluster_surfels.member_of_M[surfel_id]) {
+            continue;
+        }
+
+        surfel& current_surfel = cluster_surfels.surfels[surfel_id];
+        vec3r avg_position = current_surfel.pos();
+        vec3r avg_color = current_surfel.color();
+
+        for(auto neighbour = cluster_surfels.neighbours_begin(surfel_id);
+            neighbour != cluster_surfels.neighbours_end(surfel_id); ++neighbour){
+            avg_position += cluster_surfels.surfels[*neighbour].pos();
+            avg_color += cluster_surfels.surfels[*neighbour].color();
         }
-        avg_position /= (current_temp_neighbour_vector.size() + 1 );
-        avg_color /= (current_temp_neighbour_vector.size() + 1 );
-        current_surfel_ptr->contained_surfel->pos() = avg_position;
-        current_surfel_ptr->contained_surfel->color() = vec3b(avg_color[0], avg_color[1], avg_color[2]) ;
+
+        size_t const num_neighbours = cluster_surfels.num_neighbours(surfel_id);
+        avg_position /= (num_neighbours + 1 );
+        avg_color /= (num_neighbours + 1 );
+        current_surfel.pos() = avg_position;
+        current_surfel.color() = vec3b(avg_color[0], avg_color[1], avg_color[2]) ;
+
+        output_surfels.push_back(current_surfel);
     }
 } 
 
@@ -403,12 +466,9 @@ create_lod(real& reduction_error,
     //^^create surfel array for subsampling
     surfel_mem_array mem_array_temp(std::make_shared<surfel_vector>(surfel_vector()), 0, 0);
 
-    //container for all input surfels including [total set S]
-    shared_cluster_surfel_vector cluster_surfel_array;
-
-
-    //cluster set M
-    shared_cluster_surfel_vector cluster_surfel_output_array;
+    //container for all input surfels including [total set S], membership in
+    //the cluster set M is flagged per surfel
+    cluster_surfel_set cluster_surfels;
 
     //^^ interm. results: surfel + node_id
     std::pair<surfel_mem_array, uint32_t> sufel_node_pair;
@@ -464,58 +524,41 @@ create_lod(real& reduction_error,
                 continue;
             }              
 
-            // only place where shared pointers should be created
-            cluster_surfel_array.push_back( std::make_shared<cluster_surfel>( cluster_surfel(current_surfel, surfel_id, node_id)  ) );
+            cluster_surfels.surfels.push_back(current_surfel);
        }
     }
 
+    cluster_surfels.overlaps.assign(cluster_surfels.size(), 0.0);
+    cluster_surfels.member_of_M.assign(cluster_surfels.size(), false);
+
     //define basic features for every cluster_surfel   
-    for (auto const& target_surfel : cluster_surfel_array){
-        assign_locally_overlapping_neighbours(target_surfel, cluster_surfel_array);
-        compute_overlap(target_surfel, false);
-        compute_deviation(target_surfel);
-    }
+    assign_locally_overlapping_neighbours(cluster_surfels, tree);
 
     //average nomal, used in computaions of the hash-based grouping
-    vec3f avg_normal = compute_avg_normal(cluster_surfel_array);
+    vec3f avg_normal = compute_avg_normal(cluster_surfels);
 
 
 //sort all surfels into 2 sets
     //- set M - bais for output resul
     //- the complement of set M - all surfel which will not contribute to output
-    cluster_surfel_output_array = get_initial_cluster_seeds (avg_normal, cluster_surfel_array);
+    get_initial_cluster_seeds (avg_normal, cluster_surfels);
 
-    for (auto const& target_surfel : cluster_surfel_output_array ){    
-        compute_overlap(target_surfel, true);       
-    }
-    
 //make sure surfels selected in M are overlap-free and unifromly distributed
-    resolve_oversampling(cluster_surfel_output_array);   
-    resolve_undersampling(cluster_surfel_output_array);
+    resolve_oversampling(cluster_surfels);   
+    resolve_undersampling(cluster_surfels);
 
     
 //make sure desired number of output surfels is reached 
 
-    //remove a surfel, if too many
-     while(cluster_surfel_output_array.size() > surfels_per_node) {
-        remove_surfel(cluster_surfel_output_array);
-    }
+    //remove surfels, if too many
+    remove_surfels(cluster_surfels, surfels_per_node);
 
-    
-    //add a surfel, if too few
-    while(cluster_surfel_output_array.size() < surfels_per_node) {
-        add_surfel (cluster_surfel_output_array, cluster_surfel_array);
-    }
+    //add surfels, if too few
+    add_surfels(cluster_surfels, surfels_per_node);
     
     //average color and postion of output surfels with their neighbours
-    merge(cluster_surfel_output_array);
-    
-
-    //write surfels for output
-    for (auto const& final_cluster_surfel : cluster_surfel_output_array) {
-
-        mem_array.mem_data()->push_back(*(final_cluster_surfel->contained_surfel) );
-    }
+    //and write them for output
+    merge(cluster_surfels, *mem_array.mem_data());
 
     mem_array.set_length(mem_array.mem_data()->size());  
 
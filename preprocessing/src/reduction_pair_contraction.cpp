@@ -7,14 +7,9 @@
 
 #include <lamure/pre/reduction_pair_contraction.h>
 #include <lamure/pre/surfel.h>
-#include <set>
-#include <functional>
-#include <queue>
-#include <deque>
-#include <map>
+#include <lamure/pre/indexed_heap.h>
+#include <algorithm>
 #include <cmath>
-#include <array>
-#include <unordered_map>
 
 // #define DEBUG
 // #define ERROR_COLOR
@@ -55,107 +50,25 @@ quadric_t operator+(const quadric_t& q1, const quadric_t& q2) {
   return q;
 }
 
-struct edge_t
-{
-  edge_t(surfel_id_t p1, surfel_id_t p2) 
-   :a{p1 < p2 ? p1 : p2}
-   ,b{p1 < p2 ? p2 : p1}
-   {};
-
-  surfel_id_t a;
-  surfel_id_t b;
-};
-
-bool operator==(const edge_t& e1, const edge_t& e2) {
-  if(e1.a == e2.a)   {
-    return e1.b == e2.b;
-  }
-  return false;
-}
-
-bool operator<(const edge_t& e1, const edge_t& e2) {
-  if(e1.a < e2.a) {
-    return true;
-  }
-  else {
-    if(e1.a == e2.a) {
-      return e1.b < e2.b;
-    }
-    else return false;
-  }
-}
-
-std::ostream& operator<<(std::ostream& os, const edge_t& e) {
-  os << "<" << e.a << "--" << e.b << ">";
-  return os;
-}
-
-struct contraction_op;
-
+// contraction of the surfels with the ordinals a < b
 struct contraction {
-  contraction(edge_t e, quadric_t quad, real err, surfel surf)
-   :edge{e}
+  contraction(uint32_t first, uint32_t second, quadric_t quad, real err, surfel surf)
+   :a{first}
+   ,b{second}
    ,quadric{quad}
    ,error{err}
    ,new_surfel{surf}
   {}
 
-  edge_t edge;
+  uint32_t a;
+  uint32_t b;
   quadric_t quadric;
   real error;
   surfel new_surfel;
-
-  contraction_op* cont_op;
 };
 
-bool operator<(const contraction& c1, const contraction& c2) {
-  return c1.error < c2.error;
-}
-
-struct contraction_op {
-  contraction_op(contraction* c)
-   :cont{c}
-  {};
-
-  contraction* cont;
-};
-
-bool operator>(const contraction_op& c1, const contraction_op& c2) {
-  // invalid op -> must return false to form strict-weak ordering
-  // otherwise undefined behaviour for sort
-  return c1.cont->error > c2.cont->error;
-}
-
-
 quadric_t edge_quadric(const vec3f& normal_p1, const vec3f& normal_p2, const vec3r& p1, const vec3r& p2);
 
-}
-}
-
-const size_t num_surfels_per_node = 3000;
-const size_t num_nodes_per_level = 14348907;
-namespace std {
-template <> struct hash<lamure::pre::edge_t>
-{
-  size_t operator()(lamure::pre::edge_t const & e) const noexcept
-  {
-    uint16_t h1 = e.a.node_idx * num_surfels_per_node + e.a.surfel_idx;  
-    uint16_t h2 = e.b.node_idx * num_surfels_per_node + e.b.surfel_idx;  
-    size_t hash = h1;
-    hash += h2 >> 16;
-    return hash;
-  }
-};
-template <> struct hash<lamure::surfel_id_t>
-{
-  size_t operator()(lamure::surfel_id_t const & s) const noexcept
-  {
-    return s.node_idx * num_surfels_per_node + s.surfel_idx;  
-  }
-};
-}
-namespace lamure {
-namespace pre {
 
 bool a = false;
 
@@ -181,6 +94,7 @@ vec3b n_to_cb(vec3f normal) {
   return vec3b{uint8_t(normal.x), uint8_t(normal.y), uint8_t(normal.z)}; 
 }
 
+#ifdef ERROR_COLOR
 static vec3b heatmap(float norm_val) {
   vec3f color{0.0f};
   float third = 1 / 3.0f;
@@ -201,6 +115,7 @@ static vec3b heatmap(float norm_val) {
   color *= 255;
   return vec3b{uint8_t(color.x), uint8_t(color.y), uint8_t(color.z)};
 }
+#endif
 
 real qlength(const mat4r& quadric) {
   real a = sqrt(quadric[0]);
@@ -218,73 +133,103 @@ create_lod(real& reduction_error,
           const size_t start_node_id) const
 {
   const uint32_t fan_factor = input.size();
-  size_t num_surfels = 0;
-  size_t min_num_surfels = input[0]->length(); 
-  //compute max total number of surfels from all nodes
-  for (size_t node_idx = 0; node_idx < fan_factor; ++node_idx) {
-    num_surfels += input[node_idx]->length();
 
-    if (input[node_idx]->length() < min_num_surfels) {
-      min_num_surfels = input[node_idx]->length();
+  // surfels are addressed by ordinals: the input surfels node by node,
+  // followed by the surfels created by the contractions. This preserves
+  // the order of their surfel ids
+  std::vector<size_t> node_offsets(fan_factor + 1, 0);
+  for (size_t node_idx = 0; node_idx < fan_factor; ++node_idx) {
+    node_offsets[node_idx + 1] = node_offsets[node_idx] + input[node_idx]->length();
+  }
+  const size_t num_surfels = node_offsets.back();
+  const size_t num_contractions = num_surfels > surfels_per_node ? num_surfels - surfels_per_node : 0;
+  assert(num_surfels + num_contractions <= std::numeric_limits<uint32_t>::max());
+
+  // one slot per input surfel and per surfel that will be created
+  std::vector<surfel> surfels(num_surfels + num_contractions);
+  std::vector<quadric_t> quadrics(num_surfels + num_contractions);
+  std::vector<std::pair<uint32_t, uint32_t>> edges{};
+
+  #ifdef LEAF_REMOVAL
+  auto write_removed_leaf = [&input, &node_offsets, &surfels, num_surfels](const uint32_t ordinal) {
+    if (ordinal < num_surfels) {
+      const size_t node_idx = std::upper_bound(node_offsets.begin(), node_offsets.end(), ordinal) - node_offsets.begin() - 1;
+      surfel surf = surfels[ordinal];
+      surf.color() = vec3b{255,255,255};
+      input[node_idx]->write_surfel(surf, ordinal - node_offsets[node_idx]);
     }
+  };
+  #endif
+
+  // if the input arrays are the child nodes themselves, their
+  // neighbourhoods are computed by the tree in one pass. Resampled copies
+  // are searched locally
+  bool input_is_tree_nodes = true;
+  for (node_id_type node_idx = 0; node_idx < fan_factor; ++node_idx) {
+    input_is_tree_nodes = input_is_tree_nodes &&
+                          input[node_idx] == &tree.nodes()[start_node_id + node_idx].mem_array();
+  }
+  neighbour_graph graph(start_node_id);
+  if (input_is_tree_nodes) {
+    graph = tree.get_neighbour_graph_in_nodes(start_node_id, start_node_id + fan_factor, number_of_neighbours_);
   }
 
-  std::map<surfel_id_t, quadric_t> quadrics{};
-  std::vector<std::vector<surfel>> node_surfels{input.size() + 1, std::vector<surfel>{}};
-  std::set<edge_t> edges{};
   // accumulate edges and point quadrics
   for (node_id_type node_idx = 0; node_idx < fan_factor; ++node_idx) {
     for (size_t surfel_idx = 0; surfel_idx < input[node_idx]->length(); ++surfel_idx) {
       
-      surfel curr_surfel = input[node_idx]->read_surfel(surfel_idx);
+      const uint32_t curr_ordinal = node_offsets[node_idx] + surfel_idx;
       // save surfel
-      node_surfels[node_idx].push_back(curr_surfel);
+      surfels[curr_ordinal] = input[node_idx]->read_surfel(surfel_idx);
+      const surfel& curr_surfel = surfels[curr_ordinal];
       surfel_id_t curr_id = surfel_id_t{node_idx, surfel_idx};
 
-      assert(node_idx < num_nodes_per_level && surfel_idx < num_surfels_per_node);
       // get and store neighbours
-      auto nearest_neighbours = get_local_nearest_neighbours(input, number_of_neighbours_, curr_id);
-      std::vector<surfel_id_t> neighbour_ids{};
-      for (const auto& pair : nearest_neighbours) {
-        neighbour_ids.push_back(pair.first);
+      std::vector<std::pair<surfel_id_t, real>> nearest_neighbours;
+      if (input_is_tree_nodes) {
+        for (const auto& neighbour : graph.neighbours(surfel_id_t{node_id_type(start_node_id + node_idx), surfel_idx})) {
+          surfel_id_t local_id{node_id_type(neighbour.first.node_idx - start_node_id), neighbour.first.surfel_idx};
+          nearest_neighbours.emplace_back(local_id, neighbour.second);
+        }
+      }
+      else {
+        nearest_neighbours = get_local_nearest_neighbours(input, number_of_neighbours_, curr_id);
       }
 
       quadric_t curr_quadric{};
       for (auto const& neighbour : nearest_neighbours) {
-        edge_t curr_edge = edge_t{curr_id, neighbour.first}; 
-        assert(neighbour.first.node_idx < num_nodes_per_level && neighbour.first.surfel_idx <num_surfels_per_node);
-        if (edges.find(curr_edge) == edges.end()) {
-          edges.insert(curr_edge);
-        }
-          // accumulate quadric
-          surfel neighbour_surfel = input[neighbour.first.node_idx]->read_surfel(neighbour.first.surfel_idx);
-          curr_quadric += edge_quadric(curr_surfel.normal(), neighbour_surfel.normal(), curr_surfel.pos(), neighbour_surfel.pos());
+        const uint32_t neighbour_ordinal = node_offsets[neighbour.first.node_idx] + neighbour.first.surfel_idx;
+        edges.emplace_back(std::min(curr_ordinal, neighbour_ordinal), std::max(curr_ordinal, neighbour_ordinal));
+        // accumulate quadric
+        surfel neighbour_surfel = input[neighbour.first.node_idx]->read_surfel(neighbour.first.surfel_idx);
+        curr_quadric += edge_quadric(curr_surfel.normal(), neighbour_surfel.normal(), curr_surfel.pos(), neighbour_surfel.pos());
       }
-      quadrics[curr_id] = curr_quadric;
+      quadrics[curr_ordinal] = curr_quadric;
     }
   }
 
+  // every edge once, in ascending order
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
 
-  // allocate space for new surfels that will be created
-  node_surfels.back() = std::vector<surfel>{num_surfels - surfels_per_node};
   #ifdef DEBUG
   real error_min = std::numeric_limits<real>::max();
   real error_max = 0;
   std::cout << "creating contractions" << std::endl;
-  auto create_contraction = [&node_surfels, &quadrics, &error_max, &error_min](const edge_t& edge)->contraction
+  auto create_contraction = [&surfels, &quadrics, &error_max, &error_min](const uint32_t ordinal_a, const uint32_t ordinal_b)->contraction
   #else
-  auto create_contraction = [&node_surfels, &quadrics](const edge_t& edge)->contraction
+  auto create_contraction = [&surfels, &quadrics](const uint32_t ordinal_a, const uint32_t ordinal_b)->contraction
   #endif
    {
-    const surfel& surfel1 = node_surfels[edge.a.node_idx][edge.a.surfel_idx];
-    const surfel& surfel2 = node_surfels[edge.b.node_idx][edge.b.surfel_idx];
+    const surfel& surfel1 = surfels[ordinal_a];
+    const surfel& surfel2 = surfels[ordinal_b];
     // new surfel is mean of both old surfels
     surfel new_surfel = surfel{(surfel1.pos() + surfel2.pos()) * 0.5,
                           vec3b{(vec3r{surfel1.color()} + vec3r{surfel2.color()}) * 0.5},
                           (surfel1.radius() + surfel2.radius()) * 0.5f,
                           (normalize(surfel1.normal() + surfel2.normal()))
                           };
-    auto new_quadric = (quadrics.at(edge.a) + quadrics.at(edge.b));
+    auto new_quadric = (quadrics[ordinal_a] + quadrics[ordinal_b]);
     real error = new_quadric.error(new_surfel.pos());
     real error1 = new_quadric.error(surfel1.pos());
     real error2 = new_quadric.error(surfel2.pos());
@@ -306,206 +251,139 @@ create_lod(real& reduction_error,
     if (error > error_max) error_max = error;
     if (error < error_min) error_min = error;
     #endif
-    return contraction{edge, std::move(new_quadric), error, std::move(new_surfel)};
+    return contraction{ordinal_a, ordinal_b, std::move(new_quadric), error, std::move(new_surfel)};
   };
 
-  // store contractions and operations in queue
-  std::unordered_map<surfel_id_t, std::map<surfel_id_t,std::shared_ptr<contraction>>> contractions{};
-  std::vector<std::shared_ptr<contraction_op>> contraction_queue{};
+  // one contraction per edge. A contraction keeps its slot while the
+  // surfels it joins are replaced, the slots of discarded ones stay unused.
+  // adjacency lists the (neighbour ordinal, contraction slot) pairs of each
+  // surfel by ascending neighbour ordinal
+  std::vector<contraction> contractions{};
+  contractions.reserve(edges.size());
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> adjacency(surfels.size());
   for (const auto& edge : edges) {
-    if (contractions[edge.a].find(edge.b) != contractions[edge.a].end()) {
-      continue;
-    }
-    // map contraction to both surfels
-    contractions[edge.a][edge.b] = std::make_shared<contraction>(create_contraction(edge));
-    contractions[edge.b][edge.a] = contractions.at(edge.a).at(edge.b);
-    // check surfel id bounds
-    assert(edge.a.node_idx < num_nodes_per_level && edge.a.surfel_idx <num_surfels_per_node);
-    assert(edge.b.node_idx < num_nodes_per_level && edge.b.surfel_idx <num_surfels_per_node);
-    // store contraction operation pointing to new contraction
-    contraction_op op{contractions.at(edge.a).at(edge.b).get()};
-    contraction_queue.push_back(std::make_shared<contraction_op>(op));  
-    // let contraction point to related contraction_op
-    contractions.at(edge.a).at(edge.b)->cont_op = contraction_queue.back().get();  
-    //check pointer correctness
-    assert(contraction_queue.back().get() == contraction_queue.back()->cont->cont_op);
-    assert(contractions.at(edge.a).at(edge.b).get() == contractions.at(edge.a).at(edge.b).get()->cont_op->cont);
-    assert(contractions.at(edge.a).at(edge.b).get() == contractions.at(edge.b).at(edge.a).get());
+    const uint32_t slot = contractions.size();
+    contractions.push_back(create_contraction(edge.first, edge.second));
+    adjacency[edge.first].emplace_back(edge.second, slot);
+    adjacency[edge.second].emplace_back(edge.first, slot);
   }
-  #ifdef DEBUG
-  std::cout << "error min " << error_min << " max " << error_max << std::endl;
+  std::vector<std::pair<uint32_t, uint32_t>>().swap(edges);
 
-  error_min = std::numeric_limits<real>::max();
-  error_max = 0;
-  for (node_id_type node_idx = 0; node_idx < fan_factor; ++node_idx) {
-    for (size_t surfel_idx = 0; surfel_idx < input[node_idx]->length(); ++surfel_idx) {
-      real error = 0;
-      size_t i = 0;
-      for(const auto& pair : contractions.at(surfel_id_t{node_idx, surfel_idx})) {
-        error += pair.second->error;
-        ++i;
-      }
-      error /= real(i);
-      if (error > error_max) error_max = error;
-      if (error < error_min) error_min = error;
-    }
-  }
-  for (node_id_type node_idx = 0; node_idx < fan_factor; ++node_idx) {
-    for (size_t surfel_idx = 0; surfel_idx < input[node_idx]->length(); ++surfel_idx) {
-      surfel& curr_surfel = node_surfels[node_idx][surfel_idx];
-      real error = 0;
-      size_t i = 0;
-      for(const auto& pair : contractions.at(surfel_id_t{node_idx, surfel_idx})) {
-        error += pair.second->error;
-        ++i;
-      }
-      error /= real(i);
-      #ifdef ERROR_COLOR
-      // error of contraction
-      curr_surfel.color() = heatmap((error - error_min) / (error_max - error_min));
-      // binary dir of surfel normal
-      // curr_surfel.color() = n_to_c(curr_surfel.normal());
-      // write to orig data
-      input[node_idx]->write_surfel(curr_surfel, surfel_idx);
-      curr_surfel.color() = vec3b{127, 127, 127};
-      #endif
+  auto find_neighbour = [](std::vector<std::pair<uint32_t, uint32_t>>& neighbours, const uint32_t ordinal) {
+    return std::lower_bound(neighbours.begin(), neighbours.end(), std::make_pair(ordinal, uint32_t(0)));
+  };
+  #ifdef DEBUG
+  for (uint32_t ordinal = 0; ordinal < num_surfels; ++ordinal) {
+    real error = 0;
+    for (const auto& neighbour : adjacency[ordinal]) {
+      error += contractions[neighbour.second].error;
     }
+    error /= real(adjacency[ordinal].size());
+    #ifdef ERROR_COLOR
+    // error of contraction
+    surfel curr_surfel = surfels[ordinal];
+    curr_surfel.color() = heatmap((error - error_min) / (error_max - error_min));
+    // write to orig data
+    const size_t node_idx = std::upper_bound(node_offsets.begin(), node_offsets.end(), ordinal) - node_offsets.begin() - 1;
+    input[node_idx]->write_surfel(curr_surfel, ordinal - node_offsets[node_idx]);
+    surfels[ordinal].color() = vec3b{127, 127, 127};
+    #endif
   }
+  std::cout << "error min " << error_min << " max " << error_max << std::endl;
   size_t n_min = number_of_neighbours_;
   size_t n_max = 0;
   std::cout << "doing contractions" << std::endl;
   #endif
 
-  auto sort_func = [](const std::shared_ptr<contraction_op>& a,
-                      const std::shared_ptr<contraction_op>& b) {
-         return *a > *b;
+  // cheapest contraction on top, equal errors in the order of their edges
+  auto cheapest_first = [&contractions](const size_t left, const size_t right) {
+    if (contractions[left].error != contractions[right].error) {
+      return contractions[left].error < contractions[right].error;
+    }
+    return left < right;
   };
+  indexed_heap<decltype(cheapest_first)> contraction_queue(contractions.size(), cheapest_first);
+  for (size_t slot = 0; slot < contractions.size(); ++slot) {
+    contraction_queue.push(slot);
+  }
 
   // work off queue until target num of surfels is reached
-  for (size_t i = 0; i < num_surfels - surfels_per_node; ++i) {
-    // update queue, cheapest contraction at the back
-    std::sort(contraction_queue.begin(), contraction_queue.end(), sort_func);
+  for (size_t i = 0; i < num_contractions && !contraction_queue.empty(); ++i) {
+    const contraction& curr_contraction = contractions[contraction_queue.top()];
+    contraction_queue.pop();
 
-    contraction curr_contraction = *(contraction_queue.back()->cont);
-    contraction_queue.pop_back();
+    const uint32_t new_id = num_surfels + i;
 
-    #ifdef DEBUG
-    for (int i = contraction_queue.size() - 1; i >= 0; --i) {
-      if (curr_contraction.error > contraction_queue[i]->cont->error) {
-        std::cout << "size2 " << contraction_queue.size() << std::endl;
-        std::cout << contraction_queue[i-1]->cont->error << ", " << contraction_queue[i]->cont->error << ", " << contraction_queue[i+1]->cont->error << std::endl;
-        std::cout << "curr " << curr_contraction.error << ", smaller " << i << " with " << contraction_queue[i]->cont->error << std::endl;
-        throw std::runtime_error("curr " + std::to_string(curr_contraction.error) + ", smaller " + std::to_string(i) + " with " + std::to_string(contraction_queue[i]->cont->error));
-      }
-    }
-    #endif
-
-    assert(node_surfels.size() - 1 >= 0);
-    assert(node_surfels.size() <= std::numeric_limits<int>::max());
-    surfel_id_t new_id = surfel_id_t{uint32_t(node_surfels.size() - 1), i};
-
-    // save new surfels in vector at back
-    surfel& new_surfel = curr_contraction.new_surfel;
     // save new surfel
+    surfels[new_id] = curr_contraction.new_surfel;
     #ifdef ERROR_COLOR
-    new_surfel.color() = heatmap((curr_contraction.error - error_min) / (error_max - error_min));
+    surfels[new_id].color() = heatmap((curr_contraction.error - error_min) / (error_max - error_min));
     #endif
-    node_surfels.back()[i] = new_surfel;
 
-    const surfel_id_t& old_id_1 = curr_contraction.edge.a;
-    const surfel_id_t& old_id_2 = curr_contraction.edge.b;
+    const uint32_t old_id_1 = curr_contraction.a;
+    const uint32_t old_id_2 = curr_contraction.b;
     // invalidate old surfels
     #ifdef LEAF_REMOVAL
-    if (old_id_1.node_idx < fan_factor) {
-      surfel surf = node_surfels[old_id_1.node_idx][old_id_1.surfel_idx];
-      surf.color() = vec3b{255,255,255};
-      input[old_id_1.node_idx]->write_surfel(surf, old_id_1.surfel_idx);
-    }
-    #endif
-    node_surfels[old_id_1.node_idx][old_id_1.surfel_idx].radius() = -1.0f;
-    #ifdef LEAF_REMOVAL
-    if (old_id_2.node_idx < fan_factor) {
-      surfel surf = node_surfels[old_id_2.node_idx][old_id_2.surfel_idx];
-      surf.color() = vec3b{255,255,255};
-      input[old_id_2.node_idx]->write_surfel(surf, old_id_2.surfel_idx);
-    }
+    write_removed_leaf(old_id_1);
+    write_removed_leaf(old_id_2);
     #endif
-    node_surfels[old_id_2.node_idx][old_id_2.surfel_idx].radius() = -1.0f;
+    surfels[old_id_1].radius() = -1.0f;
+    surfels[old_id_2].radius() = -1.0f;
     // add new point quadric
     quadrics[new_id] = curr_contraction.quadric;
-    // delete old point quadrics
-    quadrics.erase(curr_contraction.edge.a);
-    quadrics.erase(curr_contraction.edge.b);
-   
-    auto update_contraction = [&create_contraction, &contractions, &curr_contraction]
-      (const surfel_id_t& new_id, const surfel_id_t& old_id, const std::pair<const surfel_id_t, std::shared_ptr<contraction>>& cont) {
-        edge_t new_edge = edge_t{new_id, cont.first};
-        // store new contraction
-        contractions[new_id][cont.first] = std::make_shared<contraction>(create_contraction(new_edge));
-        // update contractions of neighbour
-        assert(contractions.find(cont.first) != contractions.end());
-        contractions.at(cont.first).erase(old_id);
-        contractions.at(cont.first)[new_id] = contractions.at(new_id).at(cont.first);
-        // get attached operation
-        contraction_op* operation = cont.second->cont_op;
-        // transfer contraction op
-        contractions.at(new_id).at(cont.first)->cont_op = operation;
-        operation->cont = contractions.at(new_id).at(cont.first).get();
-        // check for pointer correctness
-        assert(contractions.at(new_edge.a).at(new_edge.b).get() == contractions.at(new_edge.a).at(new_edge.b).get()->cont_op->cont);
-        assert(contractions.at(new_edge.a).at(new_edge.b).get() == contractions.at(new_edge.b).at(new_edge.a).get());
+
+    auto& new_neighbours = adjacency[new_id];
+
+    // the contraction with the neighbour now joins it with the new surfel
+    auto update_contraction = [&](const uint32_t old_id, const std::pair<uint32_t, uint32_t>& cont) {
+      const uint32_t neighbour_id = cont.first;
+      contractions[cont.second] = create_contraction(std::min(new_id, neighbour_id), std::max(new_id, neighbour_id));
+      contraction_queue.update(cont.second);
+
+      new_neighbours.insert(find_neighbour(new_neighbours, neighbour_id), cont);
+      auto& neighbour_neighbours = adjacency[neighbour_id];
+      neighbour_neighbours.erase(find_neighbour(neighbour_neighbours, old_id));
+      // the new surfel has the highest ordinal so far
+      neighbour_neighbours.emplace_back(new_id, cont.second);
+    };
+    // already added -> remove duplicate contraction
+    auto remove_contraction = [&](const uint32_t old_id, const std::pair<uint32_t, uint32_t>& cont) {
+      auto& neighbour_neighbours = adjacency[cont.first];
+      neighbour_neighbours.erase(find_neighbour(neighbour_neighbours, old_id));
+      contraction_queue.remove(cont.second);
     };
 
     size_t neighbours = 0;
-    for(const auto& cont : contractions.at(old_id_1)) {
+    for (const auto& cont : adjacency[old_id_1]) {
       if (cont.first != old_id_2) {
         #ifdef LIMIT_NEIGHBOURS
         if(neighbours >= number_of_neighbours_) {
-          // already added -> remove duplicate contractions
-          contractions.at(cont.first).erase(old_id_1);
-          // // and invalidate respective operation
-          cont.second->cont_op->cont = nullptr;
+          remove_contraction(old_id_1, cont);
         }
         else
         #endif
         {
-          update_contraction(new_id, old_id_1, cont);
-          assert(contractions.at(cont.first).find(old_id_1) == contractions.at(cont.first).end());
+          update_contraction(old_id_1, cont);
           ++neighbours;
         }
       }
-      else {
-        // invalidate operation
-        cont.second->cont_op->cont = nullptr;
-      }
-    }
-    // in case no new contractions were created yet
-    if(contractions.find(new_id) == contractions.end()) {
-      // std::cout << old_id_1 << std::endl;
-      contractions[new_id];
     }
-    for(const auto& cont : contractions.at(old_id_2)) {
+    for (const auto& cont : adjacency[old_id_2]) {
       if (cont.first != old_id_1) {
+        const auto added = find_neighbour(new_neighbours, cont.first);
+        const bool is_added = added != new_neighbours.end() && added->first == cont.first;
         #ifdef LIMIT_NEIGHBOURS
-        if(contractions.at(new_id).find(cont.first) == contractions.at(new_id).end() && neighbours < number_of_neighbours_)
+        if(!is_added && neighbours < number_of_neighbours_)
         #else
-        if(contractions.at(new_id).find(cont.first) == contractions.at(new_id).end()) 
+        if(!is_added)
         #endif
         {
-          update_contraction(new_id, old_id_2, cont);
+          update_contraction(old_id_2, cont);
           ++neighbours;
         }
         else {
-          // already added -> remove duplicate contractions
-          contractions.at(cont.first).erase(old_id_2);
-          // // and invalidate respective operation
-          cont.second->cont_op->cont = nullptr;
+          remove_contraction(old_id_2, cont);
         }
-        assert(contractions.at(cont.first).find(old_id_2) == contractions.at(cont.first).end());
-      }
-      else {
-        // invalidate operation
-        cont.second->cont_op->cont = nullptr;
       }
     }
     #ifdef DEBUG
@@ -516,22 +394,18 @@ create_lod(real& reduction_error,
       n_max = neighbours;
     }
     #endif
-    // remove old mapping
-    contractions.erase(old_id_1);
-    contractions.erase(old_id_2);
-    //remove invalid contraction operations
-    contraction_queue.erase(std::remove_if(contraction_queue.begin(), contraction_queue.end(), [](const std::shared_ptr<contraction_op>& op){return op->cont == nullptr;}), contraction_queue.end());
+    // remove old adjacency
+    std::vector<std::pair<uint32_t, uint32_t>>().swap(adjacency[old_id_1]);
+    std::vector<std::pair<uint32_t, uint32_t>>().swap(adjacency[old_id_2]);
   }
   #ifdef DEBUG
   std::cout << "neighbours min " << n_min << " max " << n_max << std::endl;
   std::cout << "copying surfels" << std::endl;
   #endif
   surfel_mem_array mem_array(std::make_shared<surfel_vector>(surfel_vector()), 0, 0);
-  for (auto& node : node_surfels) {
-    for (auto& surfel : node) {
-      if (surfel.radius() > 0.0f) {
-        mem_array.mem_data()->push_back(surfel);
-      }
+  for (auto& surfel : surfels) {
+    if (surfel.radius() > 0.0f) {
+      mem_array.mem_data()->push_back(surfel);
     }
   }
   mem_array.set_length(mem_array.mem_data()->size());
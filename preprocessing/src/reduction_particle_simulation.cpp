@@ -9,8 +9,10 @@
 
 #include <lamure/pre/radius_computation_natural_neighbours.h>
 #include <lamure/pre/plane.h>
+#include <lamure/pre/spatial_hash.h>
 
 //#include <math.h>
+#include <algorithm>
 #include <functional>
 #include <numeric>
 #include <vector>
@@ -62,7 +64,8 @@ create_lod(real& reduction_error,
 
     std::vector<std::pair<real, surfel_id_t> > surfel_lookup_vector;
 
-    std::map<surfel_id_t, neighbours_t> surfels_k_nearest_neighbours;
+    // the neighbourhoods of all input surfels, also used for the drawn ones
+    const neighbour_graph graph = tree.get_neighbour_graph(start_node_id, start_node_id + input.size(), 24);
 
     real accumulated_weights = 0.0;
 
@@ -94,8 +97,7 @@ create_lod(real& reduction_error,
 
             surfel_id_t current_surfel_ids(start_node_id + node_id, surfel_id);
 
-            auto neighbours = tree.get_nearest_neighbours( current_surfel_ids, 24 );
-            surfels_k_nearest_neighbours[current_surfel_ids] = neighbours;
+            const neighbour_graph::row neighbours = graph.neighbours( current_surfel_ids );
 
             real enclosing_sphere_radius = compute_enclosing_sphere_radius(current_surfel,
                                                                            neighbours,
@@ -131,11 +133,14 @@ create_lod(real& reduction_error,
         real rand_weighted_surfel_index = (double)std::rand()/ RAND_MAX;
         size_t surfel_vector_idx = surfel_lookup_vector.size() - 1;
 
-        for( size_t vector_idx = 0; vector_idx < surfel_lookup_vector.size(); ++vector_idx) {
-            if ( surfel_lookup_vector[vector_idx].first > rand_weighted_surfel_index ) {
-                surfel_vector_idx = std::max(0, int(vector_idx-1) ) ;
-                break; //stop, we found the index for our surfel
-            }
+        // the accumulated weights are sorted, find the first one above the drawn number
+        auto const first_above = std::upper_bound(surfel_lookup_vector.begin(), surfel_lookup_vector.end(),
+                                                  rand_weighted_surfel_index,
+                                                  [](real const value, std::pair<real, surfel_id_t> const& entry) {
+                                                      return value < entry.first;
+                                                  });
+        if( first_above != surfel_lookup_vector.end() ) {
+            surfel_vector_idx = std::max(0, int(first_above - surfel_lookup_vector.begin()) - 1);
         }
 
         surfel_id_t rand_drawn_indices = surfel_lookup_vector[surfel_vector_idx].second;
@@ -146,7 +151,7 @@ create_lod(real& reduction_error,
 
         surfel_to_push.pos() = surfel_to_push.random_point_on_surfel();
 
-        auto neighbours_of_rand_surfel = tree.get_nearest_neighbours( rand_drawn_indices, 24 );
+        const neighbour_graph::row neighbours_of_rand_surfel = graph.neighbours( rand_drawn_indices );
 
         std::vector<surfel> neighbour_surfs_of_rand_surfel;
         std::vector<vec3r> neighbour_positions;
@@ -181,7 +186,7 @@ create_lod(real& reduction_error,
         //determine color by natural neighbour interpolation (right now from the point of view of the current surfel)
 
         vec3b old_color = surfel_to_push.color();
-        auto nearest_neighbours = tree.get_nearest_neighbours(rand_drawn_indices, 24);
+        const neighbours_t nearest_neighbours = neighbours_of_rand_surfel.to_vector();
         auto const nn_indices = tree.get_natural_neighbours(rand_drawn_indices, nearest_neighbours);
 
         // interpolate colors of natural neighbours
@@ -216,16 +221,54 @@ create_lod(real& reduction_error,
     //repulsion constant k
     double k = 0.001;
     {
-        std::vector<vec3r> particle_displacements;
-
+        size_t const num_particles = particle_repulsion_rad_pairs.size();
 
-        particle_displacements.reserve( particle_repulsion_rad_pairs.size() );
+        // particles only repel each other within their repulsion radius,
+        // so they are bucketed into a grid of about that size
+        std::vector<vec3r> particle_positions;
+        particle_positions.reserve(num_particles);
+        real average_repulsion_radius = 0.0;
         for(auto const& part_rep_pair : particle_repulsion_rad_pairs) {
-            vec3r particle_displacement = vec3r(0.0, 0.0, 0.0);
+            particle_positions.push_back(part_rep_pair.first.pos());
+            average_repulsion_radius += part_rep_pair.second / num_particles;
+        }
+
+        spatial_hash particle_hash;
+        particle_hash.build(particle_positions, average_repulsion_radius);
+
+        // the nearest original surfels of the moved particles are found
+        // the same way
+        std::vector<vec3r> original_positions;
+        original_positions.reserve(original_surfels.size());
+        for(auto const& original_surfel : original_surfels) {
+            original_positions.push_back(original_surfel.pos());
+        }
+
+        spatial_hash original_hash;
+        original_hash.build(original_positions, 0.0);
+
+        // the interpolation only looks at this many nearest original surfels
+        size_t const num_interpolation_neighbours = 24;
+
+        thread_pool& pool = tree.pool();
+        std::vector<std::vector<uint32_t>> worker_indices(pool.num_threads());
+        std::vector<std::vector<surfel>> worker_surfels(pool.num_threads());
+
+        std::vector<vec3r> particle_displacements(num_particles, vec3r(0.0, 0.0, 0.0));
+
+        pool.parallel_for(0, num_particles, [&](size_t const particle_idx, size_t const worker) {
+            auto const& part_rep_pair = particle_repulsion_rad_pairs[particle_idx];
+            vec3r& particle_displacement = particle_displacements[particle_idx];
 
             double r = part_rep_pair.second;
 
-            for(auto const& potential_influence_pair : particle_repulsion_rad_pairs) {
+            // candidates come in ascending order, so the displacement sums up as
+            // if all particles were tested
+            std::vector<uint32_t>& candidates = worker_indices[worker];
+            particle_hash.find_in_radius(part_rep_pair.first.pos(), r, candidates);
+
+            for(auto const candidate_idx : candidates) {
+                auto const& potential_influence_pair = particle_repulsion_rad_pairs[candidate_idx];
 
                 if(potential_influence_pair.first == part_rep_pair.first)
                     continue;
@@ -240,20 +283,29 @@ create_lod(real& reduction_error,
                     particle_displacement += k * (r - neighbour_dist) * particle_neighbour_vec;
                 }
             }
+        }, 64);
 
-            particle_displacements.push_back(particle_displacement);
-        }
-
+        pool.parallel_for(0, num_particles, [&](size_t const particle_idx, size_t const worker) {
+            surfel& particle = particle_repulsion_rad_pairs[particle_idx].first;
+            particle.pos() += particle_displacements[particle_idx];
 
-        size_t displacement_idx = 0;
+            clamp_surfel_to_bb(bb_min, bb_max, particle.pos());
 
-        for(auto& part_rep_pair : particle_repulsion_rad_pairs) {
-            part_rep_pair.first.pos() += particle_displacements[displacement_idx++];
+            // the nearest original surfels in their original order select the
+            // same natural neighbours as the complete set
+            std::vector<uint32_t>& nearest_indices = worker_indices[worker];
+            original_hash.find_nearest(particle.pos(), num_interpolation_neighbours, nearest_indices);
 
-            clamp_surfel_to_bb(bb_min, bb_max, part_rep_pair.first.pos());
+            std::vector<surfel>& nearest_surfels = worker_surfels[worker];
+            nearest_surfels.clear();
+            for(auto const original_idx : nearest_indices) {
+                nearest_surfels.push_back(original_surfels[original_idx]);
+            }
 
-            interpolate_approx_natural_neighbours(part_rep_pair.first, original_surfels, tree);
+            interpolate_approx_natural_neighbours(particle, nearest_surfels, tree, num_interpolation_neighbours);
+        }, 16);
 
+        for(auto const& part_rep_pair : particle_repulsion_rad_pairs) {
             mem_array.mem_data()->push_back(part_rep_pair.first);
         }
 
@@ -268,7 +320,7 @@ create_lod(real& reduction_error,
 
 real reduction_particle_simulation::
 compute_enclosing_sphere_radius(surfel const& target_surfel,
-                                neighbours_t const& neighbour_ids,
+                                neighbour_graph::row const& neighbour_ids,
                                 bvh const& tree) const {
     double enclosing_sphere_radius = 0.0;
 
@@ -0,0 +1,214 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/spatial_hash.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace lamure {
+namespace pre
+{
+
+namespace {
+
+// cell coordinates are packed into 21 bits each
+const int max_cells_per_axis = (1 << 21) - 2;
+
+uint64_t
+cell_key(const int x, const int y, const int z)
+{
+    return (uint64_t(x) << 42) | (uint64_t(y) << 21) | uint64_t(z);
+}
+
+}
+
+void spatial_hash::
+build(const std::vector<vec3r>& positions,
+      real cell_size)
+{
+    positions_ = positions;
+    cells_.clear();
+    num_cells_ = scm::math::vec3i(0);
+
+    if (positions_.empty())
+        return;
+
+    vec3r min_pos(std::numeric_limits<real>::max());
+    vec3r max_pos(std::numeric_limits<real>::lowest());
+    for (const auto& position : positions_) {
+        for (int axis = 0; axis < 3; ++axis) {
+            min_pos[axis] = std::min(min_pos[axis], position[axis]);
+            max_pos[axis] = std::max(max_pos[axis], position[axis]);
+        }
+    }
+
+    const vec3r extent = max_pos - min_pos;
+    const real max_extent = std::max(extent.x, std::max(extent.y, extent.z));
+
+    if (cell_size <= 0.0)
+        cell_size = max_extent / std::max(real(1.0), std::cbrt(real(positions_.size())));
+    cell_size = std::max(cell_size, max_extent / max_cells_per_axis);
+    if (cell_size <= 0.0)
+        cell_size = 1.0;
+
+    origin_ = min_pos;
+    cell_size_ = cell_size;
+    for (int axis = 0; axis < 3; ++axis)
+        num_cells_[axis] = std::min(int(extent[axis] / cell_size_) + 1, max_cells_per_axis);
+
+    cells_.resize(positions_.size());
+    for (uint32_t i = 0; i < positions_.size(); ++i) {
+        const scm::math::vec3i cell = cell_of(positions_[i]);
+        cells_[i] = cell_entry(cell_key(cell.x, cell.y, cell.z), i);
+    }
+    std::sort(cells_.begin(), cells_.end());
+}
+
+scm::math::vec3i spatial_hash::
+cell_of(const vec3r& position) const
+{
+    scm::math::vec3i cell;
+    for (int axis = 0; axis < 3; ++axis) {
+        const real coordinate = std::floor((position[axis] - origin_[axis]) / cell_size_);
+        cell[axis] = int(std::min(std::max(coordinate, real(-1.0)), real(num_cells_[axis])));
+    }
+    return cell;
+}
+
+void spatial_hash::
+collect(const scm::math::vec3i& min_cell,
+        const scm::math::vec3i& max_cell,
+        const scm::math::vec3i& skip_min,
+        const scm::math::vec3i& skip_max,
+        std::vector<uint32_t>& indices) const
+{
+    const scm::math::vec3i zero(0);
+    const scm::math::vec3i last = num_cells_ - scm::math::vec3i(1);
+
+    scm::math::vec3i lower, upper;
+    for (int axis = 0; axis < 3; ++axis) {
+        lower[axis] = std::max(min_cell[axis], zero[axis]);
+        upper[axis] = std::min(max_cell[axis], last[axis]);
+        if (lower[axis] > upper[axis])
+            return;
+    }
+
+    // cells with equal x and y and consecutive z are one range of keys
+    auto add_run = [&](const int x, const int y, const int first_z, const int last_z) {
+        if (first_z > last_z)
+            return;
+        auto it = std::lower_bound(cells_.begin(), cells_.end(),
+                                   cell_entry(cell_key(x, y, first_z), 0));
+        const uint64_t end_key = cell_key(x, y, last_z);
+        for (; it != cells_.end() && it->first <= end_key; ++it)
+            indices.push_back(it->second);
+    };
+
+    for (int x = lower.x; x <= upper.x; ++x) {
+        for (int y = lower.y; y <= upper.y; ++y) {
+            const bool inside_skip = x >= skip_min.x && x <= skip_max.x &&
+                                     y >= skip_min.y && y <= skip_max.y &&
+                                     skip_min.z <= skip_max.z;
+            if (inside_skip) {
+                add_run(x, y, lower.z, std::min(upper.z, skip_min.z - 1));
+                add_run(x, y, std::max(lower.z, skip_max.z + 1), upper.z);
+            }
+            else {
+                add_run(x, y, lower.z, upper.z);
+            }
+        }
+    }
+}
+
+void spatial_hash::
+find_in_radius(const vec3r& center,
+               const real radius,
+               std::vector<uint32_t>& indices) const
+{
+    indices.clear();
+    if (cells_.empty())
+        return;
+
+    const scm::math::vec3i no_skip_min(1), no_skip_max(0);
+    collect(cell_of(center - vec3r(radius)), cell_of(center + vec3r(radius)),
+            no_skip_min, no_skip_max, indices);
+
+    indices.erase(std::remove_if(indices.begin(), indices.end(), [&](const uint32_t i) {
+        return scm::math::length(positions_[i] - center) > radius; }),
+        indices.end());
+    std::sort(indices.begin(), indices.end());
+}
+
+void spatial_hash::
+find_nearest(const vec3r& center,
+             const size_t num_neighbours,
+             std::vector<uint32_t>& indices) const
+{
+    indices.clear();
+    const size_t k = std::min(num_neighbours, positions_.size());
+    if (k == 0)
+        return;
+
+    const scm::math::vec3i center_cell = cell_of(center);
+
+    // the first ring that reaches the grid
+    int ring = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        ring = std::max(ring, -center_cell[axis]);
+        ring = std::max(ring, center_cell[axis] - (num_cells_[axis] - 1));
+    }
+
+    std::vector<std::pair<real, uint32_t>> candidates;
+    std::vector<uint32_t> ring_indices;
+    scm::math::vec3i visited_min(1), visited_max(0);
+
+    while (true) {
+        const scm::math::vec3i ring_min = center_cell - scm::math::vec3i(ring);
+        const scm::math::vec3i ring_max = center_cell + scm::math::vec3i(ring);
+
+        ring_indices.clear();
+        collect(ring_min, ring_max, visited_min, visited_max, ring_indices);
+        for (const auto i : ring_indices)
+            candidates.emplace_back(scm::math::length_sqr(positions_[i] - center), i);
+        visited_min = ring_min;
+        visited_max = ring_max;
+
+        bool covers_grid = true;
+        for (int axis = 0; axis < 3; ++axis)
+            covers_grid = covers_grid && ring_min[axis] <= 0 && ring_max[axis] >= num_cells_[axis] - 1;
+        if (covers_grid)
+            break;
+
+        // points outside the visited cells are at least ring cells away
+        int next_ring = ring + 1;
+        if (candidates.size() >= k) {
+            std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end());
+            const real bound = ring * cell_size_;
+            if (candidates[k - 1].first < bound * bound * (1.0 - 1e-9))
+                break;
+
+            // the ring that reaches the current k-th candidate contains the result
+            const real reach = std::sqrt(candidates[k - 1].first) / cell_size_ + 1.0;
+            next_ring = std::max(next_ring, int(std::min(reach, real(max_cells_per_axis))));
+        }
+        else {
+            // nothing bounds the distance yet, grow geometrically instead
+            // of visiting many empty rings one by one
+            next_ring = std::max(next_ring, 2 * ring);
+        }
+        ring = next_ring;
+    }
+
+    std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+    for (size_t i = 0; i < k; ++i)
+        indices.push_back(candidates[i].second);
+    std::sort(indices.begin(), indices.end());
+}
+
+} } // namespace lamure
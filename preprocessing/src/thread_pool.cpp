@@ -0,0 +1,457 @@
+// Copyright (c) 2014 Bauhaus-Universitaet Weimar
+// This Software is distributed under the Modified BSD License, see license.txt.
+//
+// Virtual Reality and Visualization Research Group
+// Faculty of Media, Bauhaus-Universitaet Weimar
+// http://www.uni-weimar.de/medien/vr
+
+#include <lamure/pre/thread_pool.h>
+
+#include <algorithm>
+
+namespace lamure {
+namespace pre
+{
+
+// pool and worker index of the calling thread while it runs a task
+static thread_local const thread_pool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+// task graph whose task the calling thread runs, if any
+static thread_local void* current_graph = nullptr;
+
+namespace {
+
+template <typename job_type>
+void
+withdraw(std::vector<job_type*>& jobs, job_type* nested_job)
+{
+    jobs.erase(std::remove(jobs.begin(), jobs.end(), nested_job), jobs.end());
+}
+
+}
+
+thread_pool::
+thread_pool(const size_t num_threads)
+{
+    size_t count = num_threads;
+    if (count == 0)
+        count = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t worker = 1; worker < count; ++worker)
+        workers_.push_back(std::thread(&thread_pool::worker_loop, this, worker));
+}
+
+thread_pool::
+~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_condition_.notify_all();
+
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void thread_pool::
+parallel_for(const size_t first,
+             const size_t last,
+             const task_type& task,
+             const size_t grain_size)
+{
+    if (first >= last)
+        return;
+
+    if (current_pool == this && current_graph != nullptr && !workers_.empty() && last - first > 1) {
+        run_nested(*static_cast<job*>(current_graph), first, last, task, grain_size);
+        return;
+    }
+
+    if (current_pool == this || workers_.empty() || last - first == 1) {
+        const size_t worker = current_pool == this ? current_worker : 0;
+        for (size_t index = first; index < last; ++index)
+            task(index, worker);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+
+    const size_t length = last - first;
+    const size_t num_slices = num_threads();
+
+    job current_job;
+    current_job.task = &task;
+    current_job.grain_size = std::max(size_t(1), grain_size);
+    current_job.slices = std::vector<slice>(num_slices);
+    current_job.remaining = length;
+    current_job.queued = 0;
+
+    for (size_t s = 0; s < num_slices; ++s) {
+        current_job.slices[s].begin = first + length * s / num_slices;
+        current_job.slices[s].end = first + length * (s + 1) / num_slices;
+    }
+
+    submit(current_job);
+}
+
+void thread_pool::
+run_tasks(const std::vector<size_t>& initial,
+          const dependent_task_type& task)
+{
+    if (initial.empty())
+        return;
+
+    if (current_pool == this || workers_.empty()) {
+        const size_t worker = current_pool == this ? current_worker : 0;
+        std::vector<size_t> pending(initial.rbegin(), initial.rend());
+        const schedule_type schedule = [&](const size_t index) { pending.push_back(index); };
+        while (!pending.empty()) {
+            const size_t index = pending.back();
+            pending.pop_back();
+            task(index, worker, schedule);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+
+    const size_t num_queues = num_threads();
+
+    job current_job;
+    current_job.dependent_task = &task;
+    current_job.queues = std::vector<queue>(num_queues);
+    current_job.remaining = initial.size();
+    current_job.queued = initial.size();
+
+    for (size_t i = 0; i < initial.size(); ++i)
+        current_job.queues[i % num_queues].indices.push_front(initial[i]);
+
+    submit(current_job);
+}
+
+void thread_pool::
+run_nested(job& graph,
+           const size_t first,
+           const size_t last,
+           const task_type& task,
+           const size_t grain_size)
+{
+    const size_t length = last - first;
+    const size_t num_slices = num_threads();
+
+    job nested_job;
+    nested_job.task = &task;
+    nested_job.grain_size = std::max(size_t(1), grain_size);
+    nested_job.slices = std::vector<slice>(num_slices);
+    nested_job.remaining = length;
+    nested_job.queued = 0;
+    nested_job.parent = &graph;
+
+    for (size_t s = 0; s < num_slices; ++s) {
+        nested_job.slices[s].begin = first + length * s / num_slices;
+        nested_job.slices[s].end = first + length * (s + 1) / num_slices;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(graph.wait_mutex);
+        graph.nested.push_back(&nested_job);
+    }
+    graph.wait_condition.notify_all();
+
+    run(nested_job, current_worker);
+
+    {
+        // nothing is left to take, wait for the helpers to leave
+        std::unique_lock<std::mutex> lock(graph.wait_mutex);
+        withdraw(graph.nested, &nested_job);
+        graph.wait_condition.wait(lock, [&] {
+            return nested_job.remaining == 0 && nested_job.helpers == 0; });
+    }
+
+    if (nested_job.error)
+        std::rethrow_exception(nested_job.error);
+}
+
+void thread_pool::
+help_nested(job& graph, std::unique_lock<std::mutex>& graph_lock, const size_t worker)
+{
+    job& nested_job = *graph.nested.back();
+    ++nested_job.helpers;
+    graph_lock.unlock();
+
+    run(nested_job, worker);
+
+    // once run returns, the loop has nothing left to take
+    graph_lock.lock();
+    withdraw(graph.nested, &nested_job);
+    --nested_job.helpers;
+    graph.wait_condition.notify_all();
+}
+
+void thread_pool::
+submit(job& current_job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &current_job;
+        ++generation_;
+    }
+    wake_condition_.notify_all();
+
+    if (current_job.dependent_task)
+        run_dependent(current_job, 0);
+    else
+        run(current_job, 0);
+
+    {
+        // wait for the remaining tasks, then make sure that no worker
+        // still holds a reference to the job
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_condition_.wait(lock, [&] { return current_job.remaining == 0; });
+        job_ = nullptr;
+        done_condition_.wait(lock, [&] { return active_workers_ == 0; });
+    }
+
+    if (current_job.error)
+        std::rethrow_exception(current_job.error);
+}
+
+void thread_pool::
+worker_loop(const size_t worker)
+{
+    size_t seen_generation = 0;
+
+    while (true) {
+        job* current_job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_condition_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+            if (stop_)
+                return;
+            seen_generation = generation_;
+            if (job_ == nullptr)
+                continue;
+            current_job = job_;
+            ++active_workers_;
+        }
+
+        if (current_job->dependent_task)
+            run_dependent(*current_job, worker);
+        else
+            run(*current_job, worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --active_workers_;
+        }
+        done_condition_.notify_all();
+    }
+}
+
+void thread_pool::
+run(job& current_job, const size_t worker)
+{
+    const thread_pool* previous_pool = current_pool;
+    const size_t previous_worker = current_worker;
+    void* previous_graph = current_graph;
+    current_pool = this;
+    current_worker = worker;
+    current_graph = current_job.parent;
+
+    slice& own = current_job.slices[worker];
+
+    while (true) {
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            begin = own.begin;
+            end = std::min(own.end, own.begin + current_job.grain_size);
+            own.begin = end;
+        }
+
+        if (begin >= end) {
+            if (steal(current_job, worker))
+                continue;
+            break;
+        }
+
+        for (size_t index = begin; index < end; ++index) {
+            try {
+                (*current_job.task)(index, worker);
+            }
+            catch (...) {
+                set_error(current_job);
+            }
+        }
+
+        finish(current_job, end - begin);
+    }
+
+    current_pool = previous_pool;
+    current_worker = previous_worker;
+    current_graph = previous_graph;
+}
+
+void thread_pool::
+run_dependent(job& current_job, const size_t worker)
+{
+    const thread_pool* previous_pool = current_pool;
+    const size_t previous_worker = current_worker;
+    void* previous_graph = current_graph;
+    current_pool = this;
+    current_worker = worker;
+    current_graph = &current_job;
+
+    queue& own = current_job.queues[worker];
+
+    // successors go to the own queue, so that they are likely to run
+    // while their input is still in the cache
+    const schedule_type schedule = [&](const size_t index) {
+        ++current_job.remaining;
+        {
+            std::lock_guard<std::mutex> lock(current_job.wait_mutex);
+            ++current_job.queued;
+        }
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.indices.push_back(index);
+        }
+        current_job.wait_condition.notify_one();
+    };
+
+    while (true) {
+        size_t index;
+        if (pop(current_job, worker, index)) {
+            try {
+                (*current_job.dependent_task)(index, worker, schedule);
+            }
+            catch (...) {
+                set_error(current_job);
+            }
+
+            finish(current_job, 1);
+            continue;
+        }
+
+        // while no task is ready, help with loops started by running tasks
+        std::unique_lock<std::mutex> lock(current_job.wait_mutex);
+        current_job.wait_condition.wait(lock, [&] {
+            return current_job.queued > 0 || current_job.remaining == 0 || !current_job.nested.empty(); });
+        if (current_job.queued > 0)
+            continue;
+        if (!current_job.nested.empty()) {
+            help_nested(current_job, lock, worker);
+            continue;
+        }
+        if (current_job.remaining == 0)
+            break;
+    }
+
+    current_pool = previous_pool;
+    current_worker = previous_worker;
+    current_graph = previous_graph;
+}
+
+bool thread_pool::
+pop(job& current_job, const size_t worker, size_t& index)
+{
+    const size_t num_queues = current_job.queues.size();
+
+    for (size_t i = 0; i < num_queues; ++i) {
+        const size_t q = (worker + i) % num_queues;
+        queue& candidate = current_job.queues[q];
+        std::lock_guard<std::mutex> lock(candidate.mutex);
+        if (candidate.indices.empty())
+            continue;
+
+        // take the newest task from the own queue, the oldest from others
+        if (q == worker) {
+            index = candidate.indices.back();
+            candidate.indices.pop_back();
+        }
+        else {
+            index = candidate.indices.front();
+            candidate.indices.pop_front();
+        }
+        --current_job.queued;
+        return true;
+    }
+
+    return false;
+}
+
+void thread_pool::
+finish(job& current_job, const size_t count)
+{
+    if (current_job.remaining.fetch_sub(count) != count)
+        return;
+
+    // last task of the job, wake up idle and submitting threads
+    {
+        std::lock_guard<std::mutex> lock(current_job.wait_mutex);
+    }
+    current_job.wait_condition.notify_all();
+    if (current_job.parent) {
+        {
+            std::lock_guard<std::mutex> lock(current_job.parent->wait_mutex);
+        }
+        current_job.parent->wait_condition.notify_all();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    done_condition_.notify_all();
+}
+
+void thread_pool::
+set_error(job& current_job)
+{
+    std::lock_guard<std::mutex> lock(current_job.error_mutex);
+    if (!current_job.error)
+        current_job.error = std::current_exception();
+}
+
+bool thread_pool::
+steal(job& current_job, const size_t worker)
+{
+    const size_t num_slices = current_job.slices.size();
+
+    // find the victim with the most work left
+    size_t victim = num_slices;
+    size_t victim_length = 0;
+    for (size_t s = 0; s < num_slices; ++s) {
+        if (s == worker)
+            continue;
+        slice& candidate = current_job.slices[s];
+        std::lock_guard<std::mutex> lock(candidate.mutex);
+        const size_t length = candidate.end - candidate.begin;
+        if (length > victim_length) {
+            victim = s;
+            victim_length = length;
+        }
+    }
+
+    if (victim == num_slices)
+        return false;
+
+    size_t begin, end;
+    {
+        slice& target = current_job.slices[victim];
+        std::lock_guard<std::mutex> lock(target.mutex);
+        if (target.begin >= target.end)
+            return true; // drained in the meantime, look again
+        end = target.end;
+        begin = target.begin + (target.end - target.begin) / 2;
+        target.end = begin;
+    }
+
+    slice& own = current_job.slices[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    own.begin = begin;
+    own.end = end;
+    return true;
+}
+
+} } // namespace lamure
@@ -17,6 +17,7 @@
 #include <lamure/ren/platform.h>
 #include <lamure/types.h>
 #include <lamure/bounding_box.h>
+#include <lamure/surfel_codec.h>
 
 #include <scm/gl_core/primitives/box.h>
 
@@ -61,6 +62,10 @@ public:
     const float         get_avg_primitive_extent(const node_t node_id) const;
     const node_visibility get_visibility(const node_t node_id) const;
     const primitive_type get_primitive() const { return primitive_; }
+    const surfel_encoding get_surfel_encoding() const { return surfel_encoding_; }
+    const node_layout   get_node_layout() const { return node_layout_; }
+    const lod_node_extent get_node_extent(const node_t node_id) const;
+    const uint32_t      get_primitives_in_node(const node_t node_id) const;
     
     void                set_num_nodes(const uint32_t num_nodes) { num_nodes_ = num_nodes; }
     void                set_fan_factor(const uint32_t fan_factor) { fan_factor_ = fan_factor; }
@@ -73,6 +78,9 @@ public:
     void                set_avg_primitive_extent(const node_t node_id, const float radius);
     void                set_visibility(const node_t node_id, const node_visibility visibility);
     void                set_primitive(const primitive_type primitive) { primitive_ = primitive; };
+    void                set_surfel_encoding(const surfel_encoding encoding) { surfel_encoding_ = encoding; };
+    void                set_node_layout(const node_layout layout) { node_layout_ = layout; };
+    void                set_node_extent(const node_t node_id, const lod_node_extent& extent);
 
     void                write_bvh_file(const std::string& filename);
 
@@ -98,6 +106,9 @@ private:
     vec3f               translation_;
    
     primitive_type      primitive_;
+    surfel_encoding     surfel_encoding_;
+    node_layout         node_layout_;
+    std::vector<lod_node_extent> node_extents_; ///< compact layout only
 
 };
 
@@ -231,10 +231,10 @@ protected:
         uint32_t max_surfels_per_node_;
         uint32_t serialized_surfel_size_;
         uint32_t primitive_;
-        uint32_t reserved_0_;
+        uint32_t surfel_encoding_;
 
         bvh_tree_state state_;
-        uint32_t reserved_1_;
+        uint32_t node_layout_;
         uint64_t reserved_2_;
 
         bvh_vector translation_;
@@ -267,9 +267,9 @@ protected:
             file.write((char*)&max_surfels_per_node_, 4);
             file.write((char*)&serialized_surfel_size_, 4);
             file.write((char*)&primitive_, 4);
-            file.write((char*)&reserved_0_, 4);
+            file.write((char*)&surfel_encoding_, 4);
             file.write((char*)&state_, 4);
-            file.write((char*)&reserved_1_, 4);
+            file.write((char*)&node_layout_, 4);
             file.write((char*)&reserved_2_, 8);
             file.write((char*)&translation_.x_, 4);
             file.write((char*)&translation_.y_, 4);
@@ -288,9 +288,9 @@ protected:
             file.read((char*)&max_surfels_per_node_, 4);
             file.read((char*)&serialized_surfel_size_, 4);
             file.read((char*)&primitive_, 4);
-            file.read((char*)&reserved_0_, 4);
+            file.read((char*)&surfel_encoding_, 4);
             file.read((char*)&state_, 4);
-            file.read((char*)&reserved_1_, 4);
+            file.read((char*)&node_layout_, 4);
             file.read((char*)&reserved_2_, 8);
             file.read((char*)&translation_.x_, 4);
             file.read((char*)&translation_.y_, 4);
@@ -32,7 +32,9 @@ bvh()
   size_of_primitive_(0),
   filename_(""),
   translation_(scm::math::vec3f(0.f)),
-  primitive_(primitive_type::POINTCLOUD) {
+  primitive_(primitive_type::POINTCLOUD),
+  surfel_encoding_(surfel_encoding::raw),
+  node_layout_(node_layout::fixed) {
 
 
 } 
@@ -45,7 +47,10 @@ bvh(const std::string& filename)
   primitives_per_node_(0),
   size_of_primitive_(0),
   filename_(""),
-  translation_(scm::math::vec3f(0.f)) {
+  translation_(scm::math::vec3f(0.f)),
+  primitive_(primitive_type::POINTCLOUD),
+  surfel_encoding_(surfel_encoding::raw),
+  node_layout_(node_layout::fixed) {
 
     std::string extension = filename.substr(filename.size()-3);
     if (extension.compare("bvh") == 0) {
@@ -175,6 +180,29 @@ set_visibility(const node_t node_id, const bvh::node_visibility visibility) {
     visibility_[node_id] = visibility;
 };
 
+const lod_node_extent bvh::
+get_node_extent(const node_t node_id) const {
+    assert(node_id >= 0 && node_id < num_nodes_);
+    if (node_layout_ == node_layout::fixed) {
+       return lod_node_extent{node_id * primitives_per_node_, primitives_per_node_};
+    }
+    return node_extents_[node_id];
+}
+
+const uint32_t bvh::
+get_primitives_in_node(const node_t node_id) const {
+    return uint32_t(get_node_extent(node_id).length);
+}
+
+void bvh::
+set_node_extent(const node_t node_id, const lod_node_extent& extent) {
+    assert(node_id >= 0 && node_id < num_nodes_);
+    while (node_extents_.size() <= node_id) {
+       node_extents_.push_back(lod_node_extent{0, 0});
+    }
+    node_extents_[node_id] = extent;
+}
+
 
 
 } } // namespace lamure
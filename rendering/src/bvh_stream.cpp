@@ -255,6 +255,8 @@ read_bvh(const std::string& filename, bvh& bvh) {
     bvh.set_primitives_per_node(tree.max_surfels_per_node_);
     bvh.set_size_of_primitive(tree.serialized_surfel_size_);
     bvh.set_primitive((bvh::primitive_type)tree.primitive_);
+    bvh.set_surfel_encoding((surfel_encoding)tree.surfel_encoding_);
+    bvh.set_node_layout((node_layout)tree.node_layout_);
     scm::math::vec3f translation(tree.translation_.x_,
                                 tree.translation_.y_,
                                 tree.translation_.z_);
@@ -282,6 +284,18 @@ read_bvh(const std::string& filename, bvh& bvh) {
    
     }
 
+    if (bvh.get_node_layout() != node_layout::fixed) {
+       if (nodes_ext.size() != bvh.get_num_nodes()) {
+           throw std::runtime_error(
+               "lamure: bvh_stream::Stream corrupt -- Compact layout without node extents");
+       }
+       for (const auto& node_ext : nodes_ext) {
+           bvh.set_node_extent(node_ext.node_id_,
+                               lod_node_extent{node_ext.disk_array_.offset_,
+                                               node_ext.disk_array_.length_});
+       }
+    }
+
 }
 
 void bvh_stream::
@@ -317,9 +331,9 @@ write_bvh(const std::string& filename, bvh& bvh) {
    tree.max_surfels_per_node_ = bvh.get_primitives_per_node();
    tree.serialized_surfel_size_ = bvh.get_size_of_primitive();
    tree.primitive_ = (bvh_primitive_type)bvh.get_primitive();
-   tree.reserved_0_ = 0;
+   tree.surfel_encoding_ = (uint32_t)bvh.get_surfel_encoding();
    tree.state_ = bvh_tree_state::BVH_STATE_SERIALIZED;
-   tree.reserved_1_ = 0;
+   tree.node_layout_ = (uint32_t)bvh.get_node_layout();
    tree.reserved_2_ = 0;
    tree.translation_.x_ = bvh.get_translation().x;
    tree.translation_.y_ = bvh.get_translation().y;
@@ -352,6 +366,22 @@ write_bvh(const std::string& filename, bvh& bvh) {
        write(node);
    }
 
+   if (bvh.get_node_layout() != node_layout::fixed) {
+       for (uint32_t node_id = 0; node_id < bvh.get_num_nodes(); ++node_id) {
+           const lod_node_extent extent = bvh.get_node_extent(node_id);
+           bvh_node_extension_seg node_ext;
+           node_ext.segment_id_ = num_segments_++;
+           node_ext.node_id_ = node_id;
+           node_ext.empty_ = extent.length == 0 ? 1 : 0;
+           node_ext.reserved_ = 0;
+           node_ext.disk_array_.disk_access_ref_ = 0;
+           node_ext.disk_array_.reserved_ = 0;
+           node_ext.disk_array_.offset_ = extent.offset;
+           node_ext.disk_array_.length_ = extent.length;
+           write(node_ext);
+       }
+   }
+
    close_stream(false);
 
 }
@@ -109,6 +109,7 @@ run() {
     }
 
     char* local_cache = new char[size_of_slot_];
+    char* decoded_cache = new char[size_of_slot_];
 
     while (true) {
         semaphore_.wait();
@@ -121,27 +122,53 @@ run() {
         if (job.node_id_ != invalid_node_t) {
             assert(job.slot_mem_ != nullptr);
 
+            const bvh* bvh = database->get_model(job.model_id_)->get_bvh();
+            const surfel_encoding encoding = bvh->get_surfel_encoding();
+
             size_t stride_in_bytes = database->get_node_size(job.model_id_);
             size_t offset_in_bytes = job.node_id_ * stride_in_bytes;
+            size_t bytes_in_file = stride_in_bytes;
+            size_t bytes_decoded = stride_in_bytes;
+
+            // encoded or compact nodes are addressed by their extent
+            const bool raw_fixed = encoding == surfel_encoding::raw
+                                && bvh->get_node_layout() == node_layout::fixed;
+            const lod_node_extent extent = bvh->get_node_extent(job.node_id_);
+            if (!raw_fixed) {
+                const size_t surfel_size = surfel_codec::encoded_size(encoding);
+                offset_in_bytes = extent.offset * surfel_size;
+                bytes_in_file = extent.length * surfel_size;
+                bytes_decoded = extent.length * sizeof(dataset::serialized_surfel);
+            }
 
+            if (bytes_in_file > 0) {
 #ifdef LAMURE_ENABLE_CONCURRENT_FILE_ACCESS
-            lod_streams[job.model_id_]->read(local_cache, offset_in_bytes, stride_in_bytes);
+                lod_streams[job.model_id_]->read(local_cache, offset_in_bytes, bytes_in_file);
 #else
-            lod_stream access;
-            access.open(lod_files[job.model_id_]);
-            access.read(local_cache, offset_in_bytes, stride_in_bytes);
+                lod_stream access;
+                access.open(lod_files[job.model_id_]);
+                access.read(local_cache, offset_in_bytes, bytes_in_file);
+                access.close();
 #endif
+            }
+
+            char* node_data = local_cache;
+            if (encoding != surfel_encoding::raw) {
+                const scm::gl::boxf& box = bvh->get_bounding_box(job.node_id_);
+                surfel_codec::decode_node(local_cache, decoded_cache,
+                                          extent.length, encoding,
+                                          box.min_vertex(), box.max_vertex());
+                node_data = decoded_cache;
+            }
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                bytes_loaded_ += stride_in_bytes;
-                memcpy(job.slot_mem_, local_cache, stride_in_bytes);
+                bytes_loaded_ += bytes_in_file;
+                memcpy(job.slot_mem_, node_data, bytes_decoded);
+                // the rest of the slot holds empty surfels, as in a padded node
+                memset(job.slot_mem_ + bytes_decoded, 0, stride_in_bytes - bytes_decoded);
                 history_.push_back(job);
             }
 
-#ifndef LAMURE_ENABLE_CONCURRENT_FILE_ACCESS
-            access.close();
-#endif
-
         }
 
     }
@@ -165,6 +192,10 @@ run() {
             delete[] local_cache;
             local_cache = nullptr;
         }
+        if (decoded_cache != nullptr) {
+            delete[] decoded_cache;
+            decoded_cache = nullptr;
+        }
     }
 }
 